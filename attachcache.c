@@ -0,0 +1,237 @@
+#include "attachcache.h"
+
+#include "platform.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <inttypes.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#define CACHE_DIR "wow335pa"
+#define CACHE_FILE "attach.cache"
+// "W3AC"; the version changes with the layout of struct CacheFile
+#define CACHE_MAGIC 0x43413357u
+#define CACHE_VERSION 1u
+#define CACHE_ENTRIES 8
+
+struct CacheEntry {
+	// 0 for an unused entry
+	uint64_t pid;
+	// Tells a later process that got the same pid apart
+	uint64_t startTime;
+	struct PeModule module;
+};
+
+struct CacheFile {
+	uint32_t magic;
+	uint32_t version;
+	// Entry the next new process replaces
+	uint32_t next;
+	uint32_t reserved;
+	struct CacheEntry entries[CACHE_ENTRIES];
+};
+
+// The plugin stores from the discovery thread and the positional thread
+static plat_mutex_t storeLock = PLAT_MUTEX_INITIALIZER;
+
+// Fills dir with the cache directory and path with the file in it
+static bool cachePath(char *dir, char *path, size_t size) {
+#ifdef _WIN32
+	const char *localAppData = getenv("LOCALAPPDATA");
+	if (!localAppData) {
+		return false;
+	}
+	snprintf(dir, size, "%s\\%s", localAppData, CACHE_DIR);
+	snprintf(path, size, "%s\\%s", dir, CACHE_FILE);
+#else
+	const char *xdg = getenv("XDG_DATA_HOME");
+	if (xdg && xdg[0]) {
+		snprintf(dir, size, "%s/%s", xdg, CACHE_DIR);
+	} else {
+		const char *home = getenv("HOME");
+		if (!home) {
+			return false;
+		}
+		snprintf(dir, size, "%s/.local/share/%s", home, CACHE_DIR);
+	}
+	snprintf(path, size, "%s/%s", dir, CACHE_FILE);
+#endif
+	return true;
+}
+
+// Creates dir and any missing parents; failures show when the file is written
+static void makeDirectories(char *dir) {
+	for (char *at = dir + 1;; at++) {
+		char separator = *at;
+		if (separator != '/' && separator != '\\' && separator != '\0') {
+			continue;
+		}
+		*at = '\0';
+#ifdef _WIN32
+		CreateDirectoryA(dir, NULL);
+#else
+		mkdir(dir, 0700);
+#endif
+		*at = separator;
+		if (separator == '\0') {
+			break;
+		}
+	}
+}
+
+// When the process started, in a unit that only has to be stable while it
+// runs; 0 if it cannot be told
+static uint64_t processStartTime(uint64_t pid) {
+#ifdef _WIN32
+	HANDLE process =
+		OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, (DWORD) pid);
+	if (process == NULL) {
+		return 0;
+	}
+	FILETIME creation, exitTime, kernel, user;
+	uint64_t startTime = 0;
+	if (GetProcessTimes(process, &creation, &exitTime, &kernel, &user)) {
+		startTime = (uint64_t) creation.dwHighDateTime << 32
+					| creation.dwLowDateTime;
+	}
+	CloseHandle(process);
+	return startTime;
+#else
+	char path[64];
+	char line[1024];
+	snprintf(path, sizeof(path), "/proc/%" PRIu64 "/stat", pid);
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		return 0;
+	}
+	size_t length = fread(line, 1, sizeof(line) - 1, file);
+	fclose(file);
+	line[length] = '\0';
+
+	// The name in parentheses may contain anything; starttime is the 20th
+	// field after it, in clock ticks since boot
+	const char *field = strrchr(line, ')');
+	for (int i = 0; field && i < 20; i++) {
+		field = strchr(field + 1, ' ');
+	}
+	return field ? strtoull(field + 1, NULL, 10) : 0;
+#endif
+}
+
+// Copies the cache file into cache; false if there is none or it is not one
+static bool loadFile(const char *path, struct CacheFile *cache) {
+	size_t size;
+	const void *data = plat_map_file(path, &size);
+	if (!data) {
+		return false;
+	}
+	bool valid = size == sizeof(*cache);
+	if (valid) {
+		memcpy(cache, data, sizeof(*cache));
+		valid = cache->magic == CACHE_MAGIC && cache->version == CACHE_VERSION
+				&& cache->next < CACHE_ENTRIES;
+	}
+	plat_unmap_file(data, size);
+	return valid;
+}
+
+static bool replaceFile(const char *path, const struct CacheFile *cache) {
+	char tmpPath[600];
+#ifdef _WIN32
+	snprintf(tmpPath, sizeof(tmpPath), "%s.%lu.tmp", path,
+			 (unsigned long) GetCurrentProcessId());
+#else
+	snprintf(tmpPath, sizeof(tmpPath), "%s.%ld.tmp", path, (long) getpid());
+#endif
+	FILE *file = fopen(tmpPath, "wb");
+	if (!file) {
+		return false;
+	}
+	bool written = fwrite(cache, sizeof(*cache), 1, file) == 1;
+	written      = fclose(file) == 0 && written;
+
+#ifdef _WIN32
+	written = written
+			  && MoveFileExA(tmpPath, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	written = written && rename(tmpPath, path) == 0;
+#endif
+	if (!written) {
+		remove(tmpPath);
+	}
+	return written;
+}
+
+bool attachcache_load(uint64_t pid, PemapReadFn read, void *userdata,
+					  struct PeModule *module) {
+	char dir[512], path[512];
+	struct CacheFile cache;
+	if (pid == 0 || !cachePath(dir, path, sizeof(path))
+		|| !loadFile(path, &cache)) {
+		return false;
+	}
+
+	const struct CacheEntry *entry = NULL;
+	for (size_t i = 0; i < CACHE_ENTRIES && !entry; i++) {
+		if (cache.entries[i].pid == pid) {
+			entry = &cache.entries[i];
+		}
+	}
+	uint64_t startTime = processStartTime(pid);
+	if (!entry || startTime == 0 || entry->startTime != startTime) {
+		return false;
+	}
+
+	// The image may have been unloaded and another one loaded in its place
+	uint32_t timestamp;
+	const struct PeModule *cached = &entry->module;
+	if (!read(userdata,
+			  cached->base + cached->ntOffset + PEMAP_TIMESTAMP_OFFSET,
+			  &timestamp, sizeof(timestamp))
+		|| timestamp != cached->timestamp) {
+		return false;
+	}
+	*module = *cached;
+	return true;
+}
+
+void attachcache_store(uint64_t pid, const struct PeModule *module) {
+	char dir[512], path[512];
+	uint64_t startTime = processStartTime(pid);
+	if (pid == 0 || startTime == 0 || !cachePath(dir, path, sizeof(path))) {
+		return;
+	}
+	makeDirectories(dir);
+
+	plat_mutex_lock(&storeLock);
+	struct CacheFile cache;
+	if (!loadFile(path, &cache)) {
+		memset(&cache, 0, sizeof(cache));
+		cache.magic   = CACHE_MAGIC;
+		cache.version = CACHE_VERSION;
+	}
+
+	struct CacheEntry *entry = NULL;
+	for (size_t i = 0; i < CACHE_ENTRIES && !entry; i++) {
+		if (cache.entries[i].pid == pid) {
+			entry = &cache.entries[i];
+		}
+	}
+	if (!entry) {
+		entry      = &cache.entries[cache.next];
+		cache.next = (cache.next + 1) % CACHE_ENTRIES;
+	}
+	memset(entry, 0, sizeof(*entry));
+	entry->pid       = pid;
+	entry->startTime = startTime;
+	entry->module    = *module;
+
+	replaceFile(path, &cache);
+	plat_mutex_unlock(&storeLock);
+}
@@ -0,0 +1,30 @@
+#ifndef WOW335PA_ATTACHCACHE_H_
+#define WOW335PA_ATTACHCACHE_H_
+
+// Remembers where the client image was found in running clients, so attaching
+// again after Mumble restarts or the plugin reloads skips the module scan
+// (pemap.h). The entries live in a small file in the user's data directory:
+//   Linux:   $XDG_DATA_HOME/wow335pa/attach.cache
+//            (default ~/.local/share/wow335pa/attach.cache)
+//   Windows: %LOCALAPPDATA%\wow335pa\attach.cache
+// An entry is keyed by the pid, the process's start time and the TimeDateStamp
+// of the image, so a new process that got the same pid or a different build
+// never matches. The file is mapped to look an entry up and replaced as a
+// whole (written next to it, then renamed) to store one.
+
+#include "pemap.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Fills module from the entry for pid if the process is the one that was
+// stored and the image still carries the stored timestamp, which costs one
+// read through read. Reads files, so it belongs to attach time.
+bool attachcache_load(uint64_t pid, PemapReadFn read, void *userdata,
+					  struct PeModule *module);
+
+// Records module as the image of pid, replacing the process's previous entry
+// or the oldest one. Failures only mean the next attach scans again.
+void attachcache_store(uint64_t pid, const struct PeModule *module);
+
+#endif // WOW335PA_ATTACHCACHE_H_
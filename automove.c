@@ -0,0 +1,195 @@
+#include "automove.h"
+
+#include "channels.h"
+#include "config.h"
+#include "events.h"
+#include "mainthread.h"
+#include "plugin.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_MAPPINGS 64
+#define MAX_CHANNEL_NAME 128
+
+struct ChannelMapping {
+	int id;
+	char channel[MAX_CHANNEL_NAME];
+};
+
+struct MappingTable {
+	struct ChannelMapping mappings[MAX_MAPPINGS];
+	size_t count;
+};
+
+static struct MappingTable mapTable;
+static struct MappingTable zoneTable;
+static char defaultChannel[MAX_CHANNEL_NAME];
+static uint64_t debounceNs;
+
+// Dispatcher thread state
+static bool inWorld              = false;
+static int currentMap            = -1;
+static int currentZone           = -1;
+static const char *pendingTarget = NULL;
+static uint64_t pendingDeadline  = 0;
+static const char *appliedTarget = NULL;
+
+static atomic_bool resyncRequested = false;
+
+static void addMapping(const char *key, const char *value, void *userdata) {
+	struct MappingTable *table = userdata;
+	char *end;
+	long id = strtol(key, &end, 10);
+	if (end == key || *end != '\0' || table->count == MAX_MAPPINGS) {
+		return;
+	}
+
+	table->mappings[table->count].id = (int) id;
+	snprintf(table->mappings[table->count].channel, MAX_CHANNEL_NAME, "%s",
+			 value);
+	table->count++;
+}
+
+static const char *lookup(const struct MappingTable *table, int id) {
+	for (size_t i = 0; i < table->count; i++) {
+		if (table->mappings[i].id == id) {
+			return table->mappings[i].channel;
+		}
+	}
+	return NULL;
+}
+
+static const char *targetFor(int mapId, int zoneId) {
+	const char *target = lookup(&zoneTable, zoneId);
+	if (!target) {
+		target = lookup(&mapTable, mapId);
+	}
+	if (!target && defaultChannel[0]) {
+		target = defaultChannel;
+	}
+	return target;
+}
+
+static void schedule(const char *target, uint64_t nowNs) {
+	pendingTarget   = target;
+	pendingDeadline = nowNs + debounceNs;
+}
+
+static void onGameEvent(const struct GameEvent *event, void *userdata) {
+	(void) userdata;
+
+	if (event->type == GAME_EVENT_LEFT_WORLD) {
+		// Loading screen: wait for the next map before deciding anything
+		inWorld       = false;
+		pendingTarget = NULL;
+		return;
+	}
+
+	inWorld     = true;
+	currentMap  = event->mapId;
+	currentZone = event->zoneId;
+
+	const char *target = targetFor(currentMap, currentZone);
+	if (target != appliedTarget) {
+		schedule(target, event->timestampNs);
+	} else {
+		pendingTarget = NULL;
+	}
+}
+
+// Main thread, queued by onTick
+static void moveTo(const void *data, size_t size) {
+	(void) size;
+	const char *target = data;
+	char logBuffer[256];
+	mumble_connection_t connection;
+	mumble_channelid_t channel;
+
+	if (!channels_findByName(target, &connection, &channel)) {
+		snprintf(logBuffer, sizeof(logBuffer),
+				 "Auto-move: no channel named \"%s\"", target);
+		mumbleAPI.log(ownID, logBuffer);
+		return;
+	}
+
+	mumble_connection_t active;
+	mumble_userid_t localUser;
+	mumble_channelid_t currentChannel;
+	if (mumbleAPI.getActiveServerConnection(ownID, &active) != MUMBLE_STATUS_OK
+		|| active != connection
+		|| mumbleAPI.getLocalUserID(ownID, connection, &localUser)
+			   != MUMBLE_STATUS_OK
+		|| mumbleAPI.getChannelOfUser(ownID, connection, localUser,
+									  &currentChannel)
+			   != MUMBLE_STATUS_OK) {
+		return;
+	}
+
+	if (currentChannel == channel) {
+		return;
+	}
+
+	if (mumbleAPI.requestUserMove(ownID, connection, localUser, channel, NULL)
+		== MUMBLE_STATUS_OK) {
+		snprintf(logBuffer, sizeof(logBuffer), "Auto-move: joined \"%s\"",
+				 target);
+		mumbleAPI.log(ownID, logBuffer);
+	}
+}
+
+static void onTick(uint64_t nowNs, void *userdata) {
+	(void) userdata;
+
+	if (atomic_exchange(&resyncRequested, false) && inWorld) {
+		appliedTarget = NULL;
+		schedule(targetFor(currentMap, currentZone), nowNs);
+	}
+
+	if (!pendingTarget || nowNs < pendingDeadline) {
+		return;
+	}
+
+	// The main thread moves us; tried again on the next tick while the queue
+	// is full
+	if (!mainthread_post(moveTo, pendingTarget, strlen(pendingTarget) + 1)) {
+		return;
+	}
+	appliedTarget = pendingTarget;
+	pendingTarget = NULL;
+}
+
+void automove_init(void) {
+	mapTable.count  = 0;
+	zoneTable.count = 0;
+	config_forEach("automove.map.", addMapping, &mapTable);
+	config_forEach("automove.zone.", addMapping, &zoneTable);
+	snprintf(defaultChannel, sizeof(defaultChannel), "%s",
+			 config_getString("automove.default", ""));
+	debounceNs =
+		(uint64_t) config_getInt("automove.debounce_ms", 2000) * 1000000ull;
+
+	inWorld       = false;
+	pendingTarget = NULL;
+	appliedTarget = NULL;
+
+	if (!config_getBool("automove.enabled", true)
+		|| (mapTable.count == 0 && zoneTable.count == 0
+			&& !defaultChannel[0])) {
+		return;
+	}
+
+	events_subscribe(GAME_EVENT_MASK(GAME_EVENT_ENTERED_WORLD)
+						 | GAME_EVENT_MASK(GAME_EVENT_LEFT_WORLD)
+						 | GAME_EVENT_MASK(GAME_EVENT_MAP_CHANGED)
+						 | GAME_EVENT_MASK(GAME_EVENT_ZONE_CHANGED),
+					 onGameEvent, NULL);
+	events_subscribeTick(onTick, NULL);
+}
+
+void automove_onServerSynchronized(mumble_connection_t connection) {
+	(void) connection;
+	atomic_store(&resyncRequested, true);
+}
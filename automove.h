@@ -0,0 +1,22 @@
+#ifndef WOW335PA_AUTOMOVE_H_
+#define WOW335PA_AUTOMOVE_H_
+
+// Moves the local user into the channel configured for the current map or
+// zone. Configuration (see config.h):
+//   automove.enabled     = true
+//   automove.debounce_ms = 2000
+//   automove.zone.<id>   = <channel name>   (takes precedence over the map)
+//   automove.map.<id>    = <channel name>
+//   automove.default     = <channel name>   (in world, no mapping matched)
+// The move itself is made on Mumble's main thread, at its next callback after
+// the debounce (see mainthread.h).
+
+#include "PluginComponents_v_1_0_x.h"
+
+// Reads the mapping and subscribes to game events. Call before events_start().
+void automove_init(void);
+
+// Re-applies the current target channel once the server is synchronized
+void automove_onServerSynchronized(mumble_connection_t connection);
+
+#endif // WOW335PA_AUTOMOVE_H_
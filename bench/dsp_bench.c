@@ -0,0 +1,83 @@
+// Cost of the per-source gain + low-pass kernel for every buffer size Mumble
+// uses at 48 kHz (2.5 ms to 60 ms), mono and stereo, next to a plain scalar
+// loop doing the same work. The gain changes on every call so the ramp is
+// always active.
+
+#include "dsp.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ITERATIONS 20000
+#define MAX_SAMPLES 2880
+
+// Fresh input is copied in before every call, outside of the timing, so the
+// signal does not decay into denormals over the iterations
+static float input[2 * MAX_SAMPLES];
+static float buffer[2 * MAX_SAMPLES];
+
+static void scalarReference(struct DspVoice *voice, float *pcm,
+							uint32_t sampleCount, uint16_t channelCount,
+							float gain, float a) {
+	float g    = voice->gain;
+	float step = (gain - g) / (float) sampleCount;
+	for (uint32_t i = 0; i < sampleCount; i++) {
+		for (uint16_t c = 0; c < channelCount; c++) {
+			float *x          = &pcm[i * channelCount + c];
+			voice->lowpass[c] = (1.0f - a) * *x + a * voice->lowpass[c];
+			*x                = voice->lowpass[c] * g;
+		}
+		g += step;
+	}
+	voice->gain = gain;
+}
+
+static void run(uint32_t sampleCount, uint16_t channelCount) {
+	const float a = dsp_lowpassCoefficient(3000.0f, 48000);
+	struct DspVoice voice;
+	uint64_t kernelNs = 0, scalarNs = 0;
+
+	dsp_voiceReset(&voice, 1.0f);
+	for (int i = 0; i < ITERATIONS; i++) {
+		float gain = (i & 1) ? 0.25f : 0.75f;
+		memcpy(buffer, input, sizeof(buffer));
+		uint64_t start = plat_now_ns();
+		dsp_process(&voice, buffer, sampleCount, channelCount, gain, a);
+		kernelNs += plat_now_ns() - start;
+	}
+
+	dsp_voiceReset(&voice, 1.0f);
+	for (int i = 0; i < ITERATIONS; i++) {
+		float gain = (i & 1) ? 0.25f : 0.75f;
+		memcpy(buffer, input, sizeof(buffer));
+		uint64_t start = plat_now_ns();
+		scalarReference(&voice, buffer, sampleCount, channelCount, gain, a);
+		scalarNs += plat_now_ns() - start;
+	}
+
+	double samples = (double) sampleCount * channelCount;
+	printf("%4u frames x %u ch: kernel %7.1f ns (%5.2f ns/sample)  scalar "
+		   "%7.1f ns (%5.2f ns/sample)\n",
+		   sampleCount, channelCount, (double) kernelNs / ITERATIONS,
+		   (double) kernelNs / ITERATIONS / samples,
+		   (double) scalarNs / ITERATIONS,
+		   (double) scalarNs / ITERATIONS / samples);
+}
+
+int main(void) {
+	static const uint32_t sizes[] = { 120, 240, 480, 960, 1920, 2880 };
+
+	srand(42);
+	for (uint32_t i = 0; i < 2 * MAX_SAMPLES; i++) {
+		input[i] = (float) rand() / (float) RAND_MAX - 0.5f;
+	}
+	for (uint16_t channels = 1; channels <= 2; channels++) {
+		for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+			run(sizes[i], channels);
+		}
+	}
+
+	return 0;
+}
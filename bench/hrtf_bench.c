@@ -0,0 +1,111 @@
+// Cost of binaural rendering per source with a synthetic HRIR set of typical
+// size (256 taps at 48 kHz on a 5 degree grid). Every frame renders all
+// sources in 10 ms Mumble frames while they circle around the listener, so
+// direction changes and their crossfades are included.
+
+#include "hrtf.h"
+#include "platform.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_RATE 48000
+#define FRAME 480
+#define SECONDS 10
+#define TAPS 256
+#define ELEVATIONS 37
+#define AZIMUTHS 72
+
+static float input[FRAME];
+static float output[2 * FRAME];
+
+static void putU32(uint8_t *p, uint32_t v) {
+	p[0] = (uint8_t) v;
+	p[1] = (uint8_t) (v >> 8);
+	p[2] = (uint8_t) (v >> 16);
+	p[3] = (uint8_t) (v >> 24);
+}
+
+static void putF32(uint8_t *p, float v) {
+	uint32_t bits;
+	memcpy(&bits, &v, sizeof(bits));
+	putU32(p, bits);
+}
+
+static bool loadSyntheticSet(void) {
+	size_t taps   = (size_t) ELEVATIONS * AZIMUTHS * 2 * TAPS;
+	size_t size   = 32 + taps * sizeof(float);
+	uint8_t *data = malloc(size);
+	if (!data) {
+		return false;
+	}
+
+	memcpy(data, "W3HR", 4);
+	putU32(data + 4, 1);
+	putU32(data + 8, SAMPLE_RATE);
+	putU32(data + 12, TAPS);
+	putU32(data + 16, ELEVATIONS);
+	putU32(data + 20, AZIMUTHS);
+	putF32(data + 24, -90.0f);
+	putF32(data + 28, 5.0f);
+	for (size_t i = 0; i < taps; i++) {
+		// Decaying noise, roughly the energy envelope of a real HRIR
+		float decay = expf(-(float) (i % TAPS) / 24.0f);
+		putF32(data + 32 + i * 4,
+			   decay * ((float) rand() / (float) RAND_MAX - 0.5f));
+	}
+
+	bool ok = hrtf_loadMemory(data, size);
+	free(data);
+	return ok;
+}
+
+static void run(uint32_t sources) {
+	const uint32_t frames = SECONDS * SAMPLE_RATE / FRAME;
+	uint64_t renderNs     = 0;
+
+	for (uint32_t frame = 0; frame < frames; frame++) {
+		uint64_t start = plat_now_ns();
+		for (uint32_t s = 0; s < sources; s++) {
+			// One revolution every 4 seconds, spread over the sources
+			float angle        = (float) frame * 0.0157f + (float) s;
+			float direction[3] = { cosf(angle), sinf(angle), 0.2f };
+			hrtf_render(s, input, FRAME, 1, SAMPLE_RATE, direction);
+		}
+		memset(output, 0, sizeof(output));
+		hrtf_mix(output, FRAME, 2);
+		renderNs += plat_now_ns() - start;
+	}
+
+	double seconds = (double) renderNs / 1e9;
+	printf("%3u sources: %6.2f%% of one core, %6.2f us per source frame, "
+		   "~%.0f sources per core\n",
+		   sources, 100.0 * seconds / SECONDS,
+		   (double) renderNs / frames / sources / 1000.0,
+		   sources * SECONDS / seconds);
+}
+
+int main(void) {
+	srand(42);
+	for (uint32_t i = 0; i < FRAME; i++) {
+		input[i] = (float) rand() / (float) RAND_MAX - 0.5f;
+	}
+
+	uint64_t start = plat_now_ns();
+	if (!loadSyntheticSet()) {
+		fprintf(stderr, "Failed to load the HRIR set\n");
+		return 1;
+	}
+	printf("Converted %d directions in %.1f ms\n", ELEVATIONS * AZIMUTHS,
+		   (double) (plat_now_ns() - start) / 1e6);
+
+	run(1);
+	run(16);
+	run(64);
+	run(HRTF_MAX_VOICES);
+
+	hrtf_unload();
+	return 0;
+}
@@ -0,0 +1,100 @@
+// Cost of building the identity JSON of one positional frame, with the JSON
+// writer and with the snprintf path the plugin used before it (quotes and
+// backslashes blanked out, nothing else escaped). Prints what each produced
+// for every name, then the same with a buffer too small for the escaped name,
+// where the writer has to cut between characters.
+
+#include "json.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define ITERATIONS 1000000
+#define PLAYER_SIZE 50
+
+static const struct {
+	const char *label;
+	const char *player;
+} names[] = {
+	{ "ascii", "Arthas" },
+	{ "ascii, 49 bytes", "Abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvw" },
+	{ "utf-8", "\xC3\x9E\xC3\xB3r\xC3\xB0\xC3\xADs" },
+	{ "quotes, controls", "Jaina \"the\\ Proud\"\t\x01" },
+	{ "invalid utf-8", "Bad\xFF\xC3(name\xED\xA0\x80" },
+};
+
+static const char *viaSnprintf(char *buffer, size_t size, const char *name,
+							   int leaderGUID) {
+	char player[PLAYER_SIZE];
+	strncpy(player, name, sizeof(player) - 1);
+	player[sizeof(player) - 1] = '\0';
+	for (int i = 0; player[i]; i++) {
+		if (player[i] == '"' || player[i] == '\\') {
+			player[i] = ' ';
+		}
+	}
+	snprintf(buffer, size, "{\n\"char\": \"%s\",\n\"leaderguid\": %d\n}",
+			 player[0] ? player : "None", leaderGUID);
+	return buffer;
+}
+
+static const char *viaWriter(char *buffer, size_t size, const char *name,
+							 int leaderGUID) {
+	struct JsonWriter json;
+	json_begin(&json, buffer, size);
+	json_addString(&json, "char", name, strnlen(name, PLAYER_SIZE));
+	json_addInt(&json, "leaderguid", leaderGUID);
+	return json_end(&json);
+}
+
+static void printEscaped(const char *label, const char *text) {
+	printf("  %-8s ", label);
+	for (const char *c = text; *c; c++) {
+		if (*c == '\n') {
+			fputs("\\n", stdout);
+		} else if ((unsigned char) *c < 0x20) {
+			printf("<%02x>", (unsigned char) *c);
+		} else {
+			putchar(*c);
+		}
+	}
+	putchar('\n');
+}
+
+int main(void) {
+	static char buffer[256];
+	volatile char sink = 0;
+
+	for (size_t n = 0; n < sizeof(names) / sizeof(names[0]); n++) {
+		const char *player = names[n].player;
+		uint64_t writerNs = 0, snprintfNs = 0;
+
+		uint64_t start = plat_now_ns();
+		for (int i = 0; i < ITERATIONS; i++) {
+			sink ^= viaWriter(buffer, sizeof(buffer), player, i)[12];
+		}
+		writerNs = plat_now_ns() - start;
+
+		start = plat_now_ns();
+		for (int i = 0; i < ITERATIONS; i++) {
+			sink ^= viaSnprintf(buffer, sizeof(buffer), player, i)[12];
+		}
+		snprintfNs = plat_now_ns() - start;
+
+		printf("%-18s writer %6.1f ns  snprintf %6.1f ns\n", names[n].label,
+			   (double) writerNs / ITERATIONS,
+			   (double) snprintfNs / ITERATIONS);
+		printEscaped("writer", viaWriter(buffer, sizeof(buffer), player, 42));
+		printEscaped("snprintf",
+					 viaSnprintf(buffer, sizeof(buffer), player, 42));
+	}
+
+	printf("buffer of 24 bytes\n");
+	for (size_t n = 0; n < sizeof(names) / sizeof(names[0]); n++) {
+		printEscaped("writer", viaWriter(buffer, 24, names[n].player, 42));
+		printEscaped("snprintf",
+					 viaSnprintf(buffer, 24, names[n].player, 42));
+	}
+	return sink == 1;
+}
@@ -0,0 +1,183 @@
+// Consumer side of the shared-memory export: cost of publish, latest and next
+// without contention, then the delay between publishing a frame and a polling
+// reader seeing it, with the writer at the plugin's rate (100 Hz), at 1 kHz,
+// and flat out to show what lapped readers lose. Every reader maps the ring
+// itself, as a separate process would. Readers busy-poll, so with fewer cores
+// than readers plus the writer the latencies are scheduler time slices.
+
+#include "platform.h"
+#include "posring.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RING_NAME "/wow335pa-bench"
+#define ITERATIONS 1000000
+#define MAX_READERS 4
+#define MAX_SAMPLES 200000
+
+struct Reader {
+	plat_thread_t thread;
+	uint32_t *latencies;
+	uint32_t count;
+	uint64_t frames;
+	uint64_t lost;
+};
+
+static atomic_bool running;
+static atomic_uint readersReady;
+
+static void readerMain(void *arg) {
+	struct Reader *reader = arg;
+	struct Posring ring;
+	struct PosringFrame frame;
+
+	if (!posring_open(&ring, RING_NAME)) {
+		fprintf(stderr, "Reader failed to open the ring\n");
+		atomic_fetch_add(&readersReady, 1);
+		return;
+	}
+	atomic_fetch_add(&readersReady, 1);
+
+	while (atomic_load_explicit(&running, memory_order_relaxed)) {
+		uint64_t lost;
+		if (!posring_next(&ring, &frame, &lost)) {
+			continue;
+		}
+		uint64_t now = plat_now_ns();
+		reader->frames++;
+		reader->lost += lost;
+		if (reader->count < MAX_SAMPLES) {
+			reader->latencies[reader->count++] =
+				(uint32_t) (now - frame.timestampNs);
+		}
+	}
+	posring_close(&ring);
+}
+
+// Sleeps until shortly before the deadline so readers get the CPU on small
+// machines, then spins for the rest
+static void waitUntil(uint64_t deadline) {
+	uint64_t now = plat_now_ns();
+	if (deadline > now + 2000000) {
+		plat_sleep_ms((uint32_t) ((deadline - now) / 1000000) - 1);
+	}
+	while (plat_now_ns() < deadline) {
+	}
+}
+
+static int compareU32(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+	return (x > y) - (x < y);
+}
+
+static void uncontended(struct Posring *writer) {
+	struct Posring ring;
+	struct PosringFrame frame;
+	memset(&frame, 0, sizeof(frame));
+
+	uint64_t start = plat_now_ns();
+	for (int i = 0; i < ITERATIONS; i++) {
+		frame.timestampNs = (uint64_t) i;
+		posring_publish(writer, &frame);
+	}
+	double publishNs = (double) (plat_now_ns() - start) / ITERATIONS;
+
+	if (!posring_open(&ring, RING_NAME)) {
+		fprintf(stderr, "Failed to open the ring\n");
+		return;
+	}
+	start = plat_now_ns();
+	for (int i = 0; i < ITERATIONS; i++) {
+		posring_latest(&ring, &frame);
+	}
+	double latestNs = (double) (plat_now_ns() - start) / ITERATIONS;
+
+	// Read back whole laps: publish POSRING_SLOTS frames, then drain them
+	uint64_t nextTotal = 0, reads = 0;
+	for (uint32_t lap = 0; lap < ITERATIONS / POSRING_SLOTS; lap++) {
+		for (uint32_t i = 0; i < POSRING_SLOTS; i++) {
+			posring_publish(writer, &frame);
+		}
+		start = plat_now_ns();
+		while (posring_next(&ring, &frame, NULL)) {
+			reads++;
+		}
+		nextTotal += plat_now_ns() - start;
+	}
+	posring_close(&ring);
+
+	printf("uncontended: publish %.1f ns  latest %.1f ns  next %.1f ns\n",
+		   publishNs, latestNs, (double) nextTotal / (double) reads);
+}
+
+static void contended(struct Posring *writer, uint32_t readerCount,
+					  uint32_t rateHz, uint32_t seconds) {
+	static struct Reader readers[MAX_READERS];
+	struct PosringFrame frame;
+	memset(&frame, 0, sizeof(frame));
+
+	atomic_store(&running, true);
+	atomic_store(&readersReady, 0);
+	for (uint32_t r = 0; r < readerCount; r++) {
+		memset(&readers[r], 0, sizeof(readers[r]));
+		readers[r].latencies = malloc(MAX_SAMPLES * sizeof(uint32_t));
+		plat_thread_start(&readers[r].thread, readerMain, &readers[r]);
+	}
+	while (atomic_load(&readersReady) < readerCount) {
+	}
+
+	uint64_t published = 0;
+	uint64_t interval  = rateHz ? 1000000000ull / rateHz : 0;
+	uint64_t start     = plat_now_ns();
+	uint64_t end       = start + (uint64_t) seconds * 1000000000ull;
+	uint64_t next      = start;
+	while (plat_now_ns() < end) {
+		waitUntil(next);
+		frame.timestampNs = plat_now_ns();
+		posring_publish(writer, &frame);
+		published++;
+		next += interval;
+	}
+	atomic_store(&running, false);
+
+	for (uint32_t r = 0; r < readerCount; r++) {
+		struct Reader *reader = &readers[r];
+		plat_thread_join(reader->thread);
+		qsort(reader->latencies, reader->count, sizeof(uint32_t), compareU32);
+		uint32_t p50 = 0, p99 = 0, p999 = 0, max = 0;
+		if (reader->count > 0) {
+			p50  = reader->latencies[reader->count / 2];
+			p99  = reader->latencies[(uint64_t) reader->count * 99 / 100];
+			p999 = reader->latencies[(uint64_t) reader->count * 999 / 1000];
+			max  = reader->latencies[reader->count - 1];
+		}
+		printf("%5u Hz, %u readers, reader %u: %8llu of %8llu frames, "
+			   "%8llu lost  p50 %6u ns  p99 %6u ns  p99.9 %7u ns  max %8u "
+			   "ns\n",
+			   rateHz, readerCount, r, (unsigned long long) reader->frames,
+			   (unsigned long long) published,
+			   (unsigned long long) reader->lost, p50, p99, p999, max);
+		free(reader->latencies);
+	}
+}
+
+int main(void) {
+	struct Posring writer;
+	if (!posring_create(&writer, RING_NAME)) {
+		fprintf(stderr, "Failed to create %s\n", RING_NAME);
+		return 1;
+	}
+
+	uncontended(&writer);
+	contended(&writer, 1, 100, 2);
+	contended(&writer, 1, 1000, 2);
+	contended(&writer, MAX_READERS, 1000, 2);
+	// Flat out: readers get lapped and report what they lost
+	contended(&writer, MAX_READERS, 0, 1);
+
+	posring_destroy(&writer);
+	return 0;
+}
@@ -0,0 +1,81 @@
+// Per-frame cost of the peer spatial index at raid (40), battleground (500)
+// and Wintergrasp-sized (5000) populations. Every frame moves all peers a
+// little, then runs one range and one k-nearest query around the listener.
+
+#include "platform.h"
+#include "spatial.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FRAMES 2000
+#define HEARING_RANGE 50.0f
+#define NEAREST 8
+#define MAP_ID 571
+
+static struct SpatialIndex spatialIndex;
+static float positions[SPATIAL_MAX_ENTRIES][3];
+static uint32_t results[SPATIAL_MAX_ENTRIES];
+
+static float randomFloat(float range) {
+	return ((float) rand() / (float) RAND_MAX) * range;
+}
+
+// Peers are spread over an area x area yard square
+static void run(uint32_t peers, float area) {
+	spatial_init(&spatialIndex, HEARING_RANGE);
+	for (uint32_t i = 0; i < peers; i++) {
+		positions[i][0] = 4000.0f + randomFloat(area);
+		positions[i][1] = 2000.0f + randomFloat(area);
+		positions[i][2] = 300.0f + randomFloat(50.0f);
+		spatial_update(&spatialIndex, i, MAP_ID, positions[i]);
+	}
+
+	uint64_t updateNs = 0, rangeNs = 0, nearestNs = 0;
+	size_t found = 0;
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		// Running speed is ~7 yards/s, ten updates per second
+		for (uint32_t i = 0; i < peers; i++) {
+			positions[i][0] += randomFloat(1.4f) - 0.7f;
+			positions[i][1] += randomFloat(1.4f) - 0.7f;
+		}
+
+		uint64_t start = plat_now_ns();
+		for (uint32_t i = 0; i < peers; i++) {
+			spatial_update(&spatialIndex, i, MAP_ID, positions[i]);
+		}
+		uint64_t updated = plat_now_ns();
+
+		const float *listener = positions[frame % peers];
+		found += spatial_queryRange(&spatialIndex, MAP_ID, listener, HEARING_RANGE,
+									results, SPATIAL_MAX_ENTRIES);
+		uint64_t ranged = plat_now_ns();
+
+		found += spatial_queryNearest(&spatialIndex, MAP_ID, listener, NEAREST,
+									  HEARING_RANGE * 4, results, NULL);
+		uint64_t nearest = plat_now_ns();
+
+		updateNs += updated - start;
+		rangeNs += ranged - updated;
+		nearestNs += nearest - ranged;
+	}
+
+	printf("%5u peers: update all %8.1f ns (%5.1f ns/peer)  range %7.1f ns  "
+		   "%d-nearest %7.1f ns  (avg hits %.1f)\n",
+		   peers, (double) updateNs / FRAMES,
+		   (double) updateNs / FRAMES / peers, (double) rangeNs / FRAMES,
+		   NEAREST, (double) nearestNs / FRAMES,
+		   (double) found / FRAMES / 2.0);
+}
+
+int main(void) {
+	srand(42);
+
+	// Raid in an instance, battleground, Wintergrasp
+	run(40, 150.0f);
+	run(500, 800.0f);
+	run(5000, 1500.0f);
+
+	return 0;
+}
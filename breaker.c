@@ -0,0 +1,117 @@
+#include "breaker.h"
+
+#include <stddef.h>
+
+static uint64_t nextRandom(struct Breaker *breaker) {
+	uint64_t x = breaker->random;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	breaker->random = x;
+	return x;
+}
+
+static void enter(struct Breaker *breaker, enum BreakerState state) {
+	breaker->state = state;
+	breaker->transitions[state]++;
+}
+
+// Schedules the next probe somewhere in [0.75, 1.25] of the backoff, so
+// readers that failed together do not all retry in the same frame
+static void scheduleProbe(struct Breaker *breaker, uint64_t nowNs) {
+	uint64_t backoff = breaker->backoffNs;
+	uint64_t jitter  = nextRandom(breaker) % (backoff / 2 + 1);
+	breaker->retryAtNs = nowNs + backoff - backoff / 4 + jitter;
+}
+
+void breaker_init(struct Breaker *breaker, const struct BreakerPolicy *policy,
+				  uint64_t seed) {
+	breaker->policy = *policy;
+	if (breaker->policy.openAfter == 0) {
+		breaker->policy.openAfter = 1;
+	}
+	if (breaker->policy.maxBackoffNs < breaker->policy.baseBackoffNs) {
+		breaker->policy.maxBackoffNs = breaker->policy.baseBackoffNs;
+	}
+	// xorshift must not start at zero
+	breaker->random = seed ? seed : 0x9E3779B97F4A7C15ull;
+	for (size_t i = 0; i < BREAKER_STATES; i++) {
+		breaker->transitions[i] = 0;
+	}
+	breaker->probes = 0;
+	breaker_reset(breaker);
+}
+
+void breaker_reset(struct Breaker *breaker) {
+	breaker->state     = BREAKER_HEALTHY;
+	breaker->failures  = 0;
+	breaker->backoffNs = breaker->policy.baseBackoffNs;
+	breaker->retryAtNs = 0;
+}
+
+bool breaker_allow(struct Breaker *breaker, uint64_t nowNs) {
+	if (breaker->state != BREAKER_OPEN) {
+		return true;
+	}
+	if (nowNs < breaker->retryAtNs) {
+		return false;
+	}
+	breaker->probes++;
+	return true;
+}
+
+bool breaker_record(struct Breaker *breaker, bool ok, uint64_t nowNs) {
+	enum BreakerState before = breaker->state;
+
+	if (ok) {
+		breaker->failures  = 0;
+		breaker->backoffNs = breaker->policy.baseBackoffNs;
+		if (before != BREAKER_HEALTHY) {
+			enter(breaker, BREAKER_HEALTHY);
+		}
+		return before != BREAKER_HEALTHY;
+	}
+
+	switch (before) {
+		case BREAKER_HEALTHY:
+			breaker->failures = 1;
+			if (breaker->policy.openAfter > 1) {
+				enter(breaker, BREAKER_DEGRADED);
+				return true;
+			}
+			break;
+		case BREAKER_DEGRADED:
+			if (++breaker->failures < breaker->policy.openAfter) {
+				return false;
+			}
+			break;
+		case BREAKER_OPEN: {
+			// The probe failed too: wait twice as long
+			uint64_t limit     = breaker->policy.maxBackoffNs;
+			breaker->backoffNs = breaker->backoffNs > limit / 2
+									 ? limit
+									 : breaker->backoffNs * 2;
+			scheduleProbe(breaker, nowNs);
+			return false;
+		}
+		default:
+			return false;
+	}
+
+	enter(breaker, BREAKER_OPEN);
+	scheduleProbe(breaker, nowNs);
+	return true;
+}
+
+const char *breaker_stateName(enum BreakerState state) {
+	switch (state) {
+		case BREAKER_HEALTHY:
+			return "healthy";
+		case BREAKER_DEGRADED:
+			return "degraded";
+		case BREAKER_OPEN:
+			return "open";
+		default:
+			return "unknown";
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef WOW335PA_BREAKER_H_
+#define WOW335PA_BREAKER_H_
+
+// Circuit breaker for reading the game. On loading screens, while zoning or
+// when Wine hiccups every read fails, often for seconds; instead of trying
+// again on every frame the breaker stops reading and probes with a single
+// read after an exponentially growing, jittered backoff.
+//
+//   healthy  --failure-->           degraded
+//   degraded --openAfter failures--> open (backoff starts at baseBackoffNs)
+//   degraded --success-->           healthy
+//   open     --backoff ran out-->   one probe read
+//            probe succeeds:        healthy, backoff reset
+//            probe fails:           open again, backoff doubled up to
+//                                   maxBackoffNs
+//
+// Not thread-safe; one breaker belongs to the thread that reads.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum BreakerState {
+	BREAKER_HEALTHY,
+	BREAKER_DEGRADED,
+	BREAKER_OPEN,
+	BREAKER_STATES
+};
+
+struct BreakerPolicy {
+	// Consecutive failed reads before the circuit opens
+	uint32_t openAfter;
+	uint64_t baseBackoffNs;
+	uint64_t maxBackoffNs;
+};
+
+struct Breaker {
+	struct BreakerPolicy policy;
+	enum BreakerState state;
+	uint32_t failures;
+	uint64_t backoffNs;
+	uint64_t retryAtNs;
+	// Jitter generator (xorshift64)
+	uint64_t random;
+	// Entries into each state, and probe reads made while open
+	uint64_t transitions[BREAKER_STATES];
+	uint64_t probes;
+};
+
+void breaker_init(struct Breaker *breaker, const struct BreakerPolicy *policy,
+				  uint64_t seed);
+void breaker_reset(struct Breaker *breaker);
+
+// Whether to read at nowNs. While open this is false until the backoff ran
+// out, then true once for the probe.
+bool breaker_allow(struct Breaker *breaker, uint64_t nowNs);
+
+// Reports how the allowed read went; returns true if the state changed
+bool breaker_record(struct Breaker *breaker, bool ok, uint64_t nowNs);
+
+const char *breaker_stateName(enum BreakerState state);
+
+#endif // WOW335PA_BREAKER_H_
@@ -0,0 +1,200 @@
+#include "channels.h"
+
+#include "flatmap.h"
+#include "platform.h"
+#include "plugin.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_CHANNELS 1024
+#define MAP_CAPACITY 2048 // power of two, > MAX_CHANNELS
+#define MAX_CHANNEL_NAME 128
+
+struct ChannelEntry {
+	mumble_channelid_t id;
+	uint32_t nameHash;
+	char name[MAX_CHANNEL_NAME];
+};
+
+static struct ChannelEntry entries[MAX_CHANNELS];
+static uint32_t freeList[MAX_CHANNELS];
+static uint32_t freeCount = 0;
+
+// channel ID -> entry and name hash -> entry
+static uint32_t idKeys[MAP_CAPACITY], idValues[MAP_CAPACITY];
+static uint32_t nameKeys[MAP_CAPACITY], nameValues[MAP_CAPACITY];
+static struct FlatMap byId, byName;
+
+static plat_mutex_t lock                 = PLAT_MUTEX_INITIALIZER;
+static mumble_connection_t indexedServer = -1;
+
+static uint32_t hashName(const char *name) {
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (const unsigned char *c = (const unsigned char *) name; *c; c++) {
+		hash = (hash ^ *c) * 16777619u;
+	}
+	return hash == FLATMAP_EMPTY ? hash ^ 1u : hash;
+}
+
+static void resetLocked(void) {
+	flatmap_init(&byId, idKeys, idValues, MAP_CAPACITY);
+	flatmap_init(&byName, nameKeys, nameValues, MAP_CAPACITY);
+	for (uint32_t i = 0; i < MAX_CHANNELS; i++) {
+		freeList[i] = MAX_CHANNELS - 1 - i;
+	}
+	freeCount     = MAX_CHANNELS;
+	indexedServer = -1;
+}
+
+// If several channels share a name (or a hash) the first one indexed wins
+static void linkNameLocked(uint32_t index) {
+	uint32_t existing;
+	if (!flatmap_get(&byName, entries[index].nameHash, &existing)) {
+		flatmap_put(&byName, entries[index].nameHash, index);
+	}
+}
+
+static void unlinkNameLocked(uint32_t index) {
+	uint32_t hash = entries[index].nameHash;
+	uint32_t existing;
+	if (!flatmap_get(&byName, hash, &existing) || existing != index) {
+		return;
+	}
+
+	flatmap_remove(&byName, hash);
+	// Hand the name over to another channel with the same hash, if any
+	for (uint32_t i = 0; i < byId.capacity; i++) {
+		if (byId.keys[i] != FLATMAP_EMPTY && byId.values[i] != index
+			&& entries[byId.values[i]].nameHash == hash) {
+			flatmap_put(&byName, hash, byId.values[i]);
+			break;
+		}
+	}
+}
+
+static void upsertLocked(mumble_channelid_t channelID, const char *name) {
+	uint32_t index;
+	if (flatmap_get(&byId, (uint32_t) channelID, &index)) {
+		unlinkNameLocked(index);
+	} else {
+		if (freeCount == 0) {
+			return;
+		}
+		index = freeList[--freeCount];
+		flatmap_put(&byId, (uint32_t) channelID, index);
+	}
+
+	entries[index].id = channelID;
+	snprintf(entries[index].name, sizeof(entries[index].name), "%s", name);
+	entries[index].nameHash = hashName(entries[index].name);
+	linkNameLocked(index);
+}
+
+// Fetches the name from Mumble outside of the lock and stores it
+static void indexChannel(mumble_connection_t connection,
+						 mumble_channelid_t channelID) {
+	const char *name = NULL;
+	if (mumbleAPI.getChannelName(ownID, connection, channelID, &name)
+		!= MUMBLE_STATUS_OK) {
+		return;
+	}
+
+	plat_mutex_lock(&lock);
+	if (indexedServer == connection) {
+		upsertLocked(channelID, name);
+	}
+	plat_mutex_unlock(&lock);
+
+	mumbleAPI.freeMemory(ownID, name);
+}
+
+void channels_build(mumble_connection_t connection) {
+	mumble_channelid_t *channels = NULL;
+	size_t channelCount          = 0;
+
+	plat_mutex_lock(&lock);
+	resetLocked();
+	indexedServer = connection;
+	plat_mutex_unlock(&lock);
+
+	if (mumbleAPI.getAllChannels(ownID, connection, &channels, &channelCount)
+		!= MUMBLE_STATUS_OK) {
+		mumbleAPI.log(ownID, "ERROR: Failed to fetch the channel list");
+		return;
+	}
+
+	for (size_t i = 0; i < channelCount; i++) {
+		indexChannel(connection, channels[i]);
+	}
+	mumbleAPI.freeMemory(ownID, channels);
+
+	char logBuffer[128];
+	snprintf(logBuffer, sizeof(logBuffer), "Indexed %zu channels",
+			 channelCount);
+	mumbleAPI.log(ownID, logBuffer);
+}
+
+void channels_clear(void) {
+	plat_mutex_lock(&lock);
+	resetLocked();
+	plat_mutex_unlock(&lock);
+}
+
+void channels_onAdded(mumble_connection_t connection,
+					  mumble_channelid_t channelID) {
+	if (connection == indexedServer) {
+		indexChannel(connection, channelID);
+	}
+}
+
+void channels_onRemoved(mumble_connection_t connection,
+						mumble_channelid_t channelID) {
+	plat_mutex_lock(&lock);
+	uint32_t index;
+	if (connection == indexedServer
+		&& flatmap_get(&byId, (uint32_t) channelID, &index)) {
+		unlinkNameLocked(index);
+		flatmap_remove(&byId, (uint32_t) channelID);
+		freeList[freeCount++] = index;
+	}
+	plat_mutex_unlock(&lock);
+}
+
+void channels_onRenamed(mumble_connection_t connection,
+						mumble_channelid_t channelID) {
+	if (connection == indexedServer) {
+		indexChannel(connection, channelID);
+	}
+}
+
+bool channels_findByName(const char *name, mumble_connection_t *connection,
+						 mumble_channelid_t *channelID) {
+	uint32_t hash = hashName(name);
+	bool found    = false;
+
+	plat_mutex_lock(&lock);
+	uint32_t index;
+	if (indexedServer >= 0 && flatmap_get(&byName, hash, &index)) {
+		if (strcmp(entries[index].name, name) == 0) {
+			found = true;
+		} else {
+			// Hash collision: fall back to a scan of the channels sharing it
+			for (uint32_t i = 0; i < byId.capacity && !found; i++) {
+				if (byId.keys[i] != FLATMAP_EMPTY) {
+					index = byId.values[i];
+					found = entries[index].nameHash == hash
+							&& strcmp(entries[index].name, name) == 0;
+				}
+			}
+		}
+	}
+	if (found) {
+		*connection = indexedServer;
+		*channelID  = entries[index].id;
+	}
+	plat_mutex_unlock(&lock);
+
+	return found;
+}
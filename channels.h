@@ -0,0 +1,29 @@
+#ifndef WOW335PA_CHANNELS_H_
+#define WOW335PA_CHANNELS_H_
+
+// In-plugin index of the channels on the synchronized server. It is built once
+// via getAllChannels/getChannelName and then kept current from Mumble's
+// channel callbacks, so resolving a channel name never calls into Mumble.
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+
+// Rebuilds the index for the given connection. Main thread only.
+void channels_build(mumble_connection_t connection);
+void channels_clear(void);
+
+// Incremental updates from the mumble_onChannel* callbacks
+void channels_onAdded(mumble_connection_t connection,
+					  mumble_channelid_t channelID);
+void channels_onRemoved(mumble_connection_t connection,
+						mumble_channelid_t channelID);
+void channels_onRenamed(mumble_connection_t connection,
+						mumble_channelid_t channelID);
+
+// Resolves a channel name on the indexed connection. Safe to call from any
+// non-audio thread.
+bool channels_findByName(const char *name, mumble_connection_t *connection,
+						 mumble_channelid_t *channelID);
+
+#endif // WOW335PA_CHANNELS_H_
@@ -0,0 +1,155 @@
+#include "config.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONFIG_FILE "wow335pa.conf"
+#define MAX_ENTRIES 256
+#define MAX_KEY 64
+#define MAX_VALUE 192
+
+struct ConfigEntry {
+	char key[MAX_KEY];
+	char value[MAX_VALUE];
+};
+
+static struct ConfigEntry entries[MAX_ENTRIES];
+static size_t entryCount = 0;
+
+static bool configPath(char *path, size_t size) {
+#ifdef _WIN32
+	const char *appData = getenv("APPDATA");
+	if (!appData) {
+		return false;
+	}
+	snprintf(path, size, "%s\\%s", appData, CONFIG_FILE);
+#else
+	const char *xdg = getenv("XDG_CONFIG_HOME");
+	if (xdg && xdg[0]) {
+		snprintf(path, size, "%s/%s", xdg, CONFIG_FILE);
+	} else {
+		const char *home = getenv("HOME");
+		if (!home) {
+			return false;
+		}
+		snprintf(path, size, "%s/.config/%s", home, CONFIG_FILE);
+	}
+#endif
+	return true;
+}
+
+static char *trim(char *str) {
+	while (isspace((unsigned char) *str)) {
+		str++;
+	}
+	char *end = str + strlen(str);
+	while (end > str && isspace((unsigned char) end[-1])) {
+		end--;
+	}
+	*end = '\0';
+	return str;
+}
+
+bool config_load(void) {
+	char path[512];
+	char line[MAX_KEY + MAX_VALUE + 8];
+
+	entryCount = 0;
+
+	if (!configPath(path, sizeof(path))) {
+		return false;
+	}
+
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		return false;
+	}
+
+	while (fgets(line, sizeof(line), file) && entryCount < MAX_ENTRIES) {
+		char *content = trim(line);
+		if (content[0] == '#' || content[0] == '\0') {
+			continue;
+		}
+
+		char *separator = strchr(content, '=');
+		if (!separator) {
+			continue;
+		}
+		*separator = '\0';
+
+		char *key   = trim(content);
+		char *value = trim(separator + 1);
+		if (key[0] == '\0') {
+			continue;
+		}
+
+		snprintf(entries[entryCount].key, MAX_KEY, "%s", key);
+		snprintf(entries[entryCount].value, MAX_VALUE, "%s", value);
+		entryCount++;
+	}
+
+	fclose(file);
+	return true;
+}
+
+const char *config_getString(const char *key, const char *fallback) {
+	// Later entries override earlier ones
+	for (size_t i = entryCount; i > 0; i--) {
+		if (strcmp(entries[i - 1].key, key) == 0) {
+			return entries[i - 1].value;
+		}
+	}
+	return fallback;
+}
+
+int config_getInt(const char *key, int fallback) {
+	const char *value = config_getString(key, NULL);
+	if (!value) {
+		return fallback;
+	}
+
+	char *end;
+	long result = strtol(value, &end, 0);
+	return (end != value) ? (int) result : fallback;
+}
+
+float config_getFloat(const char *key, float fallback) {
+	const char *value = config_getString(key, NULL);
+	if (!value) {
+		return fallback;
+	}
+
+	char *end;
+	float result = strtof(value, &end);
+	return (end != value) ? result : fallback;
+}
+
+bool config_getBool(const char *key, bool fallback) {
+	const char *value = config_getString(key, NULL);
+	if (!value) {
+		return fallback;
+	}
+
+	if (strcmp(value, "1") == 0 || strcmp(value, "true") == 0
+		|| strcmp(value, "yes") == 0 || strcmp(value, "on") == 0) {
+		return true;
+	}
+	if (strcmp(value, "0") == 0 || strcmp(value, "false") == 0
+		|| strcmp(value, "no") == 0 || strcmp(value, "off") == 0) {
+		return false;
+	}
+	return fallback;
+}
+
+void config_forEach(const char *prefix, config_visitor visitor,
+					void *userdata) {
+	size_t prefixLength = strlen(prefix);
+
+	for (size_t i = 0; i < entryCount; i++) {
+		if (strncmp(entries[i].key, prefix, prefixLength) == 0) {
+			visitor(entries[i].key + prefixLength, entries[i].value, userdata);
+		}
+	}
+}
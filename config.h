@@ -0,0 +1,27 @@
+#ifndef WOW335PA_CONFIG_H_
+#define WOW335PA_CONFIG_H_
+
+// Plugin settings read once from a "key = value" file:
+//   Linux:   $XDG_CONFIG_HOME/wow335pa.conf (default ~/.config/wow335pa.conf)
+//   Windows: %APPDATA%\wow335pa.conf
+// Lines starting with '#' are comments. A missing file simply means defaults.
+
+#include <stdbool.h>
+
+// Returns false if no config file was found
+bool config_load(void);
+
+const char *config_getString(const char *key, const char *fallback);
+int config_getInt(const char *key, int fallback);
+float config_getFloat(const char *key, float fallback);
+bool config_getBool(const char *key, bool fallback);
+
+typedef void (*config_visitor)(const char *key, const char *value,
+							   void *userdata);
+
+// Calls visitor for every entry whose key starts with prefix. The key passed
+// to the visitor has the prefix stripped.
+void config_forEach(const char *prefix, config_visitor visitor,
+					void *userdata);
+
+#endif // WOW335PA_CONFIG_H_
@@ -0,0 +1,317 @@
+#include "cues.h"
+
+#include "config.h"
+#include "dsp.h"
+#include "platform.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Must be a power of two
+#define CUE_QUEUE_SIZE 16
+#define MAX_KEY 64
+
+#define WAV_FORMAT_PCM 0x0001
+#define WAV_FORMAT_FLOAT 0x0003
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+struct WavFile {
+	const void *mapping;
+	size_t mappingSize;
+	const uint8_t *data;
+	uint32_t frames;
+	uint32_t sampleRate;
+	uint16_t channels;
+	bool isFloat;
+	// Frames after resampling to CUE_SAMPLE_RATE
+	uint32_t outputFrames;
+};
+
+struct Cue {
+	const float *samples;
+	uint32_t frames;
+	uint16_t channels;
+};
+
+struct Voice {
+	int32_t cue;
+	uint32_t position;
+};
+
+static float volume;
+// Read-only once cues_init returns; all samples live in one allocation
+static struct Cue cues[GAME_EVENT_COUNT];
+static float *arena;
+
+// Single-producer/single-consumer ring from the dispatcher thread to the audio
+// thread
+static uint8_t queue[CUE_QUEUE_SIZE];
+static _Alignas(64) atomic_uint queueHead = 0;
+static _Alignas(64) atomic_uint queueTail = 0;
+
+// Audio thread state
+static struct Voice voices[CUE_MAX_VOICES];
+
+static uint16_t readU16(const uint8_t *p) {
+	return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t readU32(const uint8_t *p) {
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16)
+		   | ((uint32_t) p[3] << 24);
+}
+
+static bool parseWav(const uint8_t *bytes, size_t size, struct WavFile *wav) {
+	if (size < 12 || memcmp(bytes, "RIFF", 4) != 0
+		|| memcmp(bytes + 8, "WAVE", 4) != 0) {
+		return false;
+	}
+
+	uint16_t format = 0;
+	uint16_t bits   = 0;
+	size_t dataSize = 0;
+	wav->data       = NULL;
+	wav->channels   = 0;
+	wav->sampleRate = 0;
+	for (size_t offset = 12; offset + 8 <= size;) {
+		const uint8_t *chunk = bytes + offset;
+		size_t chunkSize     = readU32(chunk + 4);
+		size_t available     = size - offset - 8;
+		if (chunkSize > available) {
+			chunkSize = available;
+		}
+
+		if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16) {
+			format          = readU16(chunk + 8);
+			wav->channels   = readU16(chunk + 10);
+			wav->sampleRate = readU32(chunk + 12);
+			bits            = readU16(chunk + 22);
+			if (format == WAV_FORMAT_EXTENSIBLE && chunkSize >= 26) {
+				// First two bytes of the sub-format GUID
+				format = readU16(chunk + 32);
+			}
+		} else if (memcmp(chunk, "data", 4) == 0) {
+			wav->data = chunk + 8;
+			dataSize  = chunkSize;
+		}
+		// Chunks are padded to an even size
+		offset += 8 + chunkSize + (chunkSize & 1);
+	}
+
+	if (!wav->data || wav->channels < 1 || wav->channels > 2
+		|| wav->sampleRate < 8000 || wav->sampleRate > 192000) {
+		return false;
+	}
+	if (format == WAV_FORMAT_PCM && bits == 16) {
+		wav->isFloat = false;
+	} else if (format == WAV_FORMAT_FLOAT && bits == 32) {
+		wav->isFloat = true;
+	} else {
+		return false;
+	}
+
+	wav->frames = (uint32_t) (dataSize / ((size_t) wav->channels * bits / 8));
+	uint64_t outputFrames =
+		(uint64_t) wav->frames * CUE_SAMPLE_RATE / wav->sampleRate;
+	if (outputFrames == 0
+		|| outputFrames > (uint64_t) CUE_MAX_SECONDS * CUE_SAMPLE_RATE) {
+		return false;
+	}
+	wav->outputFrames = (uint32_t) outputFrames;
+
+	return true;
+}
+
+static float readSample(const struct WavFile *wav, uint32_t frame,
+						uint16_t channel) {
+	size_t index = (size_t) frame * wav->channels + channel;
+	if (wav->isFloat) {
+		uint32_t bits = readU32(wav->data + index * 4);
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+	return (float) (int16_t) readU16(wav->data + index * 2) / 32768.0f;
+}
+
+// Linear interpolation is plenty for short notification sounds
+static void decode(const struct WavFile *wav, float *out) {
+	double step = (double) wav->sampleRate / CUE_SAMPLE_RATE;
+	for (uint32_t i = 0; i < wav->outputFrames; i++) {
+		double position = i * step;
+		uint32_t index  = (uint32_t) position;
+		float fraction  = (float) (position - index);
+		uint32_t next   = index + 1 < wav->frames ? index + 1 : index;
+		for (uint16_t c = 0; c < wav->channels; c++) {
+			float a = readSample(wav, index, c);
+			float b = readSample(wav, next, c);
+			*out++  = a + fraction * (b - a);
+		}
+	}
+}
+
+static void onGameEvent(const struct GameEvent *event, void *userdata) {
+	(void) userdata;
+
+	cues_trigger(event->type);
+}
+
+uint32_t cues_init(void) {
+	struct WavFile files[GAME_EVENT_COUNT];
+	size_t totalSamples = 0;
+	uint32_t mask       = 0;
+
+	volume = config_getFloat("cue.volume", 1.0f);
+	memset(cues, 0, sizeof(cues));
+	atomic_store(&queueHead, 0);
+	atomic_store(&queueTail, 0);
+	for (uint32_t i = 0; i < CUE_MAX_VOICES; i++) {
+		voices[i].cue = -1;
+	}
+
+	// Parse everything first so the arena is a single allocation
+	for (int type = 0; type < GAME_EVENT_COUNT; type++) {
+		files[type].mapping = NULL;
+
+		char key[MAX_KEY];
+		snprintf(key, sizeof(key), "cue.%s", events_name(type));
+		for (char *c = key; *c; c++) {
+			if (*c == ' ') {
+				*c = '_';
+			}
+		}
+
+		const char *path = config_getString(key, "");
+		if (*path == '\0') {
+			continue;
+		}
+		size_t size;
+		const void *mapping = plat_map_file(path, &size);
+		if (!mapping) {
+			continue;
+		}
+		if (!parseWav(mapping, size, &files[type])) {
+			plat_unmap_file(mapping, size);
+			continue;
+		}
+		files[type].mapping     = mapping;
+		files[type].mappingSize = size;
+		totalSamples +=
+			(size_t) files[type].outputFrames * files[type].channels;
+		mask |= GAME_EVENT_MASK(type);
+	}
+
+	arena = mask ? malloc(sizeof(float) * totalSamples) : NULL;
+
+	uint32_t loaded = 0;
+	float *next     = arena;
+	for (int type = 0; type < GAME_EVENT_COUNT; type++) {
+		const struct WavFile *wav = &files[type];
+		if (!wav->mapping) {
+			continue;
+		}
+		if (arena) {
+			decode(wav, next);
+			cues[type].samples  = next;
+			cues[type].frames   = wav->outputFrames;
+			cues[type].channels = wav->channels;
+			next += (size_t) wav->outputFrames * wav->channels;
+			loaded++;
+		}
+		plat_unmap_file(wav->mapping, wav->mappingSize);
+	}
+
+	if (loaded > 0) {
+		events_subscribe(mask, onGameEvent, NULL);
+	}
+	return loaded;
+}
+
+void cues_shutdown(void) {
+	memset(cues, 0, sizeof(cues));
+	free(arena);
+	arena = NULL;
+}
+
+bool cues_trigger(enum GameEventType type) {
+	if ((unsigned) type >= GAME_EVENT_COUNT || cues[type].frames == 0) {
+		return false;
+	}
+
+	unsigned head = atomic_load_explicit(&queueHead, memory_order_relaxed);
+	unsigned tail = atomic_load_explicit(&queueTail, memory_order_acquire);
+	if (head - tail == CUE_QUEUE_SIZE) {
+		return false;
+	}
+	queue[head & (CUE_QUEUE_SIZE - 1)] = (uint8_t) type;
+	atomic_store_explicit(&queueHead, head + 1, memory_order_release);
+
+	return true;
+}
+
+static void startVoice(int32_t cue) {
+	struct Voice *target = NULL;
+	uint32_t leastLeft   = UINT32_MAX;
+
+	for (uint32_t i = 0; i < CUE_MAX_VOICES; i++) {
+		struct Voice *voice = &voices[i];
+		// A cue triggered again while it plays starts over
+		if (voice->cue == cue) {
+			target = voice;
+			break;
+		}
+		uint32_t left =
+			voice->cue < 0 ? 0 : cues[voice->cue].frames - voice->position;
+		if (left < leastLeft) {
+			target    = voice;
+			leastLeft = left;
+		}
+	}
+
+	target->cue      = cue;
+	target->position = 0;
+}
+
+bool cues_mix(float *outputPCM, uint32_t sampleCount, uint16_t channelCount,
+			  uint32_t sampleRate) {
+	unsigned tail = atomic_load_explicit(&queueTail, memory_order_relaxed);
+	unsigned head = atomic_load_explicit(&queueHead, memory_order_acquire);
+	while (tail != head) {
+		startVoice(queue[tail & (CUE_QUEUE_SIZE - 1)]);
+		tail++;
+	}
+	atomic_store_explicit(&queueTail, tail, memory_order_release);
+
+	bool mixed = false;
+	for (uint32_t i = 0; i < CUE_MAX_VOICES; i++) {
+		struct Voice *voice = &voices[i];
+		if (voice->cue < 0) {
+			continue;
+		}
+		// Cues are decoded at one rate; rather drop them than play them at
+		// the wrong pitch
+		if (sampleRate != CUE_SAMPLE_RATE) {
+			voice->cue = -1;
+			continue;
+		}
+
+		const struct Cue *cue = &cues[voice->cue];
+		uint32_t frames       = cue->frames - voice->position;
+		if (frames > sampleCount) {
+			frames = sampleCount;
+		}
+		dsp_mixClip(outputPCM, channelCount,
+					cue->samples + (size_t) voice->position * cue->channels,
+					cue->channels, frames, volume);
+		mixed = true;
+
+		voice->position += frames;
+		if (voice->position == cue->frames) {
+			voice->cue = -1;
+		}
+	}
+
+	return mixed;
+}
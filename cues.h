@@ -0,0 +1,44 @@
+#ifndef WOW335PA_CUES_H_
+#define WOW335PA_CUES_H_
+
+// Short sounds played on game events (entering an instance, a new raid
+// leader, ...). mumbleAPI.playSample opens and decodes its file on every call,
+// so instead every cue is decoded once at mumble_init into one arena and mixed
+// straight into the output in mumble_onAudioOutputAboutToPlay. Events are
+// handed from the dispatcher thread to the audio thread through a lock-free
+// queue, so a cue becomes audible with the next output buffer. Configuration:
+//   cue.<event>  = path   (WAV, 16-bit PCM or 32-bit float, mono or stereo;
+//                          <event> is an event name with underscores, e.g.
+//                          cue.map_changed or cue.leader_changed)
+//   cue.volume   = 1.0
+//
+// Files are resampled to CUE_SAMPLE_RATE when they are loaded.
+
+#include "events.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CUE_SAMPLE_RATE 48000
+// Longest cue accepted
+#define CUE_MAX_SECONDS 10
+// Cues playing at the same time; a new one replaces the one closest to its
+// end
+#define CUE_MAX_VOICES 8
+
+// Loads the configured cues and subscribes to their events. Call from
+// mumble_init before events_start(). Returns the number of cues loaded.
+uint32_t cues_init(void);
+// Frees the arena. Call from mumble_shutdown after events_stop().
+void cues_shutdown(void);
+
+// Queues the cue of an event type. Dispatcher thread only; returns false if
+// there is no cue for it or the queue is full.
+bool cues_trigger(enum GameEventType type);
+
+// Audio thread only. Starts queued cues and adds all playing ones to the
+// output. Returns whether anything was added.
+bool cues_mix(float *outputPCM, uint32_t sampleCount, uint16_t channelCount,
+			  uint32_t sampleRate);
+
+#endif // WOW335PA_CUES_H_
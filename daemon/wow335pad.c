@@ -0,0 +1,152 @@
+// Reader daemon for sandboxed Mumble (Flatpak, Snap) and for setups where
+// Mumble should not hold cap_sys_ptrace. It finds the client, runs the same
+// read plan as mumble_fetchPositionalData (wowreader.h) and publishes every
+// frame to the shared-memory ring of posring.h, where the plugin
+// (reader.daemon = true) and any other local tool pick it up.
+//
+//   wow335pad [--name /wow335pa] [--hz N] [--pid PID]
+//
+// With --pid only that process is read and the daemon exits with it.
+//
+// Only this binary needs the capability:
+//   sudo setcap cap_sys_ptrace=eip wow335pad
+
+#include "platform.h"
+#include "posring.h"
+#include "wowlayout.h"
+#include "wowreader.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// How often the process list is scanned while the client is not running
+#define SCAN_INTERVAL_NS 1000000000ull
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int signal) {
+	(void) signal;
+	stopRequested = 1;
+}
+
+static void sleepUntil(uint64_t deadlineNs) {
+	struct timespec ts;
+	ts.tv_sec  = (time_t) (deadlineNs / 1000000000ull);
+	ts.tv_nsec = (long) (deadlineNs % 1000000000ull);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)
+		   == EINTR) {
+		if (stopRequested) {
+			return;
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	const char *name  = POSRING_DEFAULT_NAME;
+	double hz         = 100.0;
+	uint64_t fixedPid = 0;
+	int status        = 0;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (strcmp(argv[i], "--name") == 0) {
+			name = argv[i + 1];
+		} else if (strcmp(argv[i], "--hz") == 0) {
+			hz = atof(argv[i + 1]);
+		} else if (strcmp(argv[i], "--pid") == 0) {
+			fixedPid = strtoull(argv[i + 1], NULL, 10);
+		} else {
+			fprintf(stderr, "wow335pad: unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+	if (hz <= 0.0) {
+		hz = 100.0;
+	}
+
+	struct Posring ring;
+	if (!posring_create(&ring, name)) {
+		fprintf(stderr, "wow335pad: cannot create %s: %s\n", name,
+				strerror(errno));
+		return 1;
+	}
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = onSignal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	struct WowProcess process = { 0 };
+	struct GameSnapshot snapshot;
+	struct PosringFrame frame;
+	bool attached       = false;
+	bool everRead       = false;
+	uint64_t interval   = (uint64_t) (1e9 / hz);
+	uint64_t nextNs     = plat_now_ns();
+	uint64_t nextScanNs = nextNs;
+
+	fprintf(stderr, "wow335pad: publishing to %s at %.0f Hz\n", name, hz);
+	while (!stopRequested) {
+		uint64_t now = plat_now_ns();
+
+		if (!attached) {
+			if (now >= nextScanNs) {
+				uint64_t pid = fixedPid ? fixedPid : wowreader_findClient();
+				nextScanNs   = now + SCAN_INTERVAL_NS;
+				if (pid) {
+					wowreader_attach(&process, pid);
+					attached = true;
+					everRead = false;
+					fprintf(stderr,
+							"wow335pad: found the client (PID %llu)\n",
+							(unsigned long long) pid);
+					if (!process.imageFound) {
+						fprintf(stderr,
+								"wow335pad: %s not found in the client, "
+								"assuming it is loaded at 0x%x\n",
+								WOW_MODULE, WOW_IMAGE_BASE);
+					}
+				}
+			}
+		}
+
+		if (attached) {
+			if (wowreader_read(&process, &snapshot)) {
+				everRead = true;
+			} else if (process.lastError == WOW_READ_DENIED && !everRead) {
+				fprintf(stderr, "wow335pad: not allowed to read the client, "
+								"run: sudo setcap cap_sys_ptrace=eip %s\n",
+						argv[0]);
+				status        = 1;
+				stopRequested = 1;
+			} else if (process.lastError == WOW_READ_GONE) {
+				fprintf(stderr, "wow335pad: the client exited\n");
+				wowreader_detach(&process);
+				stopRequested = fixedPid != 0;
+				attached   = false;
+				nextScanNs = now + SCAN_INTERVAL_NS;
+			}
+			// Failed reads are published too, so readers notice right away
+			wowreader_toFrame(&snapshot, process.lastError, &frame);
+			posring_publish(&ring, &frame);
+		}
+
+		// Frames stay on the grid; after a stall skip ahead instead of
+		// catching up
+		nextNs += attached ? interval : SCAN_INTERVAL_NS / 10;
+		if (nextNs < now) {
+			nextNs = now;
+		}
+		sleepUntil(nextNs);
+	}
+
+	fprintf(stderr, "wow335pad: stopping\n");
+	wowreader_detach(&process);
+	posring_destroy(&ring);
+
+	return status;
+}
@@ -0,0 +1,125 @@
+#include "discovery.h"
+
+#include "platform.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+// How often the process list is scanned while the client is not running
+#define DISCOVERY_INTERVAL_MS 500
+
+static plat_thread_t discoveryThread;
+// Only posted by discovery_stop(); a detach is noticed within one interval,
+// so the positional thread never touches the semaphore
+static plat_sem_t wakeup;
+static atomic_bool running = false;
+
+// The prepared process is read by the discovery thread while it checks on it
+// and handed over by discovery_take(), hence the lock
+static plat_mutex_t lock = PLAT_MUTEX_INITIALIZER;
+static bool prepared     = false;
+static bool attached     = false;
+static struct WowProcess preparedProcess;
+
+// Drops the prepared process once it exited. Called with the lock held.
+static void checkPreparedLocked(void) {
+	struct GameSnapshot snapshot;
+	if (!wowreader_read(&preparedProcess, &snapshot)
+		&& preparedProcess.lastError == WOW_READ_GONE) {
+		wowreader_detach(&preparedProcess);
+		prepared = false;
+	}
+}
+
+static void discoveryMain(void *arg) {
+	(void) arg;
+
+	while (atomic_load(&running)) {
+		plat_mutex_lock(&lock);
+		if (prepared) {
+			checkPreparedLocked();
+		}
+		bool search = !prepared && !attached;
+		plat_mutex_unlock(&lock);
+
+		uint64_t pid = search ? wowreader_findClient() : 0;
+		if (pid) {
+			// Reading files and the first read (which opens the process on
+			// Windows) happen here, outside of the lock
+			struct WowProcess process;
+			memset(&process, 0, sizeof(process));
+			wowreader_attach(&process, pid);
+			struct GameSnapshot snapshot;
+			wowreader_read(&process, &snapshot);
+
+			plat_mutex_lock(&lock);
+			if (!prepared && !attached) {
+				preparedProcess = process;
+				prepared        = true;
+			} else {
+				wowreader_detach(&process);
+			}
+			plat_mutex_unlock(&lock);
+		}
+
+		plat_sem_wait_ms(&wakeup, DISCOVERY_INTERVAL_MS);
+	}
+}
+
+bool discovery_start(void) {
+	if (atomic_load(&running)) {
+		return true;
+	}
+	if (!plat_sem_init(&wakeup)) {
+		return false;
+	}
+
+	atomic_store(&running, true);
+	if (!plat_thread_start(&discoveryThread, discoveryMain, NULL)) {
+		atomic_store(&running, false);
+		plat_sem_destroy(&wakeup);
+		return false;
+	}
+	return true;
+}
+
+void discovery_stop(void) {
+	if (!atomic_exchange(&running, false)) {
+		return;
+	}
+	plat_sem_post(&wakeup);
+	plat_thread_join(discoveryThread);
+	plat_sem_destroy(&wakeup);
+
+	if (prepared) {
+		wowreader_detach(&preparedProcess);
+		prepared = false;
+	}
+}
+
+bool discovery_take(struct WowProcess *process, const uint64_t *pids,
+					size_t count) {
+	bool taken = false;
+
+	plat_mutex_lock(&lock);
+	for (size_t i = 0; prepared && i < count; i++) {
+		if (pids[i] == preparedProcess.pid) {
+			*process = preparedProcess;
+			prepared = false;
+			taken    = true;
+		}
+	}
+	plat_mutex_unlock(&lock);
+
+	return taken;
+}
+
+void discovery_setAttached(bool isAttached) {
+	plat_mutex_lock(&lock);
+	attached = isAttached;
+	if (attached && prepared) {
+		wowreader_detach(&preparedProcess);
+		prepared = false;
+	}
+	plat_mutex_unlock(&lock);
+}
@@ -0,0 +1,29 @@
+#ifndef WOW335PA_DISCOVERY_H_
+#define WOW335PA_DISCOVERY_H_
+
+// Warm attach. A background thread started from mumble_init looks for the
+// client and does the slow part of attaching ahead of time: matching the
+// process, finding the client image, resolving the layout and a first read.
+// mumble_initPositionalData then only has to take the prepared process. The
+// thread keeps checking that the prepared process is still there, and rests
+// while the plugin is attached.
+
+#include "wowreader.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+bool discovery_start(void);
+void discovery_stop(void);
+
+// Hands over the prepared process if it is one of pids. For the thread that
+// calls mumble_initPositionalData; never waits for a search.
+bool discovery_take(struct WowProcess *process, const uint64_t *pids,
+					size_t count);
+
+// Stops looking while the plugin is attached and starts again once it is
+// not
+void discovery_setAttached(bool attached);
+
+#endif // WOW335PA_DISCOVERY_H_
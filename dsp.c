@@ -0,0 +1,344 @@
+#include "dsp.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) \
+	|| (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define DSP_SSE2 1
+#endif
+
+// Filter state below this is flushed so silence does not end up in denormals
+#define DENORMAL_LIMIT 1e-15f
+// -120 dBFS
+#define SILENCE_LIMIT 1e-6f
+
+void dsp_curveInit(struct DspCurve *curve, enum DspCurveKind kind,
+				   float minDistance, float maxDistance, const float *points,
+				   uint32_t pointCount) {
+	if (maxDistance <= 0.0f) {
+		maxDistance = 1.0f;
+	}
+	if (minDistance < 0.0f || minDistance >= maxDistance) {
+		minDistance = 0.0f;
+	}
+	curve->maxDistance   = maxDistance;
+	curve->pointsPerYard = (float) DSP_CURVE_POINTS / maxDistance;
+
+	for (uint32_t i = 0; i <= DSP_CURVE_POINTS; i++) {
+		float distance = (float) i / curve->pointsPerYard;
+		float gain;
+
+		switch (kind) {
+			case DSP_CURVE_LINEAR:
+				gain = distance <= minDistance
+						   ? 1.0f
+						   : (maxDistance - distance)
+								 / (maxDistance - minDistance);
+				break;
+			case DSP_CURVE_INVERSE: {
+				// Clamp the reference distance so there is some roll-off
+				float reference = minDistance > 0.5f ? minDistance : 0.5f;
+				float tail      = reference / maxDistance;
+				float inverse   = distance <= reference ? 1.0f
+														: reference / distance;
+				gain            = (inverse - tail) / (1.0f - tail);
+				break;
+			}
+			case DSP_CURVE_CUSTOM:
+			default: {
+				if (!points || pointCount < 2) {
+					gain = 1.0f;
+					break;
+				}
+				float position = distance / maxDistance
+								 * (float) (pointCount - 1);
+				uint32_t index = (uint32_t) position;
+				if (index >= pointCount - 1) {
+					gain = points[pointCount - 1];
+				} else {
+					float fraction = position - (float) index;
+					float span     = points[index + 1] - points[index];
+					gain           = points[index] + fraction * span;
+				}
+				break;
+			}
+		}
+
+		curve->gain[i] = gain < 0.0f ? 0.0f : (gain > 1.0f ? 1.0f : gain);
+	}
+}
+
+float dsp_lowpassCoefficient(float cutoffHz, uint32_t sampleRate) {
+	if (cutoffHz <= 0.0f || sampleRate == 0
+		|| cutoffHz >= 0.5f * (float) sampleRate) {
+		return 0.0f;
+	}
+	return expf(-2.0f * 3.14159265f * cutoffHz / (float) sampleRate);
+}
+
+bool dsp_isSilent(const float *pcm, size_t count) {
+	size_t i = 0;
+
+#ifdef DSP_SSE2
+	const __m128 limit = _mm_set1_ps(SILENCE_LIMIT);
+	const __m128 abs   = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	for (; i + 16 <= count; i += 16) {
+		__m128 peak = _mm_max_ps(
+			_mm_max_ps(_mm_and_ps(abs, _mm_loadu_ps(pcm + i)),
+					   _mm_and_ps(abs, _mm_loadu_ps(pcm + i + 4))),
+			_mm_max_ps(_mm_and_ps(abs, _mm_loadu_ps(pcm + i + 8)),
+					   _mm_and_ps(abs, _mm_loadu_ps(pcm + i + 12))));
+		if (_mm_movemask_ps(_mm_cmpge_ps(peak, limit))) {
+			return false;
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		if (fabsf(pcm[i]) >= SILENCE_LIMIT) {
+			return false;
+		}
+	}
+	return true;
+}
+
+float dsp_levelInt16(const int16_t *pcm, size_t count) {
+	double energy = 0.0;
+	size_t i      = 0;
+
+#ifdef DSP_SSE2
+	// madd squares and adds pairs of samples; -32768 is clamped so that a pair
+	// cannot overflow the 32-bit lane. Lanes are converted to float every 8
+	// samples.
+	const __m128i floor = _mm_set1_epi16(-32767);
+	__m128 sum          = _mm_setzero_ps();
+	for (; i + 8 <= count; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *) (pcm + i));
+		x         = _mm_max_epi16(x, floor);
+		sum       = _mm_add_ps(sum, _mm_cvtepi32_ps(_mm_madd_epi16(x, x)));
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, sum);
+	energy = (double) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+	for (; i < count; i++) {
+		energy += (double) pcm[i] * pcm[i];
+	}
+
+	if (count == 0 || energy <= 0.0) {
+		return -INFINITY;
+	}
+	float meanSquare = (float) (energy / (double) count);
+	return 10.0f * log10f(meanSquare / (32768.0f * 32768.0f));
+}
+
+void dsp_voiceReset(struct DspVoice *voice, float gain) {
+	voice->gain       = gain;
+	voice->lowpass[0] = 0.0f;
+	voice->lowpass[1] = 0.0f;
+}
+
+// Scalar reference, also used for the tail of the SIMD paths
+static void processScalar(float *pcm, uint32_t frames, uint16_t channelCount,
+						  float a, float *state, float *gain, float step) {
+	uint16_t filtered = channelCount < 2 ? channelCount : 2;
+	float b           = 1.0f - a;
+	float g           = *gain;
+
+	for (uint32_t i = 0; i < frames; i++) {
+		float *frame = pcm + (size_t) i * channelCount;
+		for (uint16_t c = 0; c < filtered; c++) {
+			state[c] = b * frame[c] + a * state[c];
+			frame[c] = state[c] * g;
+		}
+		for (uint16_t c = filtered; c < channelCount; c++) {
+			frame[c] *= g;
+		}
+		g += step;
+	}
+
+	*gain = g;
+}
+
+#ifdef DSP_SSE2
+static inline __m128 shiftLanes1(__m128 v) {
+	return _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4));
+}
+
+static inline __m128 shiftLanes2(__m128 v) {
+	return _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8));
+}
+
+// Four mono frames per vector. The recursion is solved within the vector with
+// a two-step prefix scan, then the previous output is carried in with the
+// matching powers of a.
+static uint32_t processMono(float *pcm, uint32_t frames, float a,
+							float *state, float *gain, float step) {
+	const __m128 b     = _mm_set1_ps(1.0f - a);
+	const __m128 a1    = _mm_set1_ps(a);
+	const __m128 a2    = _mm_set1_ps(a * a);
+	const __m128 carry = _mm_setr_ps(a, a * a, a * a * a, a * a * a * a);
+	const __m128 ramp  = _mm_setr_ps(0.0f, step, 2.0f * step, 3.0f * step);
+	const __m128 step4 = _mm_set1_ps(4.0f * step);
+	__m128 previous    = _mm_set1_ps(state[0]);
+	__m128 g           = _mm_add_ps(_mm_set1_ps(*gain), ramp);
+	uint32_t blocks    = frames / 4;
+
+	for (uint32_t i = 0; i < blocks; i++) {
+		__m128 t = _mm_mul_ps(b, _mm_loadu_ps(pcm + 4 * i));
+		t        = _mm_add_ps(t, _mm_mul_ps(a1, shiftLanes1(t)));
+		t        = _mm_add_ps(t, _mm_mul_ps(a2, shiftLanes2(t)));
+		__m128 y = _mm_add_ps(t, _mm_mul_ps(carry, previous));
+		previous = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3));
+		_mm_storeu_ps(pcm + 4 * i, _mm_mul_ps(y, g));
+		g = _mm_add_ps(g, step4);
+	}
+
+	state[0] = _mm_cvtss_f32(previous);
+	*gain    = _mm_cvtss_f32(g);
+	return blocks * 4;
+}
+
+// Two interleaved stereo frames per vector, [L0 R0 L1 R1]
+static uint32_t processStereo(float *pcm, uint32_t frames, float a,
+							  float *state, float *gain, float step) {
+	const __m128 b     = _mm_set1_ps(1.0f - a);
+	const __m128 a1    = _mm_set1_ps(a);
+	const __m128 carry = _mm_setr_ps(a, a, a * a, a * a);
+	const __m128 ramp  = _mm_setr_ps(0.0f, 0.0f, step, step);
+	const __m128 step2 = _mm_set1_ps(2.0f * step);
+	__m128 previous    = _mm_setr_ps(state[0], state[1], state[0], state[1]);
+	__m128 g           = _mm_add_ps(_mm_set1_ps(*gain), ramp);
+	uint32_t blocks    = frames / 2;
+
+	for (uint32_t i = 0; i < blocks; i++) {
+		__m128 t = _mm_mul_ps(b, _mm_loadu_ps(pcm + 4 * i));
+		t        = _mm_add_ps(t, _mm_mul_ps(a1, shiftLanes2(t)));
+		__m128 y = _mm_add_ps(t, _mm_mul_ps(carry, previous));
+		previous = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 2, 3, 2));
+		_mm_storeu_ps(pcm + 4 * i, _mm_mul_ps(y, g));
+		g = _mm_add_ps(g, step2);
+	}
+
+	state[0] = _mm_cvtss_f32(previous);
+	state[1] = _mm_cvtss_f32(_mm_shuffle_ps(previous, previous, 1));
+	*gain    = _mm_cvtss_f32(g);
+	return blocks * 2;
+}
+#endif
+
+void dsp_process(struct DspVoice *voice, float *pcm, uint32_t sampleCount,
+				 uint16_t channelCount, float gain, float coefficient) {
+	if (sampleCount == 0 || channelCount == 0) {
+		return;
+	}
+
+	float current = voice->gain;
+	float step    = (gain - current) / (float) sampleCount;
+	float a       = coefficient;
+	uint32_t done = 0;
+
+#ifdef DSP_SSE2
+	if (channelCount == 1) {
+		done = processMono(pcm, sampleCount, a, voice->lowpass, &current, step);
+	} else if (channelCount == 2) {
+		done =
+			processStereo(pcm, sampleCount, a, voice->lowpass, &current, step);
+	}
+#endif
+	processScalar(pcm + (size_t) done * channelCount, sampleCount - done,
+				  channelCount, a, voice->lowpass, &current, step);
+
+	for (int c = 0; c < 2; c++) {
+		if (fabsf(voice->lowpass[c]) < DENORMAL_LIMIT) {
+			voice->lowpass[c] = 0.0f;
+		}
+	}
+	voice->gain = gain;
+}
+
+static void mixClipScalar(float *out, uint16_t outChannels, const float *in,
+						  uint16_t inChannels, uint32_t frames, float gain) {
+	for (uint32_t f = 0; f < frames; f++) {
+		const float *frame = in + (size_t) f * inChannels;
+		float *target      = out + (size_t) f * outChannels;
+		for (uint16_t c = 0; c < outChannels; c++) {
+			float sample;
+			if (inChannels == 1) {
+				sample = frame[0];
+			} else if (outChannels == 1) {
+				sample = 0.5f * (frame[0] + frame[1]);
+			} else if (c < inChannels && c < 2) {
+				sample = frame[c];
+			} else {
+				continue;
+			}
+			float mixed = target[c] + gain * sample;
+			target[c]   = mixed > 1.0f ? 1.0f : (mixed < -1.0f ? -1.0f : mixed);
+		}
+	}
+}
+
+#ifdef DSP_SSE2
+static inline __m128 addClip(__m128 out, __m128 in, __m128 gain) {
+	__m128 mixed = _mm_add_ps(out, _mm_mul_ps(in, gain));
+	return _mm_min_ps(_mm_max_ps(mixed, _mm_set1_ps(-1.0f)),
+					  _mm_set1_ps(1.0f));
+}
+
+// Returns the number of frames mixed; the rest is left to the scalar path
+static uint32_t mixClipVector(float *out, uint16_t outChannels,
+							  const float *in, uint16_t inChannels,
+							  uint32_t frames, float gain) {
+	__m128 g      = _mm_set1_ps(gain);
+	uint32_t done = 0;
+
+	if (inChannels == outChannels && inChannels <= 2) {
+		// Same layout: four samples at a time, whatever the channels
+		size_t count = (size_t) frames * inChannels & ~(size_t) 3;
+		for (size_t i = 0; i < count; i += 4) {
+			__m128 o = _mm_loadu_ps(out + i);
+			_mm_storeu_ps(out + i, addClip(o, _mm_loadu_ps(in + i), g));
+		}
+		done = (uint32_t) (count / inChannels);
+	} else if (inChannels == 1 && outChannels == 2) {
+		for (; done + 4 <= frames; done += 4) {
+			__m128 v  = _mm_loadu_ps(in + done);
+			float *o  = out + (size_t) done * 2;
+			__m128 lo = _mm_unpacklo_ps(v, v);
+			__m128 hi = _mm_unpackhi_ps(v, v);
+			_mm_storeu_ps(o, addClip(_mm_loadu_ps(o), lo, g));
+			_mm_storeu_ps(o + 4, addClip(_mm_loadu_ps(o + 4), hi, g));
+		}
+	} else if (inChannels == 2 && outChannels == 1) {
+		__m128 half = _mm_mul_ps(g, _mm_set1_ps(0.5f));
+		for (; done + 4 <= frames; done += 4) {
+			const float *i = in + (size_t) done * 2;
+			__m128 a       = _mm_loadu_ps(i);
+			__m128 b       = _mm_loadu_ps(i + 4);
+			__m128 sum =
+				_mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)),
+						   _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+			_mm_storeu_ps(out + done,
+						  addClip(_mm_loadu_ps(out + done), sum, half));
+		}
+	}
+
+	return done;
+}
+#endif
+
+void dsp_mixClip(float *out, uint16_t outChannels, const float *in,
+				 uint16_t inChannels, uint32_t frameCount, float gain) {
+	if (outChannels == 0 || inChannels == 0) {
+		return;
+	}
+
+	uint32_t done = 0;
+#ifdef DSP_SSE2
+	done = mixClipVector(out, outChannels, in, inChannels, frameCount, gain);
+#endif
+	mixClipScalar(out + (size_t) done * outChannels, outChannels,
+				  in + (size_t) done * inChannels, inChannels,
+				  frameCount - done, gain);
+}
@@ -0,0 +1,91 @@
+#ifndef WOW335PA_DSP_H_
+#define WOW335PA_DSP_H_
+
+// Allocation-free building blocks for cheap per-source spatial effects:
+// distance attenuation curves sampled into lookup tables, and a smoothed
+// gain + one-pole low-pass kernel vectorised over samples and channels.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DSP_CURVE_POINTS 256
+// Most points a custom curve may be defined with
+#define DSP_CURVE_MAX_POINTS 32
+
+enum DspCurveKind {
+	// Full gain up to minDistance, then linearly down to zero at maxDistance
+	DSP_CURVE_LINEAR,
+	// minDistance / distance, rescaled to reach zero at maxDistance
+	DSP_CURVE_INVERSE,
+	// Gains at evenly spaced distances from 0 to maxDistance, interpolated
+	DSP_CURVE_CUSTOM,
+};
+
+struct DspCurve {
+	float maxDistance;
+	float pointsPerYard;
+	// One extra point so the lookup can always interpolate
+	float gain[DSP_CURVE_POINTS + 1];
+};
+
+// points/pointCount are only used by DSP_CURVE_CUSTOM (2 <= pointCount <=
+// DSP_CURVE_MAX_POINTS)
+void dsp_curveInit(struct DspCurve *curve, enum DspCurveKind kind,
+				   float minDistance, float maxDistance, const float *points,
+				   uint32_t pointCount);
+
+static inline float dsp_curveGain(const struct DspCurve *curve,
+								  float distance) {
+	float position = distance * curve->pointsPerYard;
+	if (!(position < (float) DSP_CURVE_POINTS)) {
+		return curve->gain[DSP_CURVE_POINTS];
+	}
+	if (position < 0.0f) {
+		position = 0.0f;
+	}
+	uint32_t index = (uint32_t) position;
+	float fraction = position - (float) index;
+	return curve->gain[index]
+		   + fraction * (curve->gain[index + 1] - curve->gain[index]);
+}
+
+// Per-source state of dsp_process, carried across buffers
+struct DspVoice {
+	float gain;
+	float lowpass[2];
+};
+
+// Pole of a one-pole low-pass with the given -3 dB cutoff; 0 means no
+// filtering
+float dsp_lowpassCoefficient(float cutoffHz, uint32_t sampleRate);
+
+// Starts a voice at the given gain without a ramp and with clean filter state
+void dsp_voiceReset(struct DspVoice *voice, float gain);
+
+// Whether all count samples are below -120 dBFS, i.e. padding rather than
+// voice
+bool dsp_isSilent(const float *pcm, size_t count);
+
+// Root mean square of count 16-bit samples, in dBFS (-INFINITY for digital
+// silence)
+float dsp_levelInt16(const int16_t *pcm, size_t count);
+
+// Filters pcm (interleaved, channelCount channels) with the one-pole low-pass
+// y[n] = (1 - a) x[n] + a y[n - 1] and scales it, ramping the gain linearly
+// from the voice's current value to gain over the buffer so that changes do
+// not zipper. Filter changes take effect at the buffer boundary, which the
+// one-pole absorbs without clicks.
+// Mono and stereo take the SIMD path, other layouts the scalar one; only the
+// first two channels of wider layouts are filtered.
+void dsp_process(struct DspVoice *voice, float *pcm, uint32_t sampleCount,
+				 uint16_t channelCount, float gain, float coefficient);
+
+// Adds frameCount frames of in (inChannels interleaved) scaled by gain to out
+// (outChannels interleaved) and clips the result to [-1, 1]. Mono input goes
+// to every output channel, stereo input is downmixed for a mono output and
+// fills the first two channels of wider ones.
+void dsp_mixClip(float *out, uint16_t outChannels, const float *in,
+				 uint16_t inChannels, uint32_t frameCount, float gain);
+
+#endif // WOW335PA_DSP_H_
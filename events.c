@@ -0,0 +1,187 @@
+#include "events.h"
+
+#include "platform.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#define EVENT_QUEUE_SIZE 64 // must be a power of two
+#define MAX_HANDLERS 16
+// How often the dispatcher polls the queue. The positional thread never wakes
+// it, so pushing stays free of system calls and cannot race events_stop()
+// tearing the semaphore down.
+#define DISPATCH_POLL_MS 10
+// Tick handlers run after every batch of events and at least this often
+#define DISPATCH_TICK_NS 100000000ull
+
+struct Subscriber {
+	uint32_t mask;
+	game_event_handler handler;
+	void *userdata;
+};
+
+struct TickSubscriber {
+	game_tick_handler handler;
+	void *userdata;
+};
+
+static struct Subscriber subscribers[MAX_HANDLERS];
+static size_t subscriberCount = 0;
+static struct TickSubscriber tickSubscribers[MAX_HANDLERS];
+static size_t tickSubscriberCount = 0;
+
+// Single-producer/single-consumer ring. The producer only writes head, the
+// consumer only writes tail; keep them on separate cache lines.
+static struct GameEvent queue[EVENT_QUEUE_SIZE];
+static _Alignas(64) atomic_uint queueHead = 0;
+static _Alignas(64) atomic_uint queueTail = 0;
+static atomic_uint droppedEvents          = 0;
+
+static plat_thread_t dispatcherThread;
+// Only posted by events_stop()
+static plat_sem_t wakeup;
+static atomic_bool running = false;
+
+bool events_subscribe(uint32_t mask, game_event_handler handler,
+					  void *userdata) {
+	if (atomic_load(&running) || subscriberCount == MAX_HANDLERS) {
+		return false;
+	}
+
+	subscribers[subscriberCount].mask     = mask;
+	subscribers[subscriberCount].handler  = handler;
+	subscribers[subscriberCount].userdata = userdata;
+	subscriberCount++;
+
+	return true;
+}
+
+bool events_subscribeTick(game_tick_handler handler, void *userdata) {
+	if (atomic_load(&running) || tickSubscriberCount == MAX_HANDLERS) {
+		return false;
+	}
+
+	tickSubscribers[tickSubscriberCount].handler  = handler;
+	tickSubscribers[tickSubscriberCount].userdata = userdata;
+	tickSubscriberCount++;
+
+	return true;
+}
+
+bool events_push(const struct GameEvent *event) {
+	if (!atomic_load_explicit(&running, memory_order_relaxed)) {
+		return false;
+	}
+
+	unsigned head = atomic_load_explicit(&queueHead, memory_order_relaxed);
+	unsigned tail = atomic_load_explicit(&queueTail, memory_order_acquire);
+	if (head - tail == EVENT_QUEUE_SIZE) {
+		atomic_fetch_add_explicit(&droppedEvents, 1, memory_order_relaxed);
+		return false;
+	}
+
+	queue[head & (EVENT_QUEUE_SIZE - 1)] = *event;
+	atomic_store_explicit(&queueHead, head + 1, memory_order_release);
+
+	return true;
+}
+
+static void dispatch(const struct GameEvent *event) {
+	uint32_t bit = GAME_EVENT_MASK(event->type);
+	for (size_t i = 0; i < subscriberCount; i++) {
+		if (subscribers[i].mask & bit) {
+			subscribers[i].handler(event, subscribers[i].userdata);
+		}
+	}
+}
+
+static void dispatcherMain(void *arg) {
+	(void) arg;
+
+	uint64_t lastTickNs = 0;
+	while (atomic_load(&running)) {
+		plat_sem_wait_ms(&wakeup, DISPATCH_POLL_MS);
+
+		unsigned tail = atomic_load_explicit(&queueTail, memory_order_relaxed);
+		unsigned head = atomic_load_explicit(&queueHead, memory_order_acquire);
+
+		// Once events_stop() is waiting, nothing more is handed out
+		bool dispatched = tail != head;
+		while (tail != head && atomic_load(&running)) {
+			struct GameEvent event = queue[tail & (EVENT_QUEUE_SIZE - 1)];
+			tail++;
+			atomic_store_explicit(&queueTail, tail, memory_order_release);
+
+			dispatch(&event);
+		}
+
+		uint64_t now = plat_now_ns();
+		if (!atomic_load(&running)
+			|| (!dispatched && now - lastTickNs < DISPATCH_TICK_NS)) {
+			continue;
+		}
+		lastTickNs = now;
+		for (size_t i = 0; i < tickSubscriberCount; i++) {
+			tickSubscribers[i].handler(now, tickSubscribers[i].userdata);
+		}
+	}
+}
+
+const char *events_name(enum GameEventType type) {
+	switch (type) {
+		case GAME_EVENT_ENTERED_WORLD:
+			return "entered world";
+		case GAME_EVENT_LEFT_WORLD:
+			return "left world";
+		case GAME_EVENT_MAP_CHANGED:
+			return "map changed";
+		case GAME_EVENT_ZONE_CHANGED:
+			return "zone changed";
+		case GAME_EVENT_LEADER_CHANGED:
+			return "leader changed";
+		case GAME_EVENT_CHARACTER_CHANGED:
+			return "character changed";
+		case GAME_EVENT_TELEPORTED:
+			return "teleported";
+		case GAME_EVENT_DIED:
+			return "died";
+		case GAME_EVENT_REVIVED:
+			return "revived";
+		default:
+			return "unknown";
+	}
+}
+
+bool events_start(void) {
+	if (atomic_load(&running)) {
+		return true;
+	}
+
+	atomic_store(&queueHead, 0);
+	atomic_store(&queueTail, 0);
+	atomic_store(&droppedEvents, 0);
+
+	if (!plat_sem_init(&wakeup)) {
+		return false;
+	}
+
+	atomic_store(&running, true);
+	if (!plat_thread_start(&dispatcherThread, dispatcherMain, NULL)) {
+		atomic_store(&running, false);
+		plat_sem_destroy(&wakeup);
+		return false;
+	}
+
+	return true;
+}
+
+void events_stop(void) {
+	if (atomic_exchange(&running, false)) {
+		plat_sem_post(&wakeup);
+		plat_thread_join(dispatcherThread);
+		plat_sem_destroy(&wakeup);
+	}
+
+	subscriberCount     = 0;
+	tickSubscriberCount = 0;
+}
@@ -0,0 +1,74 @@
+#ifndef WOW335PA_EVENTS_H_
+#define WOW335PA_EVENTS_H_
+
+// Typed game-state events. The positional thread pushes events into a
+// single-producer/single-consumer queue and a dispatcher thread, polling it
+// every 10ms, hands them to the registered handlers, so reactions never run on
+// Mumble's positional thread.
+//
+// Handlers must not call the Mumble API: it waits for Mumble's main thread,
+// which joins the dispatcher in events_stop(). They queue the call for the main
+// thread instead (mainthread.h).
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum GameEventType {
+	GAME_EVENT_ENTERED_WORLD,
+	GAME_EVENT_LEFT_WORLD,
+	GAME_EVENT_MAP_CHANGED,
+	GAME_EVENT_ZONE_CHANGED,
+	GAME_EVENT_LEADER_CHANGED,
+	GAME_EVENT_CHARACTER_CHANGED,
+	GAME_EVENT_TELEPORTED,
+	GAME_EVENT_DIED,
+	GAME_EVENT_REVIVED,
+
+	GAME_EVENT_COUNT
+};
+
+#define GAME_EVENT_MASK(type) (1u << (type))
+#define GAME_EVENT_MASK_ALL ((1u << GAME_EVENT_COUNT) - 1u)
+
+struct GameEvent {
+	enum GameEventType type;
+	uint64_t timestampNs;
+	// Map and zone the player is in when the event is emitted
+	int mapId;
+	int zoneId;
+	// Old and new value for GAME_EVENT_MAP_CHANGED, GAME_EVENT_ZONE_CHANGED
+	// and GAME_EVENT_LEADER_CHANGED
+	int previous;
+	int current;
+	// Player position (WoW coordinates) when the event is emitted
+	float position[3];
+	// Length of the jump for GAME_EVENT_TELEPORTED
+	float distance;
+	char player[50];
+};
+
+typedef void (*game_event_handler)(const struct GameEvent *event,
+								   void *userdata);
+// Called on the dispatcher thread after every batch of events and at least
+// every 100ms, for handlers that need to act on timeouts
+typedef void (*game_tick_handler)(uint64_t nowNs, void *userdata);
+
+// Registers a handler for all event types in mask. Must be called before
+// events_start(); handlers run on the dispatcher thread.
+bool events_subscribe(uint32_t mask, game_event_handler handler,
+					  void *userdata);
+bool events_subscribeTick(game_tick_handler handler, void *userdata);
+
+// Queues an event for dispatching. Must only be called from the positional
+// thread. Never blocks and makes no system call; returns false if the queue is
+// full and the event was dropped.
+bool events_push(const struct GameEvent *event);
+
+const char *events_name(enum GameEventType type);
+
+bool events_start(void);
+// Stops the dispatcher thread and forgets all handlers. Main thread; events
+// still queued are not handed out.
+void events_stop(void);
+
+#endif // WOW335PA_EVENTS_H_
@@ -0,0 +1,105 @@
+#ifndef WOW335PA_FLATMAP_H_
+#define WOW335PA_FLATMAP_H_
+
+// Open-addressing uint32 -> uint32 hash map over caller-provided storage.
+// Linear probing with backward-shift deletion, so there are no tombstones and
+// lookups stay short however often entries come and go. Never allocates.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FLATMAP_EMPTY 0xFFFFFFFFu
+
+struct FlatMap {
+	uint32_t *keys;
+	uint32_t *values;
+	// Must be a power of two and larger than the maximum number of entries
+	uint32_t capacity;
+	uint32_t count;
+};
+
+static inline uint32_t flatmap_slot_(const struct FlatMap *map, uint32_t key) {
+	// Fibonacci hashing spreads sequential IDs over the table
+	return (uint32_t) ((key * 2654435769u) & (map->capacity - 1));
+}
+
+static inline void flatmap_init(struct FlatMap *map, uint32_t *keys,
+								uint32_t *values, uint32_t capacity) {
+	map->keys     = keys;
+	map->values   = values;
+	map->capacity = capacity;
+	map->count    = 0;
+	for (uint32_t i = 0; i < capacity; i++) {
+		keys[i] = FLATMAP_EMPTY;
+	}
+}
+
+static inline void flatmap_clear(struct FlatMap *map) {
+	flatmap_init(map, map->keys, map->values, map->capacity);
+}
+
+static inline bool flatmap_get(const struct FlatMap *map, uint32_t key,
+							   uint32_t *value) {
+	uint32_t mask = map->capacity - 1;
+	for (uint32_t i = flatmap_slot_(map, key);; i = (i + 1) & mask) {
+		if (map->keys[i] == key) {
+			*value = map->values[i];
+			return true;
+		}
+		if (map->keys[i] == FLATMAP_EMPTY) {
+			return false;
+		}
+	}
+}
+
+// Inserts or overwrites. Returns false if the map is full.
+static inline bool flatmap_put(struct FlatMap *map, uint32_t key,
+							   uint32_t value) {
+	uint32_t mask = map->capacity - 1;
+	for (uint32_t i = flatmap_slot_(map, key);; i = (i + 1) & mask) {
+		if (map->keys[i] == key) {
+			map->values[i] = value;
+			return true;
+		}
+		if (map->keys[i] == FLATMAP_EMPTY) {
+			// Keep at least one empty slot so probing always terminates
+			if (map->count + 1 >= map->capacity) {
+				return false;
+			}
+			map->keys[i]   = key;
+			map->values[i] = value;
+			map->count++;
+			return true;
+		}
+	}
+}
+
+static inline bool flatmap_remove(struct FlatMap *map, uint32_t key) {
+	uint32_t mask = map->capacity - 1;
+	uint32_t i    = flatmap_slot_(map, key);
+	while (map->keys[i] != key) {
+		if (map->keys[i] == FLATMAP_EMPTY) {
+			return false;
+		}
+		i = (i + 1) & mask;
+	}
+
+	// Shift following entries back into the hole unless they already sit at
+	// or after their home slot relative to it
+	uint32_t hole = i;
+	for (uint32_t j = (hole + 1) & mask; map->keys[j] != FLATMAP_EMPTY;
+		 j        = (j + 1) & mask) {
+		uint32_t home = flatmap_slot_(map, map->keys[j]);
+		if (((j - home) & mask) >= ((j - hole) & mask)) {
+			map->keys[hole]   = map->keys[j];
+			map->values[hole] = map->values[j];
+			hole              = j;
+		}
+	}
+	map->keys[hole] = FLATMAP_EMPTY;
+	map->count--;
+
+	return true;
+}
+
+#endif // WOW335PA_FLATMAP_H_
@@ -0,0 +1,166 @@
+#include "gamestate.h"
+
+#include "events.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <string.h>
+
+// A position change larger than this between two frames is a teleport (hearth,
+// portal, summon, ...) rather than movement. Flying mounts cover ~10 yards
+// between two positional updates.
+#define TELEPORT_DISTANCE 50.0f
+
+static struct GameSnapshot previous;
+static bool havePrevious = false;
+
+// Latest frame for other threads, guarded by a seqlock: odd while the
+// positional thread is writing
+static struct GameSnapshot latest;
+static atomic_uint latestSeq = 0;
+
+static void publish(const struct GameSnapshot *snapshot) {
+	unsigned seq = atomic_load_explicit(&latestSeq, memory_order_relaxed);
+	atomic_store_explicit(&latestSeq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	latest = *snapshot;
+	atomic_store_explicit(&latestSeq, seq + 2, memory_order_release);
+}
+
+void gamestate_toListener(const struct GameSnapshot *snapshot,
+						  const float position[3], float relative[3]) {
+	float front[3], up[3], left[3], delta[3];
+
+	memcpy(front, snapshot->cameraFront, sizeof(front));
+	memcpy(up, snapshot->cameraTop, sizeof(up));
+	// Fall back to the avatar heading when the camera vectors are not set
+	if (front[0] == 0.0f && front[1] == 0.0f && front[2] == 0.0f) {
+		front[0] = cosf(snapshot->heading);
+		front[1] = sinf(snapshot->heading);
+		front[2] = 0.0f;
+	}
+	if (up[0] == 0.0f && up[1] == 0.0f && up[2] == 0.0f) {
+		up[2] = 1.0f;
+	}
+
+	// WoW coordinates are right-handed (x north, y west, z up)
+	left[0] = up[1] * front[2] - up[2] * front[1];
+	left[1] = up[2] * front[0] - up[0] * front[2];
+	left[2] = up[0] * front[1] - up[1] * front[0];
+
+	for (int i = 0; i < 3; i++) {
+		delta[i] = position[i] - snapshot->cameraPos[i];
+	}
+	relative[0] =
+		delta[0] * front[0] + delta[1] * front[1] + delta[2] * front[2];
+	relative[1] = delta[0] * left[0] + delta[1] * left[1] + delta[2] * left[2];
+	relative[2] = delta[0] * up[0] + delta[1] * up[1] + delta[2] * up[2];
+}
+
+bool gamestate_latest(struct GameSnapshot *snapshot) {
+	unsigned before, after;
+	do {
+		before = atomic_load_explicit(&latestSeq, memory_order_acquire);
+		*snapshot = latest;
+		atomic_thread_fence(memory_order_acquire);
+		after = atomic_load_explicit(&latestSeq, memory_order_relaxed);
+	} while (before != after || (before & 1));
+
+	return before != 0;
+}
+
+static void emit(enum GameEventType type, const struct GameSnapshot *snapshot,
+				 int previousValue, int currentValue, float distance) {
+	struct GameEvent event;
+	event.type        = type;
+	event.timestampNs = snapshot->timestampNs;
+	event.mapId       = snapshot->mapId;
+	event.zoneId      = snapshot->zoneId;
+	event.previous    = previousValue;
+	event.current     = currentValue;
+	memcpy(event.position, snapshot->avatarPos, sizeof(event.position));
+	event.distance = distance;
+	memcpy(event.player, snapshot->player, sizeof(event.player));
+	event.player[sizeof(event.player) - 1] = '\0';
+
+	events_push(&event);
+}
+
+static float distance3(const float *a, const float *b) {
+	float dx = a[0] - b[0];
+	float dy = a[1] - b[1];
+	float dz = a[2] - b[2];
+	return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+void gamestate_update(const struct GameSnapshot *snapshot) {
+	publish(snapshot);
+
+	bool wasInWorld = havePrevious && gamestate_inWorld(&previous);
+	bool isInWorld  = gamestate_inWorld(snapshot);
+
+	if (!isInWorld) {
+		if (wasInWorld) {
+			// Keep the last known values so listeners know what was left
+			struct GameSnapshot left = previous;
+			left.timestampNs         = snapshot->timestampNs;
+			emit(GAME_EVENT_LEFT_WORLD, &left, previous.mapId, previous.mapId,
+				 0.0f);
+		}
+		if (havePrevious) {
+			previous.valid = snapshot->valid;
+			previous.state = snapshot->state;
+		}
+		return;
+	}
+
+	if (!wasInWorld) {
+		emit(GAME_EVENT_ENTERED_WORLD, snapshot,
+			 havePrevious ? previous.mapId : -1, snapshot->mapId, 0.0f);
+	}
+
+	if (havePrevious) {
+		if (strncmp(previous.player, snapshot->player, sizeof(previous.player))
+			!= 0) {
+			emit(GAME_EVENT_CHARACTER_CHANGED, snapshot, 0, 0, 0.0f);
+		}
+		if (previous.mapId != snapshot->mapId) {
+			emit(GAME_EVENT_MAP_CHANGED, snapshot, previous.mapId,
+				 snapshot->mapId, 0.0f);
+		}
+		// A field that could not be read says nothing about a change
+		uint8_t missing = previous.missing | snapshot->missing;
+		if (!(missing & GAME_MISSING_ZONE)
+			&& previous.zoneId != snapshot->zoneId) {
+			emit(GAME_EVENT_ZONE_CHANGED, snapshot, previous.zoneId,
+				 snapshot->zoneId, 0.0f);
+		}
+		if (previous.leaderGUID != snapshot->leaderGUID) {
+			emit(GAME_EVENT_LEADER_CHANGED, snapshot, previous.leaderGUID,
+				 snapshot->leaderGUID, 0.0f);
+		}
+		if (wasInWorld && previous.mapId == snapshot->mapId) {
+			float jump = distance3(previous.avatarPos, snapshot->avatarPos);
+			if (jump > TELEPORT_DISTANCE) {
+				emit(GAME_EVENT_TELEPORTED, snapshot, snapshot->mapId,
+					 snapshot->mapId, jump);
+			}
+		}
+		bool wasGhost = gamestate_isGhost(&previous);
+		bool isGhost  = gamestate_isGhost(snapshot);
+		if (missing & GAME_MISSING_CORPSE) {
+			// Neither died nor revived
+		} else if (!wasGhost && isGhost) {
+			emit(GAME_EVENT_DIED, snapshot, 0, 0, 0.0f);
+		} else if (wasGhost && !isGhost) {
+			emit(GAME_EVENT_REVIVED, snapshot, 0, 0, 0.0f);
+		}
+	}
+
+	previous     = *snapshot;
+	havePrevious = true;
+}
+
+void gamestate_reset(void) {
+	havePrevious = false;
+}
@@ -0,0 +1,64 @@
+#ifndef WOW335PA_GAMESTATE_H_
+#define WOW335PA_GAMESTATE_H_
+
+// One frame of game state as read from the client, and the diffing that turns
+// consecutive frames into events (see events.h).
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct GameSnapshot {
+	uint64_t timestampNs;
+	// All reads succeeded
+	bool valid;
+	// 1 while the player is in the world, anything else is loading screen,
+	// login or character select
+	char state;
+	int mapId;
+	int zoneId;
+	int leaderGUID;
+	// Positions and vectors are in WoW coordinates
+	float avatarPos[3];
+	float heading;
+	float cameraPos[3];
+	float cameraFront[3];
+	float cameraTop[3];
+	// Set by the client once the spirit is released, zero while alive
+	float corpsePos[3];
+	char player[50];
+	uint8_t playerClass;
+	// Optional fields that could not be read (GAME_MISSING_*); they are zero.
+	// They do not make the frame invalid.
+	uint8_t missing;
+};
+
+#define GAME_MISSING_CLASS 0x01
+#define GAME_MISSING_ZONE 0x02
+#define GAME_MISSING_CORPSE 0x04
+
+static inline bool gamestate_inWorld(const struct GameSnapshot *snapshot) {
+	return snapshot->valid && snapshot->state == 1;
+}
+
+static inline bool gamestate_isGhost(const struct GameSnapshot *snapshot) {
+	return snapshot->corpsePos[0] != 0.0f || snapshot->corpsePos[1] != 0.0f
+		   || snapshot->corpsePos[2] != 0.0f;
+}
+
+// Position relative to the camera: x to the front, y to the left, z up (the
+// SOFA convention used by hrtf.h). position is in WoW coordinates.
+void gamestate_toListener(const struct GameSnapshot *snapshot,
+						  const float position[3], float relative[3]);
+
+// Compares the snapshot with the previous one and queues an event for every
+// change. Must only be called from the positional thread.
+void gamestate_update(const struct GameSnapshot *snapshot);
+
+// Copies the most recent snapshot. Lock-free, may be called from any thread;
+// returns false until the first frame has been read.
+bool gamestate_latest(struct GameSnapshot *snapshot);
+
+// Forgets the previous snapshot, e.g. when the game process went away
+void gamestate_reset(void);
+
+#endif // WOW335PA_GAMESTATE_H_
@@ -0,0 +1,518 @@
+#include "hrtf.h"
+
+#include "platform.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64) \
+	|| (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#	include <xmmintrin.h>
+#	define HRTF_SSE 1
+#endif
+
+// FFT size of a partition (overlap-save with 50% overlap) and the number of
+// complex bins it is computed with. Spectra of real signals are stored as
+// BINS complex values with the Nyquist bin packed into the imaginary part of
+// the DC bin.
+#define FFT_SIZE (2 * HRTF_BLOCK)
+#define BINS HRTF_BLOCK
+
+#define FILE_MAGIC "W3HR"
+#define FILE_VERSION 1
+#define FILE_HEADER_SIZE 32
+#define MAX_LENGTH 4096
+#define MAX_DIRECTIONS 65536
+
+// Voices without audio for this long are reset and may be taken over
+#define DEFAULT_IDLE_TIMEOUT_NS (1000ull * 1000000ull)
+
+struct Voice {
+	mumble_userid_t source;
+	uint64_t lastUsedNs;
+	// Samples of the current block collected so far
+	uint32_t fill;
+	// Filter the last block was rendered with, -1 before the first block
+	int32_t direction;
+	// Frequency-domain delay line: the spectra of the last partitionCount
+	// input frames, newest at fdlHead
+	uint32_t fdlHead;
+	float *fdl;
+	// Previous and current input block
+	float input[FFT_SIZE];
+	// Output of the last block, played while the next one is collected
+	float output[2][HRTF_BLOCK];
+};
+
+struct Fft {
+	uint16_t bitReverse[BINS];
+	// Twiddles of the complex BINS-point FFT
+	float cosTable[BINS / 2];
+	float sinTable[BINS / 2];
+	// Twiddles that split it into the FFT_SIZE-point real FFT
+	float splitCos[BINS];
+	float splitSin[BINS];
+};
+
+static atomic_bool loaded;
+static uint32_t sampleRate;
+static uint32_t partitionCount;
+static uint32_t elevationCount;
+static uint32_t azimuthCount;
+static float elevationStart;
+static float elevationStep;
+// [direction][ear][partition][re BINS, im BINS], scaled for the inverse FFT
+static float *filters;
+static struct Fft fft;
+
+// Audio thread state
+static struct Voice voices[HRTF_MAX_VOICES];
+static float *fdlStorage;
+static float bus[2][HRTF_MAX_FRAMES];
+static uint32_t busFrames;
+static uint64_t idleTimeoutNs = DEFAULT_IDLE_TIMEOUT_NS;
+
+static void fftInit(struct Fft *f) {
+	const double pi = 3.14159265358979323846;
+	uint32_t bits   = 0;
+	while ((1u << bits) < BINS) {
+		bits++;
+	}
+	for (uint32_t i = 0; i < BINS; i++) {
+		uint32_t reversed = 0;
+		for (uint32_t b = 0; b < bits; b++) {
+			reversed |= ((i >> b) & 1) << (bits - 1 - b);
+		}
+		f->bitReverse[i] = (uint16_t) reversed;
+	}
+	for (uint32_t i = 0; i < BINS / 2; i++) {
+		f->cosTable[i] = (float) cos(2.0 * pi * i / BINS);
+		f->sinTable[i] = (float) sin(2.0 * pi * i / BINS);
+	}
+	for (uint32_t i = 0; i < BINS; i++) {
+		f->splitCos[i] = (float) cos(2.0 * pi * i / FFT_SIZE);
+		f->splitSin[i] = (float) sin(2.0 * pi * i / FFT_SIZE);
+	}
+}
+
+// In-place forward complex FFT of BINS points on bit-reversed input
+static void fftComplex(float *re, float *im) {
+	for (uint32_t size = 2; size <= BINS; size *= 2) {
+		uint32_t half = size / 2;
+		uint32_t step = BINS / size;
+		for (uint32_t start = 0; start < BINS; start += size) {
+			for (uint32_t j = 0; j < half; j++) {
+				float wr   = fft.cosTable[j * step];
+				float wi   = -fft.sinTable[j * step];
+				uint32_t a = start + j;
+				uint32_t b = a + half;
+				float tr   = re[b] * wr - im[b] * wi;
+				float ti   = re[b] * wi + im[b] * wr;
+				re[b]      = re[a] - tr;
+				im[b]      = im[a] - ti;
+				re[a] += tr;
+				im[a] += ti;
+			}
+		}
+	}
+}
+
+// Real FFT of FFT_SIZE samples into packed BINS bins
+static void fftForward(const float *x, float *outRe, float *outIm) {
+	float zr[BINS], zi[BINS];
+	for (uint32_t n = 0; n < BINS; n++) {
+		zr[fft.bitReverse[n]] = x[2 * n];
+		zi[fft.bitReverse[n]] = x[2 * n + 1];
+	}
+	fftComplex(zr, zi);
+
+	outRe[0] = zr[0] + zi[0];
+	outIm[0] = zr[0] - zi[0];
+	for (uint32_t k = 1; k < BINS; k++) {
+		// Even and odd half spectra from Z[k] and conj(Z[BINS - k])
+		float er  = 0.5f * (zr[k] + zr[BINS - k]);
+		float ei  = 0.5f * (zi[k] - zi[BINS - k]);
+		float or_ = 0.5f * (zi[k] + zi[BINS - k]);
+		float oi  = 0.5f * (zr[BINS - k] - zr[k]);
+		float c   = fft.splitCos[k];
+		float s   = fft.splitSin[k];
+		outRe[k]  = er + c * or_ + s * oi;
+		outIm[k]  = ei + c * oi - s * or_;
+	}
+}
+
+// Inverse of fftForward, scaled by BINS
+static void fftInverse(const float *inRe, const float *inIm, float *x) {
+	float zr[BINS], zi[BINS];
+
+	// Rebuild Z = E + iO and conjugate it, so the forward transform can be
+	// used for the inverse one
+	zr[fft.bitReverse[0]] = 0.5f * (inRe[0] + inIm[0]);
+	zi[fft.bitReverse[0]] = -0.5f * (inRe[0] - inIm[0]);
+	for (uint32_t k = 1; k < BINS; k++) {
+		float er  = 0.5f * (inRe[k] + inRe[BINS - k]);
+		float ei  = 0.5f * (inIm[k] - inIm[BINS - k]);
+		float dr  = 0.5f * (inRe[k] - inRe[BINS - k]);
+		float di  = 0.5f * (inIm[k] + inIm[BINS - k]);
+		float c   = fft.splitCos[k];
+		float s   = fft.splitSin[k];
+		float or_ = dr * c - di * s;
+		float oi  = dr * s + di * c;
+		zr[fft.bitReverse[k]] = er - oi;
+		zi[fft.bitReverse[k]] = -(ei + or_);
+	}
+	fftComplex(zr, zi);
+
+	for (uint32_t n = 0; n < BINS; n++) {
+		x[2 * n]     = zr[n];
+		x[2 * n + 1] = -zi[n];
+	}
+}
+
+// acc += x * h over packed spectra
+static void multiplyAccumulate(float *accRe, float *accIm, const float *xRe,
+							   const float *xIm, const float *hRe,
+							   const float *hIm) {
+	// DC and Nyquist are real and share bin 0
+	float dc      = accRe[0] + xRe[0] * hRe[0];
+	float nyquist = accIm[0] + xIm[0] * hIm[0];
+
+#ifdef HRTF_SSE
+	for (uint32_t k = 0; k < BINS; k += 4) {
+		__m128 xr = _mm_loadu_ps(xRe + k);
+		__m128 xi = _mm_loadu_ps(xIm + k);
+		__m128 hr = _mm_loadu_ps(hRe + k);
+		__m128 hi = _mm_loadu_ps(hIm + k);
+		__m128 re = _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi));
+		__m128 im = _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr));
+		_mm_storeu_ps(accRe + k, _mm_add_ps(_mm_loadu_ps(accRe + k), re));
+		_mm_storeu_ps(accIm + k, _mm_add_ps(_mm_loadu_ps(accIm + k), im));
+	}
+#else
+	for (uint32_t k = 0; k < BINS; k++) {
+		accRe[k] += xRe[k] * hRe[k] - xIm[k] * hIm[k];
+		accIm[k] += xRe[k] * hIm[k] + xIm[k] * hRe[k];
+	}
+#endif
+
+	accRe[0] = dc;
+	accIm[0] = nyquist;
+}
+
+static inline float *filterAt(uint32_t direction, uint32_t ear,
+							  uint32_t partition) {
+	return filters
+		   + (((size_t) direction * 2 + ear) * partitionCount + partition)
+				 * 2 * BINS;
+}
+
+static uint32_t readU32(const uint8_t *p) {
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16)
+		   | ((uint32_t) p[3] << 24);
+}
+
+static float readF32(const uint8_t *p) {
+	uint32_t bits = readU32(p);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+bool hrtf_loadMemory(const void *data, size_t size) {
+	const uint8_t *bytes = data;
+
+	hrtf_unload();
+
+	if (size < FILE_HEADER_SIZE || memcmp(bytes, FILE_MAGIC, 4) != 0
+		|| readU32(bytes + 4) != FILE_VERSION) {
+		return false;
+	}
+	uint32_t rate       = readU32(bytes + 8);
+	uint32_t length     = readU32(bytes + 12);
+	uint32_t elevations = readU32(bytes + 16);
+	uint32_t azimuths   = readU32(bytes + 20);
+	if (length == 0 || length > MAX_LENGTH || elevations == 0 || azimuths == 0
+		|| elevations > MAX_DIRECTIONS / azimuths) {
+		return false;
+	}
+	// The step divides every elevation lookup, so a zero, negative or NaN
+	// step would send the row index anywhere
+	float start = readF32(bytes + 24);
+	float step  = readF32(bytes + 28);
+	if (!isfinite(start) || !isfinite(step) || step <= 0.0f) {
+		return false;
+	}
+	uint32_t directions = elevations * azimuths;
+	size_t irBytes      = (size_t) directions * 2 * length * sizeof(float);
+	if (size - FILE_HEADER_SIZE < irBytes) {
+		return false;
+	}
+
+	uint32_t partitions = (length + HRTF_BLOCK - 1) / HRTF_BLOCK;
+	size_t spectrumSize = 2 * BINS * sizeof(float);
+	filters    = malloc((size_t) directions * 2 * partitions * spectrumSize);
+	fdlStorage = malloc((size_t) HRTF_MAX_VOICES * partitions * spectrumSize);
+	if (!filters || !fdlStorage) {
+		hrtf_unload();
+		return false;
+	}
+
+	sampleRate     = rate;
+	partitionCount = partitions;
+	elevationCount = elevations;
+	azimuthCount   = azimuths;
+	elevationStart = start;
+	elevationStep  = step;
+	fftInit(&fft);
+
+	// Every partition is zero-padded to FFT_SIZE and transformed once here, so
+	// rendering only multiplies spectra. The inverse FFT's 1/BINS is folded in.
+	const uint8_t *ir = bytes + FILE_HEADER_SIZE;
+	float frame[FFT_SIZE];
+	for (uint32_t d = 0; d < directions; d++) {
+		for (uint32_t ear = 0; ear < 2; ear++) {
+			const uint8_t *taps = ir + ((size_t) d * 2 + ear) * length * 4;
+			for (uint32_t p = 0; p < partitions; p++) {
+				memset(frame, 0, sizeof(frame));
+				for (uint32_t i = 0; i < HRTF_BLOCK; i++) {
+					uint32_t tap = p * HRTF_BLOCK + i;
+					if (tap < length) {
+						frame[i] = readF32(taps + tap * 4) / (float) BINS;
+					}
+				}
+				float *spectrum = filterAt(d, ear, p);
+				fftForward(frame, spectrum, spectrum + BINS);
+			}
+		}
+	}
+
+	memset(voices, 0, sizeof(voices));
+	for (uint32_t i = 0; i < HRTF_MAX_VOICES; i++) {
+		voices[i].source = (mumble_userid_t) -1;
+		voices[i].fdl    = fdlStorage + (size_t) i * partitions * 2 * BINS;
+	}
+	memset(bus, 0, sizeof(bus));
+	busFrames = 0;
+
+	atomic_store(&loaded, true);
+	return true;
+}
+
+bool hrtf_load(const char *path) {
+	size_t size;
+	const void *data = plat_map_file(path, &size);
+	if (!data) {
+		return false;
+	}
+	// Everything is converted to spectra, so the file is not needed afterwards
+	bool ok = hrtf_loadMemory(data, size);
+	plat_unmap_file(data, size);
+	return ok;
+}
+
+void hrtf_setIdleTimeout(uint32_t ms) {
+	idleTimeoutNs = (uint64_t) ms * 1000000ull;
+}
+
+void hrtf_unload(void) {
+	atomic_store(&loaded, false);
+	free(filters);
+	free(fdlStorage);
+	filters    = NULL;
+	fdlStorage = NULL;
+}
+
+bool hrtf_loaded(void) {
+	return atomic_load(&loaded);
+}
+
+// Nearest grid direction of a listener-relative vector
+static uint32_t findDirection(const float direction[3]) {
+	const float degrees = 57.29577951f;
+	float horizontal    = sqrtf(direction[0] * direction[0]
+								+ direction[1] * direction[1]);
+	float azimuth       = atan2f(direction[1], direction[0]) * degrees;
+	float elevation     = atan2f(direction[2], horizontal) * degrees;
+	if (azimuth < 0.0f) {
+		azimuth += 360.0f;
+	}
+
+	// Clamp before converting: a tiny step puts the row far outside int32
+	float row = floorf((elevation - elevationStart) / elevationStep + 0.5f);
+	if (row < 0.0f) {
+		row = 0.0f;
+	} else if (row >= (float) elevationCount) {
+		row = (float) (elevationCount - 1);
+	}
+	uint32_t column =
+		(uint32_t) (azimuth * (float) azimuthCount / 360.0f + 0.5f)
+		% azimuthCount;
+
+	return (uint32_t) row * azimuthCount + column;
+}
+
+// Spectrum accumulators of one ear
+struct EarSpectrum {
+	float re[BINS];
+	float im[BINS];
+};
+
+static void convolve(const struct Voice *voice, uint32_t direction,
+					 uint32_t ear, float *out) {
+	struct EarSpectrum acc;
+	float frame[FFT_SIZE];
+
+	memset(&acc, 0, sizeof(acc));
+	for (uint32_t p = 0; p < partitionCount; p++) {
+		uint32_t slot  = (voice->fdlHead + partitionCount - p) % partitionCount;
+		const float *x = voice->fdl + (size_t) slot * 2 * BINS;
+		const float *h = filterAt(direction, ear, p);
+		multiplyAccumulate(acc.re, acc.im, x, x + BINS, h, h + BINS);
+	}
+	fftInverse(acc.re, acc.im, frame);
+
+	// Overlap-save: the first half is circular wrap-around
+	memcpy(out, frame + HRTF_BLOCK, sizeof(float) * HRTF_BLOCK);
+}
+
+static void processBlock(struct Voice *voice, uint32_t direction) {
+	voice->fdlHead  = (voice->fdlHead + 1) % partitionCount;
+	float *spectrum = voice->fdl + (size_t) voice->fdlHead * 2 * BINS;
+	fftForward(voice->input, spectrum, spectrum + BINS);
+
+	for (uint32_t ear = 0; ear < 2; ear++) {
+		convolve(voice, direction, ear, voice->output[ear]);
+	}
+
+	if (voice->direction >= 0 && (uint32_t) voice->direction != direction) {
+		// Fade from the old filter to the new one over this block
+		float previous[HRTF_BLOCK];
+		for (uint32_t ear = 0; ear < 2; ear++) {
+			convolve(voice, (uint32_t) voice->direction, ear, previous);
+			for (uint32_t i = 0; i < HRTF_BLOCK; i++) {
+				float t = (float) i / (float) HRTF_BLOCK;
+				voice->output[ear][i] =
+					previous[i] + t * (voice->output[ear][i] - previous[i]);
+			}
+		}
+	}
+	voice->direction = (int32_t) direction;
+
+	memmove(voice->input, voice->input + HRTF_BLOCK,
+			sizeof(float) * HRTF_BLOCK);
+}
+
+static void resetVoice(struct Voice *voice, mumble_userid_t source) {
+	voice->source    = source;
+	voice->fill      = 0;
+	voice->direction = -1;
+	voice->fdlHead   = 0;
+	memset(voice->fdl, 0, sizeof(float) * partitionCount * 2 * BINS);
+	memset(voice->input, 0, sizeof(voice->input));
+	memset(voice->output, 0, sizeof(voice->output));
+}
+
+static struct Voice *findVoice(mumble_userid_t source, uint64_t nowNs) {
+	struct Voice *oldest = NULL;
+	for (uint32_t i = 0; i < HRTF_MAX_VOICES; i++) {
+		if (voices[i].source == source) {
+			// Back after a pause: the old tail must not leak into the new
+			// utterance
+			if (nowNs - voices[i].lastUsedNs >= idleTimeoutNs) {
+				resetVoice(&voices[i], source);
+			}
+			return &voices[i];
+		}
+		if (!oldest || voices[i].lastUsedNs < oldest->lastUsedNs) {
+			oldest = &voices[i];
+		}
+	}
+
+	// Take over the voice that has been silent for the longest time
+	if (nowNs - oldest->lastUsedNs < idleTimeoutNs) {
+		return NULL;
+	}
+	resetVoice(oldest, source);
+	return oldest;
+}
+
+bool hrtf_render(mumble_userid_t source, const float *pcm,
+				 uint32_t sampleCount, uint16_t channelCount,
+				 uint32_t rate, const float direction[3]) {
+	if (!atomic_load_explicit(&loaded, memory_order_acquire)
+		|| rate != sampleRate || sampleCount > HRTF_MAX_FRAMES
+		|| channelCount == 0) {
+		return false;
+	}
+
+	uint64_t nowNs      = plat_now_ns();
+	struct Voice *voice = findVoice(source, nowNs);
+	if (!voice) {
+		return false;
+	}
+	voice->lastUsedNs = nowNs;
+
+	uint32_t target = findDirection(direction);
+	float scale     = 1.0f / (float) channelCount;
+
+	for (uint32_t offset = 0; offset < sampleCount;) {
+		uint32_t count = HRTF_BLOCK - voice->fill;
+		if (count > sampleCount - offset) {
+			count = sampleCount - offset;
+		}
+
+		float *input = voice->input + HRTF_BLOCK + voice->fill;
+		for (uint32_t i = 0; i < count; i++) {
+			const float *frame = pcm + (size_t) (offset + i) * channelCount;
+			float sum          = 0.0f;
+			for (uint16_t c = 0; c < channelCount; c++) {
+				sum += frame[c];
+			}
+			input[i] = sum * scale;
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			bus[0][offset + i] += voice->output[0][voice->fill + i];
+			bus[1][offset + i] += voice->output[1][voice->fill + i];
+		}
+
+		voice->fill += count;
+		offset += count;
+		if (voice->fill == HRTF_BLOCK) {
+			processBlock(voice, target);
+			voice->fill = 0;
+		}
+	}
+
+	if (sampleCount > busFrames) {
+		busFrames = sampleCount;
+	}
+	return true;
+}
+
+bool hrtf_mix(float *outputPCM, uint32_t sampleCount, uint16_t channelCount) {
+	if (!atomic_load_explicit(&loaded, memory_order_acquire)) {
+		return false;
+	}
+	uint32_t frames = busFrames < sampleCount ? busFrames : sampleCount;
+	if (frames == 0 || channelCount == 0) {
+		busFrames = 0;
+		return false;
+	}
+
+	for (uint32_t i = 0; i < frames; i++) {
+		float *out = outputPCM + (size_t) i * channelCount;
+		if (channelCount >= 2) {
+			out[0] += bus[0][i];
+			out[1] += bus[1][i];
+		} else {
+			out[0] += 0.5f * (bus[0][i] + bus[1][i]);
+		}
+	}
+
+	memset(bus[0], 0, sizeof(float) * busFrames);
+	memset(bus[1], 0, sizeof(float) * busFrames);
+	busFrames = 0;
+	return true;
+}
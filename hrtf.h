@@ -0,0 +1,70 @@
+#ifndef WOW335PA_HRTF_H_
+#define WOW335PA_HRTF_H_
+
+// Binaural rendering of voices with head-related transfer functions.
+//
+// Every speaking source is convolved with the HRIR pair of its direction using
+// uniformly partitioned overlap-save convolution (HRTF_BLOCK samples per
+// partition, so the added latency is HRTF_BLOCK samples, well within one
+// Mumble audio frame). When a source changes direction the outputs of the old
+// and the new filter are crossfaded over one block.
+//
+// Mumble hands sources to mumble_onAudioSourceFetched as mono buffers and only
+// mixes them into the stereo output afterwards, so hrtf_render() takes the
+// source's samples, renders them into an internal stereo bus and the caller
+// silences the source. hrtf_mix() adds the bus to the final mix in
+// mumble_onAudioOutputAboutToPlay, which runs on the same audio thread right
+// after all sources of the frame were fetched.
+//
+// HRIR sets are converted offline from SOFA files (e.g. with a few lines of
+// python-sofa or MATLAB) to a regular direction grid and stored as:
+//   char     magic[4]          "W3HR"
+//   uint32   version           1
+//   uint32   sampleRate        must match Mumble's output, normally 48000
+//   uint32   length            taps per HRIR
+//   uint32   elevations        grid rows
+//   uint32   azimuths          grid columns, evenly spaced from 0 degrees
+//   float    elevationStart    degrees, lowest row
+//   float    elevationStep     degrees
+//   float    hrir[elevations][azimuths][2][length]   left ear first
+// All values are little-endian. Directions follow the SOFA convention: azimuth
+// counter-clockwise from the front, elevation up from the horizontal plane.
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Partition size in samples
+#define HRTF_BLOCK 128
+// Sources rendered at the same time; more are passed through unspatialised.
+// Voices are only held by sources that are speaking.
+#define HRTF_MAX_VOICES 96
+// Longest audio frame accepted by hrtf_render
+#define HRTF_MAX_FRAMES 4096
+
+// Maps and converts an HRIR set. Main thread only, while no audio callback
+// can run (mumble_init/mumble_shutdown).
+bool hrtf_load(const char *path);
+bool hrtf_loadMemory(const void *data, size_t size);
+void hrtf_unload(void);
+bool hrtf_loaded(void);
+
+// A voice that got no audio for this long (default 1000 ms) starts over with
+// clean filter state and may be handed to another source. Main thread only.
+void hrtf_setIdleTimeout(uint32_t ms);
+
+// Audio thread only. Renders one source into the stereo bus. direction is the
+// source position relative to the listener: x to the front, y to the left,
+// z up (need not be normalised). Returns false if the source could not be
+// rendered, in which case it should be played as it is.
+bool hrtf_render(mumble_userid_t source, const float *pcm,
+				 uint32_t sampleCount, uint16_t channelCount,
+				 uint32_t sampleRate, const float direction[3]);
+
+// Audio thread only. Adds the bus to the output and starts the next frame.
+// Returns whether anything was added.
+bool hrtf_mix(float *outputPCM, uint32_t sampleCount, uint16_t channelCount);
+
+#endif // WOW335PA_HRTF_H_
@@ -0,0 +1,117 @@
+#include "inputgate.h"
+
+#include "config.h"
+#include "dsp.h"
+#include "gamestate.h"
+#include "platform.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_BATTLEGROUNDS 16
+// A gate word older than this is ignored
+#define STALE_NS (1000ull * 1000000ull)
+
+// Gate word: publish time in milliseconds above the flag byte
+#define GATE_CLOSED 0x01u
+#define GATE_FLAG_BITS 8
+
+static bool gateLoading;
+static bool gateGhostBattleground;
+static int battlegrounds[MAX_BATTLEGROUNDS];
+static uint32_t battlegroundCount;
+static float gateDbfs;
+static uint64_t hangoverNs;
+
+static _Atomic uint64_t gateWord;
+
+// Audio input thread state
+static uint64_t lastVoiceNs;
+
+static void parseBattlegrounds(const char *value) {
+	char *end;
+	battlegroundCount = 0;
+	for (const char *p = value; battlegroundCount < MAX_BATTLEGROUNDS;
+		 p = end) {
+		long mapId = strtol(p, &end, 10);
+		if (end == p) {
+			break;
+		}
+		battlegrounds[battlegroundCount++] = (int) mapId;
+		while (*end == ',' || *end == ' ') {
+			end++;
+		}
+	}
+}
+
+static bool onBattleground(int mapId) {
+	for (uint32_t i = 0; i < battlegroundCount; i++) {
+		if (battlegrounds[i] == mapId) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void inputgate_init(void) {
+	gateLoading           = config_getBool("input.gate_loading", false);
+	gateGhostBattleground = config_getBool("input.gate_ghost_bg", false);
+	gateDbfs              = config_getFloat("input.gate_dbfs", -100.0f);
+	hangoverNs =
+		(uint64_t) config_getInt("input.hangover_ms", 300) * 1000000ull;
+	parseBattlegrounds(config_getString("input.battleground_maps",
+										"30 489 529 566 607 628"));
+
+	atomic_store(&gateWord, 0);
+	lastVoiceNs = 0;
+}
+
+void inputgate_onSnapshot(const struct GameSnapshot *snapshot) {
+	bool closed = false;
+
+	if (gateLoading && snapshot->valid && snapshot->state != 1) {
+		closed = true;
+	}
+	// Only a released spirit can be told apart from the outside; a corpse
+	// that has not been released yet reads like a living character
+	if (gateGhostBattleground && gamestate_inWorld(snapshot)
+		&& gamestate_isGhost(snapshot) && onBattleground(snapshot->mapId)) {
+		closed = true;
+	}
+
+	uint64_t nowMs = snapshot->timestampNs / 1000000ull;
+	atomic_store_explicit(&gateWord,
+						  (nowMs << GATE_FLAG_BITS)
+							  | (closed ? GATE_CLOSED : 0u),
+						  memory_order_relaxed);
+}
+
+void inputgate_reset(void) {
+	atomic_store_explicit(&gateWord, 0, memory_order_relaxed);
+}
+
+bool inputgate_process(int16_t *pcm, uint32_t sampleCount,
+					   uint16_t channelCount) {
+	size_t count   = (size_t) sampleCount * channelCount;
+	uint64_t nowNs = plat_now_ns();
+
+	uint64_t word  = atomic_load_explicit(&gateWord, memory_order_relaxed);
+	uint64_t ageNs = nowNs - (word >> GATE_FLAG_BITS) * 1000000ull;
+	if ((word & GATE_CLOSED) && ageNs < STALE_NS) {
+		memset(pcm, 0, sizeof(int16_t) * count);
+		return true;
+	}
+
+	// Energy gate with a hangover, so word endings are not clipped
+	if (gateDbfs > -100.0f) {
+		if (dsp_levelInt16(pcm, count) >= gateDbfs) {
+			lastVoiceNs = nowNs;
+		} else if (nowNs - lastVoiceNs > hangoverNs) {
+			memset(pcm, 0, sizeof(int16_t) * count);
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,34 @@
+#ifndef WOW335PA_INPUTGATE_H_
+#define WOW335PA_INPUTGATE_H_
+
+// Suppresses our outgoing voice in mumble_onAudioInput, before Mumble encodes
+// and sends it, while the game says nobody should hear it. Configuration:
+//   input.gate_loading      = false  (loading screen, login, character select)
+//   input.gate_ghost_bg     = false  (released ghost on a battleground map)
+//   input.battleground_maps = 30 489 529 566 607 628
+//   input.gate_dbfs         = -100   (frames quieter than this are dropped,
+//                                     -100 disables)
+//   input.hangover_ms       = 300    (keep sending this long after speech)
+//
+// The game state is turned into a gate word on the positional thread, so the
+// audio input thread only does one atomic load per frame. A gate word older
+// than a second (the game closed or the plugin was detached) opens the gate.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct GameSnapshot;
+
+// Reads the config. Call from mumble_init.
+void inputgate_init(void);
+
+// Positional thread only, for every frame read from the game
+void inputgate_onSnapshot(const struct GameSnapshot *snapshot);
+void inputgate_reset(void);
+
+// Audio input thread. Silences the frame if it should not be sent and returns
+// whether it did.
+bool inputgate_process(int16_t *pcm, uint32_t sampleCount,
+					   uint16_t channelCount);
+
+#endif // WOW335PA_INPUTGATE_H_
@@ -0,0 +1,239 @@
+#include "json.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) \
+	|| (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define JSON_SSE2 1
+#endif
+
+// Kept free at all times for "\n}" and the NUL
+#define CLOSE_SIZE 3
+
+static const char digitPairs[] = "00010203040506070809"
+								 "10111213141516171819"
+								 "20212223242526272829"
+								 "30313233343536373839"
+								 "40414243444546474849"
+								 "50515253545556575859"
+								 "60616263646566676869"
+								 "70717273747576777879"
+								 "80818283848586878889"
+								 "90919293949596979899";
+
+static bool fits(const struct JsonWriter *writer, size_t size) {
+	return writer->length + size + CLOSE_SIZE <= writer->capacity;
+}
+
+// Appends all of data or nothing
+static bool put(struct JsonWriter *writer, const void *data, size_t size) {
+	if (!fits(writer, size)) {
+		return false;
+	}
+	memcpy(writer->buffer + writer->length, data, size);
+	writer->length += size;
+	return true;
+}
+
+static bool putKey(struct JsonWriter *writer, const char *key) {
+	const char *separator = writer->fields ? ",\n\"" : "\n\"";
+	return put(writer, separator, strlen(separator))
+		   && put(writer, key, strlen(key)) && put(writer, "\": ", 3);
+}
+
+void json_begin(struct JsonWriter *writer, char *buffer, size_t capacity) {
+	writer->buffer    = buffer;
+	writer->capacity  = capacity;
+	writer->length    = 1;
+	writer->fields    = 0;
+	writer->truncated = false;
+	buffer[0]         = '{';
+}
+
+void json_addInt(struct JsonWriter *writer, const char *key, int64_t value) {
+	// Digits are produced backwards, two at a time
+	char digits[20];
+	char *end         = digits + sizeof(digits);
+	char *p           = end;
+	uint64_t absolute = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;
+	while (absolute >= 100) {
+		p -= 2;
+		memcpy(p, &digitPairs[2 * (absolute % 100)], 2);
+		absolute /= 100;
+	}
+	if (absolute >= 10) {
+		p -= 2;
+		memcpy(p, &digitPairs[2 * absolute], 2);
+	} else {
+		*--p = (char) ('0' + absolute);
+	}
+	if (value < 0) {
+		*--p = '-';
+	}
+
+	size_t mark = writer->length;
+	if (putKey(writer, key) && put(writer, p, (size_t) (end - p))) {
+		writer->fields++;
+	} else {
+		writer->length    = mark;
+		writer->truncated = true;
+	}
+}
+
+// Number of leading bytes that can be copied as they are: printable ASCII
+// other than '"' and '\'
+static size_t plainPrefix(const uint8_t *data, size_t length) {
+	size_t i = 0;
+#ifdef JSON_SSE2
+	const __m128i quote     = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	// Signed, so bytes from 0x80 up compare below it as well
+	const __m128i space = _mm_set1_epi8(0x20);
+	for (; i + 16 <= length; i += 16) {
+		__m128i v       = _mm_loadu_si128((const __m128i *) (data + i));
+		__m128i special = _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+									   _mm_cmpeq_epi8(v, backslash));
+		special         = _mm_or_si128(special, _mm_cmplt_epi8(v, space));
+		// The scalar loop finds which byte it was
+		if (_mm_movemask_epi8(special)) {
+			break;
+		}
+	}
+#endif
+	for (; i < length; i++) {
+		uint8_t c = data[i];
+		if (c < 0x20 || c >= 0x80 || c == '"' || c == '\\') {
+			break;
+		}
+	}
+	return i;
+}
+
+// Length of the well-formed UTF-8 sequence at data, or 0
+static size_t utf8Sequence(const uint8_t *data, size_t length) {
+	uint8_t c = data[0];
+	size_t size;
+	uint8_t low = 0x80, high = 0xBF;
+	if (c >= 0xC2 && c <= 0xDF) {
+		size = 2;
+	} else if (c >= 0xE0 && c <= 0xEF) {
+		size = 3;
+		// No overlong forms and no surrogates
+		low  = c == 0xE0 ? 0xA0 : 0x80;
+		high = c == 0xED ? 0x9F : 0xBF;
+	} else if (c >= 0xF0 && c <= 0xF4) {
+		size = 4;
+		low  = c == 0xF0 ? 0x90 : 0x80;
+		high = c == 0xF4 ? 0x8F : 0xBF;
+	} else {
+		return 0;
+	}
+	if (size > length || data[1] < low || data[1] > high) {
+		return 0;
+	}
+	for (size_t i = 2; i < size; i++) {
+		if ((data[i] & 0xC0) != 0x80) {
+			return 0;
+		}
+	}
+	return size;
+}
+
+// Writes the escaped form of the special character at data; returns how many
+// input bytes it stood for, or 0 if it did not fit
+static size_t putSpecial(struct JsonWriter *writer, const uint8_t *data,
+						 size_t length) {
+	static const char hex[] = "0123456789abcdef";
+	uint8_t c               = data[0];
+
+	if (c >= 0x80) {
+		size_t size = utf8Sequence(data, length);
+		if (size == 0) {
+			return put(writer, "\xEF\xBF\xBD", 3) ? 1 : 0;
+		}
+		return put(writer, data, size) ? size : 0;
+	}
+
+	char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+	size_t size    = 6;
+	switch (c) {
+		case '"':
+		case '\\':
+			escape[1] = (char) c;
+			size      = 2;
+			break;
+		case '\b':
+			escape[1] = 'b';
+			size      = 2;
+			break;
+		case '\f':
+			escape[1] = 'f';
+			size      = 2;
+			break;
+		case '\n':
+			escape[1] = 'n';
+			size      = 2;
+			break;
+		case '\r':
+			escape[1] = 'r';
+			size      = 2;
+			break;
+		case '\t':
+			escape[1] = 't';
+			size      = 2;
+			break;
+	}
+	return put(writer, escape, size) ? 1 : 0;
+}
+
+void json_addString(struct JsonWriter *writer, const char *key,
+					const char *value, size_t length) {
+	const uint8_t *data = (const uint8_t *) value;
+	size_t mark         = writer->length;
+
+	// Room for at least the empty string, or the field is dropped
+	if (!putKey(writer, key) || !fits(writer, 2)) {
+		writer->length    = mark;
+		writer->truncated = true;
+		return;
+	}
+	writer->buffer[writer->length++] = '"';
+	// The closing quote is kept free from here on
+	writer->capacity--;
+
+	size_t i = 0;
+	while (i < length) {
+		size_t plain = plainPrefix(data + i, length - i);
+		size_t room  = writer->capacity - CLOSE_SIZE - writer->length;
+		if (plain > room) {
+			put(writer, data + i, room);
+			writer->truncated = true;
+			break;
+		}
+		put(writer, data + i, plain);
+		i += plain;
+		if (i == length) {
+			break;
+		}
+		size_t used = putSpecial(writer, data + i, length - i);
+		if (used == 0) {
+			writer->truncated = true;
+			break;
+		}
+		i += used;
+	}
+
+	writer->capacity++;
+	writer->buffer[writer->length++] = '"';
+	writer->fields++;
+}
+
+const char *json_end(struct JsonWriter *writer) {
+	if (writer->fields) {
+		writer->buffer[writer->length++] = '\n';
+	}
+	writer->buffer[writer->length++] = '}';
+	writer->buffer[writer->length]   = '\0';
+	return writer->buffer;
+}
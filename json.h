@@ -0,0 +1,34 @@
+#ifndef WOW335PA_JSON_H_
+#define WOW335PA_JSON_H_
+
+// Writer for the small flat JSON objects handed to Mumble as context and
+// identity, into a caller-provided fixed buffer. Strings are escaped fully
+// (quotes, backslashes, control characters as \uXXXX) and invalid UTF-8 is
+// replaced with U+FFFD. When the buffer runs out, a string is cut between two
+// whole characters and a number is dropped with its key, so the output is
+// always valid JSON; truncated tells whether anything was lost.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct JsonWriter {
+	char *buffer;
+	// Including the terminating NUL
+	size_t capacity;
+	size_t length;
+	uint32_t fields;
+	bool truncated;
+};
+
+// capacity must be at least 4
+void json_begin(struct JsonWriter *writer, char *buffer, size_t capacity);
+// key is written as is and must not need escaping
+void json_addInt(struct JsonWriter *writer, const char *key, int64_t value);
+// value is length bytes, not necessarily NUL-terminated
+void json_addString(struct JsonWriter *writer, const char *key,
+					const char *value, size_t length);
+// Closes the object and returns the NUL-terminated buffer
+const char *json_end(struct JsonWriter *writer);
+
+#endif // WOW335PA_JSON_H_
@@ -0,0 +1,96 @@
+#include "mainthread.h"
+
+#include "plugin.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#define TASK_QUEUE_SIZE 64 // must be a power of two
+
+struct Task {
+	main_task run;
+	size_t size;
+	_Alignas(max_align_t) unsigned char data[MAINTHREAD_DATA_MAX];
+};
+
+// Single-producer/single-consumer ring like the event queue in events.c. The
+// producer only writes head, the consumer only writes tail.
+static struct Task queue[TASK_QUEUE_SIZE];
+static _Alignas(64) atomic_uint queueHead = 0;
+static _Alignas(64) atomic_uint queueTail = 0;
+static atomic_uint droppedTasks           = 0;
+static atomic_bool accepting              = false;
+// Main thread only
+static bool draining = false;
+
+static void runLog(const void *data, size_t size) {
+	(void) size;
+	mumbleAPI.log(ownID, data);
+}
+
+bool mainthread_post(main_task task, const void *data, size_t size) {
+	if (!atomic_load_explicit(&accepting, memory_order_relaxed)
+		|| size > MAINTHREAD_DATA_MAX) {
+		return false;
+	}
+
+	unsigned head = atomic_load_explicit(&queueHead, memory_order_relaxed);
+	unsigned tail = atomic_load_explicit(&queueTail, memory_order_acquire);
+	if (head - tail == TASK_QUEUE_SIZE) {
+		atomic_fetch_add_explicit(&droppedTasks, 1, memory_order_relaxed);
+		return false;
+	}
+
+	struct Task *slot = &queue[head & (TASK_QUEUE_SIZE - 1)];
+	slot->run         = task;
+	slot->size        = size;
+	memcpy(slot->data, data, size);
+	atomic_store_explicit(&queueHead, head + 1, memory_order_release);
+
+	return true;
+}
+
+bool mainthread_log(const char *message) {
+	char text[MAINTHREAD_DATA_MAX];
+	size_t length = strlen(message);
+	if (length >= sizeof(text)) {
+		length = sizeof(text) - 1;
+	}
+	memcpy(text, message, length);
+	text[length] = '\0';
+
+	return mainthread_post(runLog, text, length + 1);
+}
+
+void mainthread_run(void) {
+	// A task's API call may have Mumble make another callback right away,
+	// which must not run the same task again
+	if (draining) {
+		return;
+	}
+	draining = true;
+
+	unsigned tail = atomic_load_explicit(&queueTail, memory_order_relaxed);
+	unsigned head = atomic_load_explicit(&queueHead, memory_order_acquire);
+
+	while (tail != head) {
+		const struct Task *task = &queue[tail & (TASK_QUEUE_SIZE - 1)];
+		task->run(task->data, task->size);
+		// Only now is the slot free for the producer
+		tail++;
+		atomic_store_explicit(&queueTail, tail, memory_order_release);
+	}
+	draining = false;
+}
+
+void mainthread_start(void) {
+	atomic_store(&queueHead, 0);
+	atomic_store(&queueTail, 0);
+	atomic_store(&droppedTasks, 0);
+	atomic_store(&accepting, true);
+}
+
+void mainthread_stop(void) {
+	atomic_store(&accepting, false);
+	atomic_store(&queueTail, atomic_load(&queueHead));
+}
@@ -0,0 +1,38 @@
+#ifndef WOW335PA_MAINTHREAD_H_
+#define WOW335PA_MAINTHREAD_H_
+
+// Work the dispatcher thread (events.h) hands to Mumble's main thread. Called
+// from any other thread, a Mumble API function waits until the main thread has
+// run it, and mumble_shutdown joins the dispatcher from the main thread, so
+// the dispatcher never calls the API itself. Its handlers queue a task
+// instead, and the main thread runs the queue at the start of every callback
+// Mumble makes on it: server, user and channel events, talking state changes
+// and plugin data. Tasks therefore wait for the next of those.
+//
+// The queue is single-producer (the dispatcher) and single-consumer (the main
+// thread). Tasks still queued when the plugin shuts down are dropped.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Largest payload a task can carry
+#define MAINTHREAD_DATA_MAX 512
+
+// Runs on the main thread with a copy of the bytes given to mainthread_post
+typedef void (*main_task)(const void *data, size_t size);
+
+// Dispatcher thread. Queues task with a copy of size bytes of data; false if
+// the queue is not running, full or size is too big.
+bool mainthread_post(main_task task, const void *data, size_t size);
+// Dispatcher thread. Queues mumbleAPI.log of message, cut to fit.
+bool mainthread_log(const char *message);
+
+// Main thread. Runs the tasks queued so far, in order.
+void mainthread_run(void);
+
+// Main thread, from mumble_init before events_start() and from
+// mumble_shutdown after events_stop(). Stopping drops what is still queued.
+void mainthread_start(void);
+void mainthread_stop(void);
+
+#endif // WOW335PA_MAINTHREAD_H_
@@ -0,0 +1,510 @@
+#include "metrics.h"
+
+#include "gamestate.h"
+#include "platform.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#	include <poll.h>
+#	include <sys/socket.h>
+#	include <sys/un.h>
+#endif
+
+#define MAX_BUCKETS 12
+#define OUTPUT_SIZE 16384
+// How often the server notices metrics_stop
+#define POLL_MS 200
+// How long a client gets to send an HTTP request line
+#define REQUEST_WAIT_MS 100
+
+// Upper bounds, the last bucket is +Inf
+static const double fetchBounds[] = { 10e-6,  25e-6, 50e-6, 100e-6,
+									  250e-6, 500e-6, 1e-3, 2.5e-3,
+									  5e-3,   10e-3 };
+static const double budgetBounds[] = { 0.01, 0.02, 0.05, 0.1,
+									   0.2,  0.5,  1.0 };
+static const double ageBounds[] = { 0.5e-3, 1e-3,  2e-3,  5e-3,
+									10e-3,  20e-3, 50e-3, 100e-3 };
+#define FETCH_BUCKETS (sizeof(fetchBounds) / sizeof(fetchBounds[0]) + 1)
+#define BUDGET_BUCKETS (sizeof(budgetBounds) / sizeof(budgetBounds[0]) + 1)
+#define AGE_BUCKETS (sizeof(ageBounds) / sizeof(ageBounds[0]) + 1)
+
+// Written by exactly one thread, so counters are bumped with a relaxed load
+// and store instead of a locked read-modify-write
+struct Histogram {
+	_Atomic uint64_t buckets[MAX_BUCKETS];
+	_Atomic uint64_t count;
+	// Nanoseconds for durations, millionths for ratios
+	_Atomic uint64_t sum;
+};
+
+// One block per recording thread, each starting on its own cache line
+struct FetchMetrics {
+	_Alignas(64) struct Histogram duration;
+	_Atomic uint64_t failures[WOW_READ_ERROR_COUNT];
+	_Atomic uint64_t failedFields[WOW_FIELD_COUNT];
+	_Atomic uint64_t breakerState;
+	_Atomic uint64_t breakerTransitions[BREAKER_STATES];
+	_Atomic uint64_t breakerProbes;
+	_Atomic uint64_t firstPositionNs;
+};
+
+struct AudioMetrics {
+	_Alignas(64) struct Histogram budget;
+};
+
+struct InputMetrics {
+	_Alignas(64) struct Histogram positionAge;
+};
+
+struct DiscoveryMetrics {
+	_Alignas(64) _Atomic uint64_t results[METRICS_DISCOVERY_RESULTS];
+};
+
+static struct FetchMetrics fetchMetrics;
+static struct AudioMetrics audioMetrics[METRICS_AUDIO_CALLBACKS];
+static struct InputMetrics inputMetrics;
+static struct DiscoveryMetrics discoveryMetrics;
+
+static bool enabled = false;
+static const char *backend = "process";
+
+static const char *callbackNames[METRICS_AUDIO_CALLBACKS] = { "input",
+															  "source",
+															  "output" };
+static const char *discoveryNames[METRICS_DISCOVERY_RESULTS] = {
+	"found",
+	"not_found",
+	"denied",
+	"prepared",
+};
+
+static inline void bump(_Atomic uint64_t *counter, uint64_t amount) {
+	atomic_store_explicit(
+		counter,
+		atomic_load_explicit(counter, memory_order_relaxed) + amount,
+		memory_order_relaxed);
+}
+
+static void observe(struct Histogram *histogram, const double *bounds,
+					size_t boundCount, double value, uint64_t sum) {
+	size_t bucket = 0;
+	while (bucket < boundCount && value > bounds[bucket]) {
+		bucket++;
+	}
+	bump(&histogram->buckets[bucket], 1);
+	bump(&histogram->sum, sum);
+	bump(&histogram->count, 1);
+}
+
+bool metrics_enabled(void) {
+	return enabled;
+}
+
+void metrics_setBackend(const char *name) {
+	backend = name;
+}
+
+void metrics_recordFetch(uint64_t durationNs) {
+	observe(&fetchMetrics.duration, fetchBounds, FETCH_BUCKETS - 1,
+			(double) durationNs * 1e-9, durationNs);
+}
+
+void metrics_recordReadFailure(enum WowReadError error) {
+	if (error > WOW_READ_OK && error < WOW_READ_ERROR_COUNT) {
+		bump(&fetchMetrics.failures[error], 1);
+	}
+}
+
+void metrics_recordFailedField(enum WowField field) {
+	if (field < WOW_FIELD_COUNT) {
+		bump(&fetchMetrics.failedFields[field], 1);
+	}
+}
+
+void metrics_recordMissingFields(uint8_t missing) {
+	if (missing & GAME_MISSING_CLASS) {
+		bump(&fetchMetrics.failedFields[WOW_FIELD_CLASS], 1);
+	}
+	if (missing & GAME_MISSING_ZONE) {
+		bump(&fetchMetrics.failedFields[WOW_FIELD_ZONE_ID], 1);
+	}
+	if (missing & GAME_MISSING_CORPSE) {
+		bump(&fetchMetrics.failedFields[WOW_FIELD_CORPSE_POS], 1);
+	}
+}
+
+void metrics_recordBreaker(const struct Breaker *breaker) {
+	atomic_store_explicit(&fetchMetrics.breakerState, breaker->state,
+						  memory_order_relaxed);
+	for (int state = 0; state < BREAKER_STATES; state++) {
+		atomic_store_explicit(&fetchMetrics.breakerTransitions[state],
+							  breaker->transitions[state],
+							  memory_order_relaxed);
+	}
+	atomic_store_explicit(&fetchMetrics.breakerProbes, breaker->probes,
+						  memory_order_relaxed);
+}
+
+void metrics_recordFirstPosition(uint64_t sinceLoadNs) {
+	atomic_store_explicit(&fetchMetrics.firstPositionNs, sinceLoadNs,
+						  memory_order_relaxed);
+}
+
+void metrics_recordDiscovery(enum MetricsDiscovery result) {
+	bump(&discoveryMetrics.results[result], 1);
+}
+
+void metrics_recordAudio(enum MetricsCallback callback, uint64_t startNs,
+						 uint32_t sampleCount, uint32_t sampleRate) {
+	if (sampleRate == 0 || sampleCount == 0) {
+		return;
+	}
+	double used   = (double) (plat_now_ns() - startNs) * 1e-9;
+	double budget = (double) sampleCount / (double) sampleRate;
+	double ratio  = used / budget;
+	observe(&audioMetrics[callback].budget, budgetBounds, BUDGET_BUCKETS - 1,
+			ratio, (uint64_t) (ratio * 1e6));
+}
+
+void metrics_recordPositionAge(uint64_t ageNs) {
+	observe(&inputMetrics.positionAge, ageBounds, AGE_BUCKETS - 1,
+			(double) ageNs * 1e-9, ageNs);
+}
+
+#ifdef _WIN32
+
+bool metrics_start(const char *path) {
+	(void) path;
+	return false;
+}
+
+void metrics_stop(void) {
+}
+
+const char *metrics_path(void) {
+	return "";
+}
+
+#else
+
+static char socketPath[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+static int listenFd = -1;
+static plat_thread_t serverThread;
+static atomic_bool serving = false;
+
+// Fetches seen at the previous scrape, for the sample rate. Server thread only.
+static uint64_t lastScrapeNs;
+static uint64_t lastScrapeFetches;
+
+struct Output {
+	char *data;
+	size_t size;
+	size_t length;
+};
+
+static void append(struct Output *out, const char *format, ...) {
+	if (out->length >= out->size) {
+		return;
+	}
+	va_list args;
+	va_start(args, format);
+	int written = vsnprintf(out->data + out->length, out->size - out->length,
+							format, args);
+	va_end(args);
+	if (written > 0) {
+		out->length += (size_t) written;
+	}
+	if (out->length > out->size) {
+		out->length = out->size;
+	}
+}
+
+static uint64_t load(_Atomic uint64_t *counter) {
+	return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static void appendHistogram(struct Output *out, const char *name,
+							const char *labels, struct Histogram *histogram,
+							const double *bounds, size_t boundCount,
+							double sumScale) {
+	const char *separator = labels[0] ? "," : "";
+	uint64_t cumulative   = 0;
+	for (size_t i = 0; i <= boundCount; i++) {
+		cumulative += load(&histogram->buckets[i]);
+		if (i < boundCount) {
+			append(out, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels,
+				   separator, bounds[i], (unsigned long long) cumulative);
+		} else {
+			append(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels,
+				   separator, (unsigned long long) cumulative);
+		}
+	}
+	const char *open  = labels[0] ? "{" : "";
+	const char *close = labels[0] ? "}" : "";
+	append(out, "%s_sum%s%s%s %.9g\n", name, open, labels, close,
+		   (double) load(&histogram->sum) * sumScale);
+	// Must match the +Inf bucket, which the buckets read above add up to
+	append(out, "%s_count%s%s%s %llu\n", name, open, labels, close,
+		   (unsigned long long) cumulative);
+}
+
+static size_t render(char *buffer, size_t size) {
+	struct Output out = { buffer, size, 0 };
+	uint64_t now      = plat_now_ns();
+
+	append(&out, "# HELP wow335pa_fetch_duration_seconds Time spent in "
+				 "mumble_fetchPositionalData.\n"
+				 "# TYPE wow335pa_fetch_duration_seconds histogram\n");
+	appendHistogram(&out, "wow335pa_fetch_duration_seconds", "",
+					&fetchMetrics.duration, fetchBounds, FETCH_BUCKETS - 1,
+					1e-9);
+
+	append(&out, "# HELP wow335pa_read_failures_total Frames that could not "
+				 "be read, by reason.\n"
+				 "# TYPE wow335pa_read_failures_total counter\n");
+	for (int error = WOW_READ_OK + 1; error < WOW_READ_ERROR_COUNT; error++) {
+		append(&out, "wow335pa_read_failures_total{reason=\"%s\"} %llu\n",
+			   wowreader_errorName((enum WowReadError) error),
+			   (unsigned long long) load(&fetchMetrics.failures[error]));
+	}
+
+	append(&out, "# HELP wow335pa_read_failures_by_field_total Failed reads "
+				 "by field: the field a lost frame stopped at, or an "
+				 "optional field left out of a frame.\n"
+				 "# TYPE wow335pa_read_failures_by_field_total counter\n");
+	for (int field = 0; field < WOW_FIELD_COUNT; field++) {
+		append(&out,
+			   "wow335pa_read_failures_by_field_total{field=\"%s\"} %llu\n",
+			   wowreader_fieldName((enum WowField) field),
+			   (unsigned long long) load(&fetchMetrics.failedFields[field]));
+	}
+
+	append(&out, "# HELP wow335pa_breaker_transitions_total Changes of the "
+				 "read circuit breaker, by the state entered.\n"
+				 "# TYPE wow335pa_breaker_transitions_total counter\n");
+	for (int state = 0; state < BREAKER_STATES; state++) {
+		append(&out,
+			   "wow335pa_breaker_transitions_total{state=\"%s\"} %llu\n",
+			   breaker_stateName((enum BreakerState) state),
+			   (unsigned long long) load(
+				   &fetchMetrics.breakerTransitions[state]));
+	}
+	append(&out,
+		   "# HELP wow335pa_breaker_state State of the read circuit breaker "
+		   "(0 healthy, 1 degraded, 2 open).\n"
+		   "# TYPE wow335pa_breaker_state gauge\n"
+		   "wow335pa_breaker_state %llu\n"
+		   "# HELP wow335pa_breaker_probes_total Probe reads made while the "
+		   "circuit was open.\n"
+		   "# TYPE wow335pa_breaker_probes_total counter\n"
+		   "wow335pa_breaker_probes_total %llu\n",
+		   (unsigned long long) load(&fetchMetrics.breakerState),
+		   (unsigned long long) load(&fetchMetrics.breakerProbes));
+
+	append(&out, "# HELP wow335pa_discovery_attempts_total Searches for the "
+				 "game process, by result.\n"
+				 "# TYPE wow335pa_discovery_attempts_total counter\n");
+	for (int result = 0; result < METRICS_DISCOVERY_RESULTS; result++) {
+		append(&out, "wow335pa_discovery_attempts_total{result=\"%s\"} %llu\n",
+			   discoveryNames[result],
+			   (unsigned long long) load(&discoveryMetrics.results[result]));
+	}
+
+	// Left out until there is one
+	uint64_t firstPositionNs = load(&fetchMetrics.firstPositionNs);
+	if (firstPositionNs != 0) {
+		append(&out,
+			   "# HELP wow335pa_time_to_first_position_seconds Time from "
+			   "loading the plugin to the first position in the world.\n"
+			   "# TYPE wow335pa_time_to_first_position_seconds gauge\n"
+			   "wow335pa_time_to_first_position_seconds %.6f\n",
+			   (double) firstPositionNs * 1e-9);
+	}
+
+	append(&out,
+		   "# HELP wow335pa_backend Where frames come from.\n"
+		   "# TYPE wow335pa_backend gauge\n"
+		   "wow335pa_backend{backend=\"%s\"} 1\n",
+		   backend);
+
+	// Frames per second since the previous scrape
+	uint64_t fetches = load(&fetchMetrics.duration.count);
+	double rate      = 0.0;
+	if (lastScrapeNs != 0 && now > lastScrapeNs) {
+		rate = (double) (fetches - lastScrapeFetches) * 1e9
+			   / (double) (now - lastScrapeNs);
+	}
+	lastScrapeNs      = now;
+	lastScrapeFetches = fetches;
+	append(&out,
+		   "# HELP wow335pa_sample_rate_hertz Frames read per second since "
+		   "the previous scrape.\n"
+		   "# TYPE wow335pa_sample_rate_hertz gauge\n"
+		   "wow335pa_sample_rate_hertz %.2f\n",
+		   rate);
+
+	struct GameSnapshot snapshot;
+	bool haveFrame = gamestate_latest(&snapshot);
+	append(&out,
+		   "# HELP wow335pa_in_world Whether the player is in the world.\n"
+		   "# TYPE wow335pa_in_world gauge\n"
+		   "wow335pa_in_world %d\n"
+		   "# HELP wow335pa_map_id Map of the latest frame.\n"
+		   "# TYPE wow335pa_map_id gauge\n"
+		   "wow335pa_map_id %d\n"
+		   "# HELP wow335pa_frame_age_seconds Age of the latest frame.\n"
+		   "# TYPE wow335pa_frame_age_seconds gauge\n"
+		   "wow335pa_frame_age_seconds %.6f\n",
+		   haveFrame && gamestate_inWorld(&snapshot) ? 1 : 0,
+		   haveFrame ? snapshot.mapId : 0,
+		   haveFrame && now > snapshot.timestampNs
+			   ? (double) (now - snapshot.timestampNs) * 1e-9
+			   : 0.0);
+
+	append(&out, "# HELP wow335pa_audio_budget_ratio Time spent in an audio "
+				 "callback relative to the duration of its buffer.\n"
+				 "# TYPE wow335pa_audio_budget_ratio histogram\n");
+	for (int callback = 0; callback < METRICS_AUDIO_CALLBACKS; callback++) {
+		char labels[32];
+		snprintf(labels, sizeof(labels), "callback=\"%s\"",
+				 callbackNames[callback]);
+		appendHistogram(&out, "wow335pa_audio_budget_ratio", labels,
+						&audioMetrics[callback].budget, budgetBounds,
+						BUDGET_BUCKETS - 1, 1e-6);
+	}
+
+	append(&out, "# HELP wow335pa_position_age_seconds Age of the newest "
+				 "position when mumble_onAudioInput hands a frame over for "
+				 "encoding.\n"
+				 "# TYPE wow335pa_position_age_seconds histogram\n");
+	appendHistogram(&out, "wow335pa_position_age_seconds", "",
+					&inputMetrics.positionAge, ageBounds, AGE_BUCKETS - 1,
+					1e-9);
+
+	return out.length;
+}
+
+static void sendAll(int fd, const char *data, size_t length) {
+	while (length > 0) {
+		ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+		if (sent <= 0) {
+			return;
+		}
+		data += sent;
+		length -= (size_t) sent;
+	}
+}
+
+static void serve(int client) {
+	static char buffer[OUTPUT_SIZE];
+
+	// Prometheus and curl send a request; socat and nc may send nothing
+	bool http           = false;
+	struct pollfd ready = { client, POLLIN, 0 };
+	if (poll(&ready, 1, REQUEST_WAIT_MS) > 0) {
+		char request[512];
+		ssize_t received = recv(client, request, sizeof(request), 0);
+		http = received >= 4 && memcmp(request, "GET ", 4) == 0;
+	}
+
+	size_t length = render(buffer, sizeof(buffer));
+	if (http) {
+		char header[160];
+		int headerLength =
+			snprintf(header, sizeof(header),
+					 "HTTP/1.0 200 OK\r\n"
+					 "Content-Type: text/plain; version=0.0.4\r\n"
+					 "Content-Length: %zu\r\n\r\n",
+					 length);
+		sendAll(client, header, (size_t) headerLength);
+	}
+	sendAll(client, buffer, length);
+}
+
+static void serverMain(void *arg) {
+	(void) arg;
+	while (atomic_load(&serving)) {
+		struct pollfd ready = { listenFd, POLLIN, 0 };
+		if (poll(&ready, 1, POLL_MS) <= 0) {
+			continue;
+		}
+		int client = accept(listenFd, NULL, NULL);
+		if (client < 0) {
+			continue;
+		}
+		serve(client);
+		close(client);
+	}
+}
+
+bool metrics_start(const char *path) {
+	if (atomic_load(&serving)) {
+		return true;
+	}
+
+	if (path && path[0]) {
+		snprintf(socketPath, sizeof(socketPath), "%s", path);
+	} else {
+		const char *runtime = getenv("XDG_RUNTIME_DIR");
+		if (runtime && runtime[0]) {
+			snprintf(socketPath, sizeof(socketPath), "%s/wow335pa.sock",
+					 runtime);
+		} else {
+			snprintf(socketPath, sizeof(socketPath), "/tmp/wow335pa-%u.sock",
+					 (unsigned) getuid());
+		}
+	}
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	memcpy(address.sun_path, socketPath, sizeof(address.sun_path));
+
+	listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listenFd < 0) {
+		return false;
+	}
+	// A socket left behind by a crashed Mumble
+	unlink(socketPath);
+	if (bind(listenFd, (struct sockaddr *) &address, sizeof(address)) != 0
+		|| chmod(socketPath, 0600) != 0 || listen(listenFd, 4) != 0) {
+		close(listenFd);
+		listenFd = -1;
+		return false;
+	}
+
+	atomic_store(&serving, true);
+	if (!plat_thread_start(&serverThread, serverMain, NULL)) {
+		atomic_store(&serving, false);
+		close(listenFd);
+		listenFd = -1;
+		unlink(socketPath);
+		return false;
+	}
+	enabled = true;
+
+	return true;
+}
+
+void metrics_stop(void) {
+	if (!atomic_load(&serving)) {
+		return;
+	}
+	enabled = false;
+	atomic_store(&serving, false);
+	plat_thread_join(serverThread);
+	close(listenFd);
+	listenFd = -1;
+	unlink(socketPath);
+}
+
+const char *metrics_path(void) {
+	return socketPath;
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef WOW335PA_METRICS_H_
+#define WOW335PA_METRICS_H_
+
+// Opt-in metrics in the Prometheus text format, served by a background thread
+// on a Unix domain socket (metrics.enabled, metrics.socket). Plain connections
+// get the text right away; an HTTP GET (curl --unix-socket) gets it with HTTP
+// headers.
+//
+// Every recording thread owns its counters, on cache lines of their own, and
+// only stores to them with relaxed atomics; the server thread adds them up
+// when scraped. The positional and audio callbacks therefore never write to a
+// cache line another thread writes to. Not available on Windows.
+
+#include "breaker.h"
+#include "wowreader.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum MetricsCallback {
+	METRICS_AUDIO_INPUT,
+	METRICS_AUDIO_SOURCE,
+	METRICS_AUDIO_OUTPUT,
+	METRICS_AUDIO_CALLBACKS
+};
+
+enum MetricsDiscovery {
+	METRICS_DISCOVERY_FOUND,
+	// Not running (yet), Mumble tries again later
+	METRICS_DISCOVERY_NOT_FOUND,
+	// Mumble cannot see other processes
+	METRICS_DISCOVERY_DENIED,
+	// Taken from the background search (discovery.h)
+	METRICS_DISCOVERY_PREPARED,
+	METRICS_DISCOVERY_RESULTS
+};
+
+// Starts serving on path, or on $XDG_RUNTIME_DIR/wow335pa.sock when path is
+// empty
+bool metrics_start(const char *path);
+void metrics_stop(void);
+// Socket path while serving
+const char *metrics_path(void);
+
+bool metrics_enabled(void);
+
+// "process" or "daemon"; the string must outlive the server
+void metrics_setBackend(const char *backend);
+
+// Positional thread
+void metrics_recordFetch(uint64_t durationNs);
+void metrics_recordReadFailure(enum WowReadError error);
+void metrics_recordFailedField(enum WowField field);
+// The optional fields of a frame that could not be read (GAME_MISSING_*)
+void metrics_recordMissingFields(uint8_t missing);
+// Copies the breaker's state and counters
+void metrics_recordBreaker(const struct Breaker *breaker);
+// Time from loading the plugin to the first position in the world
+void metrics_recordFirstPosition(uint64_t sinceLoadNs);
+
+// Thread that calls mumble_initPositionalData
+void metrics_recordDiscovery(enum MetricsDiscovery result);
+
+// Audio threads. startNs is what plat_now_ns() returned when the callback
+// started; the budget is the duration of the buffer.
+void metrics_recordAudio(enum MetricsCallback callback, uint64_t startNs,
+						 uint32_t sampleCount, uint32_t sampleRate);
+// Audio input thread: age of the newest position when a frame is handed over
+// for encoding (sampler.h)
+void metrics_recordPositionAge(uint64_t ageNs);
+
+#endif // WOW335PA_METRICS_H_
@@ -0,0 +1,582 @@
+#include "peers.h"
+
+#include "config.h"
+#include "events.h"
+#include "flatmap.h"
+#include "gamestate.h"
+#include "mainthread.h"
+#include "platform.h"
+#include "plugin.h"
+#include "roster.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PEERS_DATA_ID "wow335pa.meta"
+#define PROTOCOL_VERSION 1
+
+#define KIND_KEYFRAME 0
+#define KIND_DELTA 1
+#define KIND_KEYFRAME_REQUEST 2
+
+#define FIELD_NAME 0x01
+#define FIELD_CLASS 0x02
+#define FIELD_GROUP 0x04
+#define FIELD_MAP 0x08
+#define FIELD_ZONE 0x10
+#define FIELD_POSITION 0x20
+#define FIELD_FLAGS 0x40
+#define FIELD_ALL 0x7F
+
+// Quarter-yard position resolution
+#define POSITION_SCALE 4.0f
+// Start over from a fresh keyframe at least this often
+#define KEYFRAME_INTERVAL_NS (10ull * 1000000000ull)
+// Don't ask the same peer for a keyframe more often than this
+#define KEYFRAME_REQUEST_INTERVAL_NS (2ull * 1000000000ull)
+
+#define MAX_MESSAGE 128
+#define MAX_RECIPIENTS 512
+
+// The subset of the game state that goes over the wire
+struct WireState {
+	char name[50];
+	uint8_t playerClass;
+	int32_t group;
+	int32_t mapId;
+	int32_t zoneId;
+	int32_t position[3];
+	uint8_t flags;
+};
+
+// ---------------------------------------------------------------------------
+// Encoding helpers
+
+struct Writer {
+	uint8_t *data;
+	size_t size;
+	size_t used;
+};
+
+struct Reader {
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+	bool error;
+};
+
+static void putByte(struct Writer *writer, uint8_t value) {
+	if (writer->used < writer->size) {
+		writer->data[writer->used] = value;
+	}
+	writer->used++;
+}
+
+static void putVarint(struct Writer *writer, uint64_t value) {
+	while (value >= 0x80) {
+		putByte(writer, (uint8_t) (value | 0x80));
+		value >>= 7;
+	}
+	putByte(writer, (uint8_t) value);
+}
+
+static void putSigned(struct Writer *writer, int64_t value) {
+	putVarint(writer, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+static uint8_t getByte(struct Reader *reader) {
+	if (reader->pos >= reader->size) {
+		reader->error = true;
+		return 0;
+	}
+	return reader->data[reader->pos++];
+}
+
+static uint64_t getVarint(struct Reader *reader) {
+	uint64_t value = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7) {
+		uint8_t byte = getByte(reader);
+		value |= (uint64_t) (byte & 0x7F) << shift;
+		if (!(byte & 0x80)) {
+			return value;
+		}
+	}
+	reader->error = true;
+	return 0;
+}
+
+static int64_t getSigned(struct Reader *reader) {
+	uint64_t value = getVarint(reader);
+	return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+// ---------------------------------------------------------------------------
+// Receiving side. Written on the main thread, read through peers_read() from
+// the dispatcher thread; each slot is guarded by its own seqlock.
+
+struct PeerSlot {
+	atomic_uint seq;
+	bool used;
+	struct PeerState state;
+	// Keyframe the sender's deltas are relative to
+	bool haveBase;
+	uint32_t baseSeq;
+	struct WireState base;
+	uint64_t lastRequestNs;
+};
+
+static struct PeerSlot slots[PEERS_MAX];
+static uint32_t slotKeys[PEERS_MAX * 2], slotValues[PEERS_MAX * 2];
+static struct FlatMap slotByUser;
+static uint32_t freeSlots[PEERS_MAX];
+static uint32_t freeSlotCount = 0;
+
+static void beginWrite(struct PeerSlot *slot) {
+	atomic_store_explicit(&slot->seq,
+						  atomic_load_explicit(&slot->seq, memory_order_relaxed)
+							  + 1,
+						  memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+}
+
+static void endWrite(struct PeerSlot *slot) {
+	atomic_store_explicit(&slot->seq,
+						  atomic_load_explicit(&slot->seq, memory_order_relaxed)
+							  + 1,
+						  memory_order_release);
+}
+
+bool peers_read(size_t index, struct PeerState *state) {
+	if (index >= PEERS_MAX) {
+		return false;
+	}
+
+	struct PeerSlot *slot = &slots[index];
+	unsigned before, after;
+	bool used;
+	do {
+		before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		used   = slot->used;
+		*state = slot->state;
+		atomic_thread_fence(memory_order_acquire);
+		after = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+	} while (before != after || (before & 1));
+
+	return used;
+}
+
+static void releaseSlot(uint32_t index) {
+	beginWrite(&slots[index]);
+	slots[index].used     = false;
+	slots[index].haveBase = false;
+	endWrite(&slots[index]);
+	freeSlots[freeSlotCount++] = index;
+}
+
+void peers_clear(void) {
+	flatmap_init(&slotByUser, slotKeys, slotValues, PEERS_MAX * 2);
+	for (uint32_t i = 0; i < PEERS_MAX; i++) {
+		beginWrite(&slots[i]);
+		slots[i].used     = false;
+		slots[i].haveBase = false;
+		endWrite(&slots[i]);
+		freeSlots[i] = PEERS_MAX - 1 - i;
+	}
+	freeSlotCount = PEERS_MAX;
+}
+
+static void stateFromWire(struct PeerState *state,
+						  const struct WireState *wire) {
+	memcpy(state->name, wire->name, sizeof(state->name));
+	state->playerClass = wire->playerClass;
+	state->group       = wire->group;
+	state->mapId       = wire->mapId;
+	state->zoneId      = wire->zoneId;
+	for (int i = 0; i < 3; i++) {
+		state->position[i] = (float) wire->position[i] / POSITION_SCALE;
+	}
+	state->flags = wire->flags;
+}
+
+// Decodes the fields in mask straight from the message into wire. Position
+// values are added to what is already there, so callers pre-load the base.
+static void decodeFields(struct Reader *reader, uint64_t mask,
+						 struct WireState *wire, bool relative) {
+	if (mask & FIELD_NAME) {
+		uint64_t length = getVarint(reader);
+		if (length >= sizeof(wire->name)
+			|| reader->size - reader->pos < length) {
+			reader->error = true;
+			return;
+		}
+		memcpy(wire->name, reader->data + reader->pos, (size_t) length);
+		wire->name[length] = '\0';
+		reader->pos += (size_t) length;
+	}
+	if (mask & FIELD_CLASS) {
+		wire->playerClass = (uint8_t) getVarint(reader);
+	}
+	if (mask & FIELD_GROUP) {
+		wire->group = (int32_t) getSigned(reader);
+	}
+	if (mask & FIELD_MAP) {
+		wire->mapId = (int32_t) getSigned(reader);
+	}
+	if (mask & FIELD_ZONE) {
+		wire->zoneId = (int32_t) getSigned(reader);
+	}
+	if (mask & FIELD_POSITION) {
+		for (int i = 0; i < 3; i++) {
+			// Range-check before and after summing in 64 bits, so a hostile
+			// delta can overflow neither the sum nor the base
+			int64_t value = getSigned(reader);
+			if (relative && value >= INT32_MIN && value <= INT32_MAX) {
+				value += wire->position[i];
+			}
+			if (value < INT32_MIN || value > INT32_MAX) {
+				reader->error = true;
+				return;
+			}
+			wire->position[i] = (int32_t) value;
+		}
+	}
+	if (mask & FIELD_FLAGS) {
+		wire->flags = (uint8_t) getVarint(reader);
+	}
+}
+
+static void requestKeyframe(mumble_connection_t connection,
+							mumble_userid_t peer) {
+	uint8_t message[4];
+	struct Writer writer = { message, sizeof(message), 0 };
+	putByte(&writer, PROTOCOL_VERSION);
+	putByte(&writer, KIND_KEYFRAME_REQUEST);
+	putVarint(&writer, 0);
+
+	mumbleAPI.sendData(ownID, connection, &peer, 1, message, writer.used,
+					   PEERS_DATA_ID);
+}
+
+static atomic_bool keyframeRequested = false;
+
+bool peers_onReceiveData(mumble_connection_t connection,
+						 mumble_userid_t sender, const uint8_t *data,
+						 size_t dataLength, const char *dataID) {
+	if (strcmp(dataID, PEERS_DATA_ID) != 0) {
+		return false;
+	}
+	if (connection != roster_connection() || sender == roster_localUser()) {
+		return true;
+	}
+
+	struct Reader reader = { data, dataLength, 0, false };
+	if (getByte(&reader) != PROTOCOL_VERSION) {
+		return true;
+	}
+	uint8_t kind = getByte(&reader);
+	uint32_t seq = (uint32_t) getVarint(&reader);
+
+	if (kind == KIND_KEYFRAME_REQUEST) {
+		atomic_store(&keyframeRequested, true);
+		return true;
+	}
+	if (reader.error || (kind != KIND_KEYFRAME && kind != KIND_DELTA)) {
+		return true;
+	}
+
+	uint32_t index;
+	if (!flatmap_get(&slotByUser, sender, &index)) {
+		if (freeSlotCount == 0) {
+			return true;
+		}
+		index = freeSlots[--freeSlotCount];
+		flatmap_put(&slotByUser, sender, index);
+
+		beginWrite(&slots[index]);
+		memset(&slots[index].state, 0, sizeof(slots[index].state));
+		slots[index].state.user    = sender;
+		slots[index].haveBase      = false;
+		slots[index].lastRequestNs = 0;
+		endWrite(&slots[index]);
+	}
+	struct PeerSlot *slot = &slots[index];
+	uint64_t now          = plat_now_ns();
+
+	if (kind == KIND_DELTA) {
+		uint32_t base = (uint32_t) getVarint(&reader);
+		if (!slot->haveBase || slot->baseSeq != base) {
+			if (now - slot->lastRequestNs > KEYFRAME_REQUEST_INTERVAL_NS) {
+				slot->lastRequestNs = now;
+				requestKeyframe(connection, sender);
+			}
+			return true;
+		}
+	}
+	uint64_t mask = getVarint(&reader);
+	if (reader.error || (kind == KIND_KEYFRAME && mask != FIELD_ALL)) {
+		return true;
+	}
+
+	beginWrite(slot);
+	if (kind == KIND_KEYFRAME) {
+		decodeFields(&reader, mask, &slot->base, false);
+		slot->haveBase = !reader.error;
+		slot->baseSeq  = seq;
+		stateFromWire(&slot->state, &slot->base);
+	} else {
+		struct WireState current = slot->base;
+		decodeFields(&reader, mask, &current, true);
+		if (!reader.error) {
+			stateFromWire(&slot->state, &current);
+		}
+	}
+	slot->used            = slot->haveBase && !reader.error;
+	slot->state.updatedNs = now;
+	endWrite(slot);
+
+	return true;
+}
+
+void peers_onUserAdded(mumble_connection_t connection,
+					   mumble_userid_t userID) {
+	(void) userID;
+	if (connection == roster_connection()) {
+		// Newcomers have no keyframe from us yet
+		atomic_store(&keyframeRequested, true);
+	}
+}
+
+void peers_onUserRemoved(mumble_connection_t connection,
+						 mumble_userid_t userID) {
+	(void) connection;
+	uint32_t index;
+	if (flatmap_get(&slotByUser, userID, &index)) {
+		flatmap_remove(&slotByUser, userID);
+		releaseSlot(index);
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Sending side, encoded on the dispatcher thread and sent by the main thread
+
+static uint64_t sendIntervalNs;
+static mumble_connection_t sendConnection = -1;
+static bool haveSentBase                  = false;
+static struct WireState sentBase;
+static struct WireState lastSent;
+static uint32_t sentBaseSeq  = 0;
+static uint32_t sendSeq      = 0;
+static uint64_t lastSendNs   = 0;
+static uint64_t lastKeyframe = 0;
+
+static void wireFromSnapshot(struct WireState *wire,
+							 const struct GameSnapshot *snapshot) {
+	memset(wire, 0, sizeof(*wire));
+	if (!gamestate_inWorld(snapshot)) {
+		return;
+	}
+
+	memcpy(wire->name, snapshot->player, sizeof(wire->name));
+	wire->name[sizeof(wire->name) - 1] = '\0';
+	wire->playerClass                  = snapshot->playerClass;
+	wire->group                        = snapshot->leaderGUID;
+	wire->mapId                        = snapshot->mapId;
+	wire->zoneId                       = snapshot->zoneId;
+	for (int i = 0; i < 3; i++) {
+		wire->position[i] =
+			(int32_t) lrintf(snapshot->avatarPos[i] * POSITION_SCALE);
+	}
+	wire->flags = PEER_FLAG_IN_WORLD
+				  | (gamestate_isGhost(snapshot) ? PEER_FLAG_GHOST : 0);
+}
+
+static uint64_t changedFields(const struct WireState *a,
+							  const struct WireState *b) {
+	uint64_t mask = 0;
+	if (strcmp(a->name, b->name) != 0) {
+		mask |= FIELD_NAME;
+	}
+	if (a->playerClass != b->playerClass) {
+		mask |= FIELD_CLASS;
+	}
+	if (a->group != b->group) {
+		mask |= FIELD_GROUP;
+	}
+	if (a->mapId != b->mapId) {
+		mask |= FIELD_MAP;
+	}
+	if (a->zoneId != b->zoneId) {
+		mask |= FIELD_ZONE;
+	}
+	if (memcmp(a->position, b->position, sizeof(a->position)) != 0) {
+		mask |= FIELD_POSITION;
+	}
+	if (a->flags != b->flags) {
+		mask |= FIELD_FLAGS;
+	}
+	return mask;
+}
+
+static size_t encode(uint8_t *message, size_t size, bool keyframe,
+					 const struct WireState *state) {
+	struct Writer writer = { message, size, 0 };
+	uint64_t mask        = keyframe ? FIELD_ALL : changedFields(&sentBase, state);
+
+	putByte(&writer, PROTOCOL_VERSION);
+	putByte(&writer, keyframe ? KIND_KEYFRAME : KIND_DELTA);
+	putVarint(&writer, sendSeq);
+	if (!keyframe) {
+		putVarint(&writer, sentBaseSeq);
+	}
+	putVarint(&writer, mask);
+
+	if (mask & FIELD_NAME) {
+		size_t length = strlen(state->name);
+		putVarint(&writer, length);
+		for (size_t i = 0; i < length; i++) {
+			putByte(&writer, (uint8_t) state->name[i]);
+		}
+	}
+	if (mask & FIELD_CLASS) {
+		putVarint(&writer, state->playerClass);
+	}
+	if (mask & FIELD_GROUP) {
+		putSigned(&writer, state->group);
+	}
+	if (mask & FIELD_MAP) {
+		putSigned(&writer, state->mapId);
+	}
+	if (mask & FIELD_ZONE) {
+		putSigned(&writer, state->zoneId);
+	}
+	if (mask & FIELD_POSITION) {
+		for (int i = 0; i < 3; i++) {
+			putSigned(&writer, keyframe ? state->position[i]
+										: (int64_t) state->position[i]
+											  - sentBase.position[i]);
+		}
+	}
+	if (mask & FIELD_FLAGS) {
+		putVarint(&writer, state->flags);
+	}
+
+	return writer.used <= size ? writer.used : 0;
+}
+
+// A message encoded on the dispatcher thread for the main thread to send
+struct Outgoing {
+	mumble_connection_t connection;
+	size_t length;
+	uint8_t message[MAX_MESSAGE];
+};
+
+// Everybody in our channel except ourselves
+static size_t collectRecipients(mumble_userid_t *recipients) {
+	mumble_userid_t self        = roster_localUser();
+	struct RosterUser *selfUser = roster_find(self);
+	if (!selfUser) {
+		return 0;
+	}
+	int channel = atomic_load(&selfUser->channel);
+
+	size_t count = 0;
+	for (size_t i = 0; i < ROSTER_MAX_USERS && count < MAX_RECIPIENTS; i++) {
+		struct RosterUser *user = roster_at(i);
+		uint32_t id             = atomic_load(&user->id);
+		if (id != ROSTER_NO_USER && id != self
+			&& atomic_load(&user->channel) == channel) {
+			recipients[count++] = id;
+		}
+	}
+	return count;
+}
+
+// Main thread, queued by onTick
+static void sendOutgoing(const void *data, size_t size) {
+	(void) size;
+	const struct Outgoing *outgoing = data;
+	static mumble_userid_t recipients[MAX_RECIPIENTS];
+
+	// The delta base already moved on, so a message that did not go out is
+	// made up for with a keyframe. Receivers that missed a keyframe notice
+	// the base and ask for one.
+	size_t recipientCount = collectRecipients(recipients);
+	if (outgoing->connection != roster_connection() || recipientCount == 0
+		|| mumbleAPI.sendData(ownID, outgoing->connection, recipients,
+							  recipientCount, outgoing->message,
+							  outgoing->length, PEERS_DATA_ID)
+			   != MUMBLE_STATUS_OK) {
+		atomic_store(&keyframeRequested, true);
+	}
+}
+
+static void onTick(uint64_t nowNs, void *userdata) {
+	(void) userdata;
+
+	mumble_connection_t connection = roster_connection();
+	if (connection != sendConnection) {
+		sendConnection = connection;
+		haveSentBase   = false;
+	}
+	if (connection < 0 || nowNs - lastSendNs < sendIntervalNs) {
+		return;
+	}
+
+	struct GameSnapshot snapshot;
+	if (!gamestate_latest(&snapshot)) {
+		return;
+	}
+
+	struct WireState current;
+	wireFromSnapshot(&current, &snapshot);
+
+	// A request taken here is put back unless the keyframe actually goes out
+	bool requested = atomic_exchange(&keyframeRequested, false);
+	bool keyframe  = !haveSentBase || requested
+					|| nowNs - lastKeyframe > KEYFRAME_INTERVAL_NS;
+	if (!keyframe && changedFields(&lastSent, &current) == 0) {
+		return;
+	}
+
+	static mumble_userid_t recipients[MAX_RECIPIENTS];
+	struct Outgoing outgoing;
+	outgoing.connection = connection;
+	outgoing.length     = 0;
+	if (collectRecipients(recipients) > 0) {
+		outgoing.length = encode(outgoing.message, sizeof(outgoing.message),
+								 keyframe, &current);
+	}
+	if (outgoing.length == 0
+		|| !mainthread_post(sendOutgoing, &outgoing, sizeof(outgoing))) {
+		if (requested) {
+			atomic_store(&keyframeRequested, true);
+		}
+		return;
+	}
+
+	if (keyframe) {
+		sentBase     = current;
+		sentBaseSeq  = sendSeq;
+		haveSentBase = true;
+		lastKeyframe = nowNs;
+	}
+	lastSent   = current;
+	lastSendNs = nowNs;
+	sendSeq++;
+}
+
+void peers_init(void) {
+	peers_clear();
+
+	sendIntervalNs =
+		(uint64_t) config_getInt("peers.interval_ms", 500) * 1000000ull;
+	sendConnection = -1;
+	haveSentBase   = false;
+	lastSendNs     = 0;
+
+	if (config_getBool("peers.enabled", true)) {
+		events_subscribeTick(onTick, NULL);
+	}
+}
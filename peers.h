@@ -0,0 +1,66 @@
+#ifndef WOW335PA_PEERS_H_
+#define WOW335PA_PEERS_H_
+
+// In-game metadata shared with the plugins of other users in our channel via
+// sendData/onReceiveData: character, class, group (leader GUID), map, zone,
+// a quantised position and in-world/ghost flags.
+//
+// Wire format (version 1), all integers are LEB128 varints, signed ones
+// zigzag encoded:
+//   u8  version
+//   u8  kind              KEYFRAME, DELTA or KEYFRAME_REQUEST
+//   var seq               sender frame number
+//   var base              DELTA only: seq of the keyframe it is relative to
+//   var fields            bit mask of the fields that follow, in bit order
+//   ...                   name (var length + bytes), class, group, map, zone,
+//                         position (3 x zigzag), flags
+// A keyframe carries every field. A delta carries only the fields that differ
+// from its keyframe, with the position relative to the keyframe's, so any
+// single delta is decodable on its own. A receiver that does not have the
+// referenced keyframe asks the sender for a new one.
+//
+// At most one message is sent per interval (peers.interval_ms, default 500,
+// the server rate-limits plugin messages) and only when something changed.
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PEERS_MAX 256
+
+#define PEER_FLAG_IN_WORLD 0x01
+#define PEER_FLAG_GHOST 0x02
+
+struct PeerState {
+	mumble_userid_t user;
+	char name[50];
+	uint8_t playerClass;
+	int32_t group;
+	int32_t mapId;
+	int32_t zoneId;
+	// WoW coordinates, quantised to a quarter yard on the wire
+	float position[3];
+	uint8_t flags;
+	// Local receive time of the last update
+	uint64_t updatedNs;
+};
+
+// Reads the config and subscribes to the dispatcher tick. Call before
+// events_start().
+void peers_init(void);
+void peers_clear(void);
+
+// Main thread callbacks
+bool peers_onReceiveData(mumble_connection_t connection,
+						 mumble_userid_t sender, const uint8_t *data,
+						 size_t dataLength, const char *dataID);
+void peers_onUserAdded(mumble_connection_t connection, mumble_userid_t userID);
+void peers_onUserRemoved(mumble_connection_t connection,
+						 mumble_userid_t userID);
+
+// Copies the state in peer table slot index (0 <= index < PEERS_MAX).
+// Lock-free; returns false if the slot is unused.
+bool peers_read(size_t index, struct PeerState *state);
+
+#endif // WOW335PA_PEERS_H_
@@ -0,0 +1,140 @@
+#include "pemap.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#	include <windows.h>
+#	include <tlhelp32.h>
+#	define strcasecmp _stricmp
+#else
+#	include <inttypes.h>
+#	include <strings.h>
+#endif
+
+#define DOS_HEADER_SIZE 64
+#define DOS_LFANEW_OFFSET 0x3C
+// Signature, COFF file header and the start of the optional header, up to and
+// including SizeOfImage
+#define NT_HEADERS_SIZE (4 + 20 + 60)
+#define PE32_MAGIC 0x10B
+#define PE32_PLUS_MAGIC 0x20B
+
+static uint16_t loadU16(const uint8_t *data) {
+	return (uint16_t) (data[0] | data[1] << 8);
+}
+
+static uint32_t loadU32(const uint8_t *data) {
+	return (uint32_t) data[0] | (uint32_t) data[1] << 8
+		   | (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24;
+}
+
+// Checks that an image starts at base and reads its preferred base and size
+static bool readHeaders(PemapReadFn read, void *userdata, uint64_t base,
+						struct PeModule *module) {
+	uint8_t dos[DOS_HEADER_SIZE];
+	if (!read(userdata, base, dos, sizeof(dos)) || dos[0] != 'M'
+		|| dos[1] != 'Z') {
+		return false;
+	}
+	uint32_t lfanew = loadU32(dos + DOS_LFANEW_OFFSET);
+	// The headers live in the first page
+	if (lfanew < DOS_HEADER_SIZE || lfanew > 4096 - NT_HEADERS_SIZE) {
+		return false;
+	}
+
+	uint8_t nt[NT_HEADERS_SIZE];
+	if (!read(userdata, base + lfanew, nt, sizeof(nt))
+		|| memcmp(nt, "PE\0\0", 4) != 0) {
+		return false;
+	}
+	const uint8_t *optional = nt + 4 + 20;
+	switch (loadU16(optional)) {
+		case PE32_MAGIC:
+			module->preferredBase = loadU32(optional + 28);
+			break;
+		case PE32_PLUS_MAGIC:
+			module->preferredBase = (uint64_t) loadU32(optional + 24)
+									| (uint64_t) loadU32(optional + 28) << 32;
+			break;
+		default:
+			return false;
+	}
+	module->base      = base;
+	module->size      = loadU32(optional + 56);
+	module->timestamp = loadU32(nt + PEMAP_TIMESTAMP_OFFSET);
+	module->ntOffset  = lfanew;
+	return module->size > 0;
+}
+
+static void setName(struct PeModule *module, const char *name) {
+	size_t i = 0;
+	for (; name[i] && i + 1 < sizeof(module->name); i++) {
+		module->name[i] = (char) tolower((unsigned char) name[i]);
+	}
+	module->name[i] = '\0';
+}
+
+bool pemap_find(uint64_t pid, const char *name, PemapReadFn read,
+				void *userdata, struct PeModule *module) {
+	bool found = false;
+
+#ifdef _WIN32
+	HANDLE snapshot = CreateToolhelp32Snapshot(
+		TH32CS_SNAPMODULE | TH32CS_SNAPMODULE32, (DWORD) pid);
+	if (snapshot == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	MODULEENTRY32W entry;
+	entry.dwSize = sizeof(entry);
+	for (BOOL more = Module32FirstW(snapshot, &entry); more && !found;
+		 more = Module32NextW(snapshot, &entry)) {
+		char entryName[MAX_MODULE_NAME32 + 1];
+		WideCharToMultiByte(CP_UTF8, 0, entry.szModule, -1, entryName,
+							(int) sizeof(entryName), NULL, NULL);
+		entryName[sizeof(entryName) - 1] = '\0';
+		if (strcasecmp(entryName, name) == 0) {
+			uint64_t base = (uint64_t) (uintptr_t) entry.modBaseAddr;
+			found         = readHeaders(read, userdata, base, module);
+		}
+	}
+	CloseHandle(snapshot);
+#else
+	// Wine maps the headers of every image it loads straight from the file, at
+	// offset 0, so the maps are its module list
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%" PRIu64 "/maps", pid);
+	FILE *maps = fopen(path, "r");
+	if (!maps) {
+		return false;
+	}
+
+	char line[4096];
+	while (!found && fgets(line, sizeof(line), maps)) {
+		uint64_t start, end, offset;
+		int pathStart = 0;
+		if (sscanf(line, "%" SCNx64 "-%" SCNx64 " %*s %" SCNx64 " %*s %*s %n",
+				   &start, &end, &offset, &pathStart)
+				< 3
+			|| pathStart == 0 || offset != 0) {
+			continue;
+		}
+		char *file = line + pathStart;
+		file[strcspn(file, "\n")] = '\0';
+		const char *fileName      = strrchr(file, '/');
+		fileName                  = fileName ? fileName + 1 : file;
+		// Later mappings of the image are its sections, at other offsets
+		if (strcasecmp(fileName, name) == 0) {
+			found = readHeaders(read, userdata, start, module);
+		}
+	}
+	fclose(maps);
+#endif
+
+	if (found) {
+		setName(module, name);
+	}
+	return found;
+}
@@ -0,0 +1,40 @@
+#ifndef WOW335PA_PEMAP_H_
+#define WOW335PA_PEMAP_H_
+
+// Finds where a PE image (.exe or .dll) is loaded in a process. Under Wine
+// the images are found through the process's file mappings, on Windows through
+// the Toolhelp module list; either way the headers are read back from the
+// target and checked before the image is trusted.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PEMAP_NAME_SIZE 32
+// Of TimeDateStamp from the start of the NT headers
+#define PEMAP_TIMESTAMP_OFFSET 8
+
+struct PeModule {
+	// File name without the directory, lowercase; truncated if long
+	char name[PEMAP_NAME_SIZE];
+	uint64_t base;
+	// ImageBase of the optional header, where the linker put it
+	uint64_t preferredBase;
+	uint32_t size;
+	// TimeDateStamp of the COFF header, which changes with every build, and
+	// where the NT headers start (e_lfanew)
+	uint32_t timestamp;
+	uint32_t ntOffset;
+};
+
+// Reads len bytes at address of the target process
+typedef bool (*PemapReadFn)(void *userdata, uint64_t address, void *dest,
+							size_t len);
+
+// Looks for the image called name (compared case-insensitively) in process
+// pid and stops at the first one whose headers check out. Returns false if
+// there is none. Reads files, so it belongs to attach time.
+bool pemap_find(uint64_t pid, const char *name, PemapReadFn read,
+				void *userdata, struct PeModule *module);
+
+#endif // WOW335PA_PEMAP_H_
@@ -0,0 +1,254 @@
+#ifndef WOW335PA_PLATFORM_H_
+#define WOW335PA_PLATFORM_H_
+
+// Small threading and clock shim so the rest of the plugin does not have to
+// sprinkle #ifdef _WIN32 around every background task.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#	include <windows.h>
+#	include <limits.h>
+#else
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <pthread.h>
+#	include <semaphore.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <time.h>
+#	include <unistd.h>
+#endif
+
+#ifdef _WIN32
+typedef HANDLE plat_thread_t;
+typedef HANDLE plat_sem_t;
+typedef SRWLOCK plat_mutex_t;
+#	define PLAT_MUTEX_INITIALIZER SRWLOCK_INIT
+#else
+typedef pthread_t plat_thread_t;
+typedef sem_t plat_sem_t;
+typedef pthread_mutex_t plat_mutex_t;
+#	define PLAT_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#endif
+
+typedef void (*plat_thread_fn)(void *arg);
+
+struct plat_thread_start_ {
+	plat_thread_fn fn;
+	void *arg;
+};
+
+// Monotonic clock in nanoseconds
+static inline uint64_t plat_now_ns(void) {
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	if (frequency.QuadPart == 0) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+	return (uint64_t) ((double) counter.QuadPart * 1e9
+					   / (double) frequency.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+static inline void plat_sleep_ms(uint32_t ms) {
+#ifdef _WIN32
+	Sleep(ms);
+#else
+	struct timespec ts;
+	ts.tv_sec  = ms / 1000;
+	ts.tv_nsec = (long) (ms % 1000) * 1000000L;
+	while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+	}
+#endif
+}
+
+// Sleeps until plat_now_ns() reaches deadlineNs. Windows sleeps in whole
+// milliseconds, so it may wake up to a millisecond late.
+static inline void plat_sleep_until_ns(uint64_t deadlineNs) {
+#ifdef _WIN32
+	uint64_t nowNs = plat_now_ns();
+	if (deadlineNs > nowNs) {
+		Sleep((DWORD) ((deadlineNs - nowNs + 999999ull) / 1000000ull));
+	}
+#else
+	struct timespec deadline;
+	deadline.tv_sec  = (time_t) (deadlineNs / 1000000000ull);
+	deadline.tv_nsec = (long) (deadlineNs % 1000000000ull);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL)
+		   == EINTR) {
+	}
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI plat_thread_trampoline_(LPVOID param) {
+#else
+static void *plat_thread_trampoline_(void *param) {
+#endif
+	struct plat_thread_start_ start = *(struct plat_thread_start_ *) param;
+	free(param);
+	start.fn(start.arg);
+#ifdef _WIN32
+	return 0;
+#else
+	return NULL;
+#endif
+}
+
+static inline bool plat_thread_start(plat_thread_t *thread, plat_thread_fn fn,
+									 void *arg) {
+	struct plat_thread_start_ *start = malloc(sizeof(*start));
+	if (!start) {
+		return false;
+	}
+	start->fn  = fn;
+	start->arg = arg;
+#ifdef _WIN32
+	*thread = CreateThread(NULL, 0, plat_thread_trampoline_, start, 0, NULL);
+	if (*thread == NULL) {
+		free(start);
+		return false;
+	}
+#else
+	if (pthread_create(thread, NULL, plat_thread_trampoline_, start) != 0) {
+		free(start);
+		return false;
+	}
+#endif
+	return true;
+}
+
+static inline void plat_thread_join(plat_thread_t thread) {
+#ifdef _WIN32
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else
+	pthread_join(thread, NULL);
+#endif
+}
+
+static inline bool plat_sem_init(plat_sem_t *sem) {
+#ifdef _WIN32
+	*sem = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+	return *sem != NULL;
+#else
+	return sem_init(sem, 0, 0) == 0;
+#endif
+}
+
+static inline void plat_sem_destroy(plat_sem_t *sem) {
+#ifdef _WIN32
+	CloseHandle(*sem);
+#else
+	sem_destroy(sem);
+#endif
+}
+
+static inline void plat_sem_post(plat_sem_t *sem) {
+#ifdef _WIN32
+	ReleaseSemaphore(*sem, 1, NULL);
+#else
+	sem_post(sem);
+#endif
+}
+
+// Returns false if the timeout expired before the semaphore was posted
+static inline bool plat_sem_wait_ms(plat_sem_t *sem, uint32_t ms) {
+#ifdef _WIN32
+	return WaitForSingleObject(*sem, ms) == WAIT_OBJECT_0;
+#else
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += ms / 1000;
+	deadline.tv_nsec += (long) (ms % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	int rc;
+	while ((rc = sem_timedwait(sem, &deadline)) == -1 && errno == EINTR) {
+	}
+	return rc == 0;
+#endif
+}
+
+// Mutexes are only meant for state shared between Mumble's main thread and our
+// own background threads, never for the audio or positional threads.
+static inline void plat_mutex_lock(plat_mutex_t *mutex) {
+#ifdef _WIN32
+	AcquireSRWLockExclusive(mutex);
+#else
+	pthread_mutex_lock(mutex);
+#endif
+}
+
+static inline void plat_mutex_unlock(plat_mutex_t *mutex) {
+#ifdef _WIN32
+	ReleaseSRWLockExclusive(mutex);
+#else
+	pthread_mutex_unlock(mutex);
+#endif
+}
+
+// Maps a whole file read-only, NULL on failure or if the file is empty
+static inline const void *plat_map_file(const char *path, size_t *size) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+							  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return NULL;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL) {
+		return NULL;
+	}
+	// The view keeps the mapping alive
+	const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	*size = (size_t) fileSize.QuadPart;
+	return data;
+#else
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+	void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return NULL;
+	}
+	*size = (size_t) st.st_size;
+	return data;
+#endif
+}
+
+static inline void plat_unmap_file(const void *data, size_t size) {
+#ifdef _WIN32
+	(void) size;
+	UnmapViewOfFile(data);
+#else
+	munmap((void *) data, size);
+#endif
+}
+
+#endif // WOW335PA_PLATFORM_H_
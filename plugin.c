@@ -1,87 +1,170 @@
 #include "MumblePlugin_v_1_0_x.h"
 
 #include "PluginComponents_v_1_0_x.h"
+#include "automove.h"
+#include "breaker.h"
+#include "channels.h"
+#include "config.h"
+#include "cues.h"
+#include "discovery.h"
+#include "dsp.h"
+#include "events.h"
+#include "gamestate.h"
+#include "hrtf.h"
+#include "inputgate.h"
+#include "json.h"
+#include "mainthread.h"
+#include "metrics.h"
+#include "peers.h"
+#include "platform.h"
+#include "plugin.h"
+#include "posring.h"
+#include "proximity.h"
+#include "roster.h"
+#include "sampler.h"
+#include "voicefx.h"
+#include "wowlayout.h"
+#include "wowreader.h"
 #include <math.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define WOW_EXE "wow.exe" // lowercase
 #ifdef _WIN32
 #	include < windows.h>
 #else
 #	include <fcntl.h>
 #	include <unistd.h>
-#	include <ctype.h>
-#	include <sys/uio.h>
-
-// Wine process names
-#	define WINE_PRELOADER "wine-preloader"
-#	define WINE_PROCESS "wine"
 #endif
 
-// Every few calls we will log positions for debugging
-static int debugCallCounter = 0;
-
-#ifdef _WIN32
-typedef DWORD procid_t;   // Windows process ID type
-typedef LPVOID procptr_t; // Windows process pointer type
-#else
-typedef pid_t procid_t;  // Unix/Linux process ID type
-typedef void *procptr_t; // Unix/Linux process pointer type
-#endif
+// Frames shared with local tools, see posring.h
+static struct Posring exportRing;
+static bool exporting;
+
+// Frames are taken from the reader daemon (daemon/) instead of the game
+// process when reader.daemon is set, so Mumble itself needs no ptrace rights
+static bool useDaemon;
+static const char *daemonName;
+static struct Posring daemonRing;
+// The daemon's frames are treated as failed reads once they are this old
+#define DAEMON_STALE_NS 1000000000ull
+// and the daemon as gone once nothing was published for this long. A daemon
+// that was killed leaves its magic behind in the mapping, so only the age of
+// the newest frame tells.
+#define DAEMON_GONE_NS 5000000000ull
+
+// Interval of the position dump in Mumble's log, 0 when turned off
+static uint64_t debugIntervalNs;
+
+// When mumble_init ran, and how long after that the first position in the
+// world was read (0 until then). Written by the positional thread.
+static uint64_t loadedNs;
+static _Atomic uint64_t firstPositionNs;
 
 struct MumbleAPI_v_1_0_x mumbleAPI;
 mumble_plugin_id_t ownID;
 
-// Process ID for the target process (WoW)
-static procid_t pPid = 0;
-#ifdef _WIN32
-static HANDLE hProcess = NULL;
-#endif
-
-// Function to read memory from a process
-static inline bool peekProc(const procptr_t addr, void *dest,
-							const size_t len) {
-#ifdef _WIN32
-	SIZE_T bytesRead;
+// The game process (WoW)
+static struct WowProcess wowProcess;
+// Stops reading it while every read fails, see breaker.h. Positional thread.
+static struct Breaker readBreaker;
+// Sequence of the sampler's frame the previous fetch took, see sampler.h.
+// Positional thread.
+static uint64_t lastSampleSequence;
+
+// Writes every game event to Mumble's log. Runs on the dispatcher thread.
+static void logGameEvent(const struct GameEvent *event, void *userdata) {
+	(void) userdata;
+	char logBuffer[256];
 
-	// Make sure we have a valid handle
-	if (hProcess == NULL) {
-		// Open process with PROCESS_VM_READ access right
-		hProcess = OpenProcess(PROCESS_VM_READ, FALSE, pPid);
-		if (hProcess == NULL) {
-			return false;
-		}
+	switch (event->type) {
+		case GAME_EVENT_MAP_CHANGED:
+		case GAME_EVENT_ZONE_CHANGED:
+		case GAME_EVENT_LEADER_CHANGED:
+			snprintf(logBuffer, sizeof(logBuffer), "Event: %s (%d -> %d)",
+					 events_name(event->type), event->previous,
+					 event->current);
+			break;
+		case GAME_EVENT_TELEPORTED:
+			snprintf(logBuffer, sizeof(logBuffer),
+					 "Event: %s (%.1f yards on map %d)",
+					 events_name(event->type), event->distance, event->mapId);
+			break;
+		default:
+			snprintf(logBuffer, sizeof(logBuffer), "Event: %s (%s on map %d)",
+					 events_name(event->type),
+					 event->player[0] ? event->player : "None", event->mapId);
+			break;
 	}
 
-	BOOL success =
-		ReadProcessMemory(hProcess,       // Handle to the process
-						  (LPCVOID) addr, // Base address to read from
-						  dest,           // Buffer to receive data
-						  len,            // Number of bytes to read
-						  &bytesRead      // Number of bytes actually read
-		);
-
-	return (success != FALSE && bytesRead == len);
-#else
-	// On Linux/Unix, use process_vm_readv
-	struct iovec in;
-	in.iov_base = (void *) (addr); // Address from target process
-	in.iov_len  = len;             // Length
+	mainthread_log(logBuffer);
+}
 
-	struct iovec out;
-	out.iov_base = dest;
-	out.iov_len  = len;
+// Dumps the latest frame to Mumble's log. Runs on the dispatcher thread, which
+// hands the lines to the main thread (mainthread.h), as mumbleAPI.log waits
+// for it.
+static void logPositions(uint64_t nowNs, void *userdata) {
+	(void) userdata;
+	static uint64_t lastLogNs = 0;
+	struct GameSnapshot snapshot;
+	char logBuffer[512];
+
+	if (nowNs - lastLogNs < debugIntervalNs || !gamestate_latest(&snapshot)) {
+		return;
+	}
+	lastLogNs = nowNs;
+
+	// Vectors are converted to Mumble's coordinate system like the ones handed
+	// to Mumble: X=-Y, Y=Z, Z=X
+	const float *avatar = snapshot.avatarPos;
+	const float *camera = snapshot.cameraPos;
+	const float *front  = snapshot.cameraFront;
+	const float *top    = snapshot.cameraTop;
+
+	snprintf(logBuffer, sizeof(logBuffer),
+			 "DEBUG Values - State: %d, MapID: %d, Player: %s",
+			 snapshot.state, snapshot.mapId, snapshot.player);
+	mainthread_log(logBuffer);
+
+	snprintf(logBuffer, sizeof(logBuffer),
+			 "Avatar Pos: [%.2f, %.2f, %.2f] Heading: %.2f", -avatar[1],
+			 avatar[2], avatar[0], snapshot.heading);
+	mainthread_log(logBuffer);
+
+	snprintf(logBuffer, sizeof(logBuffer),
+			 "Camera Pos: [%.2f, %.2f, %.2f] Front: [%.2f, %.2f, %.2f] Top: "
+			 "[%.2f, %.2f, %.2f]",
+			 -camera[1], camera[2], camera[0], -front[1], front[2], front[0],
+			 -top[1], top[2], top[0]);
+	mainthread_log(logBuffer);
+}
 
-	ssize_t nread = process_vm_readv(pPid, &out, 1, &in, 1, 0);
+// Reports the time to the first position once. Runs on the dispatcher
+// thread.
+static void logFirstPosition(uint64_t nowNs, void *userdata) {
+	(void) nowNs;
+	(void) userdata;
+	static bool logged = false;
+	uint64_t elapsedNs = atomic_load_explicit(&firstPositionNs,
+											  memory_order_relaxed);
+
+	if (logged || elapsedNs == 0) {
+		return;
+	}
+	logged = true;
 
-	return (nread != -1 && (size_t) nread == len);
-#endif
+	char logBuffer[96];
+	snprintf(logBuffer, sizeof(logBuffer),
+			 "First position %.1f ms after loading",
+			 (double) elapsedNs / 1e6);
+	mainthread_log(logBuffer);
 }
 
 mumble_error_t mumble_init(mumble_plugin_id_t pluginID) {
-	ownID = pluginID;
+	ownID    = pluginID;
+	loadedNs = plat_now_ns();
+	atomic_store(&firstPositionNs, 0);
 
 	if (mumbleAPI.log(ownID, "Wow335 Positional Audio loaded")
 		!= MUMBLE_STATUS_OK) {
@@ -89,10 +172,127 @@ mumble_error_t mumble_init(mumble_plugin_id_t pluginID) {
 		// in your plugin's logging system (if there is any)
 	}
 
+	if (config_load()) {
+		mumbleAPI.log(ownID, "Loaded wow335pa.conf");
+	}
+
+	roster_clear();
+
+	events_subscribe(GAME_EVENT_MASK_ALL, logGameEvent, NULL);
+	debugIntervalNs =
+		(uint64_t) config_getInt("debug.positions_ms", 1000) * 1000000ull;
+	if (debugIntervalNs > 0) {
+		events_subscribeTick(logPositions, NULL);
+	}
+	events_subscribeTick(logFirstPosition, NULL);
+	automove_init();
+	peers_init();
+	proximity_init();
+	voicefx_init();
+	inputgate_init();
+	hrtf_setIdleTimeout(
+		(uint32_t) config_getInt("dsp.passive_timeout_ms", 1000));
+	if (config_getBool("hrtf.enabled", false)) {
+		const char *hrtfFile = config_getString("hrtf.file", "");
+		char logBuffer[512];
+		if (hrtf_load(hrtfFile)) {
+			snprintf(logBuffer, sizeof(logBuffer), "Loaded HRTF set \"%s\"",
+					 hrtfFile);
+		} else {
+			snprintf(logBuffer, sizeof(logBuffer),
+					 "ERROR: Failed to load HRTF set \"%s\"", hrtfFile);
+		}
+		mumbleAPI.log(ownID, logBuffer);
+	}
+	struct BreakerPolicy breakerPolicy = {
+		.openAfter     = (uint32_t) config_getInt("reader.breaker_failures", 5),
+		.baseBackoffNs = (uint64_t) config_getInt("reader.backoff_ms", 50)
+						 * 1000000ull,
+		.maxBackoffNs  = (uint64_t) config_getInt("reader.backoff_max_ms", 2000)
+						* 1000000ull,
+	};
+	breaker_init(&readBreaker, &breakerPolicy, plat_now_ns());
+	useDaemon  = config_getBool("reader.daemon", false);
+	daemonName = config_getString("reader.name", POSRING_DEFAULT_NAME);
+	// The daemon reads on its own schedule
+	struct SamplerConfig samplerConfig = {
+		.mode     = SAMPLER_INLINE,
+		.periodNs = (uint64_t) config_getInt("reader.sample_ms", 10)
+					* 1000000ull,
+		.leadNs   = (uint64_t) config_getInt("reader.sample_lead_us", 1000)
+				  * 1000ull,
+		.breaker  = breakerPolicy,
+	};
+	const char *samplerName = config_getString("reader.sampler", "inline");
+	if (!sampler_parseMode(samplerName, &samplerConfig.mode)) {
+		mumbleAPI.log(ownID, "ERROR: Unknown reader.sampler, reading inline");
+	} else if (!useDaemon && samplerConfig.mode != SAMPLER_INLINE) {
+		char logBuffer[96];
+		snprintf(logBuffer, sizeof(logBuffer),
+				 sampler_start(&samplerConfig)
+					 ? "Reading the game on the %s sampler"
+					 : "ERROR: Failed to start the %s sampler, reading inline",
+				 samplerName);
+		mumbleAPI.log(ownID, logBuffer);
+	}
+	// The daemon already exports what it reads
+	if (!useDaemon && config_getBool("export.enabled", false)) {
+		const char *name =
+			config_getString("export.name", POSRING_DEFAULT_NAME);
+		exporting = posring_create(&exportRing, name);
+		mumbleAPI.log(ownID,
+					  exporting
+						  ? "Exporting positions to shared memory"
+						  : "ERROR: Failed to create the shared-memory export");
+	}
+	metrics_setBackend(useDaemon ? "daemon" : "process");
+	// The daemon does its own discovery
+	if (!useDaemon && config_getBool("reader.warm_attach", true)
+		&& !discovery_start()) {
+		mumbleAPI.log(ownID, "ERROR: Failed to start the background search "
+							 "for the game");
+	}
+	if (config_getBool("metrics.enabled", false)) {
+		char logBuffer[160];
+		if (metrics_start(config_getString("metrics.socket", ""))) {
+			snprintf(logBuffer, sizeof(logBuffer), "Serving metrics on %s",
+					 metrics_path());
+		} else {
+			snprintf(logBuffer, sizeof(logBuffer),
+					 "ERROR: Failed to start the metrics endpoint");
+		}
+		mumbleAPI.log(ownID, logBuffer);
+	}
+	uint32_t cueCount = cues_init();
+	if (cueCount > 0) {
+		char logBuffer[64];
+		snprintf(logBuffer, sizeof(logBuffer), "Loaded %u event cues",
+				 (unsigned) cueCount);
+		mumbleAPI.log(ownID, logBuffer);
+	}
+	mainthread_start();
+	if (!events_start()) {
+		mumbleAPI.log(ownID, "ERROR: Failed to start the event dispatcher");
+	}
+
 	return MUMBLE_STATUS_OK;
 }
 
 void mumble_shutdown() {
+	discovery_stop();
+	sampler_stop();
+	events_stop();
+	mainthread_stop();
+	metrics_stop();
+	proximity_shutdown();
+	hrtf_unload();
+	cues_shutdown();
+	if (exporting) {
+		exporting = false;
+		posring_destroy(&exportRing);
+	}
+	posring_close(&daemonRing);
+
 	if (mumbleAPI.log(ownID, "Wow335 Positional Audio unloaded")
 		!= MUMBLE_STATUS_OK) {
 		// Logging failed -> usually you'd probably want to log things like this
@@ -125,6 +325,7 @@ void mumble_registerAPIFunctions(void *apiStruct) {
 }
 
 void mumble_releaseResource(const void *pointer) {
+	(void) pointer;
 	// As we never pass a resource to Mumble that needs releasing, this function
 	// should never get called
 	printf("Called mumble_releaseResource but expected that this never gets "
@@ -169,55 +370,287 @@ struct MumbleStringWrapper mumble_getDescription() {
 	return wrapper;
 }
 
-// Positional audio
+// Server callbacks. Mumble makes them on its main thread, so each one first
+// runs the work the dispatcher queued for it (mainthread.h).
 
-uint32_t mumble_getFeatures() {
-	return MUMBLE_FEATURE_POSITIONAL;
+void mumble_onServerSynchronized(mumble_connection_t connection) {
+	mainthread_run();
+	channels_build(connection);
+	roster_build(connection);
+	automove_onServerSynchronized(connection);
+}
+
+void mumble_onServerDisconnected(mumble_connection_t connection) {
+	mainthread_run();
+	proximity_onServerDisconnected(connection);
+	channels_clear();
+	roster_clear();
+	peers_clear();
+}
+
+void mumble_onUserAdded(mumble_connection_t connection,
+						mumble_userid_t userID) {
+	mainthread_run();
+	roster_onUserAdded(connection, userID);
+	peers_onUserAdded(connection, userID);
+}
+
+void mumble_onUserRemoved(mumble_connection_t connection,
+						  mumble_userid_t userID) {
+	mainthread_run();
+	roster_onUserRemoved(connection, userID);
+	peers_onUserRemoved(connection, userID);
+}
+
+void mumble_onChannelEntered(mumble_connection_t connection,
+							 mumble_userid_t userID,
+							 mumble_channelid_t previousChannelID,
+							 mumble_channelid_t newChannelID) {
+	(void) previousChannelID;
+	mainthread_run();
+	roster_onChannelEntered(connection, userID, newChannelID);
+}
+
+void mumble_onChannelExited(mumble_connection_t connection,
+							mumble_userid_t userID,
+							mumble_channelid_t channelID) {
+	mainthread_run();
+	roster_onChannelExited(connection, userID, channelID);
+}
+
+void mumble_onUserTalkingStateChanged(mumble_connection_t connection,
+									  mumble_userid_t userID,
+									  mumble_talking_state_t talkingState) {
+	mainthread_run();
+	roster_onTalkingStateChanged(connection, userID, talkingState);
+}
+
+void mumble_onChannelAdded(mumble_connection_t connection,
+						   mumble_channelid_t channelID) {
+	mainthread_run();
+	channels_onAdded(connection, channelID);
+}
+
+void mumble_onChannelRemoved(mumble_connection_t connection,
+							 mumble_channelid_t channelID) {
+	mainthread_run();
+	channels_onRemoved(connection, channelID);
+}
+
+void mumble_onChannelRenamed(mumble_connection_t connection,
+							 mumble_channelid_t channelID) {
+	mainthread_run();
+	channels_onRenamed(connection, channelID);
+}
+
+bool mumble_onReceiveData(mumble_connection_t connection,
+						  mumble_userid_t sender, const uint8_t *data,
+						  size_t dataLength, const char *dataID) {
+	mainthread_run();
+	return peers_onReceiveData(connection, sender, data, dataLength, dataID);
 }
 
-// Helper function for Linux to check if a Wine process is running WoW
-#ifndef _WIN32
-bool isWineRunningWow(uint64_t pid) {
-	char cmdlinePath[256];
-	char buffer[512];
-	snprintf(cmdlinePath, sizeof(cmdlinePath), "/proc/%llu/cmdline",
-			 (unsigned long long) pid);
+// Audio
+
+bool mumble_onAudioInput(short *inputPCM, uint32_t sampleCount,
+						 uint16_t channelCount, uint32_t sampleRate,
+						 bool isSpeech) {
+	(void) isSpeech;
+	uint64_t startNs = plat_now_ns();
+	uint64_t ageNs   = sampler_onAudioInput(startNs);
+	bool recording   = metrics_enabled();
+	if (recording && ageNs != 0) {
+		metrics_recordPositionAge(ageNs);
+	}
+
+	// Frames silenced here are still encoded, but digital silence costs next
+	// to nothing to send and to decode on the other side
+	bool modified = inputgate_process(inputPCM, sampleCount, channelCount);
+
+	if (recording) {
+		metrics_recordAudio(METRICS_AUDIO_INPUT, startNs, sampleCount,
+							sampleRate);
+	}
+	return modified;
+}
+
+static bool processSource(float *outputPCM, uint32_t sampleCount,
+						  uint16_t channelCount, uint32_t sampleRate,
+						  bool isSpeech, mumble_userid_t userID) {
+	if (!isSpeech) {
+		return false;
+	}
+
+	// Speakers out of in-game hearing range (flag precomputed by proximity.c)
+	struct RosterUser *user = roster_find(userID);
+	if (user && atomic_load_explicit(&user->culled, memory_order_relaxed)) {
+		memset(outputPCM, 0, sizeof(float) * sampleCount * channelCount);
+		return true;
+	}
 
-	FILE *cmdlineFile = fopen(cmdlinePath, "r");
-	if (!cmdlineFile) {
+	if (!user || (!voicefx_enabled() && !hrtf_loaded())) {
 		return false;
 	}
 
-	size_t bytesRead = fread(buffer, 1, sizeof(buffer) - 1, cmdlineFile);
-	fclose(cmdlineFile);
+	// DSP cost should scale with the active speakers, not with everyone whose
+	// buffer gets fetched. The talking state is updated on the main thread and
+	// lags the audio a little, so a source that is not marked as speaking is
+	// only skipped once its buffer turns out to be padding.
+	if (!roster_isSpeaking(user)
+		&& dsp_isSilent(outputPCM, (size_t) sampleCount * channelCount)) {
+		return false;
+	}
 
-	if (bytesRead == 0) {
+	// Spatial effects for speakers on our map (position published by
+	// proximity.c)
+	float position[3];
+	struct GameSnapshot listener;
+	if (!roster_unpackPosition(
+			atomic_load_explicit(&user->position, memory_order_relaxed),
+			position)
+		|| !gamestate_latest(&listener) || !gamestate_inWorld(&listener)) {
 		return false;
 	}
 
-	// Ensure null-termination
-	buffer[bytesRead] = '\0';
+	float relative[3];
+	gamestate_toListener(&listener, position, relative);
 
-	// Make the buffer lowercase for case-insensitive comparison
-	for (size_t i = 0; i < bytesRead; i++) {
-		buffer[i] = tolower(buffer[i]);
+	bool modified = false;
+	if (voicefx_enabled()) {
+		modified = voicefx_process(user, outputPCM, sampleCount, channelCount,
+								   sampleRate, listener.mapId, relative);
+	}
+	// The binaural voice is mixed back in mumble_onAudioOutputAboutToPlay
+	if (hrtf_loaded()
+		&& hrtf_render(userID, outputPCM, sampleCount, channelCount,
+					   sampleRate, relative)) {
+		memset(outputPCM, 0, sizeof(float) * sampleCount * channelCount);
+		modified = true;
 	}
 
-	return (strstr(buffer, WOW_EXE) != NULL);
+	return modified;
+}
+
+bool mumble_onAudioSourceFetched(float *outputPCM, uint32_t sampleCount,
+								 uint16_t channelCount, uint32_t sampleRate,
+								 bool isSpeech, mumble_userid_t userID) {
+	uint64_t startNs = metrics_enabled() ? plat_now_ns() : 0;
+
+	bool modified = processSource(outputPCM, sampleCount, channelCount,
+								  sampleRate, isSpeech, userID);
+
+	if (startNs) {
+		metrics_recordAudio(METRICS_AUDIO_SOURCE, startNs, sampleCount,
+							sampleRate);
+	}
+	return modified;
+}
+
+bool mumble_onAudioOutputAboutToPlay(float *outputPCM, uint32_t sampleCount,
+									 uint16_t channelCount,
+									 uint32_t sampleRate) {
+	uint64_t startNs = metrics_enabled() ? plat_now_ns() : 0;
+
+	bool modified = hrtf_mix(outputPCM, sampleCount, channelCount);
+	modified |= cues_mix(outputPCM, sampleCount, channelCount, sampleRate);
+
+	if (startNs) {
+		metrics_recordAudio(METRICS_AUDIO_OUTPUT, startNs, sampleCount,
+							sampleRate);
+	}
+	return modified;
+}
+
+// Positional audio
+
+uint32_t mumble_getFeatures() {
+	return MUMBLE_FEATURE_POSITIONAL | MUMBLE_FEATURE_AUDIO;
+}
+
+// Whether the daemon behind the mapped ring still publishes. Fills in the
+// newest frame, if there is one.
+static bool daemonAlive(struct PosringFrame *frame) {
+	if (daemonRing.header->magic != POSRING_MAGIC) {
+		return false;
+	}
+	return posring_latest(&daemonRing, frame)
+		   && plat_now_ns() - frame->timestampNs < DAEMON_GONE_NS;
+}
+
+// Opens the daemon's ring, or opens it again after the daemon restarted or died
+static bool connectDaemon(void) {
+	struct PosringFrame frame;
+	if (daemonRing.header && !daemonAlive(&frame)) {
+		posring_close(&daemonRing);
+	}
+	if (!daemonRing.header && !posring_open(&daemonRing, daemonName)) {
+		return false;
+	}
+
+	// Only hand over to Mumble once the daemon found the game
+	return posring_latest(&daemonRing, &frame) && frame.valid
+		   && plat_now_ns() - frame.timestampNs < DAEMON_STALE_NS;
+}
+
+static void logImageBase(void) {
+	char logBuffer[128];
+	if (!wowProcess.imageFound) {
+		snprintf(logBuffer, sizeof(logBuffer),
+				 "%s not found in the process, assuming it is loaded at 0x%x",
+				 WOW_MODULE, WOW_IMAGE_BASE);
+	} else if (wowProcess.imageCached) {
+		snprintf(logBuffer, sizeof(logBuffer),
+				 "%s is loaded at 0x%llx (from the attach cache)", WOW_MODULE,
+				 (unsigned long long) wowProcess.imageBase);
+	} else if (wowProcess.imageBase != WOW_IMAGE_BASE) {
+		snprintf(logBuffer, sizeof(logBuffer),
+				 "%s is loaded at 0x%llx instead of 0x%x, moving the addresses",
+				 WOW_MODULE, (unsigned long long) wowProcess.imageBase,
+				 WOW_IMAGE_BASE);
+	} else {
+		return;
+	}
+	mumbleAPI.log(ownID, logBuffer);
 }
-#endif
 
 uint8_t mumble_initPositionalData(const char *const *programNames,
 								  const uint64_t *programPIDs,
 								  size_t programCount) {
 	char logBuffer[256];
+
+	if (useDaemon) {
+		if (!connectDaemon()) {
+			metrics_recordDiscovery(METRICS_DISCOVERY_NOT_FOUND);
+			return MUMBLE_PDEC_ERROR_TEMP; // try again later
+		}
+		metrics_recordDiscovery(METRICS_DISCOVERY_FOUND);
+		snprintf(logBuffer, sizeof(logBuffer),
+				 "Reading positions from the reader daemon (%s)", daemonName);
+		mumbleAPI.log(ownID, logBuffer);
+		return MUMBLE_PDEC_OK;
+	}
+
+	// Found and prepared in the background already, see discovery.h
+	if (discovery_take(&wowProcess, programPIDs, programCount)) {
+		discovery_setAttached(true);
+		sampler_attach(&wowProcess);
+		snprintf(logBuffer, sizeof(logBuffer),
+				 "Attached to the WoW process found in the background "
+				 "(PID: %llu)",
+				 (unsigned long long) wowProcess.pid);
+		mumbleAPI.log(ownID, logBuffer);
+		logImageBase();
+		metrics_recordDiscovery(METRICS_DISCOVERY_PREPARED);
+		return MUMBLE_PDEC_OK;
+	}
+
 #ifdef _WIN32
 	// Windows direct check
 	bool found = false;
 	for (size_t i = 0; i < programCount; i++) {
 		if (_stricmp(programNames[i], WOW_EXE) == 0) {
 			found = true;
-			pPid  = programPIDs[i]; // Store the process ID
+			wowreader_attach(&wowProcess, programPIDs[i]);
 			snprintf(logBuffer, sizeof(logBuffer),
 					 "Found direct WoW process: %s (PID: %llu)",
 					 programNames[i], (unsigned long long) programPIDs[i]);
@@ -226,9 +659,14 @@ uint8_t mumble_initPositionalData(const char *const *programNames,
 		}
 	}
 	if (!found) {
+		metrics_recordDiscovery(METRICS_DISCOVERY_NOT_FOUND);
 		return MUMBLE_PDEC_ERROR_TEMP; // try again later
 	}
 
+	discovery_setAttached(true);
+	sampler_attach(&wowProcess);
+	logImageBase();
+	metrics_recordDiscovery(METRICS_DISCOVERY_FOUND);
 	return MUMBLE_PDEC_OK;
 #else
 	// Linux/Wine check
@@ -238,6 +676,7 @@ uint8_t mumble_initPositionalData(const char *const *programNames,
 					  "ERROR: Detected only a small number of processes!");
 		mumbleAPI.log(ownID, "This usually indicates that Mumble lacks "
 							 "permission to read process information.");
+		metrics_recordDiscovery(METRICS_DISCOVERY_DENIED);
 		return MUMBLE_PDEC_ERROR_PERM;
 	}
 
@@ -247,7 +686,7 @@ uint8_t mumble_initPositionalData(const char *const *programNames,
 		// Check for direct match first (rare)
 		if (strcasecmp(programNames[i], WOW_EXE) == 0) {
 			found = true;
-			pPid  = programPIDs[i]; // Store the process ID
+			wowreader_attach(&wowProcess, programPIDs[i]);
 			snprintf(logBuffer, sizeof(logBuffer),
 					 "Found direct WoW process: %s (PID: %llu)",
 					 programNames[i], (unsigned long long) programPIDs[i]);
@@ -258,9 +697,9 @@ uint8_t mumble_initPositionalData(const char *const *programNames,
 		else if (strcasecmp(programNames[i], WINE_PRELOADER) == 0
 				 || strcasecmp(programNames[i], WINE_PROCESS) == 0) {
 			// Check if this Wine process is running WoW
-			if (isWineRunningWow(programPIDs[i])) {
+			if (wowreader_isWineRunningWow(programPIDs[i])) {
 				found = true;
-				pPid  = programPIDs[i]; // Store the process ID
+				wowreader_attach(&wowProcess, programPIDs[i]);
 				snprintf(logBuffer, sizeof(logBuffer),
 						 "Found WoW running under Wine: %s (PID: %llu)",
 						 programNames[i], (unsigned long long) programPIDs[i]);
@@ -270,120 +709,176 @@ uint8_t mumble_initPositionalData(const char *const *programNames,
 		}
 	}
 	if (!found) {
+		metrics_recordDiscovery(METRICS_DISCOVERY_NOT_FOUND);
 		return MUMBLE_PDEC_ERROR_TEMP; // try again later
 	}
 
+	discovery_setAttached(true);
+	sampler_attach(&wowProcess);
+	logImageBase();
+	metrics_recordDiscovery(METRICS_DISCOVERY_FOUND);
 	return MUMBLE_PDEC_OK;
 #endif
 }
 
 void mumble_shutdownPositionalData() {
-#ifdef _WIN32
-	if (hProcess != NULL) {
-		CloseHandle(hProcess);
-		hProcess = NULL;
-	}
-#endif
+	gamestate_reset();
+	inputgate_reset();
+	breaker_reset(&readBreaker);
+	sampler_detach();
+	lastSampleSequence = 0;
+	wowreader_detach(&wowProcess);
+	posring_close(&daemonRing);
+	discovery_setAttached(false);
 }
 
 #define SET_TO_ZERO(name) \
 	name[0] = 0.0f;       \
 	name[1] = 0.0f;       \
 	name[2] = 0.0f
-bool mumble_fetchPositionalData(float *avatarPos, float *avatarDir,
-								float *avatarAxis, float *cameraPos,
-								float *cameraDir, float *cameraAxis,
-								const char **context, const char **identity) {
-	// Memory addresses
-	procptr_t state_address          = (procptr_t) 0x00BD0792;
-	procptr_t avatar_pos_address     = (procptr_t) 0x00ADF4E4;
-	procptr_t avatar_heading_address = (procptr_t) 0x00BEBA70;
-	procptr_t camera_pos_address     = (procptr_t) 0x00ADF4E4;
-	procptr_t camera_front_address   = (procptr_t) 0x00ADF5F0;
-	procptr_t camera_top_address     = (procptr_t) 0x00ADF554;
-	procptr_t player_address         = (procptr_t) 0x00C79D18;
-	procptr_t mapid_address          = (procptr_t) 0x00AB63BC;
-	procptr_t leaderguid_address     = (procptr_t) 0x00BD1968;
-
-	// Temporary variables to hold data read from the game
-	char state                      = 0;
-	float avatar_pos_corrector[3]   = { 0.0f, 0.0f, 0.0f };
-	float camera_pos_corrector[3]   = { 0.0f, 0.0f, 0.0f };
-	float avatar_heading            = 0.0f;
-	float camera_front_corrector[3] = { 0.0f, 0.0f, 0.0f };
-	float camera_top_corrector[3]   = { 0.0f, 0.0f, 0.0f };
-	char player[50]                 = { 0 };
-	int mapId                       = 0;
-	int leaderGUID                  = 0;
+// What Mumble gets while the player is not in the world
+static bool notInWorld(float *avatarPos, float *avatarDir, float *avatarAxis,
+					   float *cameraPos, float *cameraDir, float *cameraAxis,
+					   const char **context, const char **identity) {
+	static const char emptyJson[] = "{}";
+
+	SET_TO_ZERO(avatarPos);
+	SET_TO_ZERO(avatarDir);
+	SET_TO_ZERO(avatarAxis);
+	SET_TO_ZERO(cameraPos);
+	SET_TO_ZERO(cameraDir);
+	SET_TO_ZERO(cameraAxis);
+	*context  = emptyJson;
+	*identity = emptyJson;
+
+	return true; // Return true to keep trying
+}
+#undef SET_TO_ZERO
 
+static bool fetchPositions(float *avatarPos, float *avatarDir,
+						   float *avatarAxis, float *cameraPos,
+						   float *cameraDir, float *cameraAxis,
+						   const char **context, const char **identity) {
 	// Static buffers for context and identity strings
 	static char context_buffer[256]  = { 0 };
 	static char identity_buffer[256] = { 0 };
 
-	// Reading values from game memory using peekProc
-	bool ok = peekProc(state_address, &state, 1)
-			  && peekProc(avatar_pos_address, avatar_pos_corrector, 12)
-			  && peekProc(avatar_heading_address, &avatar_heading, 4)
-			  && peekProc(camera_pos_address, camera_pos_corrector, 12)
-			  && peekProc(camera_front_address, camera_front_corrector, 12)
-			  && peekProc(camera_top_address, camera_top_corrector, 12)
-			  && peekProc(player_address, player, 50)
-			  && peekProc(mapid_address, &mapId, 4)
-			  && peekProc(leaderguid_address, &leaderGUID, 4);
+	struct GameSnapshot snapshot;
+	enum WowReadError error;
+	// Whether the frame was not handed out before; a sampler may not have
+	// read since the previous fetch
+	bool fresh = true;
+	if (useDaemon) {
+		// The daemon went away; Mumble calls mumble_initPositionalData again,
+		// which maps the ring afresh
+		struct PosringFrame frame;
+		if (!daemonAlive(&frame)) {
+			return false;
+		}
+		if (plat_now_ns() - frame.timestampNs < DAEMON_STALE_NS) {
+			error = wowreader_fromFrame(&frame, &snapshot);
+		} else {
+			memset(&snapshot, 0, sizeof(snapshot));
+			snapshot.timestampNs = plat_now_ns();
+			error                = WOW_READ_STALE;
+		}
+	} else if (sampler_mode() != SAMPLER_INLINE) {
+		// Read on the sampler's schedule; its breaker runs there
+		struct SamplerFrame frame;
+		if (!sampler_latest(&frame)) {
+			return notInWorld(avatarPos, avatarDir, avatarAxis, cameraPos,
+							  cameraDir, cameraAxis, context, identity);
+		}
+		snapshot           = frame.snapshot;
+		error              = frame.error;
+		fresh              = frame.sequence != lastSampleSequence;
+		lastSampleSequence = frame.sequence;
+		if (fresh && metrics_enabled()) {
+			metrics_recordBreaker(&frame.breaker);
+			if (error != WOW_READ_OK) {
+				metrics_recordFailedField(frame.failedField);
+			}
+		}
+	} else {
+		// While the circuit is open nothing is read and the previous frame,
+		// which failed, stands
+		uint64_t nowNs = plat_now_ns();
+		if (!breaker_allow(&readBreaker, nowNs)) {
+			return notInWorld(avatarPos, avatarDir, avatarAxis, cameraPos,
+							  cameraDir, cameraAxis, context, identity);
+		}
+		bool ok = wowreader_read(&wowProcess, &snapshot);
+		error   = wowProcess.lastError;
+		breaker_record(&readBreaker, ok, nowNs);
+		if (metrics_enabled()) {
+			metrics_recordBreaker(&readBreaker);
+			if (!ok) {
+				metrics_recordFailedField(wowProcess.failedField);
+			}
+		}
+	}
+	if (fresh && error != WOW_READ_OK && metrics_enabled()) {
+		metrics_recordReadFailure(error);
+	}
+	if (fresh && snapshot.missing != 0 && metrics_enabled()) {
+		metrics_recordMissingFields(snapshot.missing);
+	}
+
+	// Hand the raw frame to the event layer, which diffs it against the
+	// previous one
+	gamestate_update(&snapshot);
+	inputgate_onSnapshot(&snapshot);
+	if (exporting && fresh) {
+		struct PosringFrame frame;
+		wowreader_toFrame(&snapshot, error, &frame);
+		posring_publish(&exportRing, &frame);
+	}
 
 	// Reset all vectors if any read failed or not in game
-	if (!ok || state != 1) {
-		SET_TO_ZERO(avatarPos);
-		SET_TO_ZERO(avatarDir);
-		SET_TO_ZERO(avatarAxis);
-		SET_TO_ZERO(cameraPos);
-		SET_TO_ZERO(cameraDir);
-		SET_TO_ZERO(cameraAxis);
+	if (!gamestate_inWorld(&snapshot)) {
+		return notInWorld(avatarPos, avatarDir, avatarAxis, cameraPos,
+						  cameraDir, cameraAxis, context, identity);
+	}
 
-		// Clear context and identity when not in game
-		strcpy(context_buffer, "{}");
-		strcpy(identity_buffer, "{}");
-		*context  = context_buffer;
-		*identity = identity_buffer;
+	if (sampler_mode() == SAMPLER_INLINE) {
+		sampler_noteFrame(snapshot.timestampNs);
+	}
 
-		return true; // Return true to keep trying
+	if (atomic_load_explicit(&firstPositionNs, memory_order_relaxed) == 0) {
+		uint64_t elapsedNs = plat_now_ns() - loadedNs;
+		atomic_store_explicit(&firstPositionNs, elapsedNs,
+							  memory_order_relaxed);
+		metrics_recordFirstPosition(elapsedNs);
 	}
 
 	// Build context JSON
-	snprintf(context_buffer, sizeof(context_buffer), "{\n\"map\": %d\n}",
-			 mapId);
-	*context = context_buffer;
+	struct JsonWriter json;
+	json_begin(&json, context_buffer, sizeof(context_buffer));
+	json_addInt(&json, "map", snapshot.mapId);
+	*context = json_end(&json);
 
 	// Build identity JSON
-	// Ensure null-termination of player name
-	player[49] = '\0';
-
-	// Simple sanitize player name for JSON
-	for (int i = 0; player[i]; i++) {
-		if (player[i] == '"' || player[i] == '\\') {
-			player[i] = ' ';
-		}
-	}
-
-	snprintf(identity_buffer, sizeof(identity_buffer),
-			 "{\n\"char\": \"%s\",\n\"leaderguid\": %d\n}",
-			 player[0] ? player : "None", leaderGUID);
-	*identity = identity_buffer;
+	const char *player = snapshot.player[0] ? snapshot.player : "None";
+	json_begin(&json, identity_buffer, sizeof(identity_buffer));
+	json_addString(&json, "char", player,
+				   strnlen(player, sizeof(snapshot.player)));
+	json_addInt(&json, "leaderguid", snapshot.leaderGUID);
+	*identity = json_end(&json);
 
 	// Convert coordinates from WoW to Mumble coordinate system
 	// WoW -> Mumble: X=Z, Y=-X, Z=Y
-	avatarPos[0] = -avatar_pos_corrector[1];
-	avatarPos[1] = avatar_pos_corrector[2];
-	avatarPos[2] = avatar_pos_corrector[0];
+	avatarPos[0] = -snapshot.avatarPos[1];
+	avatarPos[1] = snapshot.avatarPos[2];
+	avatarPos[2] = snapshot.avatarPos[0];
 
-	cameraPos[0] = -camera_pos_corrector[1];
-	cameraPos[1] = camera_pos_corrector[2];
-	cameraPos[2] = camera_pos_corrector[0];
+	cameraPos[0] = -snapshot.cameraPos[1];
+	cameraPos[1] = snapshot.cameraPos[2];
+	cameraPos[2] = snapshot.cameraPos[0];
 
 	// Avatar direction from heading
-	avatarDir[0] = -sinf(avatar_heading);
+	avatarDir[0] = -sinf(snapshot.heading);
 	avatarDir[1] = 0.0f;
-	avatarDir[2] = cosf(avatar_heading);
+	avatarDir[2] = cosf(snapshot.heading);
 
 	// Avatar axis (up vector)
 	avatarAxis[0] = 0.0f;
@@ -391,52 +886,29 @@ bool mumble_fetchPositionalData(float *avatarPos, float *avatarDir,
 	avatarAxis[2] = 0.0f;
 
 	// Camera direction (use avatar heading)
-	cameraDir[0] = -sinf(avatar_heading);
+	cameraDir[0] = -sinf(snapshot.heading);
 	cameraDir[1] = 0.0f;
-	cameraDir[2] = cosf(avatar_heading);
+	cameraDir[2] = cosf(snapshot.heading);
 
 	// Camera axis (up vector)
-	cameraAxis[0] = -camera_top_corrector[1];
-	cameraAxis[1] = camera_top_corrector[2];
-	cameraAxis[2] = camera_top_corrector[0];
-
-	// Debug log every few calls
-	debugCallCounter++;
-	if (debugCallCounter % 32 == 0) {
-		char logBuffer[512];
-
-		snprintf(logBuffer, sizeof(logBuffer),
-				 "DEBUG Values - State: %d, MapID: %d, Player: %s", state,
-				 mapId, player);
-		mumbleAPI.log(ownID, logBuffer);
+	cameraAxis[0] = -snapshot.cameraTop[1];
+	cameraAxis[1] = snapshot.cameraTop[2];
+	cameraAxis[2] = snapshot.cameraTop[0];
 
-		snprintf(logBuffer, sizeof(logBuffer),
-				 "Avatar Pos: [%.2f, %.2f, %.2f] Dir: [%.2f, %.2f, %.2f] Axis: "
-				 "[%.2f, %.2f, %.2f]",
-				 avatarPos[0], avatarPos[1], avatarPos[2], avatarDir[0],
-				 avatarDir[1], avatarDir[2], avatarAxis[0], avatarAxis[1],
-				 avatarAxis[2]);
-		mumbleAPI.log(ownID, logBuffer);
-
-		snprintf(logBuffer, sizeof(logBuffer),
-				 "Camera Pos: [%.2f, %.2f, %.2f] Dir: [%.2f, %.2f, %.2f] Axis: "
-				 "[%.2f, %.2f, %.2f]",
-				 cameraPos[0], cameraPos[1], cameraPos[2], cameraDir[0],
-				 cameraDir[1], cameraDir[2], cameraAxis[0], cameraAxis[1],
-				 cameraAxis[2]);
-		mumbleAPI.log(ownID, logBuffer);
+	return true;
+}
 
-		snprintf(logBuffer, sizeof(logBuffer), "Context: %s", *context);
-		mumbleAPI.log(ownID, logBuffer);
+bool mumble_fetchPositionalData(float *avatarPos, float *avatarDir,
+								float *avatarAxis, float *cameraPos,
+								float *cameraDir, float *cameraAxis,
+								const char **context, const char **identity) {
+	uint64_t startNs = metrics_enabled() ? plat_now_ns() : 0;
 
-		snprintf(logBuffer, sizeof(logBuffer), "Identity: %s", *identity);
-		mumbleAPI.log(ownID, logBuffer);
+	bool keep = fetchPositions(avatarPos, avatarDir, avatarAxis, cameraPos,
+							   cameraDir, cameraAxis, context, identity);
 
-		snprintf(logBuffer, sizeof(logBuffer),
-				 "Raw memory - Avatar heading: %.2f", avatar_heading);
-		mumbleAPI.log(ownID, logBuffer);
+	if (startNs) {
+		metrics_recordFetch(plat_now_ns() - startNs);
 	}
-
-	return true;
+	return keep;
 }
-#undef SET_TO_ZERO
@@ -0,0 +1,12 @@
+#ifndef WOW335PA_PLUGIN_H_
+#define WOW335PA_PLUGIN_H_
+
+// Globals owned by plugin.c that the feature modules need to talk to Mumble
+
+#include "MumbleAPI_v_1_0_x.h"
+#include "PluginComponents_v_1_0_x.h"
+
+extern struct MumbleAPI_v_1_0_x mumbleAPI;
+extern mumble_plugin_id_t ownID;
+
+#endif // WOW335PA_PLUGIN_H_
@@ -0,0 +1,253 @@
+#include "posring.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+// A reader gives up on a slot the writer keeps rewriting after this many
+// attempts; at 100 frames per second that never happens in practice
+#define MAX_RETRIES 64
+#define MAX_NAME 128
+
+_Static_assert(sizeof(struct PosringHeader) == 64, "header layout changed");
+_Static_assert(sizeof(struct PosringFrame) == 184, "frame layout changed");
+_Static_assert(sizeof(struct PosringSlot) == 192, "slot layout changed");
+
+static size_t layoutSize(uint32_t slotCount) {
+	return sizeof(struct PosringHeader)
+		   + (size_t) slotCount * sizeof(struct PosringSlot);
+}
+
+#ifdef _WIN32
+// Named mappings live in the session namespace, without the leading slash
+static void mappingName(char *out, size_t size, const char *name) {
+	snprintf(out, size, "Local\\%s", name[0] == '/' ? name + 1 : name);
+}
+#endif
+
+static void *mapShared(const char *name, size_t size, bool create,
+					   void **handle) {
+#ifdef _WIN32
+	char mapping[MAX_NAME];
+	mappingName(mapping, sizeof(mapping), name);
+	HANDLE object =
+		create ? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+									0, (DWORD) size, mapping)
+			   : OpenFileMappingA(FILE_MAP_READ, FALSE, mapping);
+	if (object == NULL) {
+		return NULL;
+	}
+	void *data =
+		MapViewOfFile(object, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0,
+					  create ? size : 0);
+	if (data == NULL) {
+		CloseHandle(object);
+		return NULL;
+	}
+	// The mapping goes away with its last handle, so the writer keeps it
+	*handle = object;
+	return data;
+#else
+	(void) handle;
+	int fd = create ? shm_open(name, O_CREAT | O_RDWR, 0600)
+					: shm_open(name, O_RDONLY, 0);
+	if (fd < 0) {
+		return NULL;
+	}
+	if (create && ftruncate(fd, (off_t) size) != 0) {
+		close(fd);
+		return NULL;
+	}
+	void *data = mmap(NULL, size, create ? PROT_READ | PROT_WRITE : PROT_READ,
+					  MAP_SHARED, fd, 0);
+	close(fd);
+	return data == MAP_FAILED ? NULL : data;
+#endif
+}
+
+static void unmapShared(struct Posring *ring) {
+#ifdef _WIN32
+	UnmapViewOfFile(ring->header);
+	if (ring->handle) {
+		CloseHandle(ring->handle);
+	}
+#else
+	munmap(ring->header, ring->size);
+#endif
+	ring->header = NULL;
+	ring->handle = NULL;
+}
+
+bool posring_create(struct Posring *ring, const char *name) {
+	size_t size  = layoutSize(POSRING_SLOTS);
+	ring->handle = NULL;
+	void *data   = mapShared(name, size, true, &ring->handle);
+	if (!data) {
+		return false;
+	}
+
+	// Readers check the magic last, so it goes in after everything else
+	memset(data, 0, size);
+	ring->header            = data;
+	ring->slots             = (struct PosringSlot *) (ring->header + 1);
+	ring->size              = size;
+	ring->owner             = true;
+	ring->name              = name;
+	ring->cursor            = 0;
+	ring->header->version   = POSRING_VERSION;
+	ring->header->slotCount = POSRING_SLOTS;
+	ring->header->frameSize = sizeof(struct PosringFrame);
+	atomic_thread_fence(memory_order_release);
+	ring->header->magic = POSRING_MAGIC;
+
+	return true;
+}
+
+void posring_destroy(struct Posring *ring) {
+	if (!ring->header) {
+		return;
+	}
+	ring->header->magic = 0;
+	unmapShared(ring);
+#ifndef _WIN32
+	shm_unlink(ring->name);
+#endif
+}
+
+void posring_publish(struct Posring *ring, struct PosringFrame *frame) {
+	uint64_t head =
+		atomic_load_explicit(&ring->header->head, memory_order_relaxed);
+	struct PosringSlot *slot = &ring->slots[head & (POSRING_SLOTS - 1)];
+	frame->sequence          = head + 1;
+
+	// Odd while the frame is being written
+	uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+	atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	memcpy(&slot->frame, frame, sizeof(*frame));
+	atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+
+	atomic_store_explicit(&ring->header->head, head + 1, memory_order_release);
+}
+
+bool posring_open(struct Posring *ring, const char *name) {
+	// Map the header first to learn the real size
+	ring->handle = NULL;
+	struct PosringHeader *header =
+		mapShared(name, sizeof(struct PosringHeader), false, &ring->handle);
+	if (!header) {
+		return false;
+	}
+	bool compatible = header->magic == POSRING_MAGIC
+					  && header->version == POSRING_VERSION
+					  && header->frameSize == sizeof(struct PosringFrame)
+					  && header->slotCount > 0
+					  && (header->slotCount & (header->slotCount - 1)) == 0;
+	uint32_t slotCount = header->slotCount;
+	ring->header       = header;
+	ring->size         = sizeof(struct PosringHeader);
+	unmapShared(ring);
+	if (!compatible) {
+		return false;
+	}
+
+	size_t size = layoutSize(slotCount);
+	void *data  = mapShared(name, size, false, &ring->handle);
+	if (!data) {
+		return false;
+	}
+	ring->header = data;
+	ring->slots  = (struct PosringSlot *) (ring->header + 1);
+	ring->size   = size;
+	ring->owner  = false;
+	ring->name   = name;
+	ring->cursor =
+		atomic_load_explicit(&ring->header->head, memory_order_acquire);
+
+	return true;
+}
+
+void posring_close(struct Posring *ring) {
+	if (ring->header) {
+		unmapShared(ring);
+	}
+}
+
+static bool readSlot(const struct PosringSlot *slot,
+					 struct PosringFrame *frame) {
+	for (int attempt = 0; attempt < MAX_RETRIES; attempt++) {
+		uint32_t before =
+			atomic_load_explicit(&slot->seq, memory_order_acquire);
+		if (before & 1) {
+			continue;
+		}
+		memcpy(frame, (const void *) &slot->frame, sizeof(*frame));
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&slot->seq, memory_order_relaxed)
+			== before) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool posring_latest(const struct Posring *ring, struct PosringFrame *frame) {
+	uint64_t head =
+		atomic_load_explicit(&ring->header->head, memory_order_acquire);
+	if (head == 0) {
+		return false;
+	}
+	uint32_t mask = ring->header->slotCount - 1;
+	return readSlot(&ring->slots[(head - 1) & mask], frame);
+}
+
+bool posring_next(struct Posring *ring, struct PosringFrame *frame,
+				  uint64_t *lost) {
+	uint32_t slotCount = ring->header->slotCount;
+	uint64_t skipped   = 0;
+
+	for (;;) {
+		uint64_t head =
+			atomic_load_explicit(&ring->header->head, memory_order_acquire);
+		if (ring->cursor >= head) {
+			break;
+		}
+		if (head - ring->cursor > slotCount) {
+			skipped += head - slotCount - ring->cursor;
+			ring->cursor = head - slotCount;
+		}
+
+		if (!readSlot(&ring->slots[ring->cursor & (slotCount - 1)], frame)) {
+			break;
+		}
+		// Overwritten after head was read: the writer lapped us
+		if (frame->sequence > ring->cursor + 1) {
+			skipped += frame->sequence - slotCount - ring->cursor;
+			ring->cursor = frame->sequence - slotCount;
+			continue;
+		}
+		// The writer started over
+		if (frame->sequence != ring->cursor + 1) {
+			break;
+		}
+
+		ring->cursor++;
+		if (lost) {
+			*lost = skipped;
+		}
+		return true;
+	}
+
+	if (lost) {
+		*lost = skipped;
+	}
+	return false;
+}
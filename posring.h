@@ -0,0 +1,106 @@
+#ifndef WOW335PA_POSRING_H_
+#define WOW335PA_POSRING_H_
+
+// Shared-memory ring of positional frames, so local tools (overlays, stream
+// widgets, loggers) can follow the game without reading its memory. One
+// process writes, any number of processes read by mapping the same POSIX
+// shared-memory object.
+//
+// The layout is fixed and versioned: a header followed by POSRING_SLOTS
+// slots. Every slot is guarded by its own seqlock (odd while being written),
+// so readers never block the writer and a torn frame is simply read again.
+// Readers compare magic, version and frameSize before trusting the layout.
+//
+// This file and posring.c are the whole reader library; see
+// bench/posring_bench.c for a consumer.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define POSRING_DEFAULT_NAME "/wow335pa"
+#define POSRING_MAGIC 0x52503357u // "W3PR"
+#define POSRING_VERSION 1u
+// Power of two
+#define POSRING_SLOTS 64u
+
+// One frame as read from the client. Positions and vectors are in WoW
+// coordinates (x north, y west, z up).
+struct PosringFrame {
+	// CLOCK_MONOTONIC of the read, in nanoseconds
+	uint64_t timestampNs;
+	// Number of the frame, counting from 1
+	uint64_t sequence;
+	// All reads succeeded
+	uint8_t valid;
+	// 1 while in the world
+	uint8_t state;
+	uint8_t playerClass;
+	// Why the read failed (enum WowReadError in wowreader.h), 0 if it did not
+	uint8_t error;
+	int32_t mapId;
+	int32_t zoneId;
+	int32_t leaderGUID;
+	float avatarPos[3];
+	float heading;
+	float cameraPos[3];
+	float cameraFront[3];
+	float cameraTop[3];
+	// Non-zero while the player is a ghost
+	float corpsePos[3];
+	// UTF-8, NUL-terminated
+	char player[52];
+	// Optional fields that could not be read (GAME_MISSING_* in gamestate.h)
+	uint8_t missing;
+	uint8_t reserved1[35];
+};
+
+// Three cache lines per slot
+struct PosringSlot {
+	_Atomic uint32_t seq;
+	uint32_t reserved;
+	struct PosringFrame frame;
+};
+
+struct PosringHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slotCount;
+	uint32_t frameSize;
+	// Frames published so far; the newest is in slot (head - 1) % slotCount
+	_Atomic uint64_t head;
+	uint8_t reserved[40];
+};
+
+struct Posring {
+	struct PosringHeader *header;
+	struct PosringSlot *slots;
+	size_t size;
+	bool owner;
+	const char *name;
+	// Mapping handle on Windows, where the writer has to keep it open
+	void *handle;
+	// Reader position for posring_next
+	uint64_t cursor;
+};
+
+// Writer. Creates (or takes over) the shared-memory object; posring_destroy
+// unlinks it again.
+bool posring_create(struct Posring *ring, const char *name);
+void posring_destroy(struct Posring *ring);
+// Never blocks or allocates; fills in frame->sequence
+void posring_publish(struct Posring *ring, struct PosringFrame *frame);
+
+// Reader
+bool posring_open(struct Posring *ring, const char *name);
+void posring_close(struct Posring *ring);
+// Copies the newest frame; false if nothing was published yet
+bool posring_latest(const struct Posring *ring, struct PosringFrame *frame);
+// Copies the frame after the last one returned, in order. Returns false when
+// the reader caught up. If the writer lapped the reader, the oldest frame
+// still in the ring is returned and *lost (if given) counts the skipped ones.
+bool posring_next(struct Posring *ring, struct PosringFrame *frame,
+				  uint64_t *lost);
+
+#endif // WOW335PA_POSRING_H_
@@ -0,0 +1,316 @@
+#include "proximity.h"
+
+#include "config.h"
+#include "events.h"
+#include "gamestate.h"
+#include "mainthread.h"
+#include "peers.h"
+#include "platform.h"
+#include "plugin.h"
+#include "roster.h"
+#include "spatial.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+static struct SpatialIndex peerIndex;
+static bool cullEnabled;
+static float cullRadius;
+static bool muteEnabled;
+static float muteRadius;
+static float unmuteRadius;
+static uint64_t muteDwellNs;
+static bool publishPositions;
+
+// Dispatcher thread state, indexed by peer table slot
+static struct PeerState peers[PEERS_MAX];
+static bool used[PEERS_MAX];
+static mumble_userid_t slotUser[PEERS_MAX];
+static bool inCullRange[PEERS_MAX];
+static bool inMuteRange[PEERS_MAX];
+static bool inUnmuteRange[PEERS_MAX];
+static uint64_t farSinceNs[PEERS_MAX];
+static uint32_t rangeResults[PEERS_MAX];
+
+// Local mutes set by us, indexed by peer table slot. Set and lifted on the
+// main thread, by the tasks the dispatcher queues (mainthread.h) and when the
+// server goes away, and read by the dispatcher, hence the lock. The lock only
+// guards the records and is never held across a Mumble API call.
+struct Mute {
+	bool active;
+	mumble_connection_t connection;
+	mumble_userid_t user;
+};
+
+static struct Mute mutes[PEERS_MAX];
+static plat_mutex_t muteLock = PLAT_MUTEX_INITIALIZER;
+
+// What a queued task mutes or unmutes
+struct MuteRequest {
+	uint32_t slot;
+	mumble_userid_t user;
+};
+
+// Tasks queued per slot and not run yet. The dispatcher decides nothing for a
+// slot while its mute state is about to change.
+static atomic_uint pending[PEERS_MAX];
+
+static void setCulled(mumble_userid_t userID, bool culled) {
+	struct RosterUser *user = roster_find(userID);
+	if (user) {
+		atomic_store_explicit(&user->culled, culled, memory_order_relaxed);
+	}
+}
+
+static void setPosition(mumble_userid_t userID, uint64_t position,
+						bool ghost) {
+	struct RosterUser *user = roster_find(userID);
+	if (user) {
+		atomic_store_explicit(&user->position, position, memory_order_relaxed);
+		atomic_store_explicit(&user->ghost, ghost, memory_order_relaxed);
+	}
+}
+
+static bool isMuted(uint32_t slot) {
+	plat_mutex_lock(&muteLock);
+	bool active = mutes[slot].active;
+	plat_mutex_unlock(&muteLock);
+	return active;
+}
+
+static void mute(uint32_t slot, mumble_userid_t userID) {
+	mumble_connection_t connection = roster_connection();
+	bool muted;
+
+	// Never take over users that were muted by hand
+	if (connection < 0
+		|| mumbleAPI.isUserLocallyMuted(ownID, connection, userID, &muted)
+			   != MUMBLE_STATUS_OK
+		|| muted
+		|| mumbleAPI.requestLocalMute(ownID, connection, userID, true)
+			   != MUMBLE_STATUS_OK) {
+		return;
+	}
+
+	plat_mutex_lock(&muteLock);
+	mutes[slot].active     = true;
+	mutes[slot].connection = connection;
+	mutes[slot].user       = userID;
+	plat_mutex_unlock(&muteLock);
+}
+
+// Lifts a mute set by us; false if Mumble refused and it is worth trying
+// again. The user or connection being gone, or somebody having unmuted them by
+// hand already, counts as lifted.
+static bool liftMute(const struct Mute *record) {
+	bool muted;
+	mumble_error_t status = mumbleAPI.isUserLocallyMuted(
+		ownID, record->connection, record->user, &muted);
+	if (status == MUMBLE_STATUS_OK && muted) {
+		status = mumbleAPI.requestLocalMute(ownID, record->connection,
+											record->user, false);
+	}
+	return status == MUMBLE_STATUS_OK || status == MUMBLE_EC_USER_NOT_FOUND
+		   || status == MUMBLE_EC_CONNECTION_NOT_FOUND;
+}
+
+// Lifts our mute on the slot's user, on the connection it was set on. The
+// record is kept if Mumble refuses, so the next attempt tries again.
+static void unmute(uint32_t slot) {
+	plat_mutex_lock(&muteLock);
+	struct Mute record = mutes[slot];
+	plat_mutex_unlock(&muteLock);
+
+	if (record.active && liftMute(&record)) {
+		plat_mutex_lock(&muteLock);
+		mutes[slot].active = false;
+		plat_mutex_unlock(&muteLock);
+	}
+}
+
+// Main thread tasks
+static void runMute(const void *data, size_t size) {
+	(void) size;
+	struct MuteRequest request;
+	memcpy(&request, data, sizeof(request));
+	mute(request.slot, request.user);
+	atomic_fetch_sub(&pending[request.slot], 1);
+}
+
+static void runUnmute(const void *data, size_t size) {
+	(void) size;
+	struct MuteRequest request;
+	memcpy(&request, data, sizeof(request));
+	unmute(request.slot);
+	atomic_fetch_sub(&pending[request.slot], 1);
+}
+
+// Dispatcher thread. Nothing happens if the queue is full; the next tick
+// decides again.
+static void queueTask(main_task task, uint32_t slot, mumble_userid_t user) {
+	struct MuteRequest request = { slot, user };
+	atomic_fetch_add(&pending[slot], 1);
+	if (!mainthread_post(task, &request, sizeof(request))) {
+		atomic_fetch_sub(&pending[slot], 1);
+	}
+}
+
+static bool isPending(uint32_t slot) {
+	return atomic_load(&pending[slot]) != 0;
+}
+
+// Drops the records of all mutes on connection, or on every connection if it
+// is negative, and lifts them without holding the lock. Main thread.
+static void liftAll(mumble_connection_t connection) {
+	static struct Mute lifted[PEERS_MAX];
+	size_t count = 0;
+
+	plat_mutex_lock(&muteLock);
+	for (uint32_t i = 0; i < PEERS_MAX; i++) {
+		if (mutes[i].active
+			&& (connection < 0 || mutes[i].connection == connection)) {
+			lifted[count++] = mutes[i];
+			mutes[i].active = false;
+		}
+	}
+	plat_mutex_unlock(&muteLock);
+
+	for (size_t i = 0; i < count; i++) {
+		liftMute(&lifted[i]);
+	}
+}
+
+static void markRange(bool *flags, const struct GameSnapshot *self,
+					  float radius) {
+	memset(flags, 0, sizeof(bool) * PEERS_MAX);
+	size_t count = spatial_queryRange(&peerIndex, self->mapId, self->avatarPos,
+									  radius, rangeResults, PEERS_MAX);
+	for (size_t i = 0; i < count; i++) {
+		flags[rangeResults[i]] = true;
+	}
+}
+
+static void updateMute(uint32_t slot, bool selfInWorld, uint64_t nowNs) {
+	// Decide only while both sides know where they are; loading screens keep
+	// whatever was decided before
+	if (!selfInWorld || !(peers[slot].flags & PEER_FLAG_IN_WORLD)) {
+		return;
+	}
+
+	// A peer on another map is outside of every range
+	if (!inMuteRange[slot]) {
+		if (farSinceNs[slot] == 0) {
+			farSinceNs[slot] = nowNs;
+		} else if (nowNs - farSinceNs[slot] >= muteDwellNs
+				   && !isPending(slot) && !isMuted(slot)) {
+			queueTask(runMute, slot, peers[slot].user);
+		}
+		return;
+	}
+
+	farSinceNs[slot] = 0;
+	if (inUnmuteRange[slot] && !isPending(slot) && isMuted(slot)) {
+		queueTask(runUnmute, slot, peers[slot].user);
+	}
+}
+
+static void onTick(uint64_t nowNs, void *userdata) {
+	(void) userdata;
+
+	for (uint32_t i = 0; i < PEERS_MAX; i++) {
+		used[i] = peers_read(i, &peers[i]);
+		if (used[i] && (peers[i].flags & PEER_FLAG_IN_WORLD)) {
+			spatial_update(&peerIndex, i, peers[i].mapId, peers[i].position);
+		} else {
+			spatial_remove(&peerIndex, i);
+		}
+
+		// The slot was handed to somebody else: undo what we did to the old
+		// user
+		if (slotUser[i] != ROSTER_NO_USER
+			&& (!used[i] || peers[i].user != slotUser[i])) {
+			setCulled(slotUser[i], false);
+			setPosition(slotUser[i], 0, false);
+			// After a mute of the old user that may still be queued
+			if (isPending(i) || isMuted(i)) {
+				queueTask(runUnmute, i, slotUser[i]);
+			}
+			farSinceNs[i] = 0;
+			slotUser[i]   = ROSTER_NO_USER;
+		}
+	}
+
+	struct GameSnapshot self;
+	bool selfInWorld = gamestate_latest(&self) && gamestate_inWorld(&self);
+
+	if (selfInWorld) {
+		if (cullEnabled) {
+			markRange(inCullRange, &self, cullRadius);
+		}
+		if (muteEnabled) {
+			markRange(inMuteRange, &self, muteRadius);
+			markRange(inUnmuteRange, &self, unmuteRadius);
+		}
+	}
+
+	for (uint32_t i = 0; i < PEERS_MAX; i++) {
+		if (!used[i]) {
+			continue;
+		}
+		slotUser[i] = peers[i].user;
+
+		if (cullEnabled) {
+			// Only cull when both sides know where they are. A peer on
+			// another map is never in range.
+			bool culled = selfInWorld && (peers[i].flags & PEER_FLAG_IN_WORLD)
+						  && !inCullRange[i];
+			setCulled(peers[i].user, culled);
+		}
+		if (muteEnabled) {
+			updateMute(i, selfInWorld, nowNs);
+		}
+		if (publishPositions) {
+			// Only positions on our own map mean anything to the listener
+			bool audible = selfInWorld && (peers[i].flags & PEER_FLAG_IN_WORLD)
+						   && peers[i].mapId == self.mapId;
+			setPosition(peers[i].user,
+						audible ? roster_packPosition(peers[i].position) : 0,
+						(peers[i].flags & PEER_FLAG_GHOST) != 0);
+		}
+	}
+}
+
+void proximity_init(void) {
+	cullEnabled  = config_getBool("cull.enabled", false);
+	cullRadius   = config_getFloat("cull.radius", 80.0f);
+	muteEnabled  = config_getBool("mute.enabled", false);
+	muteRadius   = config_getFloat("mute.radius", 250.0f);
+	unmuteRadius = muteRadius - config_getFloat("mute.hysteresis", 50.0f);
+	muteDwellNs =
+		(uint64_t) config_getInt("mute.dwell_ms", 5000) * 1000000ull;
+	publishPositions = config_getBool("hrtf.enabled", false)
+					   || config_getBool("fx.enabled", false);
+
+	spatial_init(&peerIndex, cullEnabled ? cullRadius : muteRadius);
+	for (uint32_t i = 0; i < PEERS_MAX; i++) {
+		slotUser[i]     = ROSTER_NO_USER;
+		farSinceNs[i]   = 0;
+		mutes[i].active = false;
+		atomic_store(&pending[i], 0);
+	}
+
+	if (cullEnabled || muteEnabled || publishPositions) {
+		events_subscribeTick(onTick, NULL);
+	}
+}
+
+void proximity_onServerDisconnected(mumble_connection_t connection) {
+	// The users go away with the connection, so whatever Mumble answers there
+	// is nothing left to retry
+	liftAll(connection);
+}
+
+void proximity_shutdown(void) {
+	// Local mutes outlive the plugin, so hand back everyone we muted
+	liftAll(-1);
+}
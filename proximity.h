@@ -0,0 +1,36 @@
+#ifndef WOW335PA_PROXIMITY_H_
+#define WOW335PA_PROXIMITY_H_
+
+// Keeps a spatial index of the peers' in-game positions (see peers.h) and
+// turns it into per-user flags in the roster, so the audio callbacks only need
+// one lookup per source. Runs on the dispatcher tick. Configuration:
+//   cull.enabled    = false
+//   cull.radius     = 80      (yards)
+//
+// Peers that stay beyond mute.radius (or on another map) for mute.dwell_ms are
+// locally muted through Mumble, so their audio is not even decoded. They are
+// unmuted once they come closer than mute.radius - mute.hysteresis. Users that
+// were already muted by hand are left alone.
+//   mute.enabled    = false
+//   mute.radius     = 250     (yards)
+//   mute.hysteresis = 50      (yards)
+//   mute.dwell_ms   = 5000
+//
+// With hrtf.enabled or fx.enabled the peers' positions on our map are also
+// published in the roster for the audio thread (hrtf.h, voicefx.h).
+
+#include "PluginComponents_v_1_0_x.h"
+
+// Reads the config and subscribes to the dispatcher tick. Call before
+// events_start().
+void proximity_init(void);
+
+// Lifts the local mutes set by us on that connection. Call from
+// mumble_onServerDisconnected before the roster is cleared.
+void proximity_onServerDisconnected(mumble_connection_t connection);
+
+// Lifts the local mutes set by us, which Mumble would otherwise keep. Call
+// after events_stop().
+void proximity_shutdown(void);
+
+#endif // WOW335PA_PROXIMITY_H_
@@ -0,0 +1,434 @@
+#include "roster.h"
+
+#include "platform.h"
+#include "plugin.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// User ID -> slot index. Readers probe without locking, so entries are never
+// moved while a reader could be probing: removals leave a tombstone that later
+// inserts reuse, and once tombstones make up a quarter of the table it is
+// rehashed in place under indexGeneration. Key and slot are packed into one
+// word so a reader never sees a half-written entry.
+#define INDEX_CAPACITY 8192 // power of two, 2x ROSTER_MAX_USERS
+#define INDEX_EMPTY 0xFFFFFFFFFFFFFFFFull
+#define INDEX_TOMBSTONE 0xFFFFFFFEFFFFFFFFull
+#define INDEX_MAX_TOMBSTONES (INDEX_CAPACITY / 4)
+
+// Interned strings (names and hashes). When the table passes three quarters
+// or an arena is full, the strings of the current users are copied into the
+// other arena and the table is rebuilt from them. The old arena is only
+// overwritten by the compaction after that, so a pointer a reader just loaded
+// stays valid.
+#define ARENA_SIZE (512 * 1024)
+#define INTERN_CAPACITY 16384 // power of two
+#define INTERN_MAX_COUNT (INTERN_CAPACITY / 4 * 3)
+
+static struct RosterUser users[ROSTER_MAX_USERS];
+static _Atomic uint64_t userIndex[INDEX_CAPACITY];
+// Odd while the index is being rehashed
+static atomic_uint indexGeneration = 0;
+static uint32_t tombstoneCount     = 0;
+static uint32_t freeSlots[ROSTER_MAX_USERS];
+static uint32_t freeSlotCount = 0;
+
+static char arenas[2][ARENA_SIZE];
+static int arenaCurrent     = 0;
+static size_t arenaUsed     = 0;
+static uint32_t internCount = 0;
+static const char *interned[INTERN_CAPACITY];
+
+static plat_mutex_t writeLock                     = PLAT_MUTEX_INITIALIZER;
+static _Atomic mumble_connection_t mirroredServer = -1;
+static _Atomic mumble_userid_t localUser          = ROSTER_NO_USER;
+
+static inline uint32_t indexSlot(mumble_userid_t userID) {
+	return (uint32_t) ((userID * 2654435769u) & (INDEX_CAPACITY - 1));
+}
+
+static inline uint32_t entryKey(uint64_t entry) {
+	return (uint32_t) (entry >> 32);
+}
+
+static uint32_t hashString(const char *str) {
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (const unsigned char *c = (const unsigned char *) str; *c; c++) {
+		hash = (hash ^ *c) * 16777619u;
+	}
+	return hash;
+}
+
+// Looks str up in the table, adding it to the current arena if it is new.
+// NULL if the table or the arena is full.
+static const char *internOnce(const char *str) {
+	if (internCount >= INTERN_MAX_COUNT) {
+		return NULL;
+	}
+
+	uint32_t mask = INTERN_CAPACITY - 1;
+	uint32_t i    = hashString(str) & mask;
+	// Below the maximum load there is always an empty slot to stop at
+	for (uint32_t probes = 0; probes < INTERN_CAPACITY;
+		 probes++, i = (i + 1) & mask) {
+		if (!interned[i]) {
+			size_t length = strlen(str) + 1;
+			if (arenaUsed + length > ARENA_SIZE) {
+				return NULL;
+			}
+			char *copy = arenas[arenaCurrent] + arenaUsed;
+			memcpy(copy, str, length);
+			arenaUsed += length;
+			interned[i] = copy;
+			internCount++;
+			return copy;
+		}
+		if (strcmp(interned[i], str) == 0) {
+			return interned[i];
+		}
+	}
+	return NULL;
+}
+
+// Moves the strings of the current users into the other arena
+static void compactStringsLocked(void) {
+	memset(interned, 0, sizeof(interned));
+	internCount  = 0;
+	arenaUsed    = 0;
+	arenaCurrent = 1 - arenaCurrent;
+
+	for (uint32_t i = 0; i < ROSTER_MAX_USERS; i++) {
+		struct RosterUser *user = &users[i];
+		if (atomic_load(&user->id) == ROSTER_NO_USER) {
+			continue;
+		}
+		const char *name = atomic_load(&user->name);
+		const char *hash = atomic_load(&user->hash);
+		atomic_store(&user->name, name ? internOnce(name) : NULL);
+		atomic_store(&user->hash, hash ? internOnce(hash) : NULL);
+	}
+}
+
+static const char *intern(const char *str) {
+	if (!str) {
+		return NULL;
+	}
+
+	const char *copy = internOnce(str);
+	if (!copy) {
+		compactStringsLocked();
+		copy = internOnce(str);
+	}
+	if (!copy) {
+		mumbleAPI.log(ownID, "ERROR: Out of space for user names");
+	}
+	return copy;
+}
+
+static void resetLocked(void) {
+	for (uint32_t i = 0; i < INDEX_CAPACITY; i++) {
+		atomic_store(&userIndex[i], INDEX_EMPTY);
+	}
+	for (uint32_t i = 0; i < ROSTER_MAX_USERS; i++) {
+		atomic_store(&users[i].id, ROSTER_NO_USER);
+		atomic_store(&users[i].name, NULL);
+		atomic_store(&users[i].hash, NULL);
+		freeSlots[i] = ROSTER_MAX_USERS - 1 - i;
+	}
+	freeSlotCount = ROSTER_MAX_USERS;
+
+	memset(interned, 0, sizeof(interned));
+	internCount    = 0;
+	arenaUsed      = 0;
+	tombstoneCount = 0;
+
+	atomic_store(&mirroredServer, -1);
+	atomic_store(&localUser, ROSTER_NO_USER);
+}
+
+static struct RosterUser *probeIndex(mumble_userid_t userID) {
+	uint32_t mask = INDEX_CAPACITY - 1;
+	for (uint32_t i = indexSlot(userID), probes = 0; probes < INDEX_CAPACITY;
+		 i = (i + 1) & mask, probes++) {
+		uint64_t entry =
+			atomic_load_explicit(&userIndex[i], memory_order_acquire);
+		if (entry == INDEX_EMPTY) {
+			return NULL;
+		}
+		if (entryKey(entry) == userID && entry != INDEX_TOMBSTONE) {
+			return &users[(uint32_t) entry];
+		}
+	}
+	return NULL;
+}
+
+struct RosterUser *roster_find(mumble_userid_t userID) {
+	if (atomic_load_explicit(&mirroredServer, memory_order_relaxed) < 0) {
+		return NULL;
+	}
+
+	unsigned generation =
+		atomic_load_explicit(&indexGeneration, memory_order_acquire);
+	struct RosterUser *user = NULL;
+	if (!(generation & 1)) {
+		user = probeIndex(userID);
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&indexGeneration, memory_order_relaxed)
+			== generation) {
+			return user;
+		}
+	}
+
+	// The index is being rehashed: scan the slots instead, which only
+	// happens for the few lookups that overlap a rehash
+	for (uint32_t i = 0; i < ROSTER_MAX_USERS; i++) {
+		if (atomic_load_explicit(&users[i].id, memory_order_acquire)
+			== userID) {
+			return &users[i];
+		}
+	}
+	return NULL;
+}
+
+struct RosterUser *roster_at(size_t index) {
+	return index < ROSTER_MAX_USERS ? &users[index] : NULL;
+}
+
+size_t roster_slot(const struct RosterUser *user) {
+	return (size_t) (user - users);
+}
+
+mumble_connection_t roster_connection(void) {
+	return atomic_load(&mirroredServer);
+}
+
+mumble_userid_t roster_localUser(void) {
+	return atomic_load(&localUser);
+}
+
+static struct RosterUser *insertLocked(mumble_userid_t userID) {
+	struct RosterUser *existing = probeIndex(userID);
+	if (existing) {
+		return existing;
+	}
+	if (freeSlotCount == 0) {
+		return NULL;
+	}
+
+	uint32_t mask = INDEX_CAPACITY - 1;
+	for (uint32_t i = indexSlot(userID), probes = 0; probes < INDEX_CAPACITY;
+		 i = (i + 1) & mask, probes++) {
+		uint64_t entry = atomic_load(&userIndex[i]);
+		if (entry == INDEX_EMPTY || entry == INDEX_TOMBSTONE) {
+			if (entry == INDEX_TOMBSTONE) {
+				tombstoneCount--;
+			}
+			uint32_t slot           = freeSlots[--freeSlotCount];
+			struct RosterUser *user = &users[slot];
+			atomic_store(&user->channel, -1);
+			atomic_store(&user->talkingState, MUMBLE_TS_PASSIVE);
+			atomic_store(&user->name, NULL);
+			atomic_store(&user->hash, NULL);
+			atomic_store(&user->culled, false);
+			atomic_store(&user->position, 0);
+			atomic_store(&user->ghost, false);
+			atomic_store(&user->id, userID);
+			// Publish only once the slot is fully initialised
+			atomic_store_explicit(&userIndex[i],
+								  ((uint64_t) userID << 32) | slot,
+								  memory_order_release);
+			return user;
+		}
+	}
+	return NULL;
+}
+
+// Rebuilds the index without tombstones. Lookups running meanwhile see an odd
+// generation, or a changed one, and fall back to scanning the slots.
+static void rehashLocked(void) {
+	static uint64_t live[ROSTER_MAX_USERS];
+	uint32_t liveCount = 0;
+	for (uint32_t i = 0; i < INDEX_CAPACITY; i++) {
+		uint64_t entry = atomic_load(&userIndex[i]);
+		if (entry != INDEX_EMPTY && entry != INDEX_TOMBSTONE) {
+			live[liveCount++] = entry;
+		}
+	}
+
+	atomic_fetch_add_explicit(&indexGeneration, 1, memory_order_acq_rel);
+	atomic_thread_fence(memory_order_release);
+	for (uint32_t i = 0; i < INDEX_CAPACITY; i++) {
+		atomic_store_explicit(&userIndex[i], INDEX_EMPTY,
+							  memory_order_relaxed);
+	}
+	uint32_t mask = INDEX_CAPACITY - 1;
+	for (uint32_t n = 0; n < liveCount; n++) {
+		uint32_t i = indexSlot(entryKey(live[n]));
+		while (atomic_load_explicit(&userIndex[i], memory_order_relaxed)
+			   != INDEX_EMPTY) {
+			i = (i + 1) & mask;
+		}
+		atomic_store_explicit(&userIndex[i], live[n], memory_order_relaxed);
+	}
+	atomic_fetch_add_explicit(&indexGeneration, 1, memory_order_release);
+	tombstoneCount = 0;
+}
+
+static void removeLocked(mumble_userid_t userID) {
+	uint32_t mask = INDEX_CAPACITY - 1;
+	for (uint32_t i = indexSlot(userID), probes = 0; probes < INDEX_CAPACITY;
+		 i = (i + 1) & mask, probes++) {
+		uint64_t entry = atomic_load(&userIndex[i]);
+		if (entry == INDEX_EMPTY) {
+			return;
+		}
+		if (entryKey(entry) == userID && entry != INDEX_TOMBSTONE) {
+			uint32_t slot = (uint32_t) entry;
+			atomic_store_explicit(&userIndex[i], INDEX_TOMBSTONE,
+								  memory_order_release);
+			atomic_store(&users[slot].id, ROSTER_NO_USER);
+			freeSlots[freeSlotCount++] = slot;
+			if (++tombstoneCount > INDEX_MAX_TOMBSTONES) {
+				rehashLocked();
+			}
+			return;
+		}
+	}
+}
+
+// Queries everything Mumble knows about the user (outside of the lock, these
+// calls allocate) and stores it
+static void mirrorUser(mumble_connection_t connection, mumble_userid_t userID) {
+	const char *name           = NULL;
+	const char *hash           = NULL;
+	mumble_channelid_t channel = -1;
+
+	if (mumbleAPI.getUserName(ownID, connection, userID, &name)
+		!= MUMBLE_STATUS_OK) {
+		name = NULL;
+	}
+	if (mumbleAPI.getUserHash(ownID, connection, userID, &hash)
+		!= MUMBLE_STATUS_OK) {
+		hash = NULL;
+	}
+	if (mumbleAPI.getChannelOfUser(ownID, connection, userID, &channel)
+		!= MUMBLE_STATUS_OK) {
+		channel = -1;
+	}
+
+	plat_mutex_lock(&writeLock);
+	if (atomic_load(&mirroredServer) == connection) {
+		struct RosterUser *user = insertLocked(userID);
+		if (user) {
+			atomic_store(&user->name, intern(name));
+			atomic_store(&user->hash, intern(hash));
+			atomic_store(&user->channel, channel);
+		}
+	}
+	plat_mutex_unlock(&writeLock);
+
+	if (name) {
+		mumbleAPI.freeMemory(ownID, name);
+	}
+	if (hash) {
+		mumbleAPI.freeMemory(ownID, hash);
+	}
+}
+
+void roster_build(mumble_connection_t connection) {
+	mumble_userid_t *userList = NULL;
+	size_t userCount          = 0;
+	mumble_userid_t self;
+
+	plat_mutex_lock(&writeLock);
+	resetLocked();
+	atomic_store(&mirroredServer, connection);
+	if (mumbleAPI.getLocalUserID(ownID, connection, &self)
+		== MUMBLE_STATUS_OK) {
+		atomic_store(&localUser, self);
+	}
+	plat_mutex_unlock(&writeLock);
+
+	if (mumbleAPI.getAllUsers(ownID, connection, &userList, &userCount)
+		!= MUMBLE_STATUS_OK) {
+		mumbleAPI.log(ownID, "ERROR: Failed to fetch the user list");
+		return;
+	}
+
+	for (size_t i = 0; i < userCount; i++) {
+		mirrorUser(connection, userList[i]);
+	}
+	mumbleAPI.freeMemory(ownID, userList);
+
+	char logBuffer[128];
+	snprintf(logBuffer, sizeof(logBuffer), "Mirrored %zu users", userCount);
+	mumbleAPI.log(ownID, logBuffer);
+}
+
+void roster_clear(void) {
+	plat_mutex_lock(&writeLock);
+	resetLocked();
+	plat_mutex_unlock(&writeLock);
+}
+
+void roster_onUserAdded(mumble_connection_t connection,
+						mumble_userid_t userID) {
+	if (connection == atomic_load(&mirroredServer)) {
+		mirrorUser(connection, userID);
+	}
+}
+
+void roster_onUserRemoved(mumble_connection_t connection,
+						  mumble_userid_t userID) {
+	plat_mutex_lock(&writeLock);
+	if (connection == atomic_load(&mirroredServer)) {
+		removeLocked(userID);
+	}
+	plat_mutex_unlock(&writeLock);
+}
+
+void roster_onChannelEntered(mumble_connection_t connection,
+							 mumble_userid_t userID,
+							 mumble_channelid_t newChannelID) {
+	plat_mutex_lock(&writeLock);
+	struct RosterUser *user = NULL;
+	if (connection == atomic_load(&mirroredServer)) {
+		user = roster_find(userID);
+	}
+	if (user) {
+		atomic_store(&user->channel, newChannelID);
+	}
+	plat_mutex_unlock(&writeLock);
+}
+
+void roster_onChannelExited(mumble_connection_t connection,
+							mumble_userid_t userID,
+							mumble_channelid_t channelID) {
+	plat_mutex_lock(&writeLock);
+	struct RosterUser *user = NULL;
+	if (connection == atomic_load(&mirroredServer)) {
+		user = roster_find(userID);
+	}
+	// Entered and exited may arrive in either order; only forget the channel
+	// if the user has not already been seen in a new one
+	if (user && atomic_load(&user->channel) == channelID) {
+		atomic_store(&user->channel, -1);
+	}
+	plat_mutex_unlock(&writeLock);
+}
+
+void roster_onTalkingStateChanged(mumble_connection_t connection,
+								  mumble_userid_t userID,
+								  mumble_talking_state_t talkingState) {
+	if (connection != atomic_load(&mirroredServer)) {
+		return;
+	}
+
+	// Single field update, no need for the write lock
+	struct RosterUser *user = roster_find(userID);
+	if (user) {
+		atomic_store_explicit(&user->talkingState, talkingState,
+							  memory_order_relaxed);
+	}
+}
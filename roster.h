@@ -0,0 +1,112 @@
+#ifndef WOW335PA_ROSTER_H_
+#define WOW335PA_ROSTER_H_
+
+// Mirror of the users on the synchronized server: names, certificate hashes,
+// current channel and talking state. It is built once when the connection is
+// synchronized and then updated from Mumble's user callbacks, so features
+// never need getAllUsers/getUsersInChannel/getUserName (and the matching
+// freeMemory calls) at runtime.
+//
+// Updates are serialised internally. Lookups are lock-free and allocation-free
+// and may be done from any thread, including the audio thread. Name and hash
+// strings are interned; a pointer loaded from a slot stays valid until the
+// string storage has been compacted twice, which takes thousands of joins.
+
+#include "PluginComponents_v_1_0_x.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ROSTER_MAX_USERS 4096
+
+struct RosterUser {
+	// ROSTER_NO_USER while the slot is free
+	_Atomic uint32_t id;
+	atomic_int channel;
+	atomic_int talkingState;
+	_Atomic(const char *) name;
+	_Atomic(const char *) hash;
+	// Set by proximity.c when the user is out of in-game hearing range
+	atomic_bool culled;
+	// In-game position published by proximity.c, see roster_packPosition
+	_Atomic uint64_t position;
+	// Published along with the position
+	atomic_bool ghost;
+};
+
+#define ROSTER_NO_USER 0xFFFFFFFFu
+
+// Positions are packed into one word so the audio thread can read them with a
+// single atomic load: 21 bits of quarter yards per axis (the resolution peers
+// send them with) and bit 63 set when the position is known.
+#define ROSTER_POSITION_VALID (1ull << 63)
+#define ROSTER_POSITION_LIMIT ((1 << 20) - 1)
+
+static inline uint64_t roster_packPosition(const float position[3]) {
+	uint64_t packed = ROSTER_POSITION_VALID;
+	for (int i = 0; i < 3; i++) {
+		float q   = position[i] * 4.0f;
+		int32_t v = (int32_t) (q < 0.0f ? q - 0.5f : q + 0.5f);
+		if (v > ROSTER_POSITION_LIMIT) {
+			v = ROSTER_POSITION_LIMIT;
+		} else if (v < -ROSTER_POSITION_LIMIT) {
+			v = -ROSTER_POSITION_LIMIT;
+		}
+		packed |= (uint64_t) ((uint32_t) v & 0x1FFFFF) << (21 * i);
+	}
+	return packed;
+}
+
+static inline bool roster_unpackPosition(uint64_t packed, float position[3]) {
+	if (!(packed & ROSTER_POSITION_VALID)) {
+		return false;
+	}
+	for (int i = 0; i < 3; i++) {
+		uint32_t v = (uint32_t) (packed >> (21 * i)) & 0x1FFFFF;
+		// Sign-extend the 21-bit field
+		int32_t q  = (int32_t) (v << 11) >> 11;
+		position[i] = (float) q * 0.25f;
+	}
+	return true;
+}
+
+// Mirrors the users of the given connection. Main thread only.
+void roster_build(mumble_connection_t connection);
+void roster_clear(void);
+
+// Incremental updates from the corresponding mumble_on* callbacks
+void roster_onUserAdded(mumble_connection_t connection, mumble_userid_t userID);
+void roster_onUserRemoved(mumble_connection_t connection,
+						  mumble_userid_t userID);
+void roster_onChannelEntered(mumble_connection_t connection,
+							 mumble_userid_t userID,
+							 mumble_channelid_t newChannelID);
+void roster_onChannelExited(mumble_connection_t connection,
+							mumble_userid_t userID,
+							mumble_channelid_t channelID);
+void roster_onTalkingStateChanged(mumble_connection_t connection,
+								  mumble_userid_t userID,
+								  mumble_talking_state_t talkingState);
+
+// Whether the user's voice is currently being played. Muted talkers and users
+// that just stopped are not.
+static inline bool roster_isSpeaking(const struct RosterUser *user) {
+	int state = atomic_load_explicit(&user->talkingState, memory_order_relaxed);
+	return state == MUMBLE_TS_TALKING || state == MUMBLE_TS_WHISPERING
+		   || state == MUMBLE_TS_SHOUTING;
+}
+
+// O(1) lookup, NULL if the user is not known. The returned slot may be reused
+// for another user once the user leaves; check ->id if that matters.
+struct RosterUser *roster_find(mumble_userid_t userID);
+
+// Slot of a user by index, for iterating over all ROSTER_MAX_USERS slots
+struct RosterUser *roster_at(size_t index);
+// Inverse of roster_at, for keeping per-user state in parallel arrays
+size_t roster_slot(const struct RosterUser *user);
+
+mumble_connection_t roster_connection(void);
+mumble_userid_t roster_localUser(void);
+
+#endif // WOW335PA_ROSTER_H_
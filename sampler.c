@@ -0,0 +1,296 @@
+#include "sampler.h"
+
+#include "platform.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+// Intervals in a row within a quarter of the period before the aligned sampler
+// trusts the input callback's phase
+#define LOCK_INTERVALS 8
+// Without an input callback for this many periods it is assumed to have
+// stopped
+#define LOST_PERIODS 4
+// Shortest period of the adaptive sampler
+#define ADAPTIVE_MIN_NS 1000000ull
+
+static struct SamplerConfig config = { .mode = SAMPLER_INLINE };
+static plat_thread_t samplerThread;
+static atomic_bool running = false;
+
+// The process handed over by sampler_attach. Only read with the lock held, so
+// detaching never closes a handle in use.
+static plat_mutex_t lock = PLAT_MUTEX_INITIALIZER;
+static bool attached     = false;
+static struct WowProcess process;
+static struct Breaker breaker;
+static uint64_t sequence;
+// How often the game writes a new position, smoothed, and when it last did;
+// 0 until seen. For the adaptive sampler.
+static uint64_t gameIntervalNs;
+static uint64_t gameChangedNs;
+static float gamePosition[3];
+static float gameHeading;
+
+// Newest frame, guarded by a seqlock like gamestate_latest. Only written with
+// the lock held.
+static struct SamplerFrame latest;
+static atomic_uint latestSeq = 0;
+
+// When the newest frame in the world was read, in any mode; 0 if none
+static _Atomic uint64_t newestNs = 0;
+
+// The input callback as learned by the audio input thread, the only writer:
+// the smoothed time of its latest call, its smoothed period, and how many
+// intervals in a row matched that period
+static _Atomic uint64_t inputAnchorNs = 0;
+static _Atomic uint64_t inputPeriodNs = 0;
+static _Atomic uint32_t inputStable   = 0;
+
+static void publish(const struct SamplerFrame *frame) {
+	unsigned seq = atomic_load_explicit(&latestSeq, memory_order_relaxed);
+	atomic_store_explicit(&latestSeq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	latest = *frame;
+	atomic_store_explicit(&latestSeq, seq + 2, memory_order_release);
+}
+
+// Forgets the newest frame. Called with the lock held by the thread that
+// reads them, so nobody is in the middle of sampler_latest.
+static void resetLocked(void) {
+	atomic_store_explicit(&latestSeq, 0, memory_order_release);
+	atomic_store_explicit(&newestNs, 0, memory_order_relaxed);
+	sequence       = 0;
+	gameIntervalNs = 0;
+	gameChangedNs  = 0;
+}
+
+// Follows how often the avatar moves or turns. Called with the lock held.
+static void watchGameLocked(const struct GameSnapshot *snapshot) {
+	if (!gamestate_inWorld(snapshot)
+		|| (memcmp(gamePosition, snapshot->avatarPos, sizeof(gamePosition))
+				== 0
+			&& gameHeading == snapshot->heading)) {
+		return;
+	}
+	memcpy(gamePosition, snapshot->avatarPos, sizeof(gamePosition));
+	gameHeading = snapshot->heading;
+
+	// A player standing still says nothing about the game's frame rate, so
+	// long gaps are left out
+	uint64_t intervalNs = snapshot->timestampNs - gameChangedNs;
+	if (gameChangedNs != 0 && intervalNs < 4 * config.periodNs) {
+		gameIntervalNs = gameIntervalNs == 0
+							 ? intervalNs
+							 : gameIntervalNs - gameIntervalNs / 8
+								   + intervalNs / 8;
+	}
+	gameChangedNs = snapshot->timestampNs;
+}
+
+// When to read next: a period after the previous read or, once locked on to
+// the input callback, leadNs before its next call. gameNs is gameIntervalNs
+// as of the previous read.
+static uint64_t nextTarget(uint64_t previousNs, uint64_t gameNs) {
+	uint64_t anchorNs =
+		atomic_load_explicit(&inputAnchorNs, memory_order_relaxed);
+	uint64_t periodNs =
+		atomic_load_explicit(&inputPeriodNs, memory_order_relaxed);
+	uint32_t stable = atomic_load_explicit(&inputStable, memory_order_relaxed);
+	uint64_t nowNs  = plat_now_ns();
+
+	if (config.mode == SAMPLER_ALIGNED && stable >= LOCK_INTERVALS
+		&& periodNs > config.leadNs && anchorNs <= nowNs
+		&& nowNs - anchorNs < LOST_PERIODS * periodNs) {
+		// The first call that can still be read for, and only one read per
+		// call
+		uint64_t callNs = anchorNs + periodNs;
+		while (callNs - config.leadNs <= nowNs
+			   || callNs - config.leadNs < previousNs + periodNs / 2) {
+			callNs += periodNs;
+		}
+		return callNs - config.leadNs;
+	}
+
+	uint64_t sampleNs = config.periodNs;
+	if (config.mode == SAMPLER_ADAPTIVE && gameNs != 0) {
+		// Not a whole fraction of the game's frame, so the reads drift
+		// across its frames instead of locking to one point in them
+		sampleNs = gameNs * 2 / 5;
+		sampleNs = sampleNs < ADAPTIVE_MIN_NS ? ADAPTIVE_MIN_NS : sampleNs;
+		sampleNs = sampleNs > config.periodNs ? config.periodNs : sampleNs;
+	}
+	uint64_t targetNs = previousNs + sampleNs;
+	return targetNs > nowNs ? targetNs : nowNs;
+}
+
+// Called with the lock held
+static void sampleLocked(void) {
+	uint64_t nowNs = plat_now_ns();
+	if (attached && breaker_allow(&breaker, nowNs)) {
+		struct SamplerFrame frame;
+		bool ok           = wowreader_read(&process, &frame.snapshot);
+		frame.error       = process.lastError;
+		frame.failedField = process.failedField;
+		breaker_record(&breaker, ok, nowNs);
+		frame.breaker  = breaker;
+		frame.sequence = ++sequence;
+		publish(&frame);
+		watchGameLocked(&frame.snapshot);
+		if (gamestate_inWorld(&frame.snapshot)) {
+			atomic_store_explicit(&newestNs, frame.snapshot.timestampNs,
+								  memory_order_relaxed);
+		}
+	}
+}
+
+static void samplerMain(void *arg) {
+	(void) arg;
+
+	uint64_t previousNs = plat_now_ns();
+	uint64_t gameNs     = 0;
+	while (atomic_load(&running)) {
+		uint64_t targetNs = nextTarget(previousNs, gameNs);
+		plat_sleep_until_ns(targetNs);
+		previousNs = targetNs;
+		plat_mutex_lock(&lock);
+		sampleLocked();
+		gameNs = gameIntervalNs;
+		plat_mutex_unlock(&lock);
+	}
+}
+
+bool sampler_parseMode(const char *name, enum SamplerMode *mode) {
+	if (strcmp(name, "inline") == 0) {
+		*mode = SAMPLER_INLINE;
+	} else if (strcmp(name, "thread") == 0) {
+		*mode = SAMPLER_THREAD;
+	} else if (strcmp(name, "adaptive") == 0) {
+		*mode = SAMPLER_ADAPTIVE;
+	} else if (strcmp(name, "aligned") == 0) {
+		*mode = SAMPLER_ALIGNED;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+const char *sampler_modeName(enum SamplerMode mode) {
+	switch (mode) {
+		case SAMPLER_THREAD:
+			return "thread";
+		case SAMPLER_ADAPTIVE:
+			return "adaptive";
+		case SAMPLER_ALIGNED:
+			return "aligned";
+		default:
+			return "inline";
+	}
+}
+
+bool sampler_start(const struct SamplerConfig *samplerConfig) {
+	if (atomic_load(&running)) {
+		return true;
+	}
+	config = *samplerConfig;
+	if (config.mode == SAMPLER_INLINE) {
+		return true;
+	}
+	if (config.periodNs == 0) {
+		config.periodNs = 10000000ull;
+	}
+
+	atomic_store(&running, true);
+	if (!plat_thread_start(&samplerThread, samplerMain, NULL)) {
+		atomic_store(&running, false);
+		config.mode = SAMPLER_INLINE;
+		return false;
+	}
+	return true;
+}
+
+void sampler_stop(void) {
+	if (atomic_exchange(&running, false)) {
+		plat_thread_join(samplerThread);
+	}
+	sampler_detach();
+	config.mode = SAMPLER_INLINE;
+}
+
+enum SamplerMode sampler_mode(void) {
+	return config.mode;
+}
+
+void sampler_attach(const struct WowProcess *wowProcess) {
+	plat_mutex_lock(&lock);
+	if (attached) {
+		wowreader_detach(&process);
+	}
+	resetLocked();
+	if (config.mode != SAMPLER_INLINE) {
+		process = *wowProcess;
+		// Opened again on the sampler's first read (Windows)
+		process.handle = NULL;
+		breaker_init(&breaker, &config.breaker, plat_now_ns());
+		attached = true;
+		// So the first fetch does not have to wait for the schedule
+		sampleLocked();
+	}
+	plat_mutex_unlock(&lock);
+}
+
+void sampler_detach(void) {
+	plat_mutex_lock(&lock);
+	if (attached) {
+		wowreader_detach(&process);
+		attached = false;
+	}
+	resetLocked();
+	plat_mutex_unlock(&lock);
+}
+
+bool sampler_latest(struct SamplerFrame *frame) {
+	unsigned before, after;
+	do {
+		before = atomic_load_explicit(&latestSeq, memory_order_acquire);
+		*frame = latest;
+		atomic_thread_fence(memory_order_acquire);
+		after = atomic_load_explicit(&latestSeq, memory_order_relaxed);
+	} while (before != after || (before & 1));
+
+	return before != 0;
+}
+
+void sampler_noteFrame(uint64_t timestampNs) {
+	atomic_store_explicit(&newestNs, timestampNs, memory_order_relaxed);
+}
+
+uint64_t sampler_onAudioInput(uint64_t nowNs) {
+	uint64_t anchorNs =
+		atomic_load_explicit(&inputAnchorNs, memory_order_relaxed);
+	uint64_t periodNs =
+		atomic_load_explicit(&inputPeriodNs, memory_order_relaxed);
+	uint32_t stable = atomic_load_explicit(&inputStable, memory_order_relaxed);
+
+	uint64_t expectedNs = anchorNs + periodNs;
+	uint64_t slackNs    = periodNs / 4;
+	if (anchorNs != 0 && periodNs != 0 && nowNs + slackNs > expectedNs
+		&& nowNs < expectedNs + slackNs) {
+		// On time: follow the call's jitter slowly, in period and in phase
+		int64_t errorNs = (int64_t) (nowNs - expectedNs);
+		periodNs        = (uint64_t) ((int64_t) periodNs + errorNs / 16);
+		anchorNs        = (uint64_t) ((int64_t) expectedNs + errorNs / 4);
+		stable += stable < UINT32_MAX;
+	} else {
+		// First call, or the callback was late, early or paused: start over
+		periodNs = anchorNs != 0 && nowNs > anchorNs ? nowNs - anchorNs : 0;
+		anchorNs = nowNs;
+		stable   = 0;
+	}
+	atomic_store_explicit(&inputAnchorNs, anchorNs, memory_order_relaxed);
+	atomic_store_explicit(&inputPeriodNs, periodNs, memory_order_relaxed);
+	atomic_store_explicit(&inputStable, stable, memory_order_relaxed);
+
+	uint64_t frameNs = atomic_load_explicit(&newestNs, memory_order_relaxed);
+	return frameNs != 0 && nowNs > frameNs ? nowNs - frameNs : 0;
+}
@@ -0,0 +1,79 @@
+#ifndef WOW335PA_SAMPLER_H_
+#define WOW335PA_SAMPLER_H_
+
+// When frames are read from the game (reader.sampler):
+//   inline   - in mumble_fetchPositionalData, whenever Mumble asks (default)
+//   thread   - by a background thread every reader.sample_ms (default 10)
+//   adaptive - by a background thread, 2.5 times as often as the game is
+//              seen writing a new position, between 1 ms and
+//              reader.sample_ms
+//   aligned  - by a background thread that learns the period and phase of
+//              mumble_onAudioInput and reads reader.sample_lead_us (default
+//              1000) before each call, so the newest position is about that
+//              old when Mumble encodes the input frame. It samples like
+//              "thread" until it has locked on to the callback, and again
+//              whenever the callback stops.
+// With a thread, mumble_fetchPositionalData hands out the newest sampled
+// frame instead of reading, and the read breaker (breaker.h) runs on the
+// sampler thread.
+
+#include "breaker.h"
+#include "gamestate.h"
+#include "wowreader.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum SamplerMode {
+	SAMPLER_INLINE,
+	SAMPLER_THREAD,
+	SAMPLER_ADAPTIVE,
+	SAMPLER_ALIGNED
+};
+
+struct SamplerConfig {
+	enum SamplerMode mode;
+	uint64_t periodNs;
+	uint64_t leadNs;
+	struct BreakerPolicy breaker;
+};
+
+// One read of the sampler thread
+struct SamplerFrame {
+	struct GameSnapshot snapshot;
+	enum WowReadError error;
+	enum WowField failedField;
+	// The sampler's breaker after the read
+	struct Breaker breaker;
+	// Frames read since sampler_attach, starting at 1
+	uint64_t sequence;
+};
+
+// "inline", "thread", "adaptive" or "aligned"; false for anything else
+bool sampler_parseMode(const char *name, enum SamplerMode *mode);
+const char *sampler_modeName(enum SamplerMode mode);
+
+// Starts the thread for the thread modes; nothing to do for inline. From
+// mumble_init and mumble_shutdown.
+bool sampler_start(const struct SamplerConfig *config);
+void sampler_stop(void);
+enum SamplerMode sampler_mode(void);
+
+// The thread that calls mumble_initPositionalData hands the process over and
+// takes it back. The sampler reads a copy with a handle of its own; detaching
+// waits for a read in progress.
+void sampler_attach(const struct WowProcess *process);
+void sampler_detach(void);
+
+// Positional thread. Copies the newest frame; false until the first one since
+// sampler_attach. Lock-free.
+bool sampler_latest(struct SamplerFrame *frame);
+// Positional thread, inline mode: a frame read at timestampNs
+void sampler_noteFrame(uint64_t timestampNs);
+
+// Audio input thread, once per mumble_onAudioInput with the current time.
+// Learns the callback's period and phase and returns the age of the newest
+// frame, 0 if there is none. Relaxed atomics only.
+uint64_t sampler_onAudioInput(uint64_t nowNs);
+
+#endif // WOW335PA_SAMPLER_H_
@@ -0,0 +1,314 @@
+#include "spatial.h"
+
+#include <math.h>
+#include <string.h>
+
+#define EMPTY_CELL 0xFFFFFFFFFFFFFFFFull
+// Compact the cell table once this many slots are in use
+#define MAX_CELL_LOAD (SPATIAL_MAX_CELLS / 4 * 3)
+// Upper bound on k for spatial_queryNearest
+#define MAX_NEAREST 64
+
+static inline int32_t cellCoord(const struct SpatialIndex *index, float v) {
+	return (int32_t) floorf(v * index->inverseCellSize);
+}
+
+static inline uint64_t cellKey(int32_t mapId, int32_t cx, int32_t cy) {
+	return ((uint64_t) ((uint32_t) mapId & 0xFFFFF) << 44)
+		   | ((uint64_t) ((uint32_t) cx & 0x3FFFFF) << 22)
+		   | (uint64_t) ((uint32_t) cy & 0x3FFFFF);
+}
+
+static inline uint32_t cellSlot(uint64_t key) {
+	return (uint32_t) ((key * 0x9E3779B97F4A7C15ull) >> 50)
+		   & (SPATIAL_MAX_CELLS - 1);
+}
+
+static int32_t findCell(const struct SpatialIndex *index, uint64_t key) {
+	for (uint32_t i = cellSlot(key);; i = (i + 1) & (SPATIAL_MAX_CELLS - 1)) {
+		if (index->cellKey[i] == key) {
+			return (int32_t) i;
+		}
+		if (index->cellKey[i] == EMPTY_CELL) {
+			return -1;
+		}
+	}
+}
+
+static int32_t insertCell(struct SpatialIndex *index, uint64_t key) {
+	for (uint32_t i = cellSlot(key);; i = (i + 1) & (SPATIAL_MAX_CELLS - 1)) {
+		if (index->cellKey[i] == key) {
+			return (int32_t) i;
+		}
+		if (index->cellKey[i] == EMPTY_CELL) {
+			index->cellKey[i]  = key;
+			index->cellHead[i] = -1;
+			index->cellsUsed++;
+			return (int32_t) i;
+		}
+	}
+}
+
+static void linkEntry(struct SpatialIndex *index, uint32_t id, int32_t cell) {
+	int32_t head    = index->cellHead[cell];
+	index->cell[id] = cell;
+	index->prev[id] = -1;
+	index->next[id] = head;
+	if (head >= 0) {
+		index->prev[head] = (int32_t) id;
+	}
+	index->cellHead[cell] = (int32_t) id;
+}
+
+static void unlinkEntry(struct SpatialIndex *index, uint32_t id) {
+	int32_t prev = index->prev[id];
+	int32_t next = index->next[id];
+	if (prev >= 0) {
+		index->next[prev] = next;
+	} else {
+		index->cellHead[index->cell[id]] = next;
+	}
+	if (next >= 0) {
+		index->prev[next] = prev;
+	}
+	index->cell[id] = -1;
+}
+
+static uint64_t keyOf(const struct SpatialIndex *index, uint32_t id) {
+	return cellKey(index->mapId[id], cellCoord(index, index->x[id]),
+				   cellCoord(index, index->y[id]));
+}
+
+// Drops cells that ran empty by rebuilding the table from the entries
+static void compact(struct SpatialIndex *index) {
+	for (uint32_t i = 0; i < SPATIAL_MAX_CELLS; i++) {
+		index->cellKey[i] = EMPTY_CELL;
+	}
+	index->cellsUsed = 0;
+
+	for (uint32_t id = 0; id < SPATIAL_MAX_ENTRIES; id++) {
+		if (index->cell[id] >= 0) {
+			linkEntry(index, id, insertCell(index, keyOf(index, id)));
+		}
+	}
+}
+
+void spatial_init(struct SpatialIndex *index, float cellSize) {
+	index->cellSize        = cellSize;
+	index->inverseCellSize = 1.0f / cellSize;
+	index->entryCount      = 0;
+	for (uint32_t id = 0; id < SPATIAL_MAX_ENTRIES; id++) {
+		index->cell[id] = -1;
+	}
+	compact(index);
+}
+
+bool spatial_update(struct SpatialIndex *index, uint32_t id, int32_t mapId,
+					const float position[3]) {
+	if (id >= SPATIAL_MAX_ENTRIES) {
+		return false;
+	}
+
+	uint64_t key = cellKey(mapId, cellCoord(index, position[0]),
+						   cellCoord(index, position[1]));
+	bool present = index->cell[id] >= 0;
+
+	index->x[id]     = position[0];
+	index->y[id]     = position[1];
+	index->z[id]     = position[2];
+	index->mapId[id] = mapId;
+
+	if (present) {
+		if (index->cellKey[index->cell[id]] == key) {
+			// Still in the same cell, which is the common case
+			return true;
+		}
+		unlinkEntry(index, id);
+	} else {
+		index->entryCount++;
+	}
+
+	if (index->cellsUsed >= MAX_CELL_LOAD && findCell(index, key) < 0) {
+		compact(index);
+	}
+	linkEntry(index, id, insertCell(index, key));
+
+	return true;
+}
+
+void spatial_remove(struct SpatialIndex *index, uint32_t id) {
+	if (spatial_contains(index, id)) {
+		unlinkEntry(index, id);
+		index->entryCount--;
+	}
+}
+
+static inline float distanceSquared(const struct SpatialIndex *index,
+									uint32_t id, const float position[3]) {
+	float dx = index->x[id] - position[0];
+	float dy = index->y[id] - position[1];
+	float dz = index->z[id] - position[2];
+	return dx * dx + dy * dy + dz * dz;
+}
+
+size_t spatial_queryRange(const struct SpatialIndex *index, int32_t mapId,
+						  const float position[3], float radius,
+						  uint32_t *results, size_t maxResults) {
+	int32_t cx0         = cellCoord(index, position[0] - radius);
+	int32_t cx1         = cellCoord(index, position[0] + radius);
+	int32_t cy0         = cellCoord(index, position[1] - radius);
+	int32_t cy1         = cellCoord(index, position[1] + radius);
+	float radiusSquared = radius * radius;
+	size_t count        = 0;
+
+	for (int32_t cx = cx0; cx <= cx1; cx++) {
+		for (int32_t cy = cy0; cy <= cy1; cy++) {
+			int32_t cell = findCell(index, cellKey(mapId, cx, cy));
+			if (cell < 0) {
+				continue;
+			}
+			for (int32_t id = index->cellHead[cell]; id >= 0;
+				 id         = index->next[id]) {
+				if (distanceSquared(index, (uint32_t) id, position)
+					<= radiusSquared) {
+					if (count == maxResults) {
+						return count;
+					}
+					results[count++] = (uint32_t) id;
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
+// Max-heap on distance over (ids, dists), so the farthest candidate is on top
+static void heapSiftDown(uint32_t *ids, float *dists, size_t count,
+						 size_t i) {
+	for (;;) {
+		size_t largest = i;
+		size_t left    = 2 * i + 1;
+		size_t right   = left + 1;
+		if (left < count && dists[left] > dists[largest]) {
+			largest = left;
+		}
+		if (right < count && dists[right] > dists[largest]) {
+			largest = right;
+		}
+		if (largest == i) {
+			return;
+		}
+		uint32_t id    = ids[i];
+		float dist     = dists[i];
+		ids[i]         = ids[largest];
+		dists[i]       = dists[largest];
+		ids[largest]   = id;
+		dists[largest] = dist;
+		i              = largest;
+	}
+}
+
+static void heapPush(uint32_t *ids, float *dists, size_t *count, size_t k,
+					 uint32_t id, float dist) {
+	if (*count < k) {
+		size_t i = (*count)++;
+		ids[i]   = id;
+		dists[i] = dist;
+		while (i > 0 && dists[(i - 1) / 2] < dists[i]) {
+			size_t parent  = (i - 1) / 2;
+			uint32_t tmpId = ids[parent];
+			float tmpDist  = dists[parent];
+			ids[parent]    = ids[i];
+			dists[parent]  = dists[i];
+			ids[i]         = tmpId;
+			dists[i]       = tmpDist;
+			i              = parent;
+		}
+	} else if (dist < dists[0]) {
+		ids[0]   = id;
+		dists[0] = dist;
+		heapSiftDown(ids, dists, *count, 0);
+	}
+}
+
+static void visitCell(const struct SpatialIndex *index, int32_t mapId,
+					  int32_t cx, int32_t cy, const float position[3],
+					  float maxSquared, uint32_t *ids, float *dists,
+					  size_t *count, size_t k) {
+	int32_t cell = findCell(index, cellKey(mapId, cx, cy));
+	if (cell < 0) {
+		return;
+	}
+	for (int32_t id = index->cellHead[cell]; id >= 0; id = index->next[id]) {
+		float d = distanceSquared(index, (uint32_t) id, position);
+		if (d <= maxSquared) {
+			heapPush(ids, dists, count, k, (uint32_t) id, d);
+		}
+	}
+}
+
+size_t spatial_queryNearest(const struct SpatialIndex *index, int32_t mapId,
+							const float position[3], size_t k, float maxRadius,
+							uint32_t *results, float *distances) {
+	float heapDists[MAX_NEAREST];
+	size_t count = 0;
+
+	if (k > MAX_NEAREST) {
+		k = MAX_NEAREST;
+	}
+	if (k == 0) {
+		return 0;
+	}
+
+	int32_t cx       = cellCoord(index, position[0]);
+	int32_t cy       = cellCoord(index, position[1]);
+	int32_t maxRing  = (int32_t) ceilf(maxRadius * index->inverseCellSize);
+	float maxSquared = maxRadius * maxRadius;
+
+	// Visit rings of cells around the query cell until nothing outside of the
+	// visited square can beat the current k-th candidate
+	for (int32_t ring = 0; ring <= maxRing; ring++) {
+		if (ring == 0) {
+			visitCell(index, mapId, cx, cy, position, maxSquared, results,
+					  heapDists, &count, k);
+		} else {
+			for (int32_t i = -ring; i <= ring; i++) {
+				visitCell(index, mapId, cx + i, cy - ring, position,
+						  maxSquared, results, heapDists, &count, k);
+				visitCell(index, mapId, cx + i, cy + ring, position,
+						  maxSquared, results, heapDists, &count, k);
+			}
+			for (int32_t i = -ring + 1; i <= ring - 1; i++) {
+				visitCell(index, mapId, cx - ring, cy + i, position,
+						  maxSquared, results, heapDists, &count, k);
+				visitCell(index, mapId, cx + ring, cy + i, position,
+						  maxSquared, results, heapDists, &count, k);
+			}
+		}
+
+		float reach = (float) ring * index->cellSize;
+		if (count == k && heapDists[0] <= reach * reach) {
+			break;
+		}
+	}
+
+	// Heap order -> closest first
+	for (size_t end = count; end > 1; end--) {
+		uint32_t id        = results[0];
+		float dist         = heapDists[0];
+		results[0]         = results[end - 1];
+		heapDists[0]       = heapDists[end - 1];
+		results[end - 1]   = id;
+		heapDists[end - 1] = dist;
+		heapSiftDown(results, heapDists, end - 1, 0);
+	}
+
+	if (distances) {
+		for (size_t i = 0; i < count; i++) {
+			distances[i] = sqrtf(heapDists[i]);
+		}
+	}
+
+	return count;
+}
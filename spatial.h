@@ -0,0 +1,69 @@
+#ifndef WOW335PA_SPATIAL_H_
+#define WOW335PA_SPATIAL_H_
+
+// Uniform 2D grid over (map, x, y) for "who is near me" queries on peer
+// positions. Everything lives in fixed, contiguous arrays inside the struct:
+// moving an entry is O(1) (unlink from one cell list, link into another) and
+// queries write into caller-provided buffers, so nothing ever allocates.
+//
+// Entries are identified by a caller-chosen index below SPATIAL_MAX_ENTRIES,
+// typically the slot of the peer in its own table. Not thread-safe; one
+// thread owns an index.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPATIAL_MAX_ENTRIES 8192
+#define SPATIAL_MAX_CELLS 16384 // power of two
+
+struct SpatialIndex {
+	float cellSize;
+	float inverseCellSize;
+
+	// Per entry, indexed by entry ID
+	float x[SPATIAL_MAX_ENTRIES];
+	float y[SPATIAL_MAX_ENTRIES];
+	float z[SPATIAL_MAX_ENTRIES];
+	int32_t mapId[SPATIAL_MAX_ENTRIES];
+	// Cell the entry is linked into, -1 if not present
+	int32_t cell[SPATIAL_MAX_ENTRIES];
+	int32_t next[SPATIAL_MAX_ENTRIES];
+	int32_t prev[SPATIAL_MAX_ENTRIES];
+
+	// Open-addressing table of cells keyed by (map, cx, cy). Cells that run
+	// empty are kept around and only dropped when the table is compacted.
+	uint64_t cellKey[SPATIAL_MAX_CELLS];
+	int32_t cellHead[SPATIAL_MAX_CELLS];
+	uint32_t cellsUsed;
+	uint32_t entryCount;
+};
+
+// cellSize should be about the typical query radius (hearing range)
+void spatial_init(struct SpatialIndex *index, float cellSize);
+
+// Inserts the entry or moves it to a new position. Returns false if the entry
+// ID is out of range.
+bool spatial_update(struct SpatialIndex *index, uint32_t id, int32_t mapId,
+					const float position[3]);
+void spatial_remove(struct SpatialIndex *index, uint32_t id);
+
+static inline bool spatial_contains(const struct SpatialIndex *index,
+									uint32_t id) {
+	return id < SPATIAL_MAX_ENTRIES && index->cell[id] >= 0;
+}
+
+// Writes up to maxResults IDs of entries on mapId within radius (3D distance)
+// of position. Returns the number written.
+size_t spatial_queryRange(const struct SpatialIndex *index, int32_t mapId,
+						  const float position[3], float radius,
+						  uint32_t *results, size_t maxResults);
+
+// Writes the IDs of (up to) the k entries nearest to position on mapId within
+// maxRadius, closest first, plus their distances if distances is not NULL.
+// Returns the number written.
+size_t spatial_queryNearest(const struct SpatialIndex *index, int32_t mapId,
+							const float position[3], size_t k, float maxRadius,
+							uint32_t *results, float *distances);
+
+#endif // WOW335PA_SPATIAL_H_
@@ -0,0 +1,92 @@
+// Attach cache: an entry comes back for the same process and image, and is
+// refused once the image's timestamp changed, for other processes and when
+// the file is not a cache.
+
+#include "attachcache.h"
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NT_OFFSET 0x80
+#define TIMESTAMP 0x4A5BC3E1u
+
+// Stands in for the client image: the headers up to TimeDateStamp
+static uint8_t image[4096];
+
+// The "process" is this one, read directly
+static bool readSelf(void *userdata, uint64_t address, void *dest,
+					 size_t len) {
+	(void) userdata;
+	memcpy(dest, (const void *) (uintptr_t) address, len);
+	return true;
+}
+
+static void setTimestamp(uint32_t timestamp) {
+	memcpy(image + NT_OFFSET + PEMAP_TIMESTAMP_OFFSET, &timestamp,
+		   sizeof(timestamp));
+}
+
+int main(void) {
+	char dir[] = "/tmp/attachcache_test.XXXXXX";
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	setenv("XDG_DATA_HOME", dir, 1);
+	char path[256];
+	snprintf(path, sizeof(path), "%s/wow335pa/attach.cache", dir);
+
+	uint64_t pid           = (uint64_t) getpid();
+	struct PeModule stored = { .name = "wow.exe", .size = 0x800000 };
+	stored.base            = (uint64_t) (uintptr_t) image;
+	stored.preferredBase   = 0x400000;
+	stored.timestamp       = TIMESTAMP;
+	stored.ntOffset        = NT_OFFSET;
+	setTimestamp(TIMESTAMP);
+
+	// Nothing before the first store
+	struct PeModule loaded;
+	CHECK(!attachcache_load(pid, readSelf, NULL, &loaded));
+
+	attachcache_store(pid, &stored);
+	memset(&loaded, 0, sizeof(loaded));
+	CHECK(attachcache_load(pid, readSelf, NULL, &loaded));
+	CHECK(loaded.base == stored.base);
+	CHECK(loaded.size == stored.size);
+	CHECK(loaded.timestamp == TIMESTAMP);
+	CHECK_STR(loaded.name, "wow.exe");
+
+	// Another process, even one that exists
+	CHECK(!attachcache_load((uint64_t) getppid(), readSelf, NULL, &loaded));
+
+	// Another build loaded at the same place
+	setTimestamp(TIMESTAMP + 1);
+	CHECK(!attachcache_load(pid, readSelf, NULL, &loaded));
+	setTimestamp(TIMESTAMP);
+
+	// Storing the same process again replaces its entry
+	stored.size = 0x900000;
+	attachcache_store(pid, &stored);
+	CHECK(attachcache_load(pid, readSelf, NULL, &loaded));
+	CHECK(loaded.size == 0x900000);
+
+	// A file that is not a cache is ignored and replaced by the next store
+	FILE *file = fopen(path, "wb");
+	CHECK(file != NULL);
+	if (file) {
+		fputs("not a cache", file);
+		fclose(file);
+	}
+	CHECK(!attachcache_load(pid, readSelf, NULL, &loaded));
+	attachcache_store(pid, &stored);
+	CHECK(attachcache_load(pid, readSelf, NULL, &loaded));
+
+	remove(path);
+	snprintf(path, sizeof(path), "%s/wow335pa", dir);
+	rmdir(path);
+	rmdir(dir);
+	return CHECK_DONE();
+}
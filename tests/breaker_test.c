@@ -0,0 +1,161 @@
+// Read circuit breaker: the policy on a made-up clock, and, when the tools are
+// built, against faketarget making its memory unreadable like a loading
+// screen. An optional field that cannot be read leaves the frame valid.
+
+#include "breaker.h"
+#include "check.h"
+
+#ifdef FAKETARGET
+#	include "platform.h"
+#	include "wowreader.h"
+
+#	include <signal.h>
+#	include <sys/wait.h>
+#	include <unistd.h>
+#endif
+
+#define MS 1000000ull
+
+static const struct BreakerPolicy policy = {
+	.openAfter     = 3,
+	.baseBackoffNs = 100 * MS,
+	.maxBackoffNs  = 1000 * MS,
+};
+
+static void testPolicy(void) {
+	struct Breaker breaker;
+	breaker_init(&breaker, &policy, 1);
+	uint64_t now = 1000 * MS;
+
+	// A single failure only degrades
+	CHECK(breaker_allow(&breaker, now));
+	CHECK(breaker_record(&breaker, false, now));
+	CHECK(breaker.state == BREAKER_DEGRADED);
+	CHECK(breaker_record(&breaker, true, now));
+	CHECK(breaker.state == BREAKER_HEALTHY);
+
+	// openAfter failures in a row open the circuit
+	for (int i = 0; i < 3; i++) {
+		CHECK(breaker_allow(&breaker, now));
+		breaker_record(&breaker, false, now);
+	}
+	CHECK(breaker.state == BREAKER_OPEN);
+	CHECK(breaker.transitions[BREAKER_OPEN] == 1);
+
+	// Nothing is read before the jittered backoff (75% to 125%) ran out
+	CHECK(!breaker_allow(&breaker, now + 74 * MS));
+	CHECK(breaker.retryAtNs >= now + 75 * MS);
+	CHECK(breaker.retryAtNs <= now + 125 * MS);
+
+	// Failed probes double the backoff up to the maximum
+	uint64_t expected = 100 * MS;
+	for (int i = 0; i < 6; i++) {
+		now = breaker.retryAtNs;
+		CHECK(breaker_allow(&breaker, now));
+		CHECK(!breaker_record(&breaker, false, now));
+		expected = expected * 2 > policy.maxBackoffNs ? policy.maxBackoffNs
+													  : expected * 2;
+		CHECK(breaker.backoffNs == expected);
+		CHECK(breaker.retryAtNs - now >= expected - expected / 4);
+		CHECK(breaker.retryAtNs - now <= expected + expected / 4);
+		CHECK(!breaker_allow(&breaker, now + 1));
+	}
+	CHECK(breaker.probes == 6);
+	CHECK(breaker.state == BREAKER_OPEN);
+
+	// A successful probe closes the circuit and starts over
+	now = breaker.retryAtNs;
+	CHECK(breaker_allow(&breaker, now));
+	CHECK(breaker_record(&breaker, true, now));
+	CHECK(breaker.state == BREAKER_HEALTHY);
+	CHECK(breaker.backoffNs == policy.baseBackoffNs);
+	CHECK(breaker.transitions[BREAKER_HEALTHY] == 2);
+
+	// With openAfter 1 the first failure opens it right away
+	struct BreakerPolicy eager = policy;
+	eager.openAfter            = 1;
+	breaker_init(&breaker, &eager, 1);
+	breaker_record(&breaker, false, now);
+	CHECK(breaker.state == BREAKER_OPEN);
+	CHECK(breaker.transitions[BREAKER_DEGRADED] == 0);
+}
+
+#ifdef FAKETARGET
+// Reads faketarget at 100 Hz through three of its fault windows
+static void testFaketarget(void) {
+	int pipeFds[2];
+	if (pipe(pipeFds) != 0) {
+		CHECK(!"pipe");
+		return;
+	}
+	pid_t pid = fork();
+	if (pid == 0) {
+		dup2(pipeFds[1], STDOUT_FILENO);
+		close(pipeFds[0]);
+		close(pipeFds[1]);
+		execl(FAKETARGET, FAKETARGET, "--fault-every", "1", "--fault-ms",
+			  "400", "--seconds", "5", (char *) NULL);
+		_exit(127);
+	}
+	close(pipeFds[1]);
+	char line[32] = { 0 };
+	ssize_t got   = read(pipeFds[0], line, sizeof(line) - 1);
+	close(pipeFds[0]);
+	CHECK(pid > 0 && got > 0);
+	if (pid <= 0 || got <= 0) {
+		return;
+	}
+
+	struct WowProcess process = { 0 };
+	wowreader_attach(&process, (uint64_t) pid);
+
+	// Before the first fault: an optional field at an address that is not
+	// mapped costs only that field
+	struct GameSnapshot snapshot;
+	struct WowProcess broken = process;
+	broken.addresses.zoneId  = 16;
+	CHECK(wowreader_read(&broken, &snapshot));
+	CHECK(snapshot.missing == GAME_MISSING_ZONE);
+	CHECK(snapshot.zoneId == 0);
+	CHECK(broken.lastError == WOW_READ_OK);
+
+	struct Breaker breaker;
+	breaker_init(&breaker, &policy, plat_now_ns());
+	uint32_t reads = 0, skipped = 0, failed = 0;
+	uint64_t startNs = plat_now_ns();
+	while (plat_now_ns() - startNs < 3900 * MS) {
+		uint64_t now = plat_now_ns();
+		if (!breaker_allow(&breaker, now)) {
+			skipped++;
+		} else {
+			bool ok = wowreader_read(&process, &snapshot);
+			reads++;
+			failed += !ok;
+			breaker_record(&breaker, ok, now);
+			if (!ok) {
+				CHECK(process.lastError == WOW_READ_UNMAPPED);
+				CHECK(process.failedField == WOW_FIELD_STATE);
+			}
+		}
+		plat_sleep_ms(10);
+	}
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+
+	// Every window opened the circuit and a probe closed it again; the reads
+	// it held back are most of a window's frames
+	CHECK(breaker.transitions[BREAKER_OPEN] >= 2);
+	CHECK(breaker.transitions[BREAKER_HEALTHY] >= 2);
+	CHECK(breaker.probes >= 2);
+	CHECK(skipped > failed);
+	CHECK(reads > 100);
+}
+#endif
+
+int main(void) {
+	testPolicy();
+#ifdef FAKETARGET
+	testFaketarget();
+#endif
+	return CHECK_DONE();
+}
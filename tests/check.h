@@ -0,0 +1,33 @@
+#ifndef WOW335PA_TESTS_CHECK_H_
+#define WOW335PA_TESTS_CHECK_H_
+
+// Minimal assertions for the unit tests: a failed check prints where and
+// what, and the test exits with the number of failures.
+
+#include <stdio.h>
+#include <string.h>
+
+static int checkFailures = 0;
+
+#define CHECK(condition)                                             \
+	do {                                                             \
+		if (!(condition)) {                                          \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, \
+					__LINE__, #condition);                           \
+			checkFailures++;                                         \
+		}                                                            \
+	} while (0)
+
+#define CHECK_STR(actual, expected)                                      \
+	do {                                                                 \
+		const char *a_ = (actual), *e_ = (expected);                     \
+		if (strcmp(a_, e_) != 0) {                                       \
+			fprintf(stderr, "%s:%d: got \"%s\", expected \"%s\"\n",      \
+					__FILE__, __LINE__, a_, e_);                         \
+			checkFailures++;                                             \
+		}                                                                \
+	} while (0)
+
+#define CHECK_DONE() (checkFailures == 0 ? 0 : 1)
+
+#endif // WOW335PA_TESTS_CHECK_H_
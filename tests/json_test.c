@@ -0,0 +1,203 @@
+// JSON writer: integers, escaping of control characters, UTF-8 validation and
+// truncation, which must never split an escape or a character.
+
+#include "check.h"
+#include "json.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+static char buffer[256];
+
+static const char *identity(size_t capacity, const char *name, size_t length,
+							int64_t guid, bool *truncated) {
+	struct JsonWriter json;
+	json_begin(&json, buffer, capacity);
+	json_addString(&json, "char", name, length);
+	json_addInt(&json, "leaderguid", guid);
+	const char *text = json_end(&json);
+	if (truncated) {
+		*truncated = json.truncated;
+	}
+	return text;
+}
+
+static const char *string(const char *value, size_t length) {
+	struct JsonWriter json;
+	json_begin(&json, buffer, sizeof(buffer));
+	json_addString(&json, "s", value, length);
+	return json_end(&json);
+}
+
+static const char *integer(int64_t value) {
+	struct JsonWriter json;
+	json_begin(&json, buffer, sizeof(buffer));
+	json_addInt(&json, "n", value);
+	return json_end(&json);
+}
+
+// Well-formed UTF-8 sequence at text, 0 if not
+static size_t utf8Length(const unsigned char *text) {
+	size_t size = text[0] < 0x80			  ? 1
+				  : (text[0] & 0xE0) == 0xC0 ? 2
+				  : (text[0] & 0xF0) == 0xE0 ? 3
+				  : (text[0] & 0xF8) == 0xF0 ? 4
+											 : 0;
+	for (size_t i = 1; i < size; i++) {
+		if ((text[i] & 0xC0) != 0x80) {
+			return 0;
+		}
+	}
+	return size;
+}
+
+// Every string in the output is closed, its escapes are whole and its bytes
+// are valid UTF-8 without raw control characters
+static bool wellFormed(const char *text) {
+	const unsigned char *p = (const unsigned char *) text;
+	if (*p++ != '{') {
+		return false;
+	}
+	bool inString = false;
+	while (*p) {
+		if (!inString) {
+			inString = *p == '"';
+			p++;
+			continue;
+		}
+		if (*p == '"') {
+			inString = false;
+			p++;
+		} else if (*p == '\\') {
+			if (p[1] == 'u') {
+				for (int i = 2; i < 6; i++) {
+					if (!strchr("0123456789abcdef", p[i]) || !p[i]) {
+						return false;
+					}
+				}
+				p += 6;
+			} else if (p[1] && strchr("\"\\bfnrt", p[1])) {
+				p += 2;
+			} else {
+				return false;
+			}
+		} else if (*p < 0x20) {
+			return false;
+		} else {
+			size_t size = utf8Length(p);
+			if (size == 0) {
+				return false;
+			}
+			p += size;
+		}
+	}
+	return !inString && p > (const unsigned char *) text + 1 && p[-1] == '}';
+}
+
+static void testIntegers(void) {
+	CHECK_STR(integer(0), "{\n\"n\": 0\n}");
+	CHECK_STR(integer(9), "{\n\"n\": 9\n}");
+	CHECK_STR(integer(10), "{\n\"n\": 10\n}");
+	CHECK_STR(integer(571), "{\n\"n\": 571\n}");
+	CHECK_STR(integer(-1234), "{\n\"n\": -1234\n}");
+	CHECK_STR(integer(INT64_MIN), "{\n\"n\": -9223372036854775808\n}");
+
+	struct JsonWriter json;
+	json_begin(&json, buffer, sizeof(buffer));
+	CHECK_STR(json_end(&json), "{}");
+
+	// Same text as the snprintf format the plugin used
+	CHECK_STR(identity(sizeof(buffer), "Arthas", 6, 42, NULL),
+			  "{\n\"char\": \"Arthas\",\n\"leaderguid\": 42\n}");
+}
+
+static void testEscaping(void) {
+	CHECK_STR(string("a\"b\\c", 5), "{\n\"s\": \"a\\\"b\\\\c\"\n}");
+	CHECK_STR(string("\b\f\n\r\t", 5), "{\n\"s\": \"\\b\\f\\n\\r\\t\"\n}");
+	CHECK_STR(string("\x01\x1f", 2), "{\n\"s\": \"\\u0001\\u001f\"\n}");
+	// An embedded NUL is data when the length says so
+	CHECK_STR(string("a\0b", 3), "{\n\"s\": \"a\\u0000b\"\n}");
+	// DEL needs no escape
+	CHECK_STR(string("\x7f", 1), "{\n\"s\": \"\x7f\"\n}");
+	// Past the first 16 bytes, where the vector scan hands over
+	CHECK_STR(string("0123456789abcdefgh\tij", 21),
+			  "{\n\"s\": \"0123456789abcdefgh\\tij\"\n}");
+	CHECK_STR(string("0123456789abcde\"", 16),
+			  "{\n\"s\": \"0123456789abcde\\\"\"\n}");
+}
+
+static void testUtf8(void) {
+	// Two, three and four byte characters pass through
+	const char *valid = "\xC3\x9E\xE2\x82\xAC\xF0\x9F\x98\x80";
+	CHECK_STR(string(valid, strlen(valid)),
+			  "{\n\"s\": \"\xC3\x9E\xE2\x82\xAC\xF0\x9F\x98\x80\"\n}");
+
+	// One U+FFFD per byte that does not start a valid sequence
+	CHECK_STR(string("a\xFF" "b", 3), "{\n\"s\": \"a\xEF\xBF\xBD" "b\"\n}");
+	CHECK_STR(string("\x80", 1), "{\n\"s\": \"\xEF\xBF\xBD\"\n}");
+	// Overlong '/'
+	CHECK_STR(string("\xC0\xAF", 2),
+			  "{\n\"s\": \"\xEF\xBF\xBD\xEF\xBF\xBD\"\n}");
+	// Surrogate half
+	CHECK_STR(string("\xED\xA0\x80", 3),
+			  "{\n\"s\": \"\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD\"\n}");
+	// Cut off by the end of the value
+	CHECK_STR(string("x\xE2\x82", 3),
+			  "{\n\"s\": \"x\xEF\xBF\xBD\xEF\xBF\xBD\"\n}");
+	CHECK_STR(string("\xF5\x80\x80\x80", 1), "{\n\"s\": \"\xEF\xBF\xBD\"\n}");
+}
+
+static void testTruncation(void) {
+	bool truncated;
+
+	// "{\n\"char\": \"abc" is 14 bytes; the closing quote, "\n}" and the NUL
+	// need 4 more. 23 leaves 5 bytes, one short of \u0001.
+	CHECK_STR(identity(23, "abc\x01", 4, 42, &truncated),
+			  "{\n\"char\": \"abc\"\n}");
+	CHECK(truncated);
+	CHECK_STR(identity(24, "abc\x01", 4, 42, &truncated),
+			  "{\n\"char\": \"abc\\u0001\"\n}");
+	// The string fit; the number did not and went with its key
+	CHECK(truncated);
+
+	// A three byte character is not split
+	CHECK_STR(identity(19, "ab\xE2\x82\xAC", 5, 42, &truncated),
+			  "{\n\"char\": \"ab\"\n}");
+	CHECK(truncated);
+	CHECK_STR(identity(20, "ab\xE2\x82\xAC", 5, 42, &truncated),
+			  "{\n\"char\": \"ab\xE2\x82\xAC\"\n}");
+
+	// Neither is a two byte escape
+	CHECK_STR(identity(18, "ab\"", 3, 42, &truncated),
+			  "{\n\"char\": \"ab\"\n}");
+	CHECK_STR(identity(19, "ab\"", 3, 42, &truncated),
+			  "{\n\"char\": \"ab\\\"\"\n}");
+
+	// Too small for even the key: an empty object
+	CHECK_STR(identity(8, "abc", 3, 42, &truncated), "{}");
+	CHECK(truncated);
+
+	CHECK_STR(identity(sizeof(buffer), "abc", 3, 42, &truncated),
+			  "{\n\"char\": \"abc\",\n\"leaderguid\": 42\n}");
+	CHECK(!truncated);
+
+	// Every size, for a name with every kind of special character
+	const char *nasty = "A\"\\\x01\xC3\x9E\xFF\xE2\x82\xAC\t\xF0\x9F\x98\x80z";
+	for (size_t capacity = 4; capacity <= 64; capacity++) {
+		memset(buffer, 0x55, sizeof(buffer));
+		const char *text =
+			identity(capacity, nasty, strlen(nasty), -7, &truncated);
+		CHECK(strlen(text) < capacity);
+		CHECK(wellFormed(text));
+		// Nothing written past the capacity
+		CHECK((unsigned char) buffer[capacity] == 0x55);
+	}
+}
+
+int main(void) {
+	testIntegers();
+	testEscaping();
+	testUtf8();
+	testTruncation();
+	return CHECK_DONE();
+}
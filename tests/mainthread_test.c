@@ -0,0 +1,103 @@
+// Main thread queue: tasks run in order with their own copy of the payload,
+// only on the thread that runs the queue, and nothing is queued outside of
+// mainthread_start/stop. A dispatcher that keeps logging can be stopped from
+// the main thread, which would deadlock if it called the API itself.
+
+#include "check.h"
+#include "events.h"
+#include "mainthread.h"
+#include "platform.h"
+#include "plugin.h"
+
+#include <stdatomic.h>
+
+struct MumbleAPI_v_1_0_x mumbleAPI;
+mumble_plugin_id_t ownID = 1;
+
+static _Thread_local bool onMainThread = false;
+static int logged                      = 0;
+static int loggedElsewhere             = 0;
+static char lastLog[64];
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiLog(mumble_plugin_id_t callerID, const char *message) {
+	(void) callerID;
+	logged++;
+	loggedElsewhere += !onMainThread;
+	snprintf(lastLog, sizeof(lastLog), "%s", message);
+	return MUMBLE_STATUS_OK;
+}
+
+static int order[4];
+static int ran = 0;
+
+static void record(const void *data, size_t size) {
+	CHECK(size == sizeof(int));
+	memcpy(&order[ran++ % 4], data, sizeof(int));
+}
+
+static atomic_int ticks = 0;
+
+static void logTick(uint64_t nowNs, void *userdata) {
+	(void) nowNs;
+	(void) userdata;
+	atomic_fetch_add(&ticks, 1);
+	mainthread_log("tick");
+}
+
+int main(void) {
+	mumbleAPI.log = apiLog;
+	onMainThread  = true;
+
+	// Refused before the start
+	int value = 0;
+	CHECK(!mainthread_post(record, &value, sizeof(value)));
+
+	mainthread_start();
+	for (value = 1; value <= 3; value++) {
+		CHECK(mainthread_post(record, &value, sizeof(value)));
+	}
+	value = 99;
+	CHECK(ran == 0);
+	mainthread_run();
+	CHECK(ran == 3);
+	CHECK(order[0] == 1 && order[1] == 2 && order[2] == 3);
+
+	// Full queue, too big a payload, and a message cut to fit
+	int posted = 0;
+	while (mainthread_post(record, &value, sizeof(value))) {
+		posted++;
+	}
+	CHECK(posted > 0);
+	static char big[MAINTHREAD_DATA_MAX + 1];
+	CHECK(!mainthread_post(record, big, sizeof(big)));
+	mainthread_run();
+	CHECK(ran == 3 + posted);
+	memset(big, 'x', sizeof(big) - 1);
+	CHECK(mainthread_log(big));
+	mainthread_run();
+	CHECK(strlen(lastLog) == sizeof(lastLog) - 1);
+
+	// A dispatcher that logs on every tick
+	logged = 0;
+	events_subscribeTick(logTick, NULL);
+	CHECK(events_start());
+	while (atomic_load(&ticks) < 3) {
+		mainthread_run();
+		plat_sleep_ms(10);
+	}
+	events_stop();
+	mainthread_run();
+	CHECK(logged >= 2);
+	CHECK(loggedElsewhere == 0);
+	CHECK_STR(lastLog, "tick");
+
+	// Dropped when stopping, refused afterwards
+	CHECK(mainthread_log("dropped"));
+	mainthread_stop();
+	CHECK(!mainthread_log("refused"));
+	mainthread_run();
+	CHECK_STR(lastLog, "tick");
+
+	return CHECK_DONE();
+}
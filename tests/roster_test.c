@@ -0,0 +1,137 @@
+// Roster: user churn with unique names must neither hang the string interning
+// nor lose users to index tombstones, and lookups keep working across the
+// rehashes and compactions that churn triggers.
+
+#include "check.h"
+#include "plugin.h"
+#include "roster.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CONNECTION 1
+
+struct MumbleAPI_v_1_0_x mumbleAPI;
+mumble_plugin_id_t ownID = 1;
+
+static int logged = 0;
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiLog(mumble_plugin_id_t callerID, const char *message) {
+	(void) callerID;
+	(void) message;
+	logged++;
+	return MUMBLE_STATUS_OK;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiFreeMemory(mumble_plugin_id_t callerID, const void *pointer) {
+	(void) callerID;
+	free((void *) pointer);
+	return MUMBLE_STATUS_OK;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiGetLocalUserID(mumble_plugin_id_t callerID,
+					  mumble_connection_t connection,
+					  mumble_userid_t *userID) {
+	(void) callerID;
+	(void) connection;
+	*userID = 0;
+	return MUMBLE_STATUS_OK;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiGetAllUsers(mumble_plugin_id_t callerID, mumble_connection_t connection,
+				   mumble_userid_t **users, size_t *userCount) {
+	(void) callerID;
+	(void) connection;
+	*users      = malloc(sizeof(mumble_userid_t));
+	(*users)[0] = 0;
+	*userCount  = 1;
+	return MUMBLE_STATUS_OK;
+}
+
+// Every user gets a name and a hash of its own, and long ones, so the string
+// arena fills up as users come and go
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiGetUserName(mumble_plugin_id_t callerID, mumble_connection_t connection,
+				   mumble_userid_t userID, const char **name) {
+	(void) callerID;
+	(void) connection;
+	char *text = malloc(64);
+	snprintf(text, 64, "user-%u-with-a-name-long-enough-to-matter", userID);
+	*name = text;
+	return MUMBLE_STATUS_OK;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiGetUserHash(mumble_plugin_id_t callerID, mumble_connection_t connection,
+				   mumble_userid_t userID, const char **hash) {
+	(void) callerID;
+	(void) connection;
+	char *text = malloc(64);
+	snprintf(text, 64, "%040x", userID * 2654435761u);
+	*hash = text;
+	return MUMBLE_STATUS_OK;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiGetChannelOfUser(mumble_plugin_id_t callerID,
+						mumble_connection_t connection, mumble_userid_t userID,
+						mumble_channelid_t *channel) {
+	(void) callerID;
+	(void) connection;
+	*channel = (mumble_channelid_t) (userID % 7);
+	return MUMBLE_STATUS_OK;
+}
+
+static bool hasName(mumble_userid_t userID) {
+	char expected[64];
+	snprintf(expected, sizeof(expected),
+			 "user-%u-with-a-name-long-enough-to-matter", userID);
+	struct RosterUser *user = roster_find(userID);
+	const char *name        = user ? atomic_load(&user->name) : NULL;
+	return name && strcmp(name, expected) == 0;
+}
+
+int main(void) {
+	mumbleAPI.log              = apiLog;
+	mumbleAPI.freeMemory       = apiFreeMemory;
+	mumbleAPI.getLocalUserID   = apiGetLocalUserID;
+	mumbleAPI.getAllUsers      = apiGetAllUsers;
+	mumbleAPI.getUserName      = apiGetUserName;
+	mumbleAPI.getUserHash      = apiGetUserHash;
+	mumbleAPI.getChannelOfUser = apiGetChannelOfUser;
+
+	roster_build(CONNECTION);
+	CHECK(hasName(0));
+
+	// A steady population of 500 with 100000 joins: far more unique strings
+	// than the intern table holds and more removals than the index has slots
+	const mumble_userid_t population = 500;
+	for (mumble_userid_t id = 1; id <= 100000; id++) {
+		roster_onUserAdded(CONNECTION, id);
+		if (id > population) {
+			roster_onUserRemoved(CONNECTION, id - population);
+		}
+		if (id % 9973 == 0) {
+			CHECK(hasName(id));
+			CHECK(roster_find(id - population) == NULL);
+		}
+	}
+
+	for (mumble_userid_t id = 100000 - population + 1; id <= 100000; id++) {
+		CHECK(hasName(id));
+		CHECK(atomic_load(&roster_find(id)->channel)
+			  == (mumble_channelid_t) (id % 7));
+	}
+	CHECK(hasName(0));
+	CHECK(roster_find(1) == NULL);
+	// Never ran out of space
+	CHECK(logged == 1);
+
+	roster_clear();
+	CHECK(roster_find(100000) == NULL);
+	return CHECK_DONE();
+}
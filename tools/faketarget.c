@@ -0,0 +1,161 @@
+// Stand-in for the game client: maps the addresses of wowlayout.h and keeps
+// writing a player walking in a circle to them, so the plugin can be run
+// against it without Wine or a client.
+//
+//   faketarget [--hz N] [--seconds N] [--radius YARDS] [--map ID]
+//              [--fault-every SECONDS --fault-ms MS] [--stamp-epoch NS]
+//
+// With --fault-every the client's memory becomes unreadable for --fault-ms
+// (default 500) at that interval, like a loading screen, so reads fail the
+// way they do under Wine. With --stamp-epoch the player walks a straight line
+// instead, at a speed that makes every frame's avatar x tell the time it was
+// written, counted from the given plat_now_ns() value (see faketarget.h), for
+// measuring how long positions take to get through (hostsim --latency).
+// Prints its pid and runs until killed or for the given time.
+
+#include "faketarget.h"
+#include "platform.h"
+#include "wowlayout.h"
+#include "wowreader.h"
+
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+
+#define WRITE(address, value) \
+	memcpy((void *) (uintptr_t) (address), &(value), sizeof(value))
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int signal) {
+	(void) signal;
+	stopRequested = 1;
+}
+
+// A lap every 20 seconds, facing along the circle
+static void writeFrame(double t, float radius) {
+	float angle       = (float) (t * 2.0 * M_PI / 20.0);
+	float position[3] = { radius * cosf(angle), radius * sinf(angle), 10.0f };
+	float heading     = angle + (float) M_PI_2;
+	float front[3]    = { cosf(heading), sinf(heading), 0.0f };
+	WRITE(WOW_ADDR_AVATAR_POS, position);
+	WRITE(WOW_ADDR_AVATAR_HEADING, heading);
+	WRITE(WOW_ADDR_CAMERA_FRONT, front);
+}
+
+// The time of writing as the avatar's x, see --stamp-epoch
+static void writeStamp(uint64_t epochNs) {
+	uint64_t ticks    = (plat_now_ns() - epochNs) / FAKETARGET_TICK_NS;
+	float position[3] = {
+		(float) ticks / FAKETARGET_TICKS_PER_YARD,
+		0.0f,
+		10.0f,
+	};
+	WRITE(WOW_ADDR_AVATAR_POS, position);
+}
+
+int main(int argc, char **argv) {
+	double hz         = 100.0;
+	double seconds    = 0.0;
+	float radius      = 20.0f;
+	int mapId         = 0;
+	double faultEvery = 0.0;
+	double faultMs    = 500.0;
+	uint64_t epochNs  = 0;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (strcmp(argv[i], "--hz") == 0) {
+			hz = atof(argv[i + 1]);
+		} else if (strcmp(argv[i], "--seconds") == 0) {
+			seconds = atof(argv[i + 1]);
+		} else if (strcmp(argv[i], "--radius") == 0) {
+			radius = (float) atof(argv[i + 1]);
+		} else if (strcmp(argv[i], "--map") == 0) {
+			mapId = atoi(argv[i + 1]);
+		} else if (strcmp(argv[i], "--fault-every") == 0) {
+			faultEvery = atof(argv[i + 1]);
+		} else if (strcmp(argv[i], "--fault-ms") == 0) {
+			faultMs = atof(argv[i + 1]);
+		} else if (strcmp(argv[i], "--stamp-epoch") == 0) {
+			epochNs = strtoull(argv[i + 1], NULL, 10);
+		} else {
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+	if (hz <= 0.0) {
+		hz = 100.0;
+	}
+
+	void *region = mmap((void *) (uintptr_t) WOW_ADDR_FIRST,
+						WOW_ADDR_END - WOW_ADDR_FIRST, PROT_READ | PROT_WRITE,
+						MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1,
+						0);
+	if (region == MAP_FAILED
+		|| (uintptr_t) region != (uintptr_t) WOW_ADDR_FIRST) {
+		perror("faketarget: cannot map the client's address range");
+		return 1;
+	}
+
+	// Named like the client so wowreader_findClient() picks it up
+	prctl(PR_SET_NAME, WOW_EXE);
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	const char player[50] = "Faketarget";
+	uint8_t playerClass   = 1;
+	int zoneId            = 12;
+	int leaderGUID        = 0;
+	float top[3]          = { 0.0f, 0.0f, 1.0f };
+	float corpse[3]       = { 0.0f, 0.0f, 0.0f };
+	char state            = 1;
+	WRITE(WOW_ADDR_PLAYER, player);
+	WRITE(WOW_ADDR_CLASS, playerClass);
+	WRITE(WOW_ADDR_MAP_ID, mapId);
+	WRITE(WOW_ADDR_ZONE_ID, zoneId);
+	WRITE(WOW_ADDR_LEADER_GUID, leaderGUID);
+	WRITE(WOW_ADDR_CAMERA_TOP, top);
+	WRITE(WOW_ADDR_CORPSE_POS, corpse);
+	WRITE(WOW_ADDR_STATE, state);
+
+	printf("%ld\n", (long) getpid());
+	fflush(stdout);
+
+	uint64_t periodNs = (uint64_t) (1e9 / hz);
+	uint64_t startNs  = plat_now_ns();
+	bool unreadable   = false;
+	for (uint64_t frame = 0; !stopRequested; frame++) {
+		double t = (double) (plat_now_ns() - startNs) * 1e-9;
+		if (seconds > 0.0 && t >= seconds) {
+			break;
+		}
+
+		// Inside a fault window the pages are inaccessible to readers and
+		// to us alike
+		bool faulted = faultEvery > 0.0 && t >= faultEvery
+					   && fmod(t, faultEvery) * 1e3 < faultMs;
+		if (faulted != unreadable) {
+			unreadable = faulted;
+			mprotect(region, WOW_ADDR_END - WOW_ADDR_FIRST,
+					 faulted ? PROT_NONE : PROT_READ | PROT_WRITE);
+		}
+		if (!unreadable && epochNs != 0) {
+			writeStamp(epochNs);
+		} else if (!unreadable) {
+			writeFrame(t, radius);
+		}
+
+		uint64_t nextNs = startNs + (frame + 1) * periodNs;
+		uint64_t nowNs  = plat_now_ns();
+		if (nextNs > nowNs) {
+			plat_sleep_ms((uint32_t) ((nextNs - nowNs) / 1000000ull));
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef WOW335PA_TOOLS_FAKETARGET_H_
+#define WOW335PA_TOOLS_FAKETARGET_H_
+
+// Shared by faketarget and hostsim: with --stamp-epoch, faketarget walks the
+// avatar along x, one yard per FAKETARGET_TICKS_PER_YARD ticks since the
+// epoch, so x tells when the position was written. That is 390 yards a
+// second: fast, but less than a teleport (gamestate.c) per frame at
+// FAKETARGET_STAMP_MIN_HZ frames a second and more. A float holds x exactly
+// for the first 167 seconds.
+#define FAKETARGET_TICK_NS 10000ull
+#define FAKETARGET_TICKS_PER_YARD 256.0f
+#define FAKETARGET_STAMP_MIN_HZ 10
+
+#endif // WOW335PA_TOOLS_FAKETARGET_H_
@@ -0,0 +1,643 @@
+// Minimal stand-in for Mumble: loads the plugin with dlopen and drives its
+// callbacks from threads shaped like Mumble's, i.e. the main thread, the
+// positional thread, the audio input thread and the audio output thread (every
+// source of a frame, then the final mix).
+//
+//   hostsim [options] [plugin]
+//     --seconds N     run time (default 5)
+//     --pid PID       read this process instead of starting faketarget
+//     --fetch-ms N    positional fetch interval (default 20)
+//     --sources N     sources fetched per output frame (default 4)
+//     --fault-every N make faketarget's memory unreadable for half a second
+//                     every N seconds (see faketarget.c)
+//     --game-hz N     frames faketarget writes per second (default 100)
+//     --latency       have faketarget write timestamped positions and report
+//                     how old they are when an input frame is sent: the delay
+//                     from the game writing a position to the first frame
+//                     sent with it, and the age of the position at every frame
+//     --fetch-on-input
+//                     call mumble_fetchPositionalData from the audio input
+//                     thread after every mumble_onAudioInput, like an encoder
+//                     that fetches the position it attaches, instead of from
+//                     the positional thread every --fetch-ms
+//     --rt-check      report every allocation, blocking call and Mumble API
+//                     call made inside mumble_fetchPositionalData or an audio
+//                     callback, and every system call made inside an audio
+//                     callback (see rtcheck.h); exits with 1 if there was any
+//
+// The plugin reads its configuration as usual, so XDG_CONFIG_HOME selects the
+// wow335pa.conf to test with.
+
+#include "MumbleAPI_v_1_0_x.h"
+#include "faketarget.h"
+#include "platform.h"
+#include "rtcheck.h"
+
+#include <dlfcn.h>
+#include <math.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#ifndef HOSTSIM_PLUGIN
+#	define HOSTSIM_PLUGIN "libwow355pa_linux_x86_64.so"
+#endif
+#ifndef HOSTSIM_FAKETARGET
+#	define HOSTSIM_FAKETARGET "faketarget"
+#endif
+
+// 10 ms frames, like Mumble
+#define SAMPLE_RATE 48000
+#define FRAME_SAMPLES 480
+#define FRAME_NS 10000000ull
+#define MAX_SOURCES 64
+// The plugin takes fewer processes as a sign of missing permissions
+#define PROCESS_LIST_SIZE 64
+
+#define PLUGIN_ID 1
+// How often the main thread makes a callback, see main()
+#define MAIN_TICK_MS 100
+
+struct Plugin {
+	void *handle;
+	mumble_error_t (*init)(mumble_plugin_id_t);
+	void (*shutdown)(void);
+	void (*registerAPIFunctions)(void *);
+	uint8_t (*initPositionalData)(const char *const *, const uint64_t *,
+								  size_t);
+	bool (*fetchPositionalData)(float *, float *, float *, float *, float *,
+								float *, const char **, const char **);
+	void (*shutdownPositionalData)(void);
+	bool (*onAudioInput)(short *, uint32_t, uint16_t, uint32_t, bool);
+	bool (*onAudioSourceFetched)(float *, uint32_t, uint16_t, uint32_t, bool,
+								 mumble_userid_t);
+	bool (*onAudioOutputAboutToPlay)(float *, uint32_t, uint16_t, uint32_t);
+	void (*onUserTalkingStateChanged)(mumble_connection_t, mumble_userid_t,
+									  mumble_talking_state_t);
+};
+
+// Time spent in one kind of callback
+struct Timing {
+	const char *name;
+	uint64_t calls;
+	uint64_t totalNs;
+	uint64_t maxNs;
+};
+
+static struct Plugin plugin;
+static atomic_bool running    = true;
+// From mumble_init to the first fetch with the avatar somewhere
+static uint64_t initNs;
+static uint64_t firstPositionNs;
+static bool rtCheck           = false;
+static uint32_t fetchMs       = 20;
+static uint32_t sources       = 4;
+static pid_t targetPid        = 0;
+static const char *faultEvery = NULL;
+static const char *gameHz     = NULL;
+static bool fetchOnInput      = false;
+
+// --latency: faketarget's epoch, the avatar's x of the latest fetch (float
+// bits; it tells when faketarget wrote it), and what the input thread saw
+static bool latency = false;
+static uint64_t epochNs;
+static _Atomic uint32_t fetchedStamp;
+static atomic_bool positionalReady = false;
+static atomic_bool inputFinished   = false;
+static uint64_t *motionNs;
+static uint64_t *ageNs;
+static size_t motionCount, ageCount, latencyCapacity;
+
+static struct Timing fetchTiming  = { .name = "mumble_fetchPositionalData" };
+static struct Timing inputTiming  = { .name = "mumble_onAudioInput" };
+static struct Timing sourceTiming = { .name = "mumble_onAudioSourceFetched" };
+static struct Timing mixTiming    = {
+	.name = "mumble_onAudioOutputAboutToPlay",
+};
+
+static void begin(const struct Timing *timing, uint64_t *startNs) {
+	rtcheck_enter(timing->name);
+	*startNs = plat_now_ns();
+}
+
+static void end(struct Timing *timing, uint64_t startNs) {
+	uint64_t elapsedNs = plat_now_ns() - startNs;
+	rtcheck_leave();
+	timing->calls++;
+	timing->totalNs += elapsedNs;
+	if (elapsedNs > timing->maxNs) {
+		timing->maxNs = elapsedNs;
+	}
+}
+
+// Mumble API. Every function runs on Mumble's main thread in the real client
+// and blocks the calling thread until it did, so none of them may be called
+// from a real-time path.
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiLog(mumble_plugin_id_t callerID, const char *message) {
+	(void) callerID;
+
+	rtcheck_report("mumbleAPI.log");
+	printf("[plugin] %s\n", message);
+	return MUMBLE_STATUS_OK;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiFreeMemory(mumble_plugin_id_t callerID, const void *pointer) {
+	(void) callerID;
+	(void) pointer;
+
+	rtcheck_report("mumbleAPI.freeMemory");
+	return MUMBLE_STATUS_OK;
+}
+
+// Not connected to a server
+static mumble_error_t PLUGIN_CALLING_CONVENTION apiGetActiveServerConnection(
+	mumble_plugin_id_t callerID, mumble_connection_t *connection) {
+	(void) callerID;
+	(void) connection;
+
+	rtcheck_report("mumbleAPI.getActiveServerConnection");
+	return MUMBLE_EC_NO_ACTIVE_CONNECTION;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiGetLocalUserID(mumble_plugin_id_t callerID,
+					  mumble_connection_t connection,
+					  mumble_userid_t *userID) {
+	(void) callerID;
+	(void) connection;
+	(void) userID;
+
+	rtcheck_report("mumbleAPI.getLocalUserID");
+	return MUMBLE_EC_CONNECTION_NOT_FOUND;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiIsUserLocallyMuted(mumble_plugin_id_t callerID,
+						  mumble_connection_t connection,
+						  mumble_userid_t userID, bool *muted) {
+	(void) callerID;
+	(void) connection;
+	(void) userID;
+	(void) muted;
+
+	rtcheck_report("mumbleAPI.isUserLocallyMuted");
+	return MUMBLE_EC_CONNECTION_NOT_FOUND;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiRequestLocalMute(mumble_plugin_id_t callerID,
+						mumble_connection_t connection, mumble_userid_t userID,
+						bool muted) {
+	(void) callerID;
+	(void) connection;
+	(void) userID;
+	(void) muted;
+
+	rtcheck_report("mumbleAPI.requestLocalMute");
+	return MUMBLE_EC_CONNECTION_NOT_FOUND;
+}
+
+static mumble_error_t PLUGIN_CALLING_CONVENTION
+	apiSendData(mumble_plugin_id_t callerID, mumble_connection_t connection,
+				const mumble_userid_t *users, size_t userCount,
+				const uint8_t *data, size_t dataLength, const char *dataID) {
+	(void) callerID;
+	(void) connection;
+	(void) users;
+	(void) userCount;
+	(void) data;
+	(void) dataLength;
+	(void) dataID;
+
+	rtcheck_report("mumbleAPI.sendData");
+	return MUMBLE_EC_CONNECTION_NOT_FOUND;
+}
+
+// Stores a symbol of the plugin in a function pointer
+static bool resolve(void *function, const char *symbol) {
+	void *address = dlsym(plugin.handle, symbol);
+	if (!address) {
+		fprintf(stderr, "hostsim: %s is missing\n", symbol);
+		return false;
+	}
+	memcpy(function, &address, sizeof(address));
+	return true;
+}
+
+static bool loadPlugin(const char *path) {
+	plugin.handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!plugin.handle) {
+		fprintf(stderr, "hostsim: %s\n", dlerror());
+		return false;
+	}
+
+	return resolve(&plugin.init, "mumble_init")
+		   && resolve(&plugin.shutdown, "mumble_shutdown")
+		   && resolve(&plugin.registerAPIFunctions,
+					  "mumble_registerAPIFunctions")
+		   && resolve(&plugin.initPositionalData, "mumble_initPositionalData")
+		   && resolve(&plugin.fetchPositionalData,
+					  "mumble_fetchPositionalData")
+		   && resolve(&plugin.shutdownPositionalData,
+					  "mumble_shutdownPositionalData")
+		   && resolve(&plugin.onAudioInput, "mumble_onAudioInput")
+		   && resolve(&plugin.onAudioSourceFetched,
+					  "mumble_onAudioSourceFetched")
+		   && resolve(&plugin.onAudioOutputAboutToPlay,
+					  "mumble_onAudioOutputAboutToPlay")
+		   && resolve(&plugin.onUserTalkingStateChanged,
+					  "mumble_onUserTalkingStateChanged");
+}
+
+// Starts faketarget and waits until it has mapped the client's memory
+static pid_t spawnTarget(const char *path) {
+	int pipeFds[2];
+	if (pipe(pipeFds) != 0) {
+		return 0;
+	}
+	pid_t pid = fork();
+	if (pid == 0) {
+		// Do not leave it running if the host crashes
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
+		dup2(pipeFds[1], STDOUT_FILENO);
+		close(pipeFds[0]);
+		close(pipeFds[1]);
+		char epoch[32];
+		snprintf(epoch, sizeof(epoch), "%llu", (unsigned long long) epochNs);
+		const char *args[10];
+		int count     = 0;
+		args[count++] = path;
+		if (faultEvery) {
+			args[count++] = "--fault-every";
+			args[count++] = faultEvery;
+		}
+		if (gameHz) {
+			args[count++] = "--hz";
+			args[count++] = gameHz;
+		}
+		if (latency) {
+			args[count++] = "--stamp-epoch";
+			args[count++] = epoch;
+		}
+		args[count] = NULL;
+		execv(path, (char *const *) args);
+		_exit(127);
+	}
+	close(pipeFds[1]);
+
+	char line[32] = { 0 };
+	FILE *output  = fdopen(pipeFds[0], "r");
+	if (pid < 0 || !output || !fgets(line, sizeof(line), output)) {
+		fprintf(stderr, "hostsim: could not start %s\n", path);
+		if (pid > 0) {
+			kill(pid, SIGTERM);
+			waitpid(pid, NULL, 0);
+		}
+		pid = 0;
+	}
+	if (output) {
+		fclose(output);
+	}
+	return pid;
+}
+
+// One timed fetch, from whichever thread fetches
+static bool fetch(void) {
+	float avatarPos[3], avatarDir[3], avatarAxis[3];
+	float cameraPos[3], cameraDir[3], cameraAxis[3];
+	const char *context, *identity;
+
+	uint64_t startNs;
+	begin(&fetchTiming, &startNs);
+	bool ok = plugin.fetchPositionalData(avatarPos, avatarDir, avatarAxis,
+										 cameraPos, cameraDir, cameraAxis,
+										 &context, &identity);
+	end(&fetchTiming, startNs);
+	if (!ok) {
+		return false;
+	}
+	if (firstPositionNs == 0
+		&& (avatarPos[0] != 0.0f || avatarPos[1] != 0.0f
+			|| avatarPos[2] != 0.0f)) {
+		firstPositionNs = plat_now_ns() - initNs;
+	}
+	// The game's x is Mumble's z
+	uint32_t stamp;
+	memcpy(&stamp, &avatarPos[2], sizeof(stamp));
+	atomic_store_explicit(&fetchedStamp, stamp, memory_order_relaxed);
+	return true;
+}
+
+// With --latency, after every input frame: how old the position it would be
+// sent with is and, the first time a position is sent, how long that took
+// since faketarget wrote it
+static void recordLatency(void) {
+	static uint32_t lastStamp = 0;
+	uint32_t stamp =
+		atomic_load_explicit(&fetchedStamp, memory_order_relaxed);
+	float x;
+	memcpy(&x, &stamp, sizeof(x));
+	float ticks        = x * FAKETARGET_TICKS_PER_YARD;
+	uint64_t writtenNs = epochNs + (uint64_t) ticks * FAKETARGET_TICK_NS;
+	uint64_t nowNs     = plat_now_ns();
+	if (ticks <= 0.0f || writtenNs > nowNs || ageCount == latencyCapacity) {
+		return;
+	}
+
+	ageNs[ageCount++] = nowNs - writtenNs;
+	if (stamp != lastStamp) {
+		lastStamp                 = stamp;
+		motionNs[motionCount++] = nowNs - writtenNs;
+	}
+}
+
+static void positionalMain(void *arg) {
+	(void) arg;
+
+	const char *names[PROCESS_LIST_SIZE];
+	uint64_t pids[PROCESS_LIST_SIZE];
+	for (size_t i = 0; i < PROCESS_LIST_SIZE; i++) {
+		names[i] = "idle";
+		pids[i]  = 0;
+	}
+	names[PROCESS_LIST_SIZE - 1] = "wow.exe";
+	pids[PROCESS_LIST_SIZE - 1]  = (uint64_t) targetPid;
+
+	while (atomic_load(&running)
+		   && plugin.initPositionalData(names, pids, PROCESS_LIST_SIZE)
+				  != MUMBLE_PDEC_OK) {
+		plat_sleep_ms(500);
+	}
+	atomic_store(&positionalReady, true);
+
+	while (atomic_load(&running) && (fetchOnInput || fetch())) {
+		plat_sleep_ms(fetchMs);
+	}
+
+	// The input thread may still be fetching
+	while (fetchOnInput && !atomic_load(&inputFinished)) {
+		plat_sleep_ms(1);
+	}
+	plugin.shutdownPositionalData();
+}
+
+// Paces an audio thread without any system call the seccomp filter traps
+static void waitUntil(uint64_t deadlineNs) {
+	struct timespec deadline;
+	deadline.tv_sec  = (time_t) (deadlineNs / 1000000000ull);
+	deadline.tv_nsec = (long) (deadlineNs % 1000000000ull);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL)
+		   != 0) {
+	}
+}
+
+static void startAudioThread(const char *name) {
+	if (rtCheck && !rtcheck_installSeccomp()) {
+		fprintf(stderr,
+				"hostsim: no seccomp on the %s thread, system calls are "
+				"not traced\n",
+				name);
+	}
+}
+
+static void finishAudioThread(void) {
+	if (rtCheck) {
+		rtcheck_exitThread();
+	}
+}
+
+static void inputMain(void *arg) {
+	(void) arg;
+
+	static short pcm[FRAME_SAMPLES];
+	startAudioThread("audio input");
+
+	uint64_t nextNs = plat_now_ns();
+	for (uint32_t frame = 0; atomic_load(&running); frame++) {
+		for (uint32_t i = 0; i < FRAME_SAMPLES; i++) {
+			pcm[i] = (short) (8000.0f
+							  * sinf((float) (frame * FRAME_SAMPLES + i)
+									 * 0.05f));
+		}
+		uint64_t startNs;
+		begin(&inputTiming, &startNs);
+		plugin.onAudioInput(pcm, FRAME_SAMPLES, 1, SAMPLE_RATE, true);
+		end(&inputTiming, startNs);
+		if (fetchOnInput && atomic_load(&positionalReady)) {
+			fetch();
+		}
+		if (latency) {
+			recordLatency();
+		}
+
+		nextNs += FRAME_NS;
+		waitUntil(nextNs);
+	}
+
+	atomic_store(&inputFinished, true);
+	finishAudioThread();
+}
+
+static void outputMain(void *arg) {
+	(void) arg;
+
+	static float source[FRAME_SAMPLES];
+	static float output[FRAME_SAMPLES * 2];
+	startAudioThread("audio output");
+
+	uint64_t nextNs = plat_now_ns();
+	for (uint32_t frame = 0; atomic_load(&running); frame++) {
+		memset(output, 0, sizeof(output));
+		for (uint32_t s = 0; s < sources; s++) {
+			for (uint32_t i = 0; i < FRAME_SAMPLES; i++) {
+				source[i] = 0.25f
+							* sinf((float) (frame * FRAME_SAMPLES + i)
+								   * 0.01f * (float) (s + 1));
+			}
+			uint64_t startNs;
+			begin(&sourceTiming, &startNs);
+			plugin.onAudioSourceFetched(source, FRAME_SAMPLES, 1, SAMPLE_RATE,
+										true, (mumble_userid_t) (s + 1));
+			end(&sourceTiming, startNs);
+		}
+		uint64_t startNs;
+		begin(&mixTiming, &startNs);
+		plugin.onAudioOutputAboutToPlay(output, FRAME_SAMPLES, 2, SAMPLE_RATE);
+		end(&mixTiming, startNs);
+
+		nextNs += FRAME_NS;
+		waitUntil(nextNs);
+	}
+
+	finishAudioThread();
+}
+
+static void printTiming(const struct Timing *timing) {
+	printf("%-34s %8llu calls  mean %8.2f us  max %8.2f us\n", timing->name,
+		   (unsigned long long) timing->calls,
+		   timing->calls ? (double) timing->totalNs / timing->calls / 1e3
+						 : 0.0,
+		   (double) timing->maxNs / 1e3);
+}
+
+static int compareNs(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return (x > y) - (x < y);
+}
+
+static void printLatency(const char *name, uint64_t *values, size_t count) {
+	if (count == 0) {
+		printf("%-34s no positions\n", name);
+		return;
+	}
+	qsort(values, count, sizeof(values[0]), compareNs);
+	printf("%-34s p50 %6.2f ms  p90 %6.2f ms  p99 %6.2f ms  max %6.2f ms  "
+		   "(%zu)\n",
+		   name, (double) values[(count - 1) / 2] / 1e6,
+		   (double) values[(count - 1) * 9 / 10] / 1e6,
+		   (double) values[(count - 1) * 99 / 100] / 1e6,
+		   (double) values[count - 1] / 1e6, count);
+}
+
+int main(int argc, char **argv) {
+	const char *pluginPath = HOSTSIM_PLUGIN;
+	double seconds         = 5.0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--rt-check") == 0) {
+			rtCheck = true;
+		} else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+			seconds = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--pid") == 0 && i + 1 < argc) {
+			targetPid = (pid_t) atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--fetch-ms") == 0 && i + 1 < argc) {
+			fetchMs = (uint32_t) atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--fault-every") == 0 && i + 1 < argc) {
+			faultEvery = argv[++i];
+		} else if (strcmp(argv[i], "--game-hz") == 0 && i + 1 < argc) {
+			gameHz = argv[++i];
+		} else if (strcmp(argv[i], "--latency") == 0) {
+			latency = true;
+		} else if (strcmp(argv[i], "--fetch-on-input") == 0) {
+			fetchOnInput = true;
+		} else if (strcmp(argv[i], "--sources") == 0 && i + 1 < argc) {
+			sources = (uint32_t) atoi(argv[++i]);
+			if (sources > MAX_SOURCES) {
+				sources = MAX_SOURCES;
+			}
+		} else if (argv[i][0] != '-') {
+			pluginPath = argv[i];
+		} else {
+			fprintf(stderr, "hostsim: unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	// faketarget's timestamps are exact for 167 seconds, and at fewer frames
+	// a second its avatar would seem to teleport
+	if (latency
+		&& (targetPid != 0 || seconds > 160.0
+			|| (gameHz && atof(gameHz) < FAKETARGET_STAMP_MIN_HZ))) {
+		fprintf(stderr, "hostsim: --latency needs faketarget, at most 160 "
+						"seconds and a --game-hz of at least %d\n",
+				FAKETARGET_STAMP_MIN_HZ);
+		return 2;
+	}
+	if (latency) {
+		latencyCapacity = (size_t) (seconds * 1e9 / FRAME_NS) + 16;
+		motionNs        = calloc(latencyCapacity, sizeof(uint64_t));
+		ageNs           = calloc(latencyCapacity, sizeof(uint64_t));
+		if (!motionNs || !ageNs) {
+			return 2;
+		}
+	}
+
+	rtcheck_init();
+
+	epochNs      = plat_now_ns();
+	bool spawned = false;
+	if (targetPid == 0) {
+		targetPid = spawnTarget(HOSTSIM_FAKETARGET);
+		spawned   = targetPid != 0;
+		if (!spawned) {
+			return 2;
+		}
+	}
+	if (!loadPlugin(pluginPath)) {
+		return 2;
+	}
+
+	// Functions the plugin only calls while connected to a server stay NULL
+	struct MumbleAPI_v_1_0_x api;
+	memset(&api, 0, sizeof(api));
+	api.log                       = apiLog;
+	api.freeMemory                = apiFreeMemory;
+	api.getActiveServerConnection = apiGetActiveServerConnection;
+	api.getLocalUserID            = apiGetLocalUserID;
+	api.isUserLocallyMuted        = apiIsUserLocallyMuted;
+	api.requestLocalMute          = apiRequestLocalMute;
+	api.sendData                  = apiSendData;
+	plugin.registerAPIFunctions(&api);
+	initNs = plat_now_ns();
+	plugin.init(PLUGIN_ID);
+
+	// Only the callbacks are real-time paths; loading may allocate
+	rtcheck_arm(rtCheck);
+
+	plat_thread_t positional, input, output;
+	bool started = plat_thread_start(&positional, positionalMain, NULL)
+				   && plat_thread_start(&input, inputMain, NULL)
+				   && plat_thread_start(&output, outputMain, NULL);
+	if (!started) {
+		fprintf(stderr, "hostsim: could not start the threads\n");
+		return 2;
+	}
+	// Mumble's main thread. The plugin runs the work its dispatcher queued for
+	// the main thread in every callback made there; a user talking on
+	// push-to-talk stands in for the server traffic that makes them.
+	uint64_t endNs = plat_now_ns() + (uint64_t) (seconds * 1e9);
+	for (bool talking = true; plat_now_ns() < endNs; talking = !talking) {
+		plat_sleep_ms(MAIN_TICK_MS);
+		plugin.onUserTalkingStateChanged(
+			0, 0, talking ? MUMBLE_TS_TALKING : MUMBLE_TS_PASSIVE);
+	}
+	atomic_store(&running, false);
+	plat_thread_join(positional);
+	plat_thread_join(input);
+	plat_thread_join(output);
+
+	rtcheck_arm(false);
+	plugin.shutdown();
+	if (spawned) {
+		kill(targetPid, SIGTERM);
+		waitpid(targetPid, NULL, 0);
+	}
+
+	printTiming(&fetchTiming);
+	printTiming(&inputTiming);
+	printTiming(&sourceTiming);
+	printTiming(&mixTiming);
+	if (firstPositionNs != 0) {
+		printf("first position %.1f ms after mumble_init\n",
+			   (double) firstPositionNs / 1e6);
+	} else {
+		printf("no position read\n");
+	}
+	if (latency) {
+		printLatency("game write to first frame sent", motionNs,
+					 motionCount);
+		printLatency("position age at every frame sent", ageNs, ageCount);
+	}
+	if (rtCheck) {
+		printf("rtcheck: %u violations\n", rtcheck_violations());
+		return rtcheck_violations() == 0 ? 0 : 1;
+	}
+	return 0;
+}
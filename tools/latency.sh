@@ -0,0 +1,43 @@
+#!/bin/sh
+# Motion-to-encode latency of every sampler mode (reader.sampler), headless.
+#
+#   tools/latency.sh [build directory] [seconds per run]
+#
+# hostsim runs the plugin in the build directory (default build, configured
+# with -DBUILD_TOOLS=ON) against faketarget writing a timestamped position 60
+# times a second, once per mode with Mumble's positional thread fetching every
+# 20 ms and once with the input thread fetching before every frame it sends.
+# Each run prints how long a position took from the game writing it to the
+# first input frame sent with it, and how old the position was at every frame.
+# Mumble's network and the listener's audio come after that and do not depend
+# on the plugin.
+
+set -eu
+
+build_dir=${1:-build}
+seconds=${2:-10}
+hostsim="$build_dir/tools/hostsim"
+if [ ! -x "$hostsim" ]; then
+	echo "no $hostsim; configure $build_dir with -DBUILD_TOOLS=ON" >&2
+	exit 1
+fi
+
+config_dir=$(mktemp -d)
+trap 'rm -rf "$config_dir"' EXIT
+
+for fetch in positional input; do
+	if [ "$fetch" = input ]; then
+		set -- --fetch-on-input
+		echo "== fetched by the input thread before every frame"
+	else
+		set --
+		echo "== fetched by the positional thread every 20 ms"
+	fi
+	for mode in inline thread adaptive aligned; do
+		printf 'reader.sampler = %s\ndebug.positions_ms = 0\n' "$mode" \
+			>"$config_dir/wow335pa.conf"
+		echo "-- $mode"
+		XDG_CONFIG_HOME="$config_dir" "$hostsim" --latency --game-hz 60 \
+			--seconds "$seconds" "$@" | grep -E '^(game write|position age)'
+	done
+done
@@ -0,0 +1,746 @@
+// Memory scanner for finding the addresses of wowlayout.h in a new client
+// build. Snapshots of the target's writable mappings are written to files and
+// memory-mapped back, so a pair of large snapshots costs page cache, not heap;
+// candidate addresses are a bitmap narrowed by the kernels of scan.h.
+//
+//   memscan snapshot PID FILE [--all]
+//       Reads every writable mapping of PID (below 4 GiB, where a 32-bit
+//       client lives, unless --all) with the plugin's reader.
+//   memscan narrow CANDIDATES TYPE OP [ARG...] [BEFORE] AFTER
+//       TYPE is u8, i32, u32 or f32. OP is one of
+//         equal | changed | increased | decreased    BEFORE and AFTER
+//         near EPSILON                               BEFORE and AFTER, f32
+//         value V [EPSILON]                          AFTER only
+//       The first narrow creates CANDIDATES with every element of AFTER;
+//       later ones only keep what still matches.
+//   memscan list CANDIDATES SNAPSHOT [--limit N]
+//   memscan schema CANDIDATES SNAPSHOT NAME
+//       Prints the survivors as a WOW_ADDR_ definition for wowlayout.h.
+//   memscan bench [MB]
+//       Checks the vector kernels against the scalar ones on random data and
+//       prints their throughput.
+//
+// A typical search for the heading: snapshot, turn, snapshot, narrow changed;
+// stand still, snapshot, narrow equal; and so on until a few are left.
+
+#include "platform.h"
+#include "scan.h"
+#include "wowreader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SNAPSHOT_MAGIC "W3SNAP01"
+#define CANDIDATES_MAGIC "W3CAND01"
+#define PAGE_SIZE 4096
+#define CHUNK_SIZE (1u << 20)
+#define MAX_REGIONS 65536
+#define LOW_MEMORY_END 0x100000000ull
+
+struct SnapshotHeader {
+	char magic[8];
+	uint64_t pid;
+	uint64_t timestampNs;
+	uint32_t regionCount;
+	uint32_t reserved;
+};
+
+struct SnapshotRegion {
+	uint64_t start;
+	uint64_t size;
+	// From the start of the file, page aligned
+	uint64_t offset;
+	// Bytes that could not be read and were left zero
+	uint64_t unreadable;
+};
+
+struct CandidatesHeader {
+	char magic[8];
+	uint32_t type;
+	uint32_t regionCount;
+	uint64_t alive;
+	uint64_t passes;
+};
+
+struct CandidatesRegion {
+	uint64_t start;
+	uint64_t size;
+	// From the start of the file, to uint64_t bitmap words
+	uint64_t offset;
+	uint64_t reserved;
+};
+
+struct Mapping {
+	uint8_t *data;
+	size_t size;
+};
+
+static bool mapFile(const char *path, bool writable, size_t createSize,
+					struct Mapping *mapping) {
+	int flags = writable ? O_RDWR : O_RDONLY;
+	if (createSize) {
+		flags |= O_CREAT | O_TRUNC;
+	}
+	int fd = open(path, flags, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "memscan: %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	struct stat info;
+	if (createSize && ftruncate(fd, (off_t) createSize) != 0) {
+		fprintf(stderr, "memscan: %s: %s\n", path, strerror(errno));
+		close(fd);
+		return false;
+	}
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		fprintf(stderr, "memscan: %s is empty\n", path);
+		close(fd);
+		return false;
+	}
+
+	mapping->size = (size_t) info.st_size;
+	mapping->data = mmap(NULL, mapping->size,
+						 writable ? PROT_READ | PROT_WRITE : PROT_READ,
+						 MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping->data == MAP_FAILED) {
+		fprintf(stderr, "memscan: cannot map %s: %s\n", path,
+				strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+static void unmapFile(struct Mapping *mapping) {
+	munmap(mapping->data, mapping->size);
+}
+
+// Snapshots
+
+struct Snapshot {
+	struct Mapping file;
+	const struct SnapshotHeader *header;
+	const struct SnapshotRegion *regions;
+};
+
+static bool openSnapshot(const char *path, struct Snapshot *snapshot) {
+	if (!mapFile(path, false, 0, &snapshot->file)) {
+		return false;
+	}
+	snapshot->header  = (const struct SnapshotHeader *) snapshot->file.data;
+	snapshot->regions = (const struct SnapshotRegion *) (snapshot->header + 1);
+
+	const struct SnapshotHeader *header = snapshot->header;
+	bool valid =
+		snapshot->file.size >= sizeof(*header)
+		&& memcmp(header->magic, SNAPSHOT_MAGIC, 8) == 0
+		&& header->regionCount <= MAX_REGIONS
+		&& sizeof(*header) + header->regionCount * sizeof(*snapshot->regions)
+			   <= snapshot->file.size;
+	for (uint32_t i = 0; valid && i < header->regionCount; i++) {
+		valid = snapshot->regions[i].offset + snapshot->regions[i].size
+				<= snapshot->file.size;
+	}
+	if (!valid) {
+		fprintf(stderr, "memscan: %s is not a snapshot\n", path);
+		unmapFile(&snapshot->file);
+	}
+	return valid;
+}
+
+static const struct SnapshotRegion *findRegion(const struct Snapshot *snapshot,
+											   uint64_t start) {
+	// Regions are sorted by address, as in /proc/PID/maps
+	uint32_t low = 0, high = snapshot->header->regionCount;
+	while (low < high) {
+		uint32_t middle = (low + high) / 2;
+		if (snapshot->regions[middle].start < start) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	if (low < snapshot->header->regionCount
+		&& snapshot->regions[low].start == start) {
+		return &snapshot->regions[low];
+	}
+	return NULL;
+}
+
+static int takeSnapshot(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: memscan snapshot PID FILE [--all]\n");
+		return 2;
+	}
+	uint64_t pid  = strtoull(argv[0], NULL, 10);
+	bool all      = argc > 2 && strcmp(argv[2], "--all") == 0;
+	uint64_t *map = malloc(MAX_REGIONS * 2 * sizeof(uint64_t));
+	uint32_t count = 0;
+
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%" PRIu64 "/maps", pid);
+	FILE *maps = fopen(path, "r");
+	if (!maps || !map) {
+		fprintf(stderr, "memscan: cannot read %s\n", path);
+		free(map);
+		return 1;
+	}
+	char line[512];
+	while (count < MAX_REGIONS && fgets(line, sizeof(line), maps)) {
+		uint64_t start, end;
+		char perms[5];
+		if (sscanf(line, "%" SCNx64 "-%" SCNx64 " %4s", &start, &end, perms)
+				!= 3
+			|| perms[0] != 'r' || perms[1] != 'w' || strstr(line, "[vvar")) {
+			continue;
+		}
+		if (!all && start >= LOW_MEMORY_END) {
+			continue;
+		}
+		if (!all && end > LOW_MEMORY_END) {
+			end = LOW_MEMORY_END;
+		}
+		map[2 * count]     = start;
+		map[2 * count + 1] = end - start;
+		count++;
+	}
+	fclose(maps);
+
+	size_t tableEnd = sizeof(struct SnapshotHeader)
+					  + count * sizeof(struct SnapshotRegion);
+	size_t fileSize = (tableEnd + PAGE_SIZE - 1) & ~(size_t) (PAGE_SIZE - 1);
+	for (uint32_t i = 0; i < count; i++) {
+		fileSize += map[2 * i + 1];
+	}
+
+	struct Mapping file;
+	if (!mapFile(argv[1], true, fileSize, &file)) {
+		free(map);
+		return 1;
+	}
+	struct SnapshotHeader *header  = (struct SnapshotHeader *) file.data;
+	struct SnapshotRegion *regions = (struct SnapshotRegion *) (header + 1);
+	memcpy(header->magic, SNAPSHOT_MAGIC, 8);
+	header->pid         = pid;
+	header->timestampNs = plat_now_ns();
+	header->regionCount = count;
+
+	struct WowProcess process;
+	wowreader_attach(&process, pid);
+	uint64_t start      = plat_now_ns();
+	uint64_t offset     = (tableEnd + PAGE_SIZE - 1) & ~(size_t) (PAGE_SIZE - 1);
+	uint64_t unreadable = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		struct SnapshotRegion *region = &regions[i];
+		region->start                 = map[2 * i];
+		region->size                  = map[2 * i + 1];
+		region->offset                = offset;
+		offset += region->size;
+
+		// Straight into the file's pages; a failed chunk is retried page by
+		// page so one guard page does not cost the whole megabyte
+		for (uint64_t done = 0; done < region->size; done += CHUNK_SIZE) {
+			uint64_t size = region->size - done < CHUNK_SIZE
+								? region->size - done
+								: CHUNK_SIZE;
+			uint8_t *dest = file.data + region->offset + done;
+			if (wowreader_peek(&process, region->start + done, dest, size)) {
+				continue;
+			}
+			if (process.lastError == WOW_READ_DENIED
+				|| process.lastError == WOW_READ_GONE) {
+				fprintf(stderr, "memscan: cannot read PID %" PRIu64 ": %s\n",
+						pid, wowreader_errorName(process.lastError));
+				unmapFile(&file);
+				unlink(argv[1]);
+				free(map);
+				return 1;
+			}
+			for (uint64_t page = 0; page < size; page += PAGE_SIZE) {
+				if (!wowreader_peek(&process, region->start + done + page,
+									dest + page, PAGE_SIZE)) {
+					memset(dest + page, 0, PAGE_SIZE);
+					region->unreadable += PAGE_SIZE;
+				}
+			}
+		}
+		unreadable += region->unreadable;
+	}
+	wowreader_detach(&process);
+	free(map);
+
+	printf("%u regions, %.1f MB (%.1f MB unreadable) in %.2f s\n", count,
+		   (double) (fileSize - tableEnd) / 1e6, (double) unreadable / 1e6,
+		   (double) (plat_now_ns() - start) / 1e9);
+	unmapFile(&file);
+	return 0;
+}
+
+// Candidates
+
+static bool createCandidates(const char *path, enum ScanType type,
+							 const struct Snapshot *layout) {
+	size_t elementSize = scan_typeSize(type);
+	uint32_t count     = layout->header->regionCount;
+	size_t size        = sizeof(struct CandidatesHeader)
+				  + count * sizeof(struct CandidatesRegion);
+	for (uint32_t i = 0; i < count; i++) {
+		size += (layout->regions[i].size / elementSize + 63) / 64 * 8;
+	}
+
+	struct Mapping file;
+	if (!mapFile(path, true, size, &file)) {
+		return false;
+	}
+	struct CandidatesHeader *header  = (struct CandidatesHeader *) file.data;
+	struct CandidatesRegion *regions = (struct CandidatesRegion *) (header + 1);
+	memcpy(header->magic, CANDIDATES_MAGIC, 8);
+	header->type        = (uint32_t) type;
+	header->regionCount = count;
+
+	uint64_t offset = sizeof(*header) + count * sizeof(*regions);
+	for (uint32_t i = 0; i < count; i++) {
+		uint64_t elements  = layout->regions[i].size / elementSize;
+		regions[i].start   = layout->regions[i].start;
+		regions[i].size    = layout->regions[i].size;
+		regions[i].offset  = offset;
+		uint64_t words     = (elements + 63) / 64;
+		memset(file.data + offset, 0xFF, words * 8);
+		offset += words * 8;
+		header->alive += elements;
+	}
+	unmapFile(&file);
+	return true;
+}
+
+struct Candidates {
+	struct Mapping file;
+	struct CandidatesHeader *header;
+	struct CandidatesRegion *regions;
+};
+
+static bool openCandidates(const char *path, struct Candidates *candidates) {
+	if (!mapFile(path, true, 0, &candidates->file)) {
+		return false;
+	}
+	candidates->header = (struct CandidatesHeader *) candidates->file.data;
+	candidates->regions =
+		(struct CandidatesRegion *) (candidates->header + 1);
+	if (candidates->file.size < sizeof(struct CandidatesHeader)
+		|| memcmp(candidates->header->magic, CANDIDATES_MAGIC, 8) != 0
+		|| candidates->header->type > SCAN_F32) {
+		fprintf(stderr, "memscan: %s is not a candidates file\n", path);
+		unmapFile(&candidates->file);
+		return false;
+	}
+	return true;
+}
+
+static uint64_t *regionBits(const struct Candidates *candidates, uint32_t i) {
+	return (uint64_t *) (candidates->file.data + candidates->regions[i].offset);
+}
+
+static bool parseOp(const char *name, enum ScanOp *op) {
+	static const char *names[] = { "equal",		"changed", "increased",
+								   "decreased", "near",	   "value" };
+	for (int i = 0; i < (int) (sizeof(names) / sizeof(names[0])); i++) {
+		if (strcmp(name, names[i]) == 0) {
+			*op = (enum ScanOp) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool parseValue(const char *text, enum ScanType type,
+					   struct ScanQuery *query) {
+	char *end;
+	switch (type) {
+		case SCAN_U8:
+			query->value.u8 = (uint8_t) strtoul(text, &end, 0);
+			break;
+		case SCAN_I32:
+			query->value.i32 = (int32_t) strtol(text, &end, 0);
+			break;
+		case SCAN_U32:
+			query->value.u32 = (uint32_t) strtoul(text, &end, 0);
+			break;
+		default:
+			query->value.f32 = strtof(text, &end);
+			break;
+	}
+	return *text != '\0' && *end == '\0';
+}
+
+static int narrow(int argc, char **argv) {
+	const char *usage = "usage: memscan narrow CANDIDATES TYPE OP [ARG...] "
+						"[BEFORE] AFTER\n";
+	struct ScanQuery query;
+	memset(&query, 0, sizeof(query));
+	if (argc < 4 || !scan_parseType(argv[1], &query.type)
+		|| !parseOp(argv[2], &query.op)) {
+		fputs(usage, stderr);
+		return 2;
+	}
+
+	// Arguments of the operation, then the snapshots
+	int next = 3;
+	if (query.op == SCAN_NEAR) {
+		query.epsilon = next < argc ? strtof(argv[next++], NULL) : 0.0f;
+	} else if (query.op == SCAN_VALUE) {
+		if (next >= argc || !parseValue(argv[next++], query.type, &query)) {
+			fputs(usage, stderr);
+			return 2;
+		}
+		if (query.type == SCAN_F32 && argc - next == 2) {
+			query.epsilon = strtof(argv[next++], NULL);
+		}
+	}
+	if (query.op == SCAN_NEAR && query.type != SCAN_F32) {
+		fprintf(stderr, "memscan: near only works on f32\n");
+		return 2;
+	}
+	int snapshotCount = query.op == SCAN_VALUE ? 1 : 2;
+	if (argc - next != snapshotCount) {
+		fputs(usage, stderr);
+		return 2;
+	}
+
+	struct Snapshot before, after;
+	if (!openSnapshot(argv[argc - 1], &after)) {
+		return 1;
+	}
+	before = after;
+	if (snapshotCount == 2 && !openSnapshot(argv[next], &before)) {
+		return 1;
+	}
+
+	if (access(argv[0], F_OK) != 0
+		&& !createCandidates(argv[0], query.type, &after)) {
+		return 1;
+	}
+	struct Candidates candidates;
+	if (!openCandidates(argv[0], &candidates)) {
+		return 1;
+	}
+	if (candidates.header->type != (uint32_t) query.type) {
+		fprintf(stderr, "memscan: %s holds %s candidates\n", argv[0],
+				scan_typeName((enum ScanType) candidates.header->type));
+		return 2;
+	}
+
+	size_t elementSize = scan_typeSize(query.type);
+	uint64_t alive     = 0;
+	uint64_t compared  = 0;
+	uint64_t start     = plat_now_ns();
+	for (uint32_t i = 0; i < candidates.header->regionCount; i++) {
+		const struct CandidatesRegion *region = &candidates.regions[i];
+		const struct SnapshotRegion *a = findRegion(&before, region->start);
+		const struct SnapshotRegion *b = findRegion(&after, region->start);
+		uint64_t *bits                 = regionBits(&candidates, i);
+		uint64_t words = (region->size / elementSize + 63) / 64;
+
+		// Only what both snapshots still have is compared, in whole words
+		uint64_t size = region->size;
+		if (!a || !b) {
+			size = 0;
+		} else {
+			size = a->size < size ? a->size : size;
+			size = b->size < size ? b->size : size;
+		}
+		uint64_t full = size / elementSize / 64;
+		if (full > 0) {
+			alive += scan_narrow(&query, before.file.data + a->offset,
+								 after.file.data + b->offset, full * 64, bits);
+			compared += full * 64 * elementSize;
+		}
+		memset(bits + full, 0, (words - full) * 8);
+	}
+	uint64_t elapsed = plat_now_ns() - start;
+
+	candidates.header->alive = alive;
+	candidates.header->passes++;
+	printf("pass %" PRIu64 ": %" PRIu64 " candidates left, compared %.1f MB "
+		   "in %.3f s (%.2f GB/s)\n",
+		   candidates.header->passes, alive, (double) compared / 1e6,
+		   (double) elapsed / 1e9,
+		   elapsed ? (double) compared / (double) elapsed : 0.0);
+
+	unmapFile(&candidates.file);
+	if (snapshotCount == 2) {
+		unmapFile(&before.file);
+	}
+	unmapFile(&after.file);
+	return 0;
+}
+
+// Calls visit for every candidate, in address order, until it returns false
+static void forEachCandidate(const struct Candidates *candidates,
+							 bool (*visit)(uint64_t address, void *userdata),
+							 void *userdata) {
+	size_t elementSize =
+		scan_typeSize((enum ScanType) candidates->header->type);
+	for (uint32_t i = 0; i < candidates->header->regionCount; i++) {
+		const uint64_t *bits = regionBits(candidates, i);
+		uint64_t words =
+			(candidates->regions[i].size / elementSize + 63) / 64;
+		for (uint64_t w = 0; w < words; w++) {
+			for (uint64_t mask = bits[w]; mask; mask &= mask - 1) {
+				uint64_t element = w * 64 + (uint64_t) __builtin_ctzll(mask);
+				if (!visit(candidates->regions[i].start + element * elementSize,
+						   userdata)) {
+					return;
+				}
+			}
+		}
+	}
+}
+
+struct Printer {
+	const struct Snapshot *snapshot;
+	enum ScanType type;
+	uint64_t limit;
+	uint64_t printed;
+	const char *prefix;
+};
+
+static void formatValue(const struct Printer *printer, uint64_t address,
+						char *out, size_t size) {
+	const struct SnapshotRegion *region = NULL;
+	const struct Snapshot *snapshot     = printer->snapshot;
+	for (uint32_t i = 0; i < snapshot->header->regionCount; i++) {
+		if (address >= snapshot->regions[i].start
+			&& address - snapshot->regions[i].start
+				   < snapshot->regions[i].size) {
+			region = &snapshot->regions[i];
+			break;
+		}
+	}
+	if (!region) {
+		snprintf(out, size, "?");
+		return;
+	}
+
+	const uint8_t *data =
+		snapshot->file.data + region->offset + (address - region->start);
+	union {
+		uint8_t u8;
+		int32_t i32;
+		uint32_t u32;
+		float f32;
+	} value;
+	memcpy(&value, data, scan_typeSize(printer->type));
+	switch (printer->type) {
+		case SCAN_U8:
+			snprintf(out, size, "%u", value.u8);
+			break;
+		case SCAN_I32:
+			snprintf(out, size, "%" PRId32, value.i32);
+			break;
+		case SCAN_U32:
+			snprintf(out, size, "%" PRIu32 " (0x%08" PRIx32 ")", value.u32,
+					 value.u32);
+			break;
+		case SCAN_F32:
+			snprintf(out, size, "%g", (double) value.f32);
+			break;
+	}
+}
+
+static bool printCandidate(uint64_t address, void *userdata) {
+	struct Printer *printer = userdata;
+	char value[48];
+	formatValue(printer, address, value, sizeof(value));
+	printf("%s0x%08" PRIx64 "  %s\n", printer->prefix, address, value);
+	return ++printer->printed < printer->limit;
+}
+
+static int list(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr,
+				"usage: memscan list CANDIDATES SNAPSHOT [--limit N]\n");
+		return 2;
+	}
+	struct Candidates candidates;
+	struct Snapshot snapshot;
+	if (!openCandidates(argv[0], &candidates)
+		|| !openSnapshot(argv[1], &snapshot)) {
+		return 1;
+	}
+
+	struct Printer printer = { &snapshot,
+							   (enum ScanType) candidates.header->type, 20, 0,
+							   "" };
+	if (argc > 3 && strcmp(argv[2], "--limit") == 0) {
+		printer.limit = strtoull(argv[3], NULL, 10);
+	}
+	printf("%" PRIu64 " candidates after %" PRIu64 " passes\n",
+		   candidates.header->alive, candidates.header->passes);
+	if (printer.limit > 0) {
+		forEachCandidate(&candidates, printCandidate, &printer);
+	}
+	return 0;
+}
+
+static bool firstCandidate(uint64_t address, void *userdata) {
+	*(uint64_t *) userdata = address;
+	return false;
+}
+
+static int schema(int argc, char **argv) {
+	if (argc < 3) {
+		fprintf(stderr, "usage: memscan schema CANDIDATES SNAPSHOT NAME\n");
+		return 2;
+	}
+	struct Candidates candidates;
+	struct Snapshot snapshot;
+	if (!openCandidates(argv[0], &candidates)
+		|| !openSnapshot(argv[1], &snapshot)) {
+		return 1;
+	}
+	if (candidates.header->alive == 0) {
+		fprintf(stderr, "memscan: no candidates left\n");
+		return 1;
+	}
+
+	static const char *cTypes[] = { "uint8_t", "int", "uint32_t", "float" };
+	enum ScanType type = (enum ScanType) candidates.header->type;
+	char name[64];
+	size_t length = 0;
+	for (const char *c = argv[2]; *c && length + 1 < sizeof(name); c++) {
+		name[length++] = (*c >= 'a' && *c <= 'z') ? (char) (*c - 'a' + 'A')
+						 : (*c == '-')			   ? '_'
+												   : *c;
+	}
+	name[length] = '\0';
+
+	uint64_t address = 0;
+	forEachCandidate(&candidates, firstCandidate, &address);
+	char value[48];
+	struct Printer printer = { &snapshot, type, 8, 0, "//   " };
+	formatValue(&printer, address, value, sizeof(value));
+
+	printf("// %s, found with memscan after %" PRIu64 " passes (%s in the "
+		   "last snapshot)\n",
+		   cTypes[type], candidates.header->passes, value);
+	printf("#define WOW_ADDR_%s 0x%08" PRIX64 "u\n", name, address);
+	if (candidates.header->alive > 1) {
+		printf("// %" PRIu64 " candidates matched, the first is used:\n",
+			   candidates.header->alive);
+		forEachCandidate(&candidates, printCandidate, &printer);
+	}
+	return 0;
+}
+
+// Benchmark and self-check of the kernels
+
+static int bench(int argc, char **argv) {
+	size_t megabytes = argc > 0 ? strtoull(argv[0], NULL, 10) : 256;
+	size_t size      = megabytes << 20;
+	uint8_t *before  = mmap(NULL, size, PROT_READ | PROT_WRITE,
+							MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	uint8_t *after   = mmap(NULL, size, PROT_READ | PROT_WRITE,
+							MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	uint64_t *vector = malloc(size / 8);
+	uint64_t *scalar = malloc(size / 8);
+	if (before == MAP_FAILED || after == MAP_FAILED || !vector || !scalar) {
+		fprintf(stderr, "memscan: not enough memory for %zu MB\n", megabytes);
+		return 1;
+	}
+
+	// Mostly unchanged memory with a few floats moving, like a game frame
+	uint32_t seed = 42;
+	for (size_t i = 0; i < size / 4; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		float x = (float) (seed >> 8) / 65536.0f;
+		memcpy(before + 4 * i, &x, 4);
+		if ((seed & 0x3FF) == 0) {
+			x += (seed & 0x400) ? 0.001f : 1.0f;
+		}
+		memcpy(after + 4 * i, &x, 4);
+	}
+
+	static const struct {
+		enum ScanType type;
+		enum ScanOp op;
+		float value;
+		float epsilon;
+		const char *name;
+	} cases[] = {
+		{ SCAN_F32, SCAN_EQUAL, 0.0f, 0.0f, "f32 equal" },
+		{ SCAN_F32, SCAN_CHANGED, 0.0f, 0.0f, "f32 changed" },
+		{ SCAN_F32, SCAN_INCREASED, 0.0f, 0.0f, "f32 increased" },
+		{ SCAN_F32, SCAN_NEAR, 0.0f, 0.01f, "f32 near 0.01" },
+		{ SCAN_F32, SCAN_VALUE, 100.0f, 1.0f, "f32 value 100+-1" },
+		{ SCAN_I32, SCAN_INCREASED, 0.0f, 0.0f, "i32 increased" },
+		{ SCAN_U32, SCAN_DECREASED, 0.0f, 0.0f, "u32 decreased" },
+		{ SCAN_U8, SCAN_CHANGED, 0.0f, 0.0f, "u8 changed" },
+		{ SCAN_U8, SCAN_INCREASED, 0.0f, 0.0f, "u8 increased" },
+	};
+
+	int failures = 0;
+	printf("%zu MB per snapshot, first pass (every candidate alive)\n",
+		   megabytes);
+	for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+		struct ScanQuery query;
+		memset(&query, 0, sizeof(query));
+		query.type      = cases[c].type;
+		query.op        = cases[c].op;
+		query.epsilon   = cases[c].epsilon;
+		query.value.f32 = cases[c].value;
+		size_t count    = size / scan_typeSize(query.type);
+
+		memset(vector, 0xFF, count / 8);
+		memset(scalar, 0xFF, count / 8);
+		uint64_t start   = plat_now_ns();
+		uint64_t alive   = scan_narrow(&query, before, after, count, vector);
+		uint64_t simdNs  = plat_now_ns() - start;
+		start            = plat_now_ns();
+		uint64_t control = scan_narrowScalar(&query, before, after, count,
+											 scalar);
+		uint64_t scalarNs = plat_now_ns() - start;
+
+		bool same = alive == control && memcmp(vector, scalar, count / 8) == 0;
+		failures += !same;
+		printf("%-18s %10" PRIu64 " left  vector %6.3f s (%5.2f GB/s)  "
+			   "scalar %6.3f s (%5.2f GB/s)  %s\n",
+			   cases[c].name, alive, (double) simdNs / 1e9,
+			   2.0 * (double) size / (double) simdNs, (double) scalarNs / 1e9,
+			   2.0 * (double) size / (double) scalarNs,
+			   same ? "ok" : "MISMATCH");
+	}
+
+	munmap(before, size);
+	munmap(after, size);
+	free(vector);
+	free(scalar);
+	return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc >= 2) {
+		const char *command = argv[1];
+		if (strcmp(command, "snapshot") == 0) {
+			return takeSnapshot(argc - 2, argv + 2);
+		} else if (strcmp(command, "narrow") == 0) {
+			return narrow(argc - 2, argv + 2);
+		} else if (strcmp(command, "list") == 0) {
+			return list(argc - 2, argv + 2);
+		} else if (strcmp(command, "schema") == 0) {
+			return schema(argc - 2, argv + 2);
+		} else if (strcmp(command, "bench") == 0) {
+			return bench(argc - 2, argv + 2);
+		}
+	}
+	fprintf(stderr, "usage: memscan snapshot|narrow|list|schema|bench ...\n"
+					"see the top of tools/memscan.c\n");
+	return 2;
+}
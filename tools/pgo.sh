@@ -0,0 +1,102 @@
+#!/bin/sh
+# Profile-guided, link-time optimised release build of the plugin, and its
+# latency compared with a plain release build.
+#
+#   tools/pgo.sh [build directory] [training seconds]
+#
+# 1. Builds an instrumented plugin (PLUGIN_PGO=GENERATE, PLUGIN_LTO=ON) with
+#    the tools.
+# 2. Trains it: hostsim drives every callback against faketarget, with
+#    tools/pgo/wow335pa.conf turning on the optional per-frame work.
+# 3. Rebuilds the same directory with the profile (PLUGIN_PGO=USE).
+# 4. Builds a plain release plugin next to it and runs the same hostsim
+#    workload against both, printing the mean and max of every callback.
+#
+# The optimised plugin ends up in <build directory> (default build-pgo).
+
+set -eu
+
+source_dir=$(cd "$(dirname "$0")/.." && pwd)
+build_dir=${1:-build-pgo}
+seconds=${2:-20}
+mkdir -p "$build_dir"
+build_dir=$(cd "$build_dir" && pwd)
+plain_dir="$build_dir/plain"
+profile_dir="$build_dir/pgo-profile"
+jobs=$(nproc 2>/dev/null || echo 2)
+
+# The training config is picked up through XDG_CONFIG_HOME
+export XDG_CONFIG_HOME="$source_dir/tools/pgo"
+
+configure() {
+	dir=$1
+	shift
+	cmake -S "$source_dir" -B "$dir" -DCMAKE_BUILD_TYPE=Release \
+		-DBUILD_TOOLS=ON "$@" >/dev/null
+	cmake --build "$dir" -j"$jobs" >/dev/null
+}
+
+plugin_of() {
+	find "$1" -maxdepth 1 -name 'libwow355pa_*' | head -n 1
+}
+
+echo "== instrumented build"
+rm -rf "$profile_dir"
+# Same LTO and visibility as the final build: both change early inlining, and
+# the profile only applies to code with the same control flow
+configure "$build_dir" -DPLUGIN_PGO=GENERATE -DPLUGIN_LTO=ON \
+	-DPLUGIN_PGO_DIR="$profile_dir"
+
+echo "== training for $seconds s"
+"$build_dir/tools/hostsim" --seconds "$seconds" --fetch-ms 5 --sources 8 \
+	"$(plugin_of "$build_dir")" >/dev/null
+
+if ls "$profile_dir"/*.profraw >/dev/null 2>&1; then
+	llvm-profdata merge -output="$profile_dir/default.profdata" \
+		"$profile_dir"/*.profraw
+fi
+
+echo "== optimised build"
+configure "$build_dir" -DPLUGIN_PGO=USE -DPLUGIN_LTO=ON
+
+echo "== plain build"
+configure "$plain_dir" -DPLUGIN_PGO=OFF -DPLUGIN_LTO=OFF
+
+optimised=$(plugin_of "$build_dir")
+plain=$(plugin_of "$plain_dir")
+
+echo "== exported symbols"
+echo "plain:     $(nm -D --defined-only "$plain" | wc -l)"
+echo "optimised: $(nm -D --defined-only "$optimised" | wc -l)" \
+	"($(nm -D --defined-only "$optimised" | grep -vc ' mumble_') not mumble_*)"
+
+# Alternate the two plugins so drift on the machine hits both alike
+run() {
+	"$build_dir/tools/hostsim" --seconds 5 --fetch-ms 5 --sources 8 "$1"
+}
+: >"$build_dir/plain.txt"
+: >"$build_dir/optimised.txt"
+for round in 1 2 3; do
+	run "$plain" | grep ' calls ' >>"$build_dir/plain.txt"
+	run "$optimised" | grep ' calls ' >>"$build_dir/optimised.txt"
+done
+
+echo "== latency, mean over 3 runs of 5 s (us)"
+awk '
+	FNR == NR { mean[$1] += $5; if ($8 > max[$1]) max[$1] = $8; next }
+	{
+		omean[$1] += $5; if ($8 > omax[$1]) omax[$1] = $8
+		if (!($1 in seen)) { seen[$1] = 1; names[++count] = $1 }
+	}
+	END {
+		printf "%-34s %10s %10s %8s %10s %10s\n", "callback", "plain",
+			"optimised", "change", "plain max", "opt max"
+		for (i = 1; i <= count; i++) {
+			name = names[i]
+			p = mean[name] / 3; o = omean[name] / 3
+			change = p > 0 ? (o - p) * 100 / p : 0
+			printf "%-34s %10.2f %10.2f %+7.1f%% %10.2f %10.2f\n", name, p, o,
+				change, max[name], omax[name]
+		}
+	}
+' "$build_dir/plain.txt" "$build_dir/optimised.txt"
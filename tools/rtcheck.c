@@ -0,0 +1,394 @@
+#include "rtcheck.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#	include <linux/audit.h>
+#	include <linux/filter.h>
+#	include <linux/seccomp.h>
+#	include <sys/prctl.h>
+#	include <ucontext.h>
+#	define RTCHECK_SECCOMP 1
+#	ifdef __x86_64__
+#		define RTCHECK_AUDIT_ARCH AUDIT_ARCH_X86_64
+#	else
+#		define RTCHECK_AUDIT_ARCH AUDIT_ARCH_AARCH64
+#	endif
+#endif
+
+#define MAX_FRAMES 32
+
+// glibc's allocator, which the interposed functions forward to
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *pointer);
+
+static atomic_bool armed          = false;
+static atomic_uint violationCount = 0;
+static int reportFd               = 2;
+
+static _Thread_local const char *currentCallback = NULL;
+static _Thread_local bool reporting              = false;
+
+// Resolved on first use, as libc may call some of them before main
+#define RESOLVE(name)                             \
+	do {                                          \
+		if (!real_##name) {                       \
+			real_##name = dlsym(RTLD_NEXT, #name); \
+		}                                         \
+	} while (0)
+
+static int (*real_pthread_mutex_lock)(pthread_mutex_t *);
+static int (*real_pthread_cond_wait)(pthread_cond_t *, pthread_mutex_t *);
+static int (*real_pthread_cond_timedwait)(pthread_cond_t *,
+										  pthread_mutex_t *,
+										  const struct timespec *);
+static int (*real_sem_wait)(sem_t *);
+static int (*real_sem_timedwait)(sem_t *, const struct timespec *);
+static int (*real_nanosleep)(const struct timespec *, struct timespec *);
+static int (*real_clock_nanosleep)(clockid_t, int, const struct timespec *,
+								   struct timespec *);
+static int (*real_usleep)(useconds_t);
+static int (*real_open)(const char *, int, ...);
+static FILE *(*real_fopen)(const char *, const char *);
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_write)(int, const void *, size_t);
+static int (*real_poll)(struct pollfd *, nfds_t, int);
+
+// Only raw system calls from here on: no allocation, no stdio
+static void writeRaw(const char *text) {
+	size_t length = strlen(text);
+	while (length > 0) {
+		long written = syscall(SYS_write, reportFd, text, length);
+		if (written <= 0) {
+			return;
+		}
+		text += written;
+		length -= (size_t) written;
+	}
+}
+
+static void reportAt(const char *what, const char *where) {
+	if (reporting || !atomic_load_explicit(&armed, memory_order_relaxed)) {
+		return;
+	}
+	reporting = true;
+	atomic_fetch_add_explicit(&violationCount, 1, memory_order_relaxed);
+
+	writeRaw("rtcheck: ");
+	writeRaw(what);
+	writeRaw(" in ");
+	writeRaw(where);
+	writeRaw("\n");
+	void *frames[MAX_FRAMES];
+	int frameCount = backtrace(frames, MAX_FRAMES);
+	backtrace_symbols_fd(frames, frameCount, reportFd);
+	writeRaw("\n");
+
+	reporting = false;
+}
+
+void rtcheck_report(const char *what) {
+	if (currentCallback) {
+		reportAt(what, currentCallback);
+	}
+}
+
+#define CHECK(what)                          \
+	do {                                     \
+		if (currentCallback) {               \
+			reportAt(what, currentCallback); \
+		}                                    \
+	} while (0)
+
+// Allocator
+
+void *malloc(size_t size) {
+	CHECK("malloc");
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+	CHECK("calloc");
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+	CHECK("realloc");
+	return __libc_realloc(pointer, size);
+}
+
+void free(void *pointer) {
+	if (pointer) {
+		CHECK("free");
+	}
+	__libc_free(pointer);
+}
+
+int posix_memalign(void **pointer, size_t alignment, size_t size) {
+	CHECK("posix_memalign");
+	if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0) {
+		return EINVAL;
+	}
+	*pointer = __libc_memalign(alignment, size);
+	return *pointer ? 0 : ENOMEM;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+	CHECK("aligned_alloc");
+	return __libc_memalign(alignment, size);
+}
+
+// Locks and waits. pthread_mutex_trylock and sem_post never block and are
+// left alone.
+
+int pthread_mutex_lock(pthread_mutex_t *mutex) {
+	CHECK("pthread_mutex_lock");
+	RESOLVE(pthread_mutex_lock);
+	return real_pthread_mutex_lock(mutex);
+}
+
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex) {
+	CHECK("pthread_cond_wait");
+	RESOLVE(pthread_cond_wait);
+	return real_pthread_cond_wait(cond, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+						   const struct timespec *deadline) {
+	CHECK("pthread_cond_timedwait");
+	RESOLVE(pthread_cond_timedwait);
+	return real_pthread_cond_timedwait(cond, mutex, deadline);
+}
+
+int sem_wait(sem_t *sem) {
+	CHECK("sem_wait");
+	RESOLVE(sem_wait);
+	return real_sem_wait(sem);
+}
+
+int sem_timedwait(sem_t *sem, const struct timespec *deadline) {
+	CHECK("sem_timedwait");
+	RESOLVE(sem_timedwait);
+	return real_sem_timedwait(sem, deadline);
+}
+
+int nanosleep(const struct timespec *duration, struct timespec *remaining) {
+	CHECK("nanosleep");
+	RESOLVE(nanosleep);
+	return real_nanosleep(duration, remaining);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec *time,
+					struct timespec *remaining) {
+	CHECK("clock_nanosleep");
+	RESOLVE(clock_nanosleep);
+	return real_clock_nanosleep(clock, flags, time, remaining);
+}
+
+int usleep(useconds_t microseconds) {
+	CHECK("usleep");
+	RESOLVE(usleep);
+	return real_usleep(microseconds);
+}
+
+// I/O
+
+int open(const char *path, int flags, ...) {
+	CHECK("open");
+	mode_t mode = 0;
+	if (flags & (O_CREAT | O_TMPFILE)) {
+		va_list args;
+		va_start(args, flags);
+		mode = va_arg(args, mode_t);
+		va_end(args);
+	}
+	RESOLVE(open);
+	return real_open(path, flags, mode);
+}
+
+FILE *fopen(const char *path, const char *mode) {
+	CHECK("fopen");
+	RESOLVE(fopen);
+	return real_fopen(path, mode);
+}
+
+ssize_t read(int fd, void *buffer, size_t size) {
+	CHECK("read");
+	RESOLVE(read);
+	return real_read(fd, buffer, size);
+}
+
+ssize_t write(int fd, const void *buffer, size_t size) {
+	CHECK("write");
+	RESOLVE(write);
+	return real_write(fd, buffer, size);
+}
+
+int poll(struct pollfd *fds, nfds_t count, int timeout) {
+	CHECK("poll");
+	RESOLVE(poll);
+	return real_poll(fds, count, timeout);
+}
+
+// Seccomp
+
+#ifdef RTCHECK_SECCOMP
+static void onSigsys(int signal, siginfo_t *info, void *context) {
+	(void) signal;
+
+	char what[32] = "syscall ";
+	char digits[12];
+	int length = 0;
+	for (unsigned nr = (unsigned) info->si_syscall; length == 0 || nr > 0;
+		 nr /= 10) {
+		digits[length++] = (char) ('0' + nr % 10);
+	}
+	size_t at = strlen(what);
+	while (length > 0) {
+		what[at++] = digits[--length];
+	}
+	what[at] = '\0';
+	reportAt(what, currentCallback ? currentCallback : "host code");
+
+	// The call was not made; fail it
+	ucontext_t *uc = context;
+#	ifdef __x86_64__
+	uc->uc_mcontext.gregs[REG_RAX] = -ENOSYS;
+#	else
+	uc->uc_mcontext.regs[0] = (unsigned long long) -ENOSYS;
+#	endif
+}
+#endif
+
+bool rtcheck_installSeccomp(void) {
+#ifdef RTCHECK_SECCOMP
+	enum { ALLOW = 19 };
+	struct sock_filter filter[] = {
+		/* 0 */ BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+						 offsetof(struct seccomp_data, arch)),
+		/* 1 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, RTCHECK_AUDIT_ARCH, 1, 0),
+		/* 2 */ BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+		/* 3 */ BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+						 offsetof(struct seccomp_data, nr)),
+		/* 4 */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_clock_gettime, ALLOW - 5, 0),
+		/* 5 */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_rt_sigreturn, ALLOW - 6, 0),
+		/* 6 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_exit, ALLOW - 7, 0),
+		/* 7 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_write, 11 - 8, 0),
+		/* 8 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_writev, 11 - 9, 0),
+		/* 9 */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_clock_nanosleep, 14 - 10, 0),
+		/* 10 */ BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+		// Writes are only allowed to the report descriptor (backtrace output
+		// uses writev)
+		/* 11 */ BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+						  offsetof(struct seccomp_data, args[0])),
+		/* 12 */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (unsigned) reportFd, ALLOW - 13,
+				 0),
+		/* 13 */ BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+		// and sleeps to absolute deadlines on the monotonic clock, which is
+		// how the host paces its audio threads
+		/* 14 */ BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+						  offsetof(struct seccomp_data, args[0])),
+		/* 15 */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, CLOCK_MONOTONIC, 0, 18 - 16),
+		/* 16 */ BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+						  offsetof(struct seccomp_data, args[1])),
+		/* 17 */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, TIMER_ABSTIME, ALLOW - 18, 0),
+		/* 18 */ BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+		/* 19 */ BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+	};
+	struct sock_fprog program = {
+		.len    = (unsigned short) (sizeof(filter) / sizeof(filter[0])),
+		.filter = filter,
+	};
+
+	// Both only apply to the calling thread
+	return prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0
+		   && prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) == 0;
+#else
+	return false;
+#endif
+}
+
+_Noreturn void rtcheck_exitThread(void) {
+	// Only the thread exits; the kernel still clears the tid pthread_join
+	// waits on
+	for (;;) {
+		syscall(SYS_exit, 0);
+	}
+}
+
+void rtcheck_init(void) {
+	// The first backtrace() loads libgcc_s, which must not happen in a
+	// callback
+	void *frames[2];
+	backtrace(frames, 2);
+
+	// A descriptor of our own, so the seccomp filter can tell reports apart
+	// from writes by the plugin
+	int fd = fcntl(2, F_DUPFD_CLOEXEC, 100);
+	if (fd >= 0) {
+		reportFd = fd;
+	}
+
+#ifdef RTCHECK_SECCOMP
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = onSigsys;
+	action.sa_flags     = SA_SIGINFO;
+	sigaction(SIGSYS, &action, NULL);
+#endif
+
+	// Resolve everything up front rather than on first use in a callback
+	RESOLVE(pthread_mutex_lock);
+	RESOLVE(pthread_cond_wait);
+	RESOLVE(pthread_cond_timedwait);
+	RESOLVE(sem_wait);
+	RESOLVE(sem_timedwait);
+	RESOLVE(nanosleep);
+	RESOLVE(clock_nanosleep);
+	RESOLVE(usleep);
+	RESOLVE(open);
+	RESOLVE(fopen);
+	RESOLVE(read);
+	RESOLVE(write);
+	RESOLVE(poll);
+}
+
+void rtcheck_arm(bool on) {
+	atomic_store(&armed, on);
+}
+
+void rtcheck_enter(const char *callback) {
+	currentCallback = callback;
+}
+
+void rtcheck_leave(void) {
+	currentCallback = NULL;
+}
+
+uint32_t rtcheck_violations(void) {
+	return atomic_load(&violationCount);
+}
@@ -0,0 +1,41 @@
+#ifndef WOW335PA_RTCHECK_H_
+#define WOW335PA_RTCHECK_H_
+
+// Real-time safety checks for the host simulator. While a thread is inside a
+// plugin callback (between rtcheck_enter and rtcheck_leave) every call to the
+// allocator or to a function that can block is reported with a stack trace:
+// malloc, calloc, realloc, free, posix_memalign, aligned_alloc, mutex and
+// condition variable waits, sem_wait, sleeps, open/fopen, read/write and poll.
+// The checks work by interposition, so the host must export these symbols
+// (ENABLE_EXPORTS) and load the plugin with dlopen.
+//
+// Threads that call rtcheck_installSeccomp() additionally trap every system
+// call made inside a callback, including ones that bypass libc. Outside of
+// callbacks such a thread may only use clock_gettime, absolute
+// clock_nanosleep on CLOCK_MONOTONIC, and rtcheck_exitThread().
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Resolves the real functions and primes backtrace(). Call once from main
+// before any other thread starts.
+void rtcheck_init(void);
+// Turns reporting on or off for all threads
+void rtcheck_arm(bool armed);
+
+void rtcheck_enter(const char *callback);
+void rtcheck_leave(void);
+
+// Reports a violation in the current callback, if any, e.g. from a host API
+// function that must not be called on a real-time path
+void rtcheck_report(const char *what);
+
+// Linux x86-64 and AArch64 only; returns false where unavailable
+bool rtcheck_installSeccomp(void);
+// Ends a thread that installed the seccomp filter, bypassing the thread
+// teardown that the filter would trap
+_Noreturn void rtcheck_exitThread(void);
+
+uint32_t rtcheck_violations(void);
+
+#endif // WOW335PA_RTCHECK_H_
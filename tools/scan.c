@@ -0,0 +1,241 @@
+#include "scan.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) \
+	|| (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define SCAN_SSE2 1
+#endif
+
+size_t scan_typeSize(enum ScanType type) {
+	return type == SCAN_U8 ? 1 : 4;
+}
+
+static const char *typeNames[] = { "u8", "i32", "u32", "f32" };
+
+bool scan_parseType(const char *name, enum ScanType *type) {
+	for (int i = 0; i < (int) (sizeof(typeNames) / sizeof(typeNames[0]));
+		 i++) {
+		if (strcmp(name, typeNames[i]) == 0) {
+			*type = (enum ScanType) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *scan_typeName(enum ScanType type) {
+	return typeNames[type];
+}
+
+// Integer elements: NEAR has no meaning and behaves like EQUAL
+#define MATCH_INTEGER(op, x, y, v)        \
+	((op) == SCAN_CHANGED     ? (y) != (x) \
+	 : (op) == SCAN_INCREASED ? (y) > (x)  \
+	 : (op) == SCAN_DECREASED ? (y) < (x)  \
+	 : (op) == SCAN_VALUE     ? (y) == (v) \
+							  : (y) == (x))
+
+static bool matchScalar(const struct ScanQuery *query, const uint8_t *before,
+						const uint8_t *after) {
+	switch (query->type) {
+		case SCAN_U8:
+			return MATCH_INTEGER(query->op, *before, *after, query->value.u8);
+		case SCAN_I32: {
+			int32_t x, y;
+			memcpy(&x, before, 4);
+			memcpy(&y, after, 4);
+			return MATCH_INTEGER(query->op, x, y, query->value.i32);
+		}
+		case SCAN_U32: {
+			uint32_t x, y;
+			memcpy(&x, before, 4);
+			memcpy(&y, after, 4);
+			return MATCH_INTEGER(query->op, x, y, query->value.u32);
+		}
+		case SCAN_F32: {
+			float x, y;
+			memcpy(&x, before, 4);
+			memcpy(&y, after, 4);
+			switch (query->op) {
+				case SCAN_EQUAL:
+					return memcmp(before, after, 4) == 0;
+				case SCAN_CHANGED:
+					return memcmp(before, after, 4) != 0;
+				case SCAN_INCREASED:
+					return y > x;
+				case SCAN_DECREASED:
+					return y < x;
+				case SCAN_NEAR:
+					return fabsf(y - x) <= query->epsilon;
+				case SCAN_VALUE:
+					return fabsf(y - query->value.f32) <= query->epsilon;
+			}
+		}
+	}
+	return false;
+}
+
+// Matches of the 64 elements starting at before/after
+static uint64_t wordScalar(const struct ScanQuery *query, const uint8_t *before,
+						   const uint8_t *after, size_t size) {
+	uint64_t mask = 0;
+	for (int i = 0; i < 64; i++) {
+		if (matchScalar(query, before + i * size, after + i * size)) {
+			mask |= 1ull << i;
+		}
+	}
+	return mask;
+}
+
+#ifdef SCAN_SSE2
+// 4 bits, one per 32-bit lane
+static inline int match32(const struct ScanQuery *query, __m128i x, __m128i y,
+						  __m128i value, __m128 epsilon) {
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+	if (query->type == SCAN_F32) {
+		__m128 fx = _mm_castsi128_ps(x);
+		__m128 fy = _mm_castsi128_ps(y);
+		switch (query->op) {
+			case SCAN_EQUAL:
+				return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, y)));
+			case SCAN_CHANGED:
+				return ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, y)))
+					   & 0xF;
+			case SCAN_INCREASED:
+				return _mm_movemask_ps(_mm_cmpgt_ps(fy, fx));
+			case SCAN_DECREASED:
+				return _mm_movemask_ps(_mm_cmplt_ps(fy, fx));
+			case SCAN_NEAR:
+				return _mm_movemask_ps(_mm_cmple_ps(
+					_mm_and_ps(_mm_sub_ps(fy, fx), absMask), epsilon));
+			case SCAN_VALUE:
+				return _mm_movemask_ps(_mm_cmple_ps(
+					_mm_and_ps(_mm_sub_ps(fy, _mm_castsi128_ps(value)),
+							   absMask),
+					epsilon));
+		}
+		return 0;
+	}
+
+	// Unsigned order is signed order with the sign bits flipped
+	if (query->type == SCAN_U32
+		&& (query->op == SCAN_INCREASED || query->op == SCAN_DECREASED)) {
+		const __m128i sign = _mm_set1_epi32((int) 0x80000000u);
+		x                  = _mm_xor_si128(x, sign);
+		y                  = _mm_xor_si128(y, sign);
+	}
+	__m128i match;
+	switch (query->op) {
+		case SCAN_CHANGED:
+			return ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, y)))
+				   & 0xF;
+		case SCAN_INCREASED:
+			match = _mm_cmpgt_epi32(y, x);
+			break;
+		case SCAN_DECREASED:
+			match = _mm_cmpgt_epi32(x, y);
+			break;
+		case SCAN_VALUE:
+			match = _mm_cmpeq_epi32(y, value);
+			break;
+		default:
+			match = _mm_cmpeq_epi32(x, y);
+			break;
+	}
+	return _mm_movemask_ps(_mm_castsi128_ps(match));
+}
+
+// 16 bits, one per byte
+static inline int match8(const struct ScanQuery *query, __m128i x, __m128i y,
+						 __m128i value) {
+	switch (query->op) {
+		case SCAN_CHANGED:
+			return ~_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) & 0xFFFF;
+		case SCAN_INCREASED:
+			// max(x, y) != x
+			return ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(x, y), x))
+				   & 0xFFFF;
+		case SCAN_DECREASED:
+			return ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(x, y), y))
+				   & 0xFFFF;
+		case SCAN_VALUE:
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(y, value));
+		default:
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+	}
+}
+
+static uint64_t wordVector(const struct ScanQuery *query, const uint8_t *before,
+						   const uint8_t *after, __m128i value,
+						   __m128 epsilon) {
+	uint64_t mask = 0;
+	if (query->type == SCAN_U8) {
+		for (int i = 0; i < 4; i++) {
+			__m128i x = _mm_loadu_si128((const __m128i *) (before + 16 * i));
+			__m128i y = _mm_loadu_si128((const __m128i *) (after + 16 * i));
+			mask |= (uint64_t) match8(query, x, y, value) << (16 * i);
+		}
+	} else {
+		for (int i = 0; i < 16; i++) {
+			__m128i x = _mm_loadu_si128((const __m128i *) (before + 16 * i));
+			__m128i y = _mm_loadu_si128((const __m128i *) (after + 16 * i));
+			mask |= (uint64_t) match32(query, x, y, value, epsilon) << (4 * i);
+		}
+	}
+	return mask;
+}
+#endif
+
+uint64_t scan_narrow(const struct ScanQuery *query, const uint8_t *before,
+					 const uint8_t *after, size_t count, uint64_t *bits) {
+	size_t size    = scan_typeSize(query->type);
+	size_t stride  = 64 * size;
+	uint64_t alive = 0;
+	// VALUE ignores before; point it somewhere readable
+	if (query->op == SCAN_VALUE) {
+		before = after;
+	}
+
+#ifdef SCAN_SSE2
+	__m128i value = query->type == SCAN_U8
+						? _mm_set1_epi8((char) query->value.u8)
+						: _mm_set1_epi32((int) query->value.u32);
+	__m128 epsilon = _mm_set1_ps(query->epsilon);
+#endif
+
+	for (size_t w = 0; w < count / 64; w++) {
+		if (bits[w] == 0) {
+			continue;
+		}
+#ifdef SCAN_SSE2
+		bits[w] &= wordVector(query, before + w * stride, after + w * stride,
+							  value, epsilon);
+#else
+		bits[w] &= wordScalar(query, before + w * stride, after + w * stride,
+							  size);
+#endif
+		alive += (uint64_t) __builtin_popcountll(bits[w]);
+	}
+	return alive;
+}
+
+uint64_t scan_narrowScalar(const struct ScanQuery *query, const uint8_t *before,
+						   const uint8_t *after, size_t count, uint64_t *bits) {
+	size_t size    = scan_typeSize(query->type);
+	uint64_t alive = 0;
+	if (query->op == SCAN_VALUE) {
+		before = after;
+	}
+	for (size_t w = 0; w < count / 64; w++) {
+		if (bits[w] != 0) {
+			bits[w] &= wordScalar(query, before + w * 64 * size,
+								  after + w * 64 * size, size);
+			alive += (uint64_t) __builtin_popcountll(bits[w]);
+		}
+	}
+	return alive;
+}
@@ -0,0 +1,57 @@
+#ifndef WOW335PA_SCAN_H_
+#define WOW335PA_SCAN_H_
+
+// Compare kernels of the memory scanner. Candidates are a bitmap with one bit
+// per element (bit i of word w is element 64 * w + i); a kernel compares a
+// block of elements between two snapshots, or against a value, and clears the
+// bits of the elements that do not match. Words that are already zero are
+// skipped, so later passes only touch the memory of surviving candidates.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum ScanType {
+	SCAN_U8,
+	SCAN_I32,
+	SCAN_U32,
+	SCAN_F32,
+};
+
+enum ScanOp {
+	// after == before (bitwise for floats)
+	SCAN_EQUAL,
+	SCAN_CHANGED,
+	SCAN_INCREASED,
+	SCAN_DECREASED,
+	// |after - before| <= epsilon, floats only
+	SCAN_NEAR,
+	// after == value, or |after - value| <= epsilon for floats; before is not
+	// used
+	SCAN_VALUE,
+};
+
+struct ScanQuery {
+	enum ScanType type;
+	enum ScanOp op;
+	union {
+		uint8_t u8;
+		int32_t i32;
+		uint32_t u32;
+		float f32;
+	} value;
+	float epsilon;
+};
+
+size_t scan_typeSize(enum ScanType type);
+bool scan_parseType(const char *name, enum ScanType *type);
+const char *scan_typeName(enum ScanType type);
+
+// count must be a multiple of 64. Returns the number of candidates left.
+uint64_t scan_narrow(const struct ScanQuery *query, const uint8_t *before,
+					 const uint8_t *after, size_t count, uint64_t *bits);
+// One element at a time; the reference the vector kernels must agree with
+uint64_t scan_narrowScalar(const struct ScanQuery *query, const uint8_t *before,
+						   const uint8_t *after, size_t count, uint64_t *bits);
+
+#endif // WOW335PA_SCAN_H_
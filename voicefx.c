@@ -0,0 +1,143 @@
+#include "voicefx.h"
+
+#include "config.h"
+#include "dsp.h"
+#include "flatmap.h"
+#include "platform.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Distinct per-map curves, the default one included
+#define MAX_CURVES 32
+#define MAP_CAPACITY 64
+
+struct Source {
+	// Roster slots are reused, so remember whom the state belongs to
+	mumble_userid_t user;
+	uint64_t lastNs;
+	struct DspVoice voice;
+};
+
+static bool enabled;
+static float minDistance;
+static float maxDistance;
+static float behindCutoff;
+static float ghostCutoff;
+static uint64_t passiveTimeoutNs;
+
+// Read-only once voicefx_init returns
+static struct DspCurve curves[MAX_CURVES];
+static uint32_t curveCount;
+static uint32_t mapKeys[MAP_CAPACITY];
+static uint32_t mapValues[MAP_CAPACITY];
+static struct FlatMap mapCurves;
+
+// Audio thread state, indexed by roster slot
+static struct Source sources[ROSTER_MAX_USERS];
+
+static void parseCurve(struct DspCurve *curve, const char *value) {
+	if (strcmp(value, "linear") == 0) {
+		dsp_curveInit(curve, DSP_CURVE_LINEAR, minDistance, maxDistance, NULL,
+					  0);
+		return;
+	}
+	if (strcmp(value, "inverse") == 0) {
+		dsp_curveInit(curve, DSP_CURVE_INVERSE, minDistance, maxDistance, NULL,
+					  0);
+		return;
+	}
+
+	float points[DSP_CURVE_MAX_POINTS];
+	uint32_t count = 0;
+	char *end;
+	for (const char *p = value; count < DSP_CURVE_MAX_POINTS; p = end) {
+		float point = strtof(p, &end);
+		if (end == p) {
+			break;
+		}
+		points[count++] = point;
+		// Accept both "1 0.5 0" and "1, 0.5, 0"
+		while (*end == ',' || *end == ' ') {
+			end++;
+		}
+	}
+	dsp_curveInit(curve, DSP_CURVE_CUSTOM, minDistance, maxDistance, points,
+				  count);
+}
+
+static void addMapCurve(const char *key, const char *value, void *userdata) {
+	(void) userdata;
+
+	if (curveCount == MAX_CURVES) {
+		return;
+	}
+	parseCurve(&curves[curveCount], value);
+	if (flatmap_put(&mapCurves, (uint32_t) atoi(key), curveCount)) {
+		curveCount++;
+	}
+}
+
+void voicefx_init(void) {
+	enabled      = config_getBool("fx.enabled", false);
+	minDistance  = config_getFloat("fx.min_distance", 5.0f);
+	maxDistance  = config_getFloat("fx.max_distance", 60.0f);
+	behindCutoff = config_getFloat("fx.behind_cutoff", 3000.0f);
+	ghostCutoff  = config_getFloat("fx.ghost_cutoff", 1000.0f);
+	passiveTimeoutNs =
+		(uint64_t) config_getInt("dsp.passive_timeout_ms", 1000) * 1000000ull;
+
+	parseCurve(&curves[0], config_getString("fx.curve", "inverse"));
+	curveCount = 1;
+	flatmap_init(&mapCurves, mapKeys, mapValues, MAP_CAPACITY);
+	config_forEach("fx.curve.", addMapCurve, NULL);
+
+	for (uint32_t i = 0; i < ROSTER_MAX_USERS; i++) {
+		sources[i].user = ROSTER_NO_USER;
+	}
+}
+
+bool voicefx_enabled(void) {
+	return enabled;
+}
+
+bool voicefx_process(const struct RosterUser *user, float *pcm,
+					 uint32_t sampleCount, uint16_t channelCount,
+					 uint32_t sampleRate, int mapId, const float relative[3]) {
+	float distance = sqrtf(relative[0] * relative[0] + relative[1] * relative[1]
+						   + relative[2] * relative[2]);
+
+	uint32_t curve = 0;
+	flatmap_get(&mapCurves, (uint32_t) mapId, &curve);
+	float gain = dsp_curveGain(&curves[curve], distance);
+
+	// Fade the behind cue in from the side so turning around is smooth
+	float coefficient = 0.0f;
+	if (distance > 0.0f && relative[0] < 0.0f) {
+		coefficient = -relative[0] / distance
+					  * dsp_lowpassCoefficient(behindCutoff, sampleRate);
+	}
+	if (atomic_load_explicit(&user->ghost, memory_order_relaxed)) {
+		float ghost = dsp_lowpassCoefficient(ghostCutoff, sampleRate);
+		if (ghost > coefficient) {
+			coefficient = ghost;
+		}
+	}
+
+	struct Source *source = &sources[roster_slot(user)];
+	mumble_userid_t id    = atomic_load_explicit(&user->id,
+												 memory_order_relaxed);
+	uint64_t nowNs        = plat_now_ns();
+	// Sources are only processed while speaking (see plugin.c), so a long gap
+	// means a new utterance that should not start with the old filter state
+	if (source->user != id || nowNs - source->lastNs >= passiveTimeoutNs) {
+		source->user = id;
+		dsp_voiceReset(&source->voice, gain);
+	}
+	source->lastNs = nowNs;
+	dsp_process(&source->voice, pcm, sampleCount, channelCount, gain,
+				coefficient);
+
+	return true;
+}
@@ -0,0 +1,35 @@
+#ifndef WOW335PA_VOICEFX_H_
+#define WOW335PA_VOICEFX_H_
+
+// Cheap spatial effect for voices, as an alternative (or a companion) to the
+// HRTF renderer: distance attenuation from a lookup curve chosen per map, and
+// a low-pass that muffles speakers behind the camera and speakers who are
+// ghosts. Configuration:
+//   fx.enabled       = false
+//   fx.curve         = inverse   (linear, inverse or a list of gains evenly
+//                                 spaced from 0 to fx.max_distance)
+//   fx.curve.<mapId> = linear    (overrides fx.curve on that map)
+//   fx.min_distance  = 5         (yards of full volume)
+//   fx.max_distance  = 60        (yards, silent beyond)
+//   fx.behind_cutoff = 3000      (Hz, 0 disables)
+//   fx.ghost_cutoff  = 1000      (Hz, 0 disables)
+// Filter state is reset when a user spoke again after a pause of
+//   dsp.passive_timeout_ms = 1000
+
+#include "roster.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Reads the config. Call from mumble_init.
+void voicefx_init(void);
+bool voicefx_enabled(void);
+
+// Audio thread only. Applies the effect in place to a source buffer of the
+// given user. relative is the speaker's position relative to the listener (see
+// gamestate_toListener), mapId the listener's map.
+bool voicefx_process(const struct RosterUser *user, float *pcm,
+					 uint32_t sampleCount, uint16_t channelCount,
+					 uint32_t sampleRate, int mapId, const float relative[3]);
+
+#endif // WOW335PA_VOICEFX_H_
@@ -0,0 +1,40 @@
+#ifndef WOW335PA_WOWLAYOUT_H_
+#define WOW335PA_WOWLAYOUT_H_
+
+// Where the 3.3.5a (build 12340) client keeps the values read by wowreader.c.
+// Shared with the tools in tools/ that stand in for the game.
+//
+// The addresses are those of wow.exe loaded at its preferred base. The reader
+// only uses them as offsets into the image: at attach time it looks up where
+// WOW_MODULE really is (pemap.h) and moves every field by the difference.
+
+#define WOW_MODULE "wow.exe"
+#define WOW_IMAGE_BASE 0x00400000u
+
+// char, 1 while in the world
+#define WOW_ADDR_STATE 0x00BD0792u
+// float[3], WoW coordinates; the avatar and the camera are read from the same
+// place
+#define WOW_ADDR_AVATAR_POS 0x00ADF4E4u
+// float, radians
+#define WOW_ADDR_AVATAR_HEADING 0x00BEBA70u
+#define WOW_ADDR_CAMERA_POS 0x00ADF4E4u
+// float[3]
+#define WOW_ADDR_CAMERA_FRONT 0x00ADF5F0u
+#define WOW_ADDR_CAMERA_TOP 0x00ADF554u
+// char[50]
+#define WOW_ADDR_PLAYER 0x00C79D18u
+// uint8
+#define WOW_ADDR_CLASS 0x00C79E89u
+// int32
+#define WOW_ADDR_MAP_ID 0x00AB63BCu
+#define WOW_ADDR_ZONE_ID 0x00BD080Cu
+#define WOW_ADDR_LEADER_GUID 0x00BD1968u
+// float[3], zero while alive
+#define WOW_ADDR_CORPSE_POS 0x00BD0A58u
+
+// Page-aligned range covering all of the above
+#define WOW_ADDR_FIRST 0x00AB6000u
+#define WOW_ADDR_END 0x00C7A000u
+
+#endif // WOW335PA_WOWLAYOUT_H_
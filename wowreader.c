@@ -0,0 +1,391 @@
+#include "wowreader.h"
+
+#include "attachcache.h"
+#include "pemap.h"
+#include "platform.h"
+#include "wowlayout.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#	include <windows.h>
+#	include <tlhelp32.h>
+#else
+#	include <ctype.h>
+#	include <dirent.h>
+#	include <errno.h>
+#	include <stdlib.h>
+#	include <strings.h>
+#	include <sys/uio.h>
+#endif
+
+#ifdef _WIN32
+typedef LPVOID procptr_t; // Windows process pointer type
+#else
+typedef void *procptr_t; // Unix/Linux process pointer type
+#endif
+
+// Function to read memory from a process
+static inline bool peekProc(struct WowProcess *process, const procptr_t addr,
+							void *dest, const size_t len) {
+#ifdef _WIN32
+	SIZE_T bytesRead;
+
+	// Make sure we have a valid handle
+	if (process->handle == NULL) {
+		// Open process with PROCESS_VM_READ access right
+		process->handle =
+			OpenProcess(PROCESS_VM_READ, FALSE, (DWORD) process->pid);
+		if (process->handle == NULL) {
+			process->lastError = GetLastError() == ERROR_ACCESS_DENIED
+									 ? WOW_READ_DENIED
+									 : WOW_READ_GONE;
+			return false;
+		}
+	}
+
+	BOOL success =
+		ReadProcessMemory(process->handle, // Handle to the process
+						  (LPCVOID) addr,  // Base address to read from
+						  dest,            // Buffer to receive data
+						  len,             // Number of bytes to read
+						  &bytesRead       // Number of bytes actually read
+		);
+
+	if (success == FALSE) {
+		process->lastError = GetLastError() == ERROR_PARTIAL_COPY
+								 ? WOW_READ_UNMAPPED
+								 : WOW_READ_OTHER;
+		return false;
+	}
+	if (bytesRead != len) {
+		process->lastError = WOW_READ_PARTIAL;
+		return false;
+	}
+	return true;
+#else
+	// On Linux/Unix, use process_vm_readv
+	struct iovec in;
+	in.iov_base = (void *) (addr); // Address from target process
+	in.iov_len  = len;             // Length
+
+	struct iovec out;
+	out.iov_base = dest;
+	out.iov_len  = len;
+
+	ssize_t nread =
+		process_vm_readv((pid_t) process->pid, &out, 1, &in, 1, 0);
+
+	if (nread == -1) {
+		switch (errno) {
+			case EPERM:
+				process->lastError = WOW_READ_DENIED;
+				break;
+			case ESRCH:
+				process->lastError = WOW_READ_GONE;
+				break;
+			case EFAULT:
+				process->lastError = WOW_READ_UNMAPPED;
+				break;
+			default:
+				process->lastError = WOW_READ_OTHER;
+				break;
+		}
+		return false;
+	}
+	if ((size_t) nread != len) {
+		process->lastError = WOW_READ_PARTIAL;
+		return false;
+	}
+	return true;
+#endif
+}
+
+const char *wowreader_errorName(enum WowReadError error) {
+	switch (error) {
+		case WOW_READ_OK:
+			return "ok";
+		case WOW_READ_DENIED:
+			return "denied";
+		case WOW_READ_GONE:
+			return "gone";
+		case WOW_READ_UNMAPPED:
+			return "unmapped";
+		case WOW_READ_PARTIAL:
+			return "partial";
+		case WOW_READ_STALE:
+			return "stale";
+		default:
+			return "other";
+	}
+}
+
+const char *wowreader_fieldName(enum WowField field) {
+	switch (field) {
+		case WOW_FIELD_STATE:
+			return "state";
+		case WOW_FIELD_AVATAR_POS:
+			return "avatar_pos";
+		case WOW_FIELD_HEADING:
+			return "heading";
+		case WOW_FIELD_CAMERA_POS:
+			return "camera_pos";
+		case WOW_FIELD_CAMERA_FRONT:
+			return "camera_front";
+		case WOW_FIELD_CAMERA_TOP:
+			return "camera_top";
+		case WOW_FIELD_PLAYER:
+			return "player";
+		case WOW_FIELD_MAP_ID:
+			return "map_id";
+		case WOW_FIELD_LEADER_GUID:
+			return "leader_guid";
+		case WOW_FIELD_CLASS:
+			return "class";
+		case WOW_FIELD_ZONE_ID:
+			return "zone_id";
+		case WOW_FIELD_CORPSE_POS:
+			return "corpse_pos";
+		default:
+			return "unknown";
+	}
+}
+
+#ifndef _WIN32
+bool wowreader_isWineRunningWow(uint64_t pid) {
+	char cmdlinePath[256];
+	char buffer[512];
+	snprintf(cmdlinePath, sizeof(cmdlinePath), "/proc/%llu/cmdline",
+			 (unsigned long long) pid);
+
+	FILE *cmdlineFile = fopen(cmdlinePath, "r");
+	if (!cmdlineFile) {
+		return false;
+	}
+
+	size_t bytesRead = fread(buffer, 1, sizeof(buffer) - 1, cmdlineFile);
+	fclose(cmdlineFile);
+
+	if (bytesRead == 0) {
+		return false;
+	}
+
+	// Ensure null-termination
+	buffer[bytesRead] = '\0';
+
+	// Make the buffer lowercase for case-insensitive comparison
+	for (size_t i = 0; i < bytesRead; i++) {
+		buffer[i] = tolower(buffer[i]);
+	}
+
+	return (strstr(buffer, WOW_EXE) != NULL);
+}
+
+uint64_t wowreader_findClient(void) {
+	DIR *proc = opendir("/proc");
+	if (!proc) {
+		return 0;
+	}
+
+	uint64_t found = 0;
+	struct dirent *entry;
+	while (!found && (entry = readdir(proc)) != NULL) {
+		if (!isdigit((unsigned char) entry->d_name[0])) {
+			continue;
+		}
+		uint64_t pid = strtoull(entry->d_name, NULL, 10);
+
+		char path[64];
+		char name[64] = { 0 };
+		snprintf(path, sizeof(path), "/proc/%llu/comm",
+				 (unsigned long long) pid);
+		FILE *file = fopen(path, "r");
+		if (!file) {
+			continue;
+		}
+		if (fgets(name, sizeof(name), file)) {
+			name[strcspn(name, "\n")] = '\0';
+		}
+		fclose(file);
+
+		if (strcasecmp(name, WOW_EXE) == 0
+			|| ((strcasecmp(name, WINE_PRELOADER) == 0
+				 || strcasecmp(name, WINE_PROCESS) == 0)
+				&& wowreader_isWineRunningWow(pid))) {
+			found = pid;
+		}
+	}
+	closedir(proc);
+
+	return found;
+}
+#else
+uint64_t wowreader_findClient(void) {
+	HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+	if (snapshot == INVALID_HANDLE_VALUE) {
+		return 0;
+	}
+
+	uint64_t found = 0;
+	PROCESSENTRY32 entry;
+	entry.dwSize = sizeof(entry);
+	for (BOOL more = Process32First(snapshot, &entry); more && !found;
+		 more = Process32Next(snapshot, &entry)) {
+		if (_stricmp(entry.szExeFile, WOW_EXE) == 0) {
+			found = entry.th32ProcessID;
+		}
+	}
+	CloseHandle(snapshot);
+
+	return found;
+}
+#endif
+
+static bool readModule(void *userdata, uint64_t address, void *dest,
+					   size_t len) {
+	return peekProc(userdata, (procptr_t) (uintptr_t) address, dest, len);
+}
+
+void wowreader_attach(struct WowProcess *process, uint64_t pid) {
+	process->pid       = pid;
+	process->handle    = NULL;
+	process->lastError = WOW_READ_OK;
+
+	struct PeModule image;
+	process->imageCached = attachcache_load(pid, readModule, process, &image);
+	process->imageFound =
+		process->imageCached
+		|| pemap_find(pid, WOW_MODULE, readModule, process, &image);
+	if (process->imageFound && !process->imageCached) {
+		attachcache_store(pid, &image);
+	}
+	process->imageBase = process->imageFound ? image.base : WOW_IMAGE_BASE;
+	process->lastError = WOW_READ_OK;
+
+	struct WowAddresses *addresses = &process->addresses;
+#define RESOLVE(address) (process->imageBase + ((address) - WOW_IMAGE_BASE))
+	addresses->state       = RESOLVE(WOW_ADDR_STATE);
+	addresses->avatarPos   = RESOLVE(WOW_ADDR_AVATAR_POS);
+	addresses->heading     = RESOLVE(WOW_ADDR_AVATAR_HEADING);
+	addresses->cameraPos   = RESOLVE(WOW_ADDR_CAMERA_POS);
+	addresses->cameraFront = RESOLVE(WOW_ADDR_CAMERA_FRONT);
+	addresses->cameraTop   = RESOLVE(WOW_ADDR_CAMERA_TOP);
+	addresses->player      = RESOLVE(WOW_ADDR_PLAYER);
+	addresses->playerClass = RESOLVE(WOW_ADDR_CLASS);
+	addresses->mapId       = RESOLVE(WOW_ADDR_MAP_ID);
+	addresses->zoneId      = RESOLVE(WOW_ADDR_ZONE_ID);
+	addresses->leaderGUID  = RESOLVE(WOW_ADDR_LEADER_GUID);
+	addresses->corpsePos   = RESOLVE(WOW_ADDR_CORPSE_POS);
+#undef RESOLVE
+}
+
+void wowreader_detach(struct WowProcess *process) {
+#ifdef _WIN32
+	if (process->handle != NULL) {
+		CloseHandle(process->handle);
+	}
+#endif
+	process->handle = NULL;
+	process->pid    = 0;
+}
+
+bool wowreader_peek(struct WowProcess *process, uint64_t address, void *dest,
+					size_t len) {
+	process->lastError = WOW_READ_OK;
+	return peekProc(process, (procptr_t) (uintptr_t) address, dest, len);
+}
+
+bool wowreader_read(struct WowProcess *process,
+					struct GameSnapshot *snapshot) {
+	memset(snapshot, 0, sizeof(*snapshot));
+	snapshot->timestampNs = plat_now_ns();
+	process->lastError    = WOW_READ_OK;
+
+	// Stops at the first failed read, like the client going away mid-frame
+	const struct WowAddresses *at = &process->addresses;
+#define PEEK(field, address, dest, len) \
+	(process->failedField = (field),    \
+	 peekProc(process, (procptr_t) (uintptr_t) (address), dest, len))
+	snapshot->valid =
+		PEEK(WOW_FIELD_STATE, at->state, &snapshot->state, 1)
+		&& PEEK(WOW_FIELD_AVATAR_POS, at->avatarPos, snapshot->avatarPos, 12)
+		&& PEEK(WOW_FIELD_HEADING, at->heading, &snapshot->heading, 4)
+		&& PEEK(WOW_FIELD_CAMERA_POS, at->cameraPos, snapshot->cameraPos, 12)
+		&& PEEK(WOW_FIELD_CAMERA_FRONT, at->cameraFront,
+				snapshot->cameraFront, 12)
+		&& PEEK(WOW_FIELD_CAMERA_TOP, at->cameraTop, snapshot->cameraTop, 12)
+		&& PEEK(WOW_FIELD_PLAYER, at->player, snapshot->player,
+				sizeof(snapshot->player))
+		&& PEEK(WOW_FIELD_MAP_ID, at->mapId, &snapshot->mapId, 4)
+		&& PEEK(WOW_FIELD_LEADER_GUID, at->leaderGUID, &snapshot->leaderGUID,
+				4);
+#undef PEEK
+	snapshot->player[sizeof(snapshot->player) - 1] = '\0';
+
+	// Only features that are nice to have need these, so a wrong or unmapped
+	// address costs its own field and not positional audio
+#define PEEK_OPTIONAL(flag, address, dest, len)                               \
+	if (!peekProc(process, (procptr_t) (uintptr_t) (address), dest, len)) { \
+		memset(dest, 0, len);                                                 \
+		snapshot->missing |= (flag);                                          \
+	}
+	if (snapshot->valid) {
+		PEEK_OPTIONAL(GAME_MISSING_CLASS, at->playerClass,
+					  &snapshot->playerClass, 1);
+		PEEK_OPTIONAL(GAME_MISSING_ZONE, at->zoneId, &snapshot->zoneId, 4);
+		PEEK_OPTIONAL(GAME_MISSING_CORPSE, at->corpsePos, snapshot->corpsePos,
+					  12);
+		process->lastError = WOW_READ_OK;
+	}
+#undef PEEK_OPTIONAL
+
+	return snapshot->valid;
+}
+
+void wowreader_toFrame(const struct GameSnapshot *snapshot,
+					   enum WowReadError error, struct PosringFrame *frame) {
+	memset(frame, 0, sizeof(*frame));
+	frame->timestampNs = snapshot->timestampNs;
+	frame->valid       = snapshot->valid;
+	frame->state       = (uint8_t) snapshot->state;
+	frame->error       = (uint8_t) error;
+	frame->playerClass = snapshot->playerClass;
+	frame->missing     = snapshot->missing;
+	frame->mapId       = snapshot->mapId;
+	frame->zoneId      = snapshot->zoneId;
+	frame->leaderGUID  = snapshot->leaderGUID;
+	frame->heading     = snapshot->heading;
+	memcpy(frame->avatarPos, snapshot->avatarPos, sizeof(frame->avatarPos));
+	memcpy(frame->cameraPos, snapshot->cameraPos, sizeof(frame->cameraPos));
+	memcpy(frame->cameraFront, snapshot->cameraFront,
+		   sizeof(frame->cameraFront));
+	memcpy(frame->cameraTop, snapshot->cameraTop, sizeof(frame->cameraTop));
+	memcpy(frame->corpsePos, snapshot->corpsePos, sizeof(frame->corpsePos));
+	memcpy(frame->player, snapshot->player, sizeof(snapshot->player));
+}
+
+enum WowReadError wowreader_fromFrame(const struct PosringFrame *frame,
+									  struct GameSnapshot *snapshot) {
+	snapshot->timestampNs = frame->timestampNs;
+	snapshot->valid       = frame->valid != 0;
+	snapshot->state       = (char) frame->state;
+	snapshot->playerClass = frame->playerClass;
+	snapshot->missing     = frame->missing;
+	snapshot->mapId       = frame->mapId;
+	snapshot->zoneId      = frame->zoneId;
+	snapshot->leaderGUID  = frame->leaderGUID;
+	snapshot->heading     = frame->heading;
+	memcpy(snapshot->avatarPos, frame->avatarPos, sizeof(frame->avatarPos));
+	memcpy(snapshot->cameraPos, frame->cameraPos, sizeof(frame->cameraPos));
+	memcpy(snapshot->cameraFront, frame->cameraFront,
+		   sizeof(frame->cameraFront));
+	memcpy(snapshot->cameraTop, frame->cameraTop, sizeof(frame->cameraTop));
+	memcpy(snapshot->corpsePos, frame->corpsePos, sizeof(frame->corpsePos));
+	memcpy(snapshot->player, frame->player, sizeof(snapshot->player));
+	snapshot->player[sizeof(snapshot->player) - 1] = '\0';
+
+	return frame->error < WOW_READ_ERROR_COUNT
+			   ? (enum WowReadError) frame->error
+			   : WOW_READ_OTHER;
+}
@@ -0,0 +1,126 @@
+#ifndef WOW335PA_WOWREADER_H_
+#define WOW335PA_WOWREADER_H_
+
+// The read plan for one frame: finding the client, reading the values listed
+// in wowlayout.h out of its memory, and converting between snapshots and the
+// frames of the shared-memory export (posring.h). Shared by the plugin and the
+// reader daemon (daemon/), so both read exactly the same thing.
+
+#include "gamestate.h"
+#include "posring.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WOW_EXE "wow.exe" // lowercase
+
+#ifndef _WIN32
+// Wine process names
+#	define WINE_PRELOADER "wine-preloader"
+#	define WINE_PROCESS "wine"
+#endif
+
+// Why a read failed. Travels in PosringFrame.error, so the values are fixed.
+enum WowReadError {
+	WOW_READ_OK       = 0,
+	// No permission to read the process (ptrace rights)
+	WOW_READ_DENIED   = 1,
+	// The process exited
+	WOW_READ_GONE     = 2,
+	// An address is not mapped, e.g. while the client starts
+	WOW_READ_UNMAPPED = 3,
+	WOW_READ_PARTIAL  = 4,
+	WOW_READ_OTHER    = 5,
+	// Only from the daemon backend: its newest frame is too old
+	WOW_READ_STALE    = 6,
+	WOW_READ_ERROR_COUNT
+};
+
+// The fields of one frame, in the order wowreader_read reads them
+enum WowField {
+	WOW_FIELD_STATE,
+	WOW_FIELD_AVATAR_POS,
+	WOW_FIELD_HEADING,
+	WOW_FIELD_CAMERA_POS,
+	WOW_FIELD_CAMERA_FRONT,
+	WOW_FIELD_CAMERA_TOP,
+	WOW_FIELD_PLAYER,
+	WOW_FIELD_MAP_ID,
+	WOW_FIELD_LEADER_GUID,
+	// Optional: a failed read only zeroes the field, see GameSnapshot.missing
+	WOW_FIELD_CLASS,
+	WOW_FIELD_ZONE_ID,
+	WOW_FIELD_CORPSE_POS,
+	WOW_FIELD_COUNT
+};
+
+// Where the fields of wowlayout.h are in one particular process
+struct WowAddresses {
+	uint64_t state;
+	uint64_t avatarPos;
+	uint64_t heading;
+	uint64_t cameraPos;
+	uint64_t cameraFront;
+	uint64_t cameraTop;
+	uint64_t player;
+	uint64_t playerClass;
+	uint64_t mapId;
+	uint64_t zoneId;
+	uint64_t leaderGUID;
+	uint64_t corpsePos;
+};
+
+struct WowProcess {
+	uint64_t pid;
+	// Process handle on Windows, opened on the first read
+	void *handle;
+	// Set by wowreader_read; failedField is the field it stopped at
+	enum WowReadError lastError;
+	enum WowField failedField;
+	// Resolved once by wowreader_attach. Without imageFound (the client is not
+	// loaded yet, or not a PE image) imageBase falls back to WOW_IMAGE_BASE.
+	// imageCached: it came from the attach cache (attachcache.h).
+	bool imageFound;
+	bool imageCached;
+	uint64_t imageBase;
+	struct WowAddresses addresses;
+};
+
+const char *wowreader_errorName(enum WowReadError error);
+const char *wowreader_fieldName(enum WowField field);
+
+#ifndef _WIN32
+// Whether the command line of a Wine process mentions the client
+bool wowreader_isWineRunningWow(uint64_t pid);
+#endif
+
+// Looks for the client among all processes with the same matching as
+// mumble_initPositionalData; 0 if it is not running. Reads /proc (the
+// process list on Windows), so it belongs to background threads.
+uint64_t wowreader_findClient(void);
+
+// Finds the client image in the process, from the attach cache if the process
+// was seen before, and resolves the fields of wowlayout.h against wherever the
+// client image is loaded. Reads files; not for the per-frame path.
+void wowreader_attach(struct WowProcess *process, uint64_t pid);
+void wowreader_detach(struct WowProcess *process);
+
+// Reads len bytes at address of the game process; sets process->lastError on
+// failure. For tools that look at more than one frame's worth of memory.
+bool wowreader_peek(struct WowProcess *process, uint64_t address, void *dest,
+					size_t len);
+
+// Reads one frame and stamps it with the current time. Returns
+// snapshot->valid, which only takes the fields before the optional ones.
+// Fields whose read failed are zero; process->lastError tells why a required
+// one failed, snapshot->missing which optional ones did.
+bool wowreader_read(struct WowProcess *process, struct GameSnapshot *snapshot);
+
+void wowreader_toFrame(const struct GameSnapshot *snapshot,
+					   enum WowReadError error, struct PosringFrame *frame);
+// Returns the error the writer recorded for the frame
+enum WowReadError wowreader_fromFrame(const struct PosringFrame *frame,
+									  struct GameSnapshot *snapshot);
+
+#endif // WOW335PA_WOWREADER_H_